@@ -8,6 +8,7 @@ import (
 	mqtt "github.com/eclipse/paho.mqtt.golang"
 )
 
+// Run with: go run consumer.go decode.go
 func main() {
 	broker := "tcp://localhost:1883" // Mqtt broker address
 	clientID := "DDNETConsumer"      // Client ID to be used when connecting to the broker
@@ -37,7 +38,13 @@ func main() {
 	 * This handler will be called for all messages received on the subscribed topics
 	 */
 	opts.SetDefaultPublishHandler(func(client mqtt.Client, msg mqtt.Message) {
-		log.Printf("Received message[%s]: %s\n", msg.Topic(), string(msg.Payload()))
+		// Payloads can be JSON, CBOR or MessagePack depending on sv_mqtt_encoding, see decode.go
+		payload, err := decodePayload(msg.Payload())
+		if err != nil {
+			log.Printf("Received undecodable message[%s]: %v\n", msg.Topic(), err)
+			return
+		}
+		log.Printf("Received message[%s]: %s\n", msg.Topic(), payload)
 	})
 
 	// Handle lost connection
@@ -0,0 +1,291 @@
+package main
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"math"
+)
+
+/**
+ * The server encodes the payloads of each channel as JSON, CBOR or MessagePack (sv_mqtt_encoding).
+ * The encoding is sent in the MQTT 5 content type property. This MQTT 3.1.1 client can't see it,
+ * but all structured payloads are maps, so the first byte tells the encodings apart:
+ * - '{':                  JSON
+ * - 0xa0-0xbf:            CBOR map
+ * - 0x80-0x8f, 0xde, 0xdf: MessagePack map
+ * Anything else is a plain text message.
+ *
+ * Run the consumer with: go run consumer.go decode.go
+ */
+
+// decodePayload turns a payload of any encoding into a JSON string for printing
+func decodePayload(payload []byte) (string, error) {
+	if len(payload) == 0 {
+		return "", nil
+	}
+	first := payload[0]
+	var value any
+	var err error
+	switch {
+	case first == '{':
+		return string(payload), nil
+	case first >= 0xa0 && first <= 0xbf:
+		value, _, err = decodeCbor(payload)
+	case (first >= 0x80 && first <= 0x8f) || first == 0xde || first == 0xdf:
+		value, _, err = decodeMsgpack(payload)
+	default:
+		return string(payload), nil
+	}
+	if err != nil {
+		return "", err
+	}
+	out, err := json.Marshal(value)
+	return string(out), err
+}
+
+var errTruncated = errors.New("truncated payload")
+
+func need(data []byte, n int) error {
+	if len(data) < n {
+		return errTruncated
+	}
+	return nil
+}
+
+// decodeCbor decodes the subset of CBOR written by nlohmann::json::to_cbor
+func decodeCbor(data []byte) (any, []byte, error) {
+	if err := need(data, 1); err != nil {
+		return nil, nil, err
+	}
+	major := data[0] >> 5
+	info := data[0] & 0x1f
+	data = data[1:]
+
+	if major == 7 {
+		switch info {
+		case 20:
+			return false, data, nil
+		case 21:
+			return true, data, nil
+		case 22, 23:
+			return nil, data, nil
+		case 25:
+			if err := need(data, 2); err != nil {
+				return nil, nil, err
+			}
+			return halfToFloat(binary.BigEndian.Uint16(data)), data[2:], nil
+		case 26:
+			if err := need(data, 4); err != nil {
+				return nil, nil, err
+			}
+			return float64(math.Float32frombits(binary.BigEndian.Uint32(data))), data[4:], nil
+		case 27:
+			if err := need(data, 8); err != nil {
+				return nil, nil, err
+			}
+			return math.Float64frombits(binary.BigEndian.Uint64(data)), data[8:], nil
+		}
+		return nil, nil, fmt.Errorf("unsupported cbor simple value %d", info)
+	}
+
+	var arg uint64
+	switch {
+	case info < 24:
+		arg = uint64(info)
+	case info == 24:
+		if err := need(data, 1); err != nil {
+			return nil, nil, err
+		}
+		arg, data = uint64(data[0]), data[1:]
+	case info == 25:
+		if err := need(data, 2); err != nil {
+			return nil, nil, err
+		}
+		arg, data = uint64(binary.BigEndian.Uint16(data)), data[2:]
+	case info == 26:
+		if err := need(data, 4); err != nil {
+			return nil, nil, err
+		}
+		arg, data = uint64(binary.BigEndian.Uint32(data)), data[4:]
+	case info == 27:
+		if err := need(data, 8); err != nil {
+			return nil, nil, err
+		}
+		arg, data = binary.BigEndian.Uint64(data), data[8:]
+	default:
+		return nil, nil, fmt.Errorf("unsupported cbor length %d", info)
+	}
+
+	switch major {
+	case 0:
+		return arg, data, nil
+	case 1:
+		return -1 - int64(arg), data, nil
+	case 2, 3:
+		if uint64(len(data)) < arg {
+			return nil, nil, errTruncated
+		}
+		return string(data[:arg]), data[arg:], nil
+	case 4:
+		return decodeArray(data, arg, decodeCbor)
+	case 5:
+		return decodeMap(data, arg, decodeCbor)
+	}
+	return nil, nil, fmt.Errorf("unsupported cbor major type %d", major)
+}
+
+// decodeMsgpack decodes the subset of MessagePack written by nlohmann::json::to_msgpack
+func decodeMsgpack(data []byte) (any, []byte, error) {
+	if err := need(data, 1); err != nil {
+		return nil, nil, err
+	}
+	b := data[0]
+	data = data[1:]
+
+	readUint := func(size int) (uint64, error) {
+		if err := need(data, size); err != nil {
+			return 0, err
+		}
+		var v uint64
+		for _, c := range data[:size] {
+			v = v<<8 | uint64(c)
+		}
+		data = data[size:]
+		return v, nil
+	}
+
+	switch {
+	case b <= 0x7f:
+		return uint64(b), data, nil
+	case b >= 0xe0:
+		return int64(int8(b)), data, nil
+	case b >= 0x80 && b <= 0x8f:
+		return decodeMap(data, uint64(b&0x0f), decodeMsgpack)
+	case b >= 0x90 && b <= 0x9f:
+		return decodeArray(data, uint64(b&0x0f), decodeMsgpack)
+	case b >= 0xa0 && b <= 0xbf:
+		return readString(data, uint64(b&0x1f))
+	}
+
+	switch b {
+	case 0xc0:
+		return nil, data, nil
+	case 0xc2:
+		return false, data, nil
+	case 0xc3:
+		return true, data, nil
+	case 0xc4, 0xd9:
+		n, err := readUint(1)
+		if err != nil {
+			return nil, nil, err
+		}
+		return readString(data, n)
+	case 0xc5, 0xda:
+		n, err := readUint(2)
+		if err != nil {
+			return nil, nil, err
+		}
+		return readString(data, n)
+	case 0xc6, 0xdb:
+		n, err := readUint(4)
+		if err != nil {
+			return nil, nil, err
+		}
+		return readString(data, n)
+	case 0xca:
+		v, err := readUint(4)
+		return float64(math.Float32frombits(uint32(v))), data, err
+	case 0xcb:
+		v, err := readUint(8)
+		return math.Float64frombits(v), data, err
+	case 0xcc, 0xcd, 0xce, 0xcf:
+		v, err := readUint(1 << (b - 0xcc))
+		return v, data, err
+	case 0xd0, 0xd1, 0xd2, 0xd3:
+		size := 1 << (b - 0xd0)
+		v, err := readUint(size)
+		shift := 64 - 8*size
+		return int64(v<<shift) >> shift, data, err
+	case 0xdc, 0xdd:
+		n, err := readUint(2 << (b - 0xdc))
+		if err != nil {
+			return nil, nil, err
+		}
+		return decodeArray(data, n, decodeMsgpack)
+	case 0xde, 0xdf:
+		n, err := readUint(2 << (b - 0xde))
+		if err != nil {
+			return nil, nil, err
+		}
+		return decodeMap(data, n, decodeMsgpack)
+	}
+	return nil, nil, fmt.Errorf("unsupported msgpack type 0x%02x", b)
+}
+
+type decoder func([]byte) (any, []byte, error)
+
+func readString(data []byte, n uint64) (any, []byte, error) {
+	if uint64(len(data)) < n {
+		return nil, nil, errTruncated
+	}
+	return string(data[:n]), data[n:], nil
+}
+
+func decodeArray(data []byte, n uint64, decode decoder) (any, []byte, error) {
+	if n > uint64(len(data)) {
+		return nil, nil, errTruncated
+	}
+	array := make([]any, 0, n)
+	for i := uint64(0); i < n; i++ {
+		var value any
+		var err error
+		if value, data, err = decode(data); err != nil {
+			return nil, nil, err
+		}
+		array = append(array, value)
+	}
+	return array, data, nil
+}
+
+func decodeMap(data []byte, n uint64, decode decoder) (any, []byte, error) {
+	if n > uint64(len(data)) {
+		return nil, nil, errTruncated
+	}
+	object := make(map[string]any, n)
+	for i := uint64(0); i < n; i++ {
+		var key, value any
+		var err error
+		if key, data, err = decode(data); err != nil {
+			return nil, nil, err
+		}
+		if value, data, err = decode(data); err != nil {
+			return nil, nil, err
+		}
+		object[fmt.Sprint(key)] = value
+	}
+	return object, data, nil
+}
+
+func halfToFloat(half uint16) float64 {
+	exponent := int(half>>10) & 0x1f
+	mantissa := float64(half & 0x3ff)
+	var value float64
+	switch exponent {
+	case 0:
+		value = math.Ldexp(mantissa, -24)
+	case 31:
+		if mantissa == 0 {
+			value = math.Inf(1)
+		} else {
+			value = math.NaN()
+		}
+	default:
+		value = math.Ldexp(mantissa+1024, exponent-25)
+	}
+	if half&0x8000 != 0 {
+		return -value
+	}
+	return value
+}
@@ -0,0 +1,115 @@
+#!/bin/bash
+
+arg_clients=64
+arg_ticks=500
+arg_threads="1 2 4 8"
+arg_map="Sunny Side Up"
+
+function print_help() {
+	echo "usage: $(basename "$0") [OPTION..]"
+	echo "description:"
+	echo "  Measures the time the server needs to build the snapshots of"
+	echo "  debug dummies with different values of sv_snapshot_threads."
+	echo "  Runs the debug server binary from the current build directory."
+	echo "options:"
+	echo "  --help|-h             show this help"
+	echo "  --clients N           number of debug dummies (default: $arg_clients)"
+	echo "  --ticks N             number of measured ticks (default: $arg_ticks)"
+	echo "  --threads \"N..\"       snapshot thread counts to compare (default: \"$arg_threads\")"
+	echo "  --map NAME            map from data/maps (default: \"$arg_map\")"
+}
+
+while [ "$#" -gt 0 ]; do
+	case "$1" in
+	-h | --help)
+		print_help
+		exit 0
+		;;
+	--clients)
+		arg_clients="$2"
+		shift
+		;;
+	--ticks)
+		arg_ticks="$2"
+		shift
+		;;
+	--threads)
+		arg_threads="$2"
+		shift
+		;;
+	--map)
+		arg_map="$2"
+		shift
+		;;
+	*)
+		echo "Error: unknown argument '$1'"
+		exit 1
+		;;
+	esac
+	shift
+done
+
+if [ ! -f DDNet-Server ]; then
+	echo "[-] Error: server binary 'DDNet-Server' not found"
+	exit 1
+fi
+if [ ! -f "data/maps/$arg_map.map" ]; then
+	echo "[-] Error: map 'data/maps/$arg_map.map' not found"
+	exit 1
+fi
+
+rm -rf benchmark_snapshots
+mkdir -p benchmark_snapshots/data/maps
+cp "data/maps/$arg_map.map" benchmark_snapshots/data/maps
+cd benchmark_snapshots || exit 1
+
+{
+	echo $'add_path $CURRENTDIR'
+	echo $'add_path $USERDIR'
+	echo $'add_path $DATADIR'
+	echo $'add_path ../data'
+} > storage.cfg
+
+for threads in $arg_threads; do
+	# Get unused port from the system by binding to port 0 and immediately closing the socket again
+	port=$(python3 -c 'import socket; s=socket.socket(); s.bind(("", 0)); print(s.getsockname()[1]); s.close()')
+
+	rm -f server.fifo
+	../DDNet-Server \
+		"sv_input_fifo server.fifo;
+		sv_map \"$arg_map\";
+		sv_max_clients $arg_clients;
+		sv_sqlite_file ddnet-server.sqlite;
+		sv_register 0;
+		sv_port $port;
+		sv_high_bandwidth 1;
+		sv_snapshot_threads $threads;
+		dbg_dummies $arg_clients;
+		dbg_bench_snapshots $arg_ticks" > "server_$threads.txt" 2>&1 &
+	pid=$!
+
+	# warmup plus measured ticks at 50 ticks per second, with some slack
+	timeout=$(((arg_ticks + 50) / 50 + 30))
+	for ((i = 0; i < timeout * 10; i++)); do
+		if grep -q "snapshot benchmark:" "server_$threads.txt" || ! kill -0 "$pid" 2> /dev/null; then
+			break
+		fi
+		sleep 0.1
+	done
+
+	if ! grep "snapshot benchmark:" "server_$threads.txt" | sed 's/.*snapshot benchmark: /[*] /'; then
+		echo "[-] Error: no result for $threads threads, see benchmark_snapshots/server_$threads.txt"
+		if ! grep -q "dbg_bench_snapshots" "server_$threads.txt"; then
+			echo "[-] Note: dbg_bench_snapshots is only available in debug builds"
+		fi
+	fi
+
+	if [ -r "/proc/$pid/status" ]; then
+		echo "[*] $(grep -E "^VmHWM:" "/proc/$pid/status" | tr -s '\t ' ' ') (peak RSS)"
+	fi
+
+	if [ -p server.fifo ]; then
+		echo "shutdown" > server.fifo
+	fi
+	wait "$pid"
+done
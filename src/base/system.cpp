@@ -40,6 +40,7 @@
 #include <netinet/in.h>
 #include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 
 #include <dirent.h>
@@ -84,6 +85,13 @@
 #include <sys/filio.h>
 #endif
 
+#if defined(CONF_PLATFORM_LINUX)
+#include <sys/vfs.h>
+#elif defined(CONF_PLATFORM_MACOS)
+#include <sys/mount.h>
+#include <sys/param.h>
+#endif
+
 IOHANDLE io_stdin()
 {
 	return stdin;
@@ -158,6 +166,19 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+#if defined(CONF_PLATFORM_LINUX)
+/* packets queued by net_udp_send until net_udp_flush */
+typedef struct
+{
+	int num;
+	int socks[VLEN];
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	struct sockaddr_storage sockaddrs[VLEN];
+} NETSOCKET_SEND_BATCH;
+#endif
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -166,6 +187,9 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+#if defined(CONF_PLATFORM_LINUX)
+	NETSOCKET_SEND_BATCH *send_batch;
+#endif
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -445,6 +469,85 @@ int io_sync(IOHANDLE io)
 #endif
 }
 
+#if defined(CONF_PLATFORM_LINUX) || defined(CONF_PLATFORM_MACOS)
+/* files on these can be truncated by other machines at any time, and the
+   pages of a mapping can fail to load when the connection is lost, which
+   raises SIGBUS on access */
+static bool io_is_remote(IOHANDLE io)
+{
+	struct statfs fs;
+	if(fstatfs(fileno((FILE *)io), &fs) != 0)
+		return true;
+#if defined(CONF_PLATFORM_LINUX)
+	switch((unsigned long)fs.f_type)
+	{
+	case 0x6969: /* NFS_SUPER_MAGIC */
+	case 0x517B: /* SMB_SUPER_MAGIC */
+	case 0xFF534D42: /* CIFS_SUPER_MAGIC */
+	case 0xFE534D42: /* SMB2_SUPER_MAGIC */
+	case 0x65735546: /* FUSE_SUPER_MAGIC */
+	case 0x01021997: /* V9FS_MAGIC */
+	case 0x00C36400: /* CEPH_SUPER_MAGIC */
+	case 0x5346414F: /* AFS_SUPER_MAGIC */
+		return true;
+	}
+	return false;
+#else
+	return !(fs.f_flags & MNT_LOCAL);
+#endif
+}
+#endif
+
+void *io_map(IOHANDLE io, size_t *size)
+{
+	*size = 0;
+#if defined(CONF_PLATFORM_LINUX) || defined(CONF_PLATFORM_MACOS)
+	if(io_is_remote(io))
+		return nullptr;
+#endif
+	long int length = io_length(io);
+	if(length <= 0)
+		return nullptr;
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping = CreateFileMappingW((HANDLE)_get_osfhandle(_fileno((FILE *)io)), NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping == NULL)
+		return nullptr;
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	// the view keeps the mapping alive
+	CloseHandle(mapping);
+	if(data == NULL)
+		return nullptr;
+#else
+	void *data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileno((FILE *)io), 0);
+	if(data == MAP_FAILED)
+		return nullptr;
+#endif
+	*size = length;
+	return data;
+}
+
+bool io_map_valid(IOHANDLE io, size_t size)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	__int64 length = _filelengthi64(_fileno((FILE *)io));
+	return length >= 0 && (unsigned __int64)length >= size;
+#else
+	struct stat st;
+	return fstat(fileno((FILE *)io), &st) == 0 && st.st_size >= 0 && (size_t)st.st_size >= size;
+#endif
+}
+
+void io_unmap(void *data, size_t size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 #define ASYNC_BUFSIZE (8 * 1024)
 #define ASYNC_LOCAL_BUFSIZE (64 * 1024)
 
@@ -452,6 +555,8 @@ struct ASYNCIO
 {
 	CLock lock;
 	IOHANDLE io;
+	AIO_FILTER filter;
+	void *filter_user;
 	SEMAPHORE sphore;
 	void *thread;
 
@@ -530,6 +635,11 @@ static void aio_thread(void *user)
 			{
 				if(aio->finish == ASYNCIO_CLOSE)
 				{
+					if(aio->filter)
+					{
+						aio->filter(aio->io, nullptr, 0, aio->filter_user);
+						aio->error = io_error(aio->io);
+					}
 					io_close(aio->io);
 				}
 				aio_handle_free_and_unlock(aio);
@@ -563,7 +673,10 @@ static void aio_thread(void *user)
 		aio->read_pos = (aio->read_pos + buffers.len1 + buffers.len2) % aio->buffer_size;
 		aio->lock.unlock();
 
-		io_write(aio->io, local_buffer, local_buffer_len);
+		if(aio->filter)
+			aio->filter(aio->io, local_buffer, local_buffer_len, aio->filter_user);
+		else
+			io_write(aio->io, local_buffer, local_buffer_len);
 		io_flush(aio->io);
 		result_io_error = io_error(aio->io);
 
@@ -573,6 +686,11 @@ static void aio_thread(void *user)
 }
 
 ASYNCIO *aio_new(IOHANDLE io)
+{
+	return aio_new_filtered(io, nullptr, nullptr);
+}
+
+ASYNCIO *aio_new_filtered(IOHANDLE io, AIO_FILTER filter, void *user)
 {
 	ASYNCIO *aio = new ASYNCIO;
 	if(!aio)
@@ -580,6 +698,8 @@ ASYNCIO *aio_new(IOHANDLE io)
 		return 0;
 	}
 	aio->io = io;
+	aio->filter = filter;
+	aio->filter_user = user;
 	sphore_init(&aio->sphore);
 	aio->thread = 0;
 
@@ -1631,6 +1751,104 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+static int priv_net_udp_sendto(NETSOCKET sock, int socket, const void *data, int size, const struct sockaddr *sa, socklen_t salen)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	NETSOCKET_SEND_BATCH *batch = sock->send_batch;
+	if(batch && size <= PACKETSIZE)
+	{
+		if(batch->num == VLEN)
+			net_udp_flush(sock);
+		const int i = batch->num++;
+		batch->socks[i] = socket;
+		mem_copy(batch->bufs[i], data, size);
+		batch->iovecs[i].iov_len = size;
+		mem_copy(&batch->sockaddrs[i], sa, salen);
+		batch->msgs[i].msg_hdr.msg_namelen = salen;
+		return size;
+	}
+	/* keep the order of the queued packets */
+	if(batch)
+		net_udp_flush(sock);
+#endif
+	network_stats.send_calls++;
+	return sendto(socket, (const char *)data, size, 0, sa, salen);
+}
+
+void net_udp_set_batching(NETSOCKET sock, bool enable)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(enable && !sock->send_batch)
+	{
+		NETSOCKET_SEND_BATCH *batch = (NETSOCKET_SEND_BATCH *)malloc(sizeof(*batch));
+		batch->num = 0;
+		mem_zero(batch->msgs, sizeof(batch->msgs));
+		for(int i = 0; i < VLEN; i++)
+		{
+			batch->iovecs[i].iov_base = batch->bufs[i];
+			batch->msgs[i].msg_hdr.msg_iov = &batch->iovecs[i];
+			batch->msgs[i].msg_hdr.msg_iovlen = 1;
+			batch->msgs[i].msg_hdr.msg_name = &batch->sockaddrs[i];
+		}
+		sock->send_batch = batch;
+	}
+	else if(!enable && sock->send_batch)
+	{
+		net_udp_flush(sock);
+		free(sock->send_batch);
+		sock->send_batch = NULL;
+	}
+#endif
+}
+
+int net_udp_flush(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	NETSOCKET_SEND_BATCH *batch = sock->send_batch;
+	if(!batch)
+		return 0;
+
+	int sent = 0;
+	int dropped = 0;
+	int error = 0;
+	int pos = 0;
+	while(pos < batch->num)
+	{
+		/* one call per run of packets on the same socket */
+		int end = pos + 1;
+		while(end < batch->num && batch->socks[end] == batch->socks[pos])
+			end++;
+		while(pos < end)
+		{
+			network_stats.send_calls++;
+			int result = sendmmsg(batch->socks[pos], &batch->msgs[pos], end - pos, 0);
+			if(result <= 0)
+			{
+				/* drop the packet that failed, like sendto would */
+				if(result < 0 && errno == EINTR)
+					continue;
+				if(!error)
+					error = result < 0 ? errno : EIO;
+				dropped++;
+				pos++;
+				continue;
+			}
+			pos += result;
+			sent += result;
+		}
+	}
+	batch->num = 0;
+	if(dropped)
+	{
+		dbg_msg("net", "sendmmsg error (%d '%s'), dropped %d of %d packets", error, strerror(error), dropped, sent + dropped);
+		return -1;
+	}
+	return sent;
+#else
+	return 0;
+#endif
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
@@ -1650,7 +1868,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 			else
 				netaddr_to_sockaddr_in(addr, &sa);
 
-			d = sendto((int)sock->ipv4sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			d = priv_net_udp_sendto(sock, sock->ipv4sock, data, size, (struct sockaddr *)&sa, sizeof(sa));
 		}
 		else
 			dbg_msg("net", "can't send ipv4 traffic to this socket");
@@ -1688,7 +1906,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 			else
 				netaddr_to_sockaddr_in6(addr, &sa);
 
-			d = sendto((int)sock->ipv6sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			d = priv_net_udp_sendto(sock, sock->ipv6sock, data, size, (struct sockaddr *)&sa, sizeof(sa));
 		}
 		else
 			dbg_msg("net", "can't send ipv6 traffic to this socket");
@@ -1836,6 +2054,9 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 int net_udp_close(NETSOCKET sock)
 {
+#if defined(CONF_PLATFORM_LINUX)
+	net_udp_set_batching(sock, false);
+#endif
 	return priv_net_close_all_sockets(sock);
 }
 
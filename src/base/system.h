@@ -358,6 +358,58 @@ long int io_tell(IOHANDLE io);
  */
 long int io_length(IOHANDLE io);
 
+/**
+ * Maps the contents of a file into memory for reading.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param size Receives the size of the file.
+ *
+ * @return Pointer to the contents of the file, `nullptr` if the file is
+ * empty or can't be mapped.
+ *
+ * @remark The contents are read from the file when they are accessed.
+ * @remark The mapping stays valid after closing the file, until it is
+ * released with @link io_unmap @endlink.
+ * @remark If the file is truncated while it is mapped, accessing the part
+ * past the new end crashes the process with `SIGBUS`. Check the size with
+ * @link io_map_valid @endlink before accessing the mapping if the file may
+ * be modified in place.
+ * @remark Files on network or FUSE filesystems are not mapped, as they can
+ * be changed by other machines. Read them with @link io_read @endlink
+ * instead.
+ */
+void *io_map(IOHANDLE io, size_t *size);
+
+/**
+ * Checks whether a file is still large enough to access its mapping up to
+ * a given size, i.e. that it wasn't truncated since it was mapped.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the mapped file.
+ * @param size Size of the part of the mapping that will be accessed.
+ *
+ * @return `true` if the part can be accessed.
+ *
+ * @remark Doesn't change the position in the file, so it can be used while
+ * other threads read from the file.
+ * @remark The file can still be truncated right after the check, it only
+ * narrows the window in which a truncation crashes the process.
+ */
+bool io_map_valid(IOHANDLE io, size_t size);
+
+/**
+ * Releases a mapping created with @link io_map @endlink.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Pointer returned by @link io_map @endlink, may be `nullptr`.
+ * @param size Size of the mapping.
+ */
+void io_unmap(void *data, size_t size);
+
 /**
  * Closes a file.
  *
@@ -440,6 +492,37 @@ typedef struct ASYNCIO ASYNCIO;
  */
 ASYNCIO *aio_new(IOHANDLE io);
 
+/**
+ * Writes the queued data to the file in place of io_write on the writer
+ * thread, for example to compress it without blocking the thread that
+ * queues it.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param data The queued data, or nullptr once before the file is closed
+ *             to write what is still left.
+ * @param size Number of bytes queued.
+ * @param user Pointer passed to @link aio_new_filtered @endlink.
+ */
+typedef void (*AIO_FILTER)(IOHANDLE io, const void *data, unsigned size, void *user);
+
+/**
+ * Wraps a @link IOHANDLE @endlink for asynchronous writing, the data is
+ * passed through a filter on the writer thread.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param filter Called on the writer thread with the queued data.
+ * @param user Passed to the filter, has to stay valid until
+ *             @link aio_wait @endlink returned.
+ *
+ * @return The handle for asynchronous writing.
+ *
+ */
+ASYNCIO *aio_new_filtered(IOHANDLE io, AIO_FILTER filter, void *user);
+
 /**
  * Locks the ASYNCIO structure so it can't be written into by
  * other threads.
@@ -896,9 +979,47 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  *
  * @return On success it returns the number of bytes sent. Returns -1
  * on error.
+ *
+ * @remark If batching is enabled with @link net_udp_set_batching @endlink,
+ * the packet is only queued and a successful return value means that it
+ * was queued. Errors while sending it are reported by
+ * @link net_udp_flush @endlink.
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Makes @link net_udp_send @endlink queue the packets of an UDP socket
+ * instead of sending each of them with its own system call.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ * @param enable Whether to queue packets. Disabling it sends the queued
+ * packets.
+ *
+ * @remark Queued packets are only sent by @link net_udp_flush @endlink,
+ * when the queue is full or when the socket is closed.
+ * @remark Only has an effect on Linux, other platforms always send right
+ * away.
+ */
+void net_udp_set_batching(NETSOCKET sock, bool enable);
+
+/**
+ * Sends the packets queued on an UDP socket with as few system calls as
+ * possible.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @return The number of packets sent. Returns -1 if a packet could not be
+ * sent, the error is logged and the packet is dropped like an unbatched
+ * packet whose send failed.
+ *
+ * @see net_udp_set_batching
+ */
+int net_udp_flush(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
@@ -2129,6 +2250,7 @@ typedef struct
 	uint64_t sent_bytes;
 	uint64_t recv_packets;
 	uint64_t recv_bytes;
+	uint64_t send_calls;
 } NETSTATS;
 
 void net_stats(NETSTATS *stats);
@@ -36,6 +36,12 @@ class IEngineMap : public IMap
 	MACRO_INTERFACE("enginemap")
 public:
 	virtual bool Load(const char *pMapName) = 0;
+	// does not need the kernel, so a map that is not registered can be
+	// loaded in another thread
+	virtual bool Load(class IStorage *pStorage, const char *pMapName) = 0;
+	// replaces the current map with the one loaded by pOther, which is
+	// unloaded afterwards
+	virtual void Take(IEngineMap *pOther) = 0;
 	virtual void Unload() = 0;
 	virtual bool IsLoaded() const = 0;
 	virtual IOHANDLE File() const = 0;
@@ -19,11 +19,23 @@ enum
 	CHANNEL_SERVERINFO,
 	CHANNEL_RESPONSE,
 	CHANNEL_INGAME,
+	CHANNEL_PLAYERS,
+	NUM_CHANNELS,
 	CHANNEL_RESPONSETYPE_RCON = 0,
 	CHANNEL_RESPONSETYPE_CHAT,
 	CHANNEL_RESPONSETYPE_RESENDMAP,
 };
 
+enum
+{
+	MQTT_LOGIN_SUCCESS = 0,
+	MQTT_LOGIN_FAILED,
+	MQTT_LOGIN_TIMEOUT,
+	MQTT_LOGIN_UNAVAILABLE, // not connected to the broker
+	MQTT_LOGIN_PENDING, // the client is waiting for a response already
+	MQTT_LOGIN_REQUESTED,
+};
+
 
 class IMqtt : public IInterface
 {
@@ -34,6 +46,7 @@ public:
 
 	/* SETTER AND GETTER */
     virtual void SetMapUpdate(bool update) = 0;
+	// Called on the tick thread, captures what the heartbeat reports
 	virtual void SetHeartbeat(bool update) = 0;
 	virtual void SetServerUpdate(bool update) = 0;
 	virtual void SetLastHeartbeat(int lastHeartBeat) = 0;
@@ -41,15 +54,28 @@ public:
 
 	/* MQTT FUNCTIONS */
 	virtual void Run() = 0;
+	// Called on the main thread before Run is started on the MQTT thread
 	virtual void Init() = 0;
+	// Called by the server after every game tick
+	virtual void OnTick() = 0;
+	// Called by the server on the tick thread once a map was loaded
+	virtual void OnMapChange() = 0;
 	virtual bool Subscribe(const int &topic) = 0;
 	virtual bool Publish(const int &topic, const std::string &payload) = 0;
 	virtual bool Publish(const int& topic, const json& payload) = 0;
-    virtual bool PublishWithResponse(const int &topic, const std::string &payload, const std::string &responseTopic) = 0;
-    virtual bool WaitForResponse(const std::string &responseTopic, std::function<void(const std::string&)> callback) = 0;
+	virtual bool Publish(const int& topic, json&& payload) = 0;
+
+	// Allocation free publishing for the channels that are fed from the
+	// tick thread on every chat message and console line
+	virtual bool PublishConsole(int Level, const char *pFrom, const char *pStr) = 0;
+	virtual bool PublishRcon(const char *pCommand, int ClientId) = 0;
+	virtual bool PublishChat(int ClientId, const char *pName, const char *pMessage, int Team) = 0;
 
 	/* EXTRA FUNCTIONS */
-	virtual bool RequestLogin(const int &clientId, const std::string &logintoken) = 0;
+	// Sends a login request without waiting for the response. The result
+	// is passed to CGameContext::OnMqttLogin on the tick thread later.
+	// Returns MQTT_LOGIN_REQUESTED or the reason the request wasn't sent.
+	virtual int RequestLogin(int ClientId, const char *pLoginToken) = 0;
 };
 IMqtt *CreateMqtt();
 #endif // ENGINE_MQTT_H
@@ -302,7 +302,12 @@ public:
 	// is instantiated.
 	virtual void OnInit(const void *pPersistentData) = 0;
 	virtual void OnConsoleInit() = 0;
+	// called from a background thread while the map is loaded, may only
+	// touch the files of the new map
 	virtual void OnMapChange(char *pNewMapName, int MapNameSize) = 0;
+	// called on the main thread with the temporary copy of the map that
+	// `OnMapChange` wrote, once the map is used. The game deletes it.
+	virtual void OnMapTempfile(const char *pTempfile) = 0;
 	// `pPersistentData` may be null if this is the last time `IGameServer`
 	// is destroyed.
 	virtual void OnShutdown(void *pPersistentData) = 0;
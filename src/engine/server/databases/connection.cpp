@@ -1,10 +1,34 @@
 #include "connection.h"
 
+#include <engine/console.h>
+
+#include <algorithm>
+
 IDbConnection::IDbConnection(const char *pPrefix)
 {
 	str_copy(m_aPrefix, pPrefix);
 }
 
+void IDbConnection::PrintStatementStats(IConsole *pConsole) const
+{
+	std::vector<std::pair<std::string, CDbStatementStats>> vStats;
+	GetStatementStats(&vStats);
+	std::sort(vStats.begin(), vStats.end(), [](const auto &Left, const auto &Right) {
+		return Left.second.m_ExecuteTime > Right.second.m_ExecuteTime;
+	});
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf), "  %d cached statements", (int)vStats.size());
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	for(size_t i = 0; i < minimum<size_t>(vStats.size(), 5); i++)
+	{
+		const CDbStatementStats &Stats = vStats[i].second;
+		str_format(aBuf, sizeof(aBuf), "  prepared %d, executed %d, %.2f ms: %.300s",
+			Stats.m_NumPrepared, Stats.m_NumExecuted, Stats.m_ExecuteTime * 1000.0 / time_freq(), vStats[i].first.c_str());
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
 void IDbConnection::FormatCreateRace(char *aBuf, unsigned int BufferSize, bool Backup) const
 {
 	str_format(aBuf, BufferSize,
@@ -3,8 +3,15 @@
 
 #include "connection_pool.h"
 
+#include <base/math.h>
 #include <engine/shared/protocol.h>
+
+#include <list>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 enum
 {
@@ -14,7 +21,84 @@ enum
 
 class IConsole;
 
-// can hold one PreparedStatement with Results
+struct CDbStatementStats
+{
+	// how often the statement had to be prepared
+	int m_NumPrepared = 0;
+	// how often the statement was executed, also counts the executions
+	// without preparing it again
+	int m_NumExecuted = 0;
+	// time spent executing the statement and fetching the rows
+	int64_t m_ExecuteTime = 0;
+};
+
+// Prepared statements of a connection by their SQL text, preparing the same
+// text again returns the cached statement. Once there are too many, the
+// least recently used statement is closed.
+template<typename TStmt>
+class CDbStatementCache
+{
+public:
+	struct CEntry
+	{
+		std::string m_Sql;
+		TStmt m_pStmt;
+		CDbStatementStats m_Stats;
+	};
+
+	// returns nullptr if the statement isn't cached
+	CEntry *Find(const char *pSql)
+	{
+		auto It = m_Index.find(pSql);
+		if(It == m_Index.end())
+			return nullptr;
+		m_Entries.splice(m_Entries.begin(), m_Entries, It->second);
+		return &*It->second;
+	}
+
+	// the added statement stays cached until the next call to Add, even if
+	// MaxEntries is 0
+	CEntry *Add(const char *pSql, TStmt pStmt, int MaxEntries)
+	{
+		m_Entries.push_front({pSql, std::move(pStmt), {}});
+		m_Index[m_Entries.front().m_Sql] = m_Entries.begin();
+		while((int)m_Entries.size() > maximum(MaxEntries, 1))
+		{
+			m_Index.erase(m_Entries.back().m_Sql);
+			m_Entries.pop_back();
+		}
+		return &m_Entries.front();
+	}
+
+	void Remove(const CEntry *pEntry)
+	{
+		auto It = m_Index.find(pEntry->m_Sql);
+		m_Entries.erase(It->second);
+		m_Index.erase(It);
+	}
+
+	void Clear()
+	{
+		m_Index.clear();
+		m_Entries.clear();
+	}
+
+	int Size() const { return m_Entries.size(); }
+
+	void GetStats(std::vector<std::pair<std::string, CDbStatementStats>> *pvStats) const
+	{
+		for(const CEntry &Entry : m_Entries)
+			pvStats->emplace_back(Entry.m_Sql, Entry.m_Stats);
+	}
+
+private:
+	// most recently used first
+	std::list<CEntry> m_Entries;
+	std::unordered_map<std::string, typename std::list<CEntry>::iterator> m_Index;
+};
+
+// can hold one PreparedStatement with Results, keeps the previously
+// prepared statements to reuse them
 class IDbConnection
 {
 public:
@@ -50,11 +134,27 @@ public:
 	// has to be called to return the connection back to the pool
 	virtual void Disconnect() = 0;
 
+	// the statements until the commit or rollback are executed in one
+	// transaction, has to be committed or rolled back before disconnecting
+	//
+	// returns true on failure
+	virtual bool BeginTransaction(char *pError, int ErrorSize) = 0;
+	// returns true on failure, the transaction has to be rolled back then
+	virtual bool CommitTransaction(char *pError, int ErrorSize) = 0;
+	// returns true on failure
+	virtual bool RollbackTransaction(char *pError, int ErrorSize) = 0;
+
 	// ? for Placeholders, connection has to be established, can overwrite previous prepared statements
+	// reuses the statement if the same text was prepared before, the values have to be bound again
 	//
 	// returns true on failure
 	virtual bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) = 0;
 
+	// maximum number of prepared statements kept for reuse, 0 prepares every statement again
+	void SetMaxCachedStatements(int Max) { m_MaxCachedStatements = Max; }
+	// SQL text and statistics of the statements that are currently kept
+	virtual void GetStatementStats(std::vector<std::pair<std::string, CDbStatementStats>> *pvStats) const = 0;
+
 	// PrepareStatement has to be called beforehand,
 	virtual void BindString(int Idx, const char *pString) = 0;
 	virtual void BindBlob(int Idx, unsigned char *pBlob, int Size) = 0;
@@ -92,6 +192,10 @@ private:
 	char m_aPrefix[64];
 
 protected:
+	int m_MaxCachedStatements = 16;
+	// prints the statements that took the most time
+	void PrintStatementStats(IConsole *pConsole) const;
+
 	void FormatCreateRace(char *aBuf, unsigned int BufferSize, bool Backup) const;
 	void FormatCreateTeamrace(char *aBuf, unsigned int BufferSize, const char *pIdType, bool Backup) const;
 	void FormatCreateMaps(char *aBuf, unsigned int BufferSize) const;
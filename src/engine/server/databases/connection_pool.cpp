@@ -6,8 +6,10 @@
 #include <engine/console.h>
 
 #include <chrono>
-#include <iterator>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -64,6 +66,16 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	// identifies the query in the logs
+	int m_JobNum = 0;
+};
+
+// a write query that is executed together with others in one transaction
+struct CSqlBatchEntry
+{
+	CSqlExecData *m_pData;
+	Write m_Write;
+	bool m_Success;
 };
 
 CSqlExecData::CSqlExecData(
@@ -117,25 +129,169 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
+// Queue of queries between two threads, grows as needed. A nullptr tells
+// the receiving thread to exit.
+class CSqlQueue
+{
+public:
+	void Push(std::unique_ptr<CSqlExecData> pData)
+	{
+		{
+			std::unique_lock<std::mutex> Lock(m_Lock);
+			m_vpQueries.push_back(std::move(pData));
+			m_Size.fetch_add(1);
+		}
+		m_Cond.notify_one();
+	}
+
+	// keeps the queries together for the receiving thread
+	void PushBatch(std::vector<std::unique_ptr<CSqlExecData>> vpBatch)
+	{
+		{
+			std::unique_lock<std::mutex> Lock(m_Lock);
+			for(auto &pData : vpBatch)
+				m_vpQueries.push_back(std::move(pData));
+			m_Size.fetch_add(vpBatch.size());
+		}
+		m_Cond.notify_one();
+	}
+
+	// blocks until there is a query
+	std::unique_ptr<CSqlExecData> Pop()
+	{
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		m_Cond.wait(Lock, [this]() { return !m_vpQueries.empty(); });
+		std::unique_ptr<CSqlExecData> pData = std::move(m_vpQueries.front());
+		m_vpQueries.pop_front();
+		m_Size.fetch_sub(1);
+		return pData;
+	}
+
+	// blocks until there is a query. If it is a write query, waits up to
+	// Delay for more write queries to be added after it. Other queries end
+	// the batch without being removed, so the order is kept.
+	void PopBatch(std::vector<std::unique_ptr<CSqlExecData>> *pvpBatch, int MaxWrites, std::chrono::milliseconds Delay)
+	{
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		m_Cond.wait(Lock, [this]() { return !m_vpQueries.empty(); });
+		const auto Deadline = std::chrono::steady_clock::now() + Delay;
+		while(true)
+		{
+			pvpBatch->push_back(std::move(m_vpQueries.front()));
+			m_vpQueries.pop_front();
+			m_Size.fetch_sub(1);
+			if(!IsWrite(pvpBatch->back().get()) || (int)pvpBatch->size() >= MaxWrites)
+				return;
+			if(!m_Cond.wait_until(Lock, Deadline, [this]() { return !m_vpQueries.empty(); }))
+				return;
+			if(!IsWrite(m_vpQueries.front().get()))
+				return;
+		}
+	}
+
+	int Size() const { return m_Size.load(); }
+
+private:
+	static bool IsWrite(const CSqlExecData *pData)
+	{
+		return pData != nullptr && pData->m_Mode == CSqlExecData::WRITE_ACCESS;
+	}
+
+	std::mutex m_Lock;
+	std::condition_variable m_Cond;
+	std::deque<std::unique_ptr<CSqlExecData>> m_vpQueries;
+	std::atomic_int m_Size{0};
+};
+
+struct CDbConnectionPool::CSharedData
+{
+	// Used as signal that shutdown is in progress from main thread to
+	// speed up the queries by discarding read queries and writing to
+	// the sqlite file instead of the remote mysql server.
+	std::atomic_bool m_Shutdown{false};
+	// Number of threads that didn't exit yet.
+	std::atomic_int m_NumRunning{0};
+
+	// Write queries go to the backup thread first, which passes them on
+	// to the worker thread in the same order.
+	CSqlQueue m_BackupQueue;
+	CSqlQueue m_WriteQueue;
+	// Read queries are executed by whichever read worker is free.
+	CSqlQueue m_ReadQueue;
+	int m_NumReadWorkers = 0;
+
+	std::atomic_int m_MaxWriteBatch{1};
+	std::atomic_int m_WriteBatchDelay{0};
+	std::atomic_int m_MaxCachedStatements{16};
+
+	// The read workers connect to these databases on their own.
+	std::mutex m_ReadDatabasesLock;
+	std::vector<std::unique_ptr<CSqlExecData>> m_vpReadDatabases;
+};
+
+void CDbConnectionPool::AddRead(std::unique_ptr<CSqlExecData> pData)
+{
+	pData->m_JobNum = m_NextJobNum++;
+	m_pShared->m_ReadQueue.Push(std::move(pData));
+	ReportBacklog("read", NumPending(READ), &m_ReadBacklogWarn);
+}
+
+void CDbConnectionPool::AddWrite(std::unique_ptr<CSqlExecData> pData)
+{
+	pData->m_JobNum = m_NextJobNum++;
+	m_pShared->m_BackupQueue.Push(std::move(pData));
+	ReportBacklog("write", NumPending(WRITE), &m_WriteBacklogWarn);
+}
+
+void CDbConnectionPool::ReportBacklog(const char *pKind, int Pending, int *pWarnAt)
+{
+	// the queries are kept regardless, but the players wait for them
+	if(Pending >= *pWarnAt)
+	{
+		dbg_msg("sql", "%d %s queries are waiting, the database can't keep up", Pending, pKind);
+		*pWarnAt *= 2;
+	}
+	else if(Pending < BACKLOG_WARN / 2)
+	{
+		*pWarnAt = BACKLOG_WARN;
+	}
+}
+
+int CDbConnectionPool::NumPending(Mode DatabaseMode) const
+{
+	if(DatabaseMode == READ)
+		return m_pShared->m_ReadQueue.Size();
+	return m_pShared->m_BackupQueue.Size() + m_pShared->m_WriteQueue.Size();
+}
+
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == READ)
+		AddRead(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+	else
+		AddWrite(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
 }
 
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == READ)
+	{
+		std::unique_lock<std::mutex> Lock(m_pShared->m_ReadDatabasesLock);
+		m_pShared->m_vpReadDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
+		return;
+	}
+	AddWrite(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
 }
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == READ)
+	{
+		std::unique_lock<std::mutex> Lock(m_pShared->m_ReadDatabasesLock);
+		m_pShared->m_vpReadDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
+		return;
+	}
+	AddWrite(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
 }
 
 void CDbConnectionPool::Execute(
@@ -143,9 +299,7 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	AddRead(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -153,9 +307,7 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	AddWrite(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::OnShutdown()
@@ -164,9 +316,11 @@ void CDbConnectionPool::OnShutdown()
 		return;
 	m_Shutdown = true;
 	m_pShared->m_Shutdown.store(true);
-	m_pShared->m_NumBackup.Signal();
+	m_pShared->m_BackupQueue.Push(nullptr);
+	for(int i = 0; i < m_pShared->m_NumReadWorkers; i++)
+		m_pShared->m_ReadQueue.Push(nullptr);
 	int i = 0;
-	while(m_pShared->m_Shutdown.load())
+	while(m_pShared->m_NumRunning.load() > 0)
 	{
 		// print a log about every two seconds
 		if(i % 20 == 0 && i > 0)
@@ -179,7 +333,7 @@ void CDbConnectionPool::OnShutdown()
 }
 
 // The backup worker thread looks at write queries and stores them
-// in the sqlite database (WRITE_BACKUP). It skips over read queries.
+// in the sqlite database (WRITE_BACKUP).
 // After processing the query, it gets passed on to the Worker thread.
 // This is done to not loose ranks when the server shuts down before all
 // queries are executed on the mysql server
@@ -203,20 +357,24 @@ void CBackup::Start(void *pUser)
 {
 	CBackup *pThis = (CBackup *)pUser;
 	pThis->ProcessQueries();
+	pThis->m_pShared->m_NumRunning.fetch_sub(1);
 	delete pThis;
 }
 
 void CBackup::ProcessQueries()
 {
-	for(int JobNum = 0;; JobNum++)
+	while(true)
 	{
-		m_pShared->m_NumBackup.Wait();
-		CSqlExecData *pThreadData = m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)].get();
+		// the write queries are grouped here already, the worker thread
+		// keeps the batches
+		std::vector<std::unique_ptr<CSqlExecData>> vpBatch;
+		m_pShared->m_BackupQueue.PopBatch(&vpBatch, m_pShared->m_MaxWriteBatch.load(), std::chrono::milliseconds(m_pShared->m_WriteBatchDelay.load()));
+		CSqlExecData *pThreadData = vpBatch.front().get();
 
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_pShared->m_NumWorker.Signal();
+			m_pShared->m_WriteQueue.Push(nullptr);
 			return;
 		}
 
@@ -227,17 +385,33 @@ void CBackup::ProcessQueries()
 		}
 		else if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS && m_pWriteBackup.get())
 		{
-			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData, Write::BACKUP_FIRST);
-			dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", JobNum, pThreadData->m_pName, Success);
+			std::vector<CSqlBatchEntry> vBatch;
+			for(auto &pData : vpBatch)
+				vBatch.push_back({pData.get(), Write::BACKUP_FIRST, false});
+			m_pWriteBackup->SetMaxCachedStatements(m_pShared->m_MaxCachedStatements.load());
+			CDbConnectionPool::ExecSqlBatch(m_pWriteBackup.get(), &vBatch);
+			for(const CSqlBatchEntry &Entry : vBatch)
+				dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", Entry.m_pData->m_JobNum, Entry.m_pData->m_pName, Entry.m_Success);
 		}
-		m_pShared->m_NumWorker.Signal();
+		m_pShared->m_WriteQueue.PushBatch(std::move(vpBatch));
 	}
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
-// entry from the backup server after completing it on the write server.
-// static void Worker(void *pUser);
+static void CompleteQuery(CSqlExecData *pThreadData, bool Success)
+{
+	if(!Success)
+		dbg_msg("sql", "[%i] %s failed on all databases", pThreadData->m_JobNum, pThreadData->m_pName);
+	if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+	{
+		pThreadData->m_pThreadData->m_pResult->m_Success = Success;
+		pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+	}
+}
+
+// the worker thread executes the write queries on mysql or sqlite in the
+// order they were added. If we write on a mysql server and have a backup
+// server configured, we'll remove the entry from the backup server after
+// completing it on the write server.
 class CWorker
 {
 public:
@@ -248,6 +422,7 @@ public:
 
 private:
 	void Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode);
+	void ProcessWrites(const std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, bool *pFailMode);
 
 	// There are two possible configurations
 	//  * sqlite mode: There exists exactly one READ and the same WRITE server
@@ -256,8 +431,7 @@ private:
 	//                most one WRITE server. The WRITE server for all DDNet
 	//                Servers must be the same (to counteract double loads).
 	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+	// The READ servers are handled by the read workers.
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -269,124 +443,55 @@ void CWorker::Start(void *pUser)
 {
 	CWorker *pThis = (CWorker *)pUser;
 	pThis->ProcessQueries();
+	pThis->m_pShared->m_NumRunning.fetch_sub(1);
 	delete pThis;
 }
 
 void CWorker::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails, write to the backup
+	// database until all requests are handled
 	bool FailMode = false;
-	for(int JobNum = 0;; JobNum++)
+	while(true)
 	{
-		if(FailMode && m_pShared->m_NumWorker.GetApproximateValue() == 0)
+		if(FailMode && m_pShared->m_WriteQueue.Size() == 0)
 		{
 			FailMode = false;
 		}
-		m_pShared->m_NumWorker.Wait();
-		auto pThreadData = std::move(m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)]);
+		// the backup thread already grouped the write queries
+		std::vector<std::unique_ptr<CSqlExecData>> vpBatch;
+		m_pShared->m_WriteQueue.PopBatch(&vpBatch, m_pShared->m_MaxWriteBatch.load(), 0ms);
+		CSqlExecData *pThreadData = vpBatch.front().get();
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_pShared->m_Shutdown.store(false);
 			return;
 		}
-		bool Success = false;
-		switch(pThreadData->m_Mode)
+		if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS)
 		{
-		case CSqlExecData::READ_ACCESS:
-		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
-			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
-				{
-					ReadServer = CurServer;
-					dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
-			}
-			if(!Success)
-			{
-				FailMode = true;
-			}
+			ProcessWrites(vpBatch, &FailMode);
+			continue;
 		}
-		break;
-		case CSqlExecData::WRITE_ACCESS:
+		bool Success = false;
+		switch(pThreadData->m_Mode)
 		{
-			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", JobNum, pThreadData->m_pName);
-			}
-			else if(FailMode && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", JobNum, pThreadData->m_pName);
-			}
-			else if(CDbConnectionPool::ExecSqlFunc(m_pWriteConnection.get(), pThreadData.get(), Write::NORMAL))
-			{
-				dbg_msg("sql", "[%i] %s done on write database", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-			// enter fail mode if not successful
-			FailMode = FailMode || !Success;
-			const Write w = Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
-			if(m_pWriteBackup && CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData.get(), w))
-			{
-				dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-		}
-		break;
 		case CSqlExecData::ADD_MYSQL:
 		{
 			auto pMysql = CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
-			switch(pThreadData->m_Ptr.m_Mysql.m_Mode)
-			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
-				break;
-			case CDbConnectionPool::Mode::WRITE:
+			if(pThreadData->m_Ptr.m_Mysql.m_Mode == CDbConnectionPool::Mode::WRITE)
 				m_pWriteConnection = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::WRITE_BACKUP:
+			else if(pThreadData->m_Ptr.m_Mysql.m_Mode == CDbConnectionPool::Mode::WRITE_BACKUP)
 				m_pWriteBackup = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::NUM_MODES:
-				break;
-			}
 			Success = true;
 			break;
 		}
 		case CSqlExecData::ADD_SQLITE:
 		{
 			auto pSqlite = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_FileName, true);
-			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
-			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
-				break;
-			case CDbConnectionPool::Mode::WRITE:
+			if(pThreadData->m_Ptr.m_Sqlite.m_Mode == CDbConnectionPool::Mode::WRITE)
 				m_pWriteConnection = std::move(pSqlite);
-				break;
-			case CDbConnectionPool::Mode::WRITE_BACKUP:
+			else if(pThreadData->m_Ptr.m_Sqlite.m_Mode == CDbConnectionPool::Mode::WRITE_BACKUP)
 				m_pWriteBackup = std::move(pSqlite);
-				break;
-			case CDbConnectionPool::Mode::NUM_MODES:
-				break;
-			}
 			Success = true;
 			break;
 		}
@@ -394,27 +499,67 @@ void CWorker::ProcessQueries()
 			Print(pThreadData->m_Ptr.m_Print.m_pConsole, pThreadData->m_Ptr.m_Print.m_Mode);
 			Success = true;
 			break;
+		case CSqlExecData::READ_ACCESS:
+			dbg_assert(false, "read query in the write queue");
+			break;
+		case CSqlExecData::WRITE_ACCESS:
+			break;
 		}
-		if(!Success)
-			dbg_msg("sql", "[%i] %s failed on all databases", JobNum, pThreadData->m_pName);
-		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		CompleteQuery(pThreadData, Success);
+	}
+}
+
+void CWorker::ProcessWrites(const std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, bool *pFailMode)
+{
+	std::vector<CSqlBatchEntry> vBatch;
+	for(const auto &pData : vpBatch)
+		vBatch.push_back({pData.get(), Write::NORMAL, false});
+	if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
+	{
+		for(const CSqlBatchEntry &Entry : vBatch)
+			dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", Entry.m_pData->m_JobNum, Entry.m_pData->m_pName);
+	}
+	else if(*pFailMode && m_pWriteBackup != nullptr)
+	{
+		for(const CSqlBatchEntry &Entry : vBatch)
+			dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", Entry.m_pData->m_JobNum, Entry.m_pData->m_pName);
+	}
+	else
+	{
+		m_pWriteConnection->SetMaxCachedStatements(m_pShared->m_MaxCachedStatements.load());
+		CDbConnectionPool::ExecSqlBatch(m_pWriteConnection.get(), &vBatch);
+		for(const CSqlBatchEntry &Entry : vBatch)
+			if(Entry.m_Success)
+				dbg_msg("sql", "[%i] %s done on write database", Entry.m_pData->m_JobNum, Entry.m_pData->m_pName);
+	}
+
+	for(CSqlBatchEntry &Entry : vBatch)
+	{
+		// enter fail mode if not successful
+		*pFailMode = *pFailMode || !Entry.m_Success;
+		Entry.m_Write = Entry.m_Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
+	}
+	if(m_pWriteBackup)
+	{
+		std::vector<CSqlBatchEntry> vBackupBatch = vBatch;
+		m_pWriteBackup->SetMaxCachedStatements(m_pShared->m_MaxCachedStatements.load());
+		CDbConnectionPool::ExecSqlBatch(m_pWriteBackup.get(), &vBackupBatch);
+		for(size_t i = 0; i < vBatch.size(); i++)
 		{
-			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
-			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+			if(vBackupBatch[i].m_Success)
+			{
+				dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", vBatch[i].m_pData->m_JobNum, vBatch[i].m_pData->m_pName);
+				vBatch[i].m_Success = true;
+			}
 		}
 	}
+	for(const CSqlBatchEntry &Entry : vBatch)
+		CompleteQuery(Entry.m_pData, Entry.m_Success);
 }
 
 void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 {
-	if(DatabaseMode == CDbConnectionPool::Mode::READ)
-	{
-		for(auto &pReadConnection : m_vpReadConnections)
-			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
-			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
-	}
-	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
+	if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
 		if(m_pWriteConnection)
 			m_pWriteConnection->Print(pConsole, "Write");
@@ -430,6 +575,118 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// The read workers execute the read queries, several at once so that a
+// slow query doesn't hold up the others. Each of them has its own
+// connections to all read databases.
+class CReadWorker
+{
+public:
+	CReadWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int WorkerId) :
+		m_pShared(std::move(pShared)), m_WorkerId(WorkerId) {}
+	static void Start(void *pUser);
+	void ProcessQueries();
+
+private:
+	void UpdateConnections();
+	void Print(IConsole *pConsole);
+
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+	int m_WorkerId;
+};
+
+/* static */
+void CReadWorker::Start(void *pUser)
+{
+	CReadWorker *pThis = (CReadWorker *)pUser;
+	pThis->ProcessQueries();
+	pThis->m_pShared->m_NumRunning.fetch_sub(1);
+	delete pThis;
+}
+
+void CReadWorker::UpdateConnections()
+{
+	std::unique_lock<std::mutex> Lock(m_pShared->m_ReadDatabasesLock);
+	for(size_t i = m_vpReadConnections.size(); i < m_pShared->m_vpReadDatabases.size(); i++)
+	{
+		const CSqlExecData *pDatabase = m_pShared->m_vpReadDatabases[i].get();
+		if(pDatabase->m_Mode == CSqlExecData::ADD_MYSQL)
+			m_vpReadConnections.push_back(CreateMysqlConnection(pDatabase->m_Ptr.m_Mysql.m_Config));
+		else
+			m_vpReadConnections.push_back(CreateSqliteConnection(pDatabase->m_Ptr.m_Sqlite.m_FileName, true));
+	}
+}
+
+void CReadWorker::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	// enter fail mode when a sql request fails, skip read request during it
+	// until all requests are handled
+	bool FailMode = false;
+	while(true)
+	{
+		if(FailMode && m_pShared->m_ReadQueue.Size() == 0)
+		{
+			FailMode = false;
+		}
+		std::unique_ptr<CSqlExecData> pThreadData = m_pShared->m_ReadQueue.Pop();
+		// work through all database jobs after OnShutdown is called before exiting the thread
+		if(pThreadData == nullptr)
+		{
+			return;
+		}
+		UpdateConnections();
+		const int JobNum = pThreadData->m_JobNum;
+		bool Success = false;
+		if(pThreadData->m_Mode == CSqlExecData::PRINT)
+		{
+			Print(pThreadData->m_Ptr.m_Print.m_pConsole);
+			Success = true;
+		}
+		else
+		{
+			dbg_assert(pThreadData->m_Mode == CSqlExecData::READ_ACCESS, "write query in the read queue");
+			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+			{
+				if(m_pShared->m_Shutdown)
+				{
+					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
+					break;
+				}
+				if(FailMode)
+				{
+					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
+					break;
+				}
+				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
+				m_vpReadConnections[CurServer]->SetMaxCachedStatements(m_pShared->m_MaxCachedStatements.load());
+				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+				{
+					ReadServer = CurServer;
+					dbg_msg("sql", "[%i] %s done on read database %d by read worker %d", JobNum, pThreadData->m_pName, CurServer, m_WorkerId);
+					Success = true;
+					break;
+				}
+			}
+			if(!Success)
+			{
+				FailMode = true;
+			}
+		}
+		CompleteQuery(pThreadData.get(), Success);
+	}
+}
+
+void CReadWorker::Print(IConsole *pConsole)
+{
+	for(auto &pReadConnection : m_vpReadConnections)
+		pReadConnection->Print(pConsole, "Read");
+	if(m_vpReadConnections.empty())
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+}
+
 /* static */
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
 {
@@ -464,11 +721,52 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 	return Success;
 }
 
+/* static */
+void CDbConnectionPool::ExecSqlBatch(IDbConnection *pConnection, std::vector<CSqlBatchEntry> *pvBatch)
+{
+	for(CSqlBatchEntry &Entry : *pvBatch)
+		Entry.m_Success = false;
+	if(pvBatch->size() > 1 && pConnection != nullptr)
+	{
+		char aError[256] = "unknown error";
+		if(pConnection->Connect(aError, sizeof(aError)))
+		{
+			dbg_msg("sql", "failed connecting to db: %s", aError);
+			return;
+		}
+		// one transaction for all of them instead of one for every row
+		bool Failed = pConnection->BeginTransaction(aError, sizeof(aError));
+		for(size_t i = 0; i < pvBatch->size() && !Failed; i++)
+		{
+			const CSqlBatchEntry &Entry = (*pvBatch)[i];
+			Failed = Entry.m_pData->m_Ptr.m_pWriteFunc(pConnection, Entry.m_pData->m_pThreadData.get(), Entry.m_Write, aError, sizeof(aError));
+		}
+		if(!Failed)
+			Failed = pConnection->CommitTransaction(aError, sizeof(aError));
+		if(!Failed)
+		{
+			pConnection->Disconnect();
+			for(CSqlBatchEntry &Entry : *pvBatch)
+				Entry.m_Success = true;
+			return;
+		}
+		// execute them one by one to find out which one failed
+		dbg_msg("sql", "batch of %d writes failed: %s", (int)pvBatch->size(), aError);
+		if(pConnection->RollbackTransaction(aError, sizeof(aError)))
+			dbg_msg("sql", "rollback failed: %s", aError);
+		pConnection->Disconnect();
+	}
+	for(CSqlBatchEntry &Entry : *pvBatch)
+		Entry.m_Success = ExecSqlFunc(pConnection, Entry.m_pData, Entry.m_Write);
+}
+
 CDbConnectionPool::CDbConnectionPool()
 {
 	m_pShared = std::make_shared<CSharedData>();
+	m_pShared->m_NumRunning.store(2);
 	m_pWorkerThread = thread_init(CWorker::Start, new CWorker(m_pShared), "database worker thread");
 	m_pBackupThread = thread_init(CBackup::Start, new CBackup(m_pShared), "database backup worker thread");
+	SetNumReadWorkers(1);
 }
 
 CDbConnectionPool::~CDbConnectionPool()
@@ -478,4 +776,29 @@ CDbConnectionPool::~CDbConnectionPool()
 		thread_wait(m_pWorkerThread);
 	if(m_pBackupThread)
 		thread_wait(m_pBackupThread);
+	for(void *pThread : m_vpReadThreads)
+		thread_wait(pThread);
+}
+
+void CDbConnectionPool::SetWriteBatch(int MaxWrites, int Delay)
+{
+	m_pShared->m_MaxWriteBatch.store(maximum(MaxWrites, 1));
+	m_pShared->m_WriteBatchDelay.store(maximum(Delay, 0));
+}
+
+void CDbConnectionPool::SetMaxCachedStatements(int Max)
+{
+	m_pShared->m_MaxCachedStatements.store(maximum(Max, 0));
+}
+
+void CDbConnectionPool::SetNumReadWorkers(int NumWorkers)
+{
+	if(m_Shutdown)
+		return;
+	while(m_pShared->m_NumReadWorkers < NumWorkers)
+	{
+		m_pShared->m_NumRunning.fetch_add(1);
+		m_vpReadThreads.push_back(thread_init(CReadWorker::Start, new CReadWorker(m_pShared, m_pShared->m_NumReadWorkers), "database read worker thread"));
+		m_pShared->m_NumReadWorkers++;
+	}
 }
@@ -92,42 +92,54 @@ public:
 		std::unique_ptr<const ISqlData> pSqlRequestData,
 		const char *pName);
 
+	// Starts more threads for the read queries, each with its own
+	// connections to the read databases. There is one from the start and
+	// the number never decreases.
+	void SetNumReadWorkers(int NumWorkers);
+	// Write queries that are added within Delay milliseconds of each other
+	// are executed in one transaction, up to MaxWrites at once. Without
+	// calling this, every write query has its own transaction.
+	void SetWriteBatch(int MaxWrites, int Delay);
+	// Prepared statements each connection keeps for reuse, applied before
+	// the connection executes its next queries.
+	void SetMaxCachedStatements(int Max);
+	// number of queries that aren't done yet, for WRITE including the ones
+	// the backup database is still working on
+	int NumPending(Mode DatabaseMode) const;
+
 	void OnShutdown();
 
 	friend class CWorker;
+	friend class CReadWorker;
 	friend class CBackup;
 
+	enum
+	{
+		// warn about the backlog when this many queries of a kind are
+		// waiting, and again every time it doubles
+		BACKLOG_WARN = 256,
+	};
+
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
+	static void ExecSqlBatch(IDbConnection *pConnection, std::vector<struct CSqlBatchEntry> *pvBatch);
 
-	// Only the main thread accesses this variable. It points to the index,
-	// where the next query is added to the queue.
-	int m_InsertIdx = 0;
+	void AddRead(std::unique_ptr<struct CSqlExecData> pData);
+	void AddWrite(std::unique_ptr<struct CSqlExecData> pData);
+	void ReportBacklog(const char *pKind, int Pending, int *pWarnAt);
 
-	bool m_Shutdown = false;
+	// Only the main thread accesses these variables.
+	int m_NextJobNum = 0;
+	int m_ReadBacklogWarn = BACKLOG_WARN;
+	int m_WriteBacklogWarn = BACKLOG_WARN;
 
-	struct CSharedData
-	{
-		// Used as signal that shutdown is in progress from main thread to
-		// speed up the queries by discarding read queries and writing to
-		// the sqlite file instead of the remote mysql server.
-		// The worker thread signals the main thread that all queries are
-		// processed by setting this variable to false again.
-		std::atomic_bool m_Shutdown{false};
-		// Queries go first to the backup thread. This semaphore signals about
-		// new queries.
-		CSemaphore m_NumBackup;
-		// When the backup thread processed the query, it signals the main
-		// thread with this semaphore about the new query
-		CSemaphore m_NumWorker;
-
-		// spsc queue with additional backup worker to look at queries first.
-		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
-	};
+	bool m_Shutdown = false;
 
+	struct CSharedData;
 	std::shared_ptr<CSharedData> m_pShared;
 	void *m_pWorkerThread = nullptr;
 	void *m_pBackupThread = nullptr;
+	std::vector<void *> m_vpReadThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
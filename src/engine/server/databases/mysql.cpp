@@ -24,6 +24,13 @@ enum
 	MYSQLSTATE_SHUTTINGDOWN,
 };
 
+enum
+{
+	// ER_MAX_PREPARED_STMT_COUNT_REACHED from mysqld_error.h, the same in
+	// MySQL and MariaDB
+	MYSQL_ERROR_MAX_PREPARED_STMT_COUNT = 1461,
+};
+
 std::atomic_int g_MysqlState = {MYSQLSTATE_UNINITIALIZED};
 std::atomic_int g_MysqlNumConnections;
 
@@ -82,7 +89,12 @@ public:
 	bool Connect(char *pError, int ErrorSize) override;
 	void Disconnect() override;
 
+	bool BeginTransaction(char *pError, int ErrorSize) override;
+	bool CommitTransaction(char *pError, int ErrorSize) override;
+	bool RollbackTransaction(char *pError, int ErrorSize) override;
+
 	bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) override;
+	void GetStatementStats(std::vector<std::pair<std::string, CDbStatementStats>> *pvStats) const override;
 
 	void BindString(int Idx, const char *pString) override;
 	void BindBlob(int Idx, unsigned char *pBlob, int Size) override;
@@ -113,9 +125,14 @@ private:
 
 	char m_aErrorDetail[128];
 	void StoreErrorMysql(const char *pContext);
-	void StoreErrorStmt(const char *pContext);
+	void StoreErrorStmt(const char *pContext, MYSQL_STMT *pStmt);
 	bool ConnectImpl();
+	void SetReconnect(bool Reconnect);
+	// rows the current statement didn't fetch block the connection
+	void FreeResult();
 	bool PrepareAndExecuteStatement(const char *pStmt);
+	// binds the parameters and executes the current statement
+	bool ExecuteStatement(char *pError, int ErrorSize);
 	//static void DeleteResult(MYSQL_RES *pResult);
 
 	union UParameterExtra
@@ -128,7 +145,16 @@ private:
 	bool m_NewQuery = false;
 	bool m_HaveConnection = false;
 	MYSQL m_Mysql;
-	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pStmt = nullptr;
+	// server side statements don't survive a reconnect, the cache is
+	// cleared when the connection id changes
+	unsigned long m_ThreadId = 0;
+	CDbStatementCache<std::unique_ptr<MYSQL_STMT, CStmtDeleter>> m_Statements;
+	// set once the server ran out of prepared statements, from then on
+	// this connection only keeps the statement it is currently using
+	bool m_StatementLimitReached = false;
+	// current statement, owned by m_Statements
+	MYSQL_STMT *m_pStmt = nullptr;
+	CDbStatementCache<std::unique_ptr<MYSQL_STMT, CStmtDeleter>>::CEntry *m_pStmtEntry = nullptr;
 	std::vector<MYSQL_BIND> m_vStmtParameters;
 	std::vector<UParameterExtra> m_vStmtParameterExtras;
 
@@ -158,6 +184,7 @@ CMysqlConnection::CMysqlConnection(CMysqlConfig Config) :
 
 CMysqlConnection::~CMysqlConnection()
 {
+	m_Statements.Clear();
 	mysql_close(&m_Mysql);
 	g_MysqlNumConnections -= 1;
 }
@@ -167,21 +194,28 @@ void CMysqlConnection::StoreErrorMysql(const char *pContext)
 	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:mysql:%d): %s", pContext, mysql_errno(&m_Mysql), mysql_error(&m_Mysql));
 }
 
-void CMysqlConnection::StoreErrorStmt(const char *pContext)
+void CMysqlConnection::StoreErrorStmt(const char *pContext, MYSQL_STMT *pStmt)
 {
-	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt.get()), mysql_stmt_error(m_pStmt.get()));
+	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(pStmt), mysql_stmt_error(pStmt));
 }
 
 bool CMysqlConnection::PrepareAndExecuteStatement(const char *pStmt)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	// only used while setting up the connection, not worth caching
+	std::unique_ptr<MYSQL_STMT, CStmtDeleter> pSetupStmt(mysql_stmt_init(&m_Mysql));
+	if(!pSetupStmt)
 	{
-		StoreErrorStmt("prepare");
+		StoreErrorMysql("stmt_init");
 		return true;
 	}
-	if(mysql_stmt_execute(m_pStmt.get()))
+	if(mysql_stmt_prepare(pSetupStmt.get(), pStmt, str_length(pStmt)))
 	{
-		StoreErrorStmt("execute");
+		StoreErrorStmt("prepare", pSetupStmt.get());
+		return true;
+	}
+	if(mysql_stmt_execute(pSetupStmt.get()))
+	{
+		StoreErrorStmt("execute", pSetupStmt.get());
 		return true;
 	}
 	return false;
@@ -194,6 +228,7 @@ void CMysqlConnection::Print(IConsole *pConsole, const char *pMode)
 		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d",
 		pMode, m_Config.m_aDatabase, GetPrefix(), m_Config.m_aUser, m_Config.m_aIp, m_Config.m_Port);
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	PrintStatementStats(pConsole);
 }
 
 void CMysqlConnection::ToUnixTimestamp(const char *pTimestamp, char *aBuf, unsigned int BufferSize)
@@ -222,32 +257,42 @@ bool CMysqlConnection::ConnectImpl()
 {
 	if(m_HaveConnection)
 	{
-		if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+		if(m_pStmt && mysql_stmt_free_result(m_pStmt))
 		{
-			StoreErrorStmt("free_result");
+			StoreErrorStmt("free_result", m_pStmt);
 			dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
 		}
+		m_pStmt = nullptr;
+		m_pStmtEntry = nullptr;
 		if(!mysql_select_db(&m_Mysql, m_Config.m_aDatabase))
 		{
 			// Success.
+			if(mysql_thread_id(&m_Mysql) != m_ThreadId)
+			{
+				// reconnected automatically
+				m_Statements.Clear();
+				m_ThreadId = mysql_thread_id(&m_Mysql);
+			}
 			return false;
 		}
 		StoreErrorMysql("select_db");
 		dbg_msg("mysql", "ping error, trying to reconnect %s", m_aErrorDetail);
+		m_Statements.Clear();
 		mysql_close(&m_Mysql);
 		mem_zero(&m_Mysql, sizeof(m_Mysql));
 		mysql_init(&m_Mysql);
 	}
 
+	m_Statements.Clear();
 	m_pStmt = nullptr;
+	m_pStmtEntry = nullptr;
 	unsigned int OptConnectTimeout = 60;
 	unsigned int OptReadTimeout = 60;
 	unsigned int OptWriteTimeout = 120;
-	my_bool OptReconnect = true;
 	mysql_options(&m_Mysql, MYSQL_OPT_CONNECT_TIMEOUT, &OptConnectTimeout);
 	mysql_options(&m_Mysql, MYSQL_OPT_READ_TIMEOUT, &OptReadTimeout);
 	mysql_options(&m_Mysql, MYSQL_OPT_WRITE_TIMEOUT, &OptWriteTimeout);
-	mysql_options(&m_Mysql, MYSQL_OPT_RECONNECT, &OptReconnect);
+	SetReconnect(true);
 	mysql_options(&m_Mysql, MYSQL_SET_CHARSET_NAME, "utf8mb4");
 	if(m_Config.m_aBindaddr[0] != '\0')
 	{
@@ -260,8 +305,7 @@ bool CMysqlConnection::ConnectImpl()
 		return true;
 	}
 	m_HaveConnection = true;
-
-	m_pStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
+	m_ThreadId = mysql_thread_id(&m_Mysql);
 
 	// Apparently MYSQL_SET_CHARSET_NAME is not enough
 	if(PrepareAndExecuteStatement("SET CHARACTER SET utf8mb4"))
@@ -319,16 +363,107 @@ void CMysqlConnection::Disconnect()
 	m_InUse.store(false);
 }
 
-bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+void CMysqlConnection::SetReconnect(bool Reconnect)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	my_bool OptReconnect = Reconnect;
+	mysql_options(&m_Mysql, MYSQL_OPT_RECONNECT, &OptReconnect);
+}
+
+bool CMysqlConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	// after reconnecting in the middle of the transaction, the statements
+	// after it would be committed without the ones before
+	SetReconnect(false);
+	if(mysql_autocommit(&m_Mysql, false))
 	{
-		StoreErrorStmt("prepare");
+		StoreErrorMysql("autocommit");
 		str_copy(pError, m_aErrorDetail, ErrorSize);
 		return true;
 	}
+	return false;
+}
+
+void CMysqlConnection::FreeResult()
+{
+	if(m_pStmt != nullptr)
+	{
+		mysql_stmt_free_result(m_pStmt);
+	}
+	m_pStmt = nullptr;
+	m_pStmtEntry = nullptr;
+}
+
+bool CMysqlConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	FreeResult();
+	if(mysql_commit(&m_Mysql))
+	{
+		StoreErrorMysql("commit");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	mysql_autocommit(&m_Mysql, true);
+	SetReconnect(true);
+	return false;
+}
+
+bool CMysqlConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	FreeResult();
+	bool Failed = mysql_rollback(&m_Mysql);
+	if(Failed)
+	{
+		StoreErrorMysql("rollback");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+	}
+	mysql_autocommit(&m_Mysql, true);
+	SetReconnect(true);
+	return Failed;
+}
+
+bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+{
+	FreeResult();
+	m_pStmtEntry = m_Statements.Find(pStmt);
+	if(m_pStmtEntry == nullptr)
+	{
+		std::unique_ptr<MYSQL_STMT, CStmtDeleter> pNewStmt(mysql_stmt_init(&m_Mysql));
+		if(!pNewStmt)
+		{
+			StoreErrorMysql("stmt_init");
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			return true;
+		}
+		bool Failed = mysql_stmt_prepare(pNewStmt.get(), pStmt, str_length(pStmt));
+		if(Failed && mysql_stmt_errno(pNewStmt.get()) == MYSQL_ERROR_MAX_PREPARED_STMT_COUNT && m_Statements.Size() > 0)
+		{
+			// max_prepared_stmt_count is shared by all connections to the
+			// server, give back the cached statements and try once more
+			if(!m_StatementLimitReached)
+				dbg_msg("mysql", "server reached max_prepared_stmt_count, not caching statements on this connection anymore");
+			m_StatementLimitReached = true;
+			m_Statements.Clear();
+			pNewStmt.reset(mysql_stmt_init(&m_Mysql));
+			if(!pNewStmt)
+			{
+				StoreErrorMysql("stmt_init");
+				str_copy(pError, m_aErrorDetail, ErrorSize);
+				return true;
+			}
+			Failed = mysql_stmt_prepare(pNewStmt.get(), pStmt, str_length(pStmt));
+		}
+		if(Failed)
+		{
+			StoreErrorStmt("prepare", pNewStmt.get());
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			return true;
+		}
+		m_pStmtEntry = m_Statements.Add(pStmt, std::move(pNewStmt), m_StatementLimitReached ? 0 : m_MaxCachedStatements);
+		m_pStmtEntry->m_Stats.m_NumPrepared++;
+	}
+	m_pStmt = m_pStmtEntry->m_pStmt.get();
 	m_NewQuery = true;
-	unsigned NumParameters = mysql_stmt_param_count(m_pStmt.get());
+	unsigned NumParameters = mysql_stmt_param_count(m_pStmt);
 	m_vStmtParameters.resize(NumParameters);
 	m_vStmtParameterExtras.resize(NumParameters);
 	mem_zero(&m_vStmtParameters[0], sizeof(m_vStmtParameters[0]) * m_vStmtParameters.size());
@@ -438,28 +573,47 @@ void CMysqlConnection::BindNull(int Idx)
 	pParam->error = nullptr;
 }
 
+void CMysqlConnection::GetStatementStats(std::vector<std::pair<std::string, CDbStatementStats>> *pvStats) const
+{
+	m_Statements.GetStats(pvStats);
+}
+
+bool CMysqlConnection::ExecuteStatement(char *pError, int ErrorSize)
+{
+	m_NewQuery = false;
+	m_pStmtEntry->m_Stats.m_NumExecuted++;
+	if(mysql_stmt_bind_param(m_pStmt, &m_vStmtParameters[0]))
+	{
+		StoreErrorStmt("bind_param", m_pStmt);
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	if(mysql_stmt_execute(m_pStmt))
+	{
+		StoreErrorStmt("execute", m_pStmt);
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		// prepare it again next time, in case the statement became invalid
+		m_Statements.Remove(m_pStmtEntry);
+		m_pStmt = nullptr;
+		m_pStmtEntry = nullptr;
+		return true;
+	}
+	return false;
+}
+
 bool CMysqlConnection::Step(bool *pEnd, char *pError, int ErrorSize)
 {
-	if(m_NewQuery)
+	const int64_t Start = time_get_impl();
+	auto *pStats = &m_pStmtEntry->m_Stats;
+	if(m_NewQuery && ExecuteStatement(pError, ErrorSize))
 	{
-		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), &m_vStmtParameters[0]))
-		{
-			StoreErrorStmt("bind_param");
-			str_copy(pError, m_aErrorDetail, ErrorSize);
-			return true;
-		}
-		if(mysql_stmt_execute(m_pStmt.get()))
-		{
-			StoreErrorStmt("execute");
-			str_copy(pError, m_aErrorDetail, ErrorSize);
-			return true;
-		}
+		return true;
 	}
-	int Result = mysql_stmt_fetch(m_pStmt.get());
+	int Result = mysql_stmt_fetch(m_pStmt);
+	pStats->m_ExecuteTime += time_get_impl() - Start;
 	if(Result == 1)
 	{
-		StoreErrorStmt("fetch");
+		StoreErrorStmt("fetch", m_pStmt);
 		str_copy(pError, m_aErrorDetail, ErrorSize);
 		return true;
 	}
@@ -473,20 +627,14 @@ bool CMysqlConnection::ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSi
 {
 	if(m_NewQuery)
 	{
-		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), &m_vStmtParameters[0]))
+		const int64_t Start = time_get_impl();
+		auto *pStats = &m_pStmtEntry->m_Stats;
+		if(ExecuteStatement(pError, ErrorSize))
 		{
-			StoreErrorStmt("bind_param");
-			str_copy(pError, m_aErrorDetail, ErrorSize);
-			return true;
-		}
-		if(mysql_stmt_execute(m_pStmt.get()))
-		{
-			StoreErrorStmt("execute");
-			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt.get());
+		pStats->m_ExecuteTime += time_get_impl() - Start;
+		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt);
 		return false;
 	}
 	str_copy(pError, "tried to execute update without query", ErrorSize);
@@ -507,9 +655,9 @@ bool CMysqlConnection::IsNull(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
-		StoreErrorStmt("fetch_column:null");
+		StoreErrorStmt("fetch_column:null", m_pStmt);
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
 		dbg_assert(0, "error in IsNull");
 	}
@@ -531,9 +679,9 @@ float CMysqlConnection::GetFloat(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
-		StoreErrorStmt("fetch_column:float");
+		StoreErrorStmt("fetch_column:float", m_pStmt);
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
 		dbg_assert(0, "error in GetFloat");
 	}
@@ -559,9 +707,9 @@ int CMysqlConnection::GetInt(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
-		StoreErrorStmt("fetch_column:int");
+		StoreErrorStmt("fetch_column:int", m_pStmt);
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
 		dbg_assert(0, "error in GetInt");
 	}
@@ -587,9 +735,9 @@ int64_t CMysqlConnection::GetInt64(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
-		StoreErrorStmt("fetch_column:int64");
+		StoreErrorStmt("fetch_column:int64", m_pStmt);
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
 		dbg_assert(0, "error in GetInt64");
 	}
@@ -622,9 +770,9 @@ void CMysqlConnection::GetString(int Col, char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
-		StoreErrorStmt("fetch_column:string");
+		StoreErrorStmt("fetch_column:string", m_pStmt);
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
 		dbg_assert(0, "error in GetString");
 	}
@@ -654,9 +802,9 @@ int CMysqlConnection::GetBlob(int Col, unsigned char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
-		StoreErrorStmt("fetch_column:blob");
+		StoreErrorStmt("fetch_column:blob", m_pStmt);
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
 		dbg_assert(0, "error in GetBlob");
 	}
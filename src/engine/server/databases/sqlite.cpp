@@ -30,7 +30,12 @@ public:
 	bool Connect(char *pError, int ErrorSize) override;
 	void Disconnect() override;
 
+	bool BeginTransaction(char *pError, int ErrorSize) override;
+	bool CommitTransaction(char *pError, int ErrorSize) override;
+	bool RollbackTransaction(char *pError, int ErrorSize) override;
+
 	bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) override;
+	void GetStatementStats(std::vector<std::pair<std::string, CDbStatementStats>> *pvStats) const override;
 
 	void BindString(int Idx, const char *pString) override;
 	void BindBlob(int Idx, unsigned char *pBlob, int Size) override;
@@ -57,13 +62,25 @@ public:
 	bool CreateFailsafeTables();
 
 private:
+	class CStmtDeleter
+	{
+	public:
+		void operator()(sqlite3_stmt *pStmt) const { sqlite3_finalize(pStmt); }
+	};
+
 	// copy of config vars
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	bool m_Setup;
 
 	sqlite3 *m_pDb;
+	CDbStatementCache<std::unique_ptr<sqlite3_stmt, CStmtDeleter>> m_Statements;
+	// current statement, owned by m_Statements
 	sqlite3_stmt *m_pStmt;
+	CDbStatementStats *m_pStmtStats;
+	bool m_NewQuery; // not executed since it was prepared
 	bool m_Done; // no more rows available for Step
+	// makes the current statement ready to be executed again
+	void ResetStatement();
 	// returns false, if the query succeeded
 	bool Execute(const char *pQuery, char *pError, int ErrorSize);
 	// returns true on failure
@@ -81,6 +98,8 @@ CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup) :
 	m_Setup(Setup),
 	m_pDb(nullptr),
 	m_pStmt(nullptr),
+	m_pStmtStats(nullptr),
+	m_NewQuery(false),
 	m_Done(true),
 	m_InUse(false)
 {
@@ -89,8 +108,8 @@ CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup) :
 
 CSqliteConnection::~CSqliteConnection()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	// the database can't be closed while statements are left
+	m_Statements.Clear();
 	sqlite3_close(m_pDb);
 	m_pDb = nullptr;
 }
@@ -102,6 +121,7 @@ void CSqliteConnection::Print(IConsole *pConsole, const char *pMode)
 		"SQLite-%s: DB: '%s'",
 		pMode, m_aFilename);
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	PrintStatementStats(pConsole);
 }
 
 void CSqliteConnection::ToUnixTimestamp(const char *pTimestamp, char *aBuf, unsigned int BufferSize)
@@ -182,31 +202,74 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 
 void CSqliteConnection::Disconnect()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
-	m_pStmt = nullptr;
+	ResetStatement();
 	m_InUse.store(false);
 }
 
-bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+bool CSqliteConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	ResetStatement();
+	// take the write lock right away, a deferred transaction that already
+	// read something can't wait for it
+	return Execute("BEGIN IMMEDIATE", pError, ErrorSize);
+}
+
+bool CSqliteConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	ResetStatement();
+	return Execute("COMMIT", pError, ErrorSize);
+}
+
+bool CSqliteConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	ResetStatement();
+	return Execute("ROLLBACK", pError, ErrorSize);
+}
+
+void CSqliteConnection::ResetStatement()
 {
 	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	{
+		// also ends the read transaction of a query that didn't fetch all rows
+		sqlite3_reset(m_pStmt);
+		sqlite3_clear_bindings(m_pStmt);
+	}
 	m_pStmt = nullptr;
-	int Result = sqlite3_prepare_v2(
-		m_pDb,
-		pStmt,
-		-1, // pStmt can be any length
-		&m_pStmt,
-		NULL);
-	if(FormatError(Result, pError, ErrorSize))
+	m_pStmtStats = nullptr;
+}
+
+bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+{
+	ResetStatement();
+	auto *pEntry = m_Statements.Find(pStmt);
+	if(pEntry == nullptr)
 	{
-		return true;
+		sqlite3_stmt *pNewStmt = nullptr;
+		int Result = sqlite3_prepare_v2(
+			m_pDb,
+			pStmt,
+			-1, // pStmt can be any length
+			&pNewStmt,
+			NULL);
+		if(FormatError(Result, pError, ErrorSize))
+		{
+			return true;
+		}
+		pEntry = m_Statements.Add(pStmt, std::unique_ptr<sqlite3_stmt, CStmtDeleter>(pNewStmt), m_MaxCachedStatements);
+		pEntry->m_Stats.m_NumPrepared++;
 	}
+	m_pStmt = pEntry->m_pStmt.get();
+	m_pStmtStats = &pEntry->m_Stats;
+	m_NewQuery = true;
 	m_Done = false;
 	return false;
 }
 
+void CSqliteConnection::GetStatementStats(std::vector<std::pair<std::string, CDbStatementStats>> *pvStats) const
+{
+	m_Statements.GetStats(pvStats);
+}
+
 void CSqliteConnection::BindString(int Idx, const char *pString)
 {
 	int Result = sqlite3_bind_text(m_pStmt, Idx, pString, -1, NULL);
@@ -276,7 +339,14 @@ bool CSqliteConnection::Step(bool *pEnd, char *pError, int ErrorSize)
 		*pEnd = true;
 		return false;
 	}
+	const int64_t Start = time_get_impl();
 	int Result = sqlite3_step(m_pStmt);
+	if(m_pStmtStats != nullptr)
+	{
+		m_pStmtStats->m_NumExecuted += m_NewQuery;
+		m_pStmtStats->m_ExecuteTime += time_get_impl() - Start;
+	}
+	m_NewQuery = false;
 	if(Result == SQLITE_ROW)
 	{
 		*pEnd = false;
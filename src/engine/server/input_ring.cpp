@@ -0,0 +1,60 @@
+#include "input_ring.h"
+
+#include <base/system.h>
+
+CInputRing::CInputRing()
+{
+	Reset();
+}
+
+void CInputRing::Reset()
+{
+	for(auto &Tick : m_aTicks)
+	{
+		Tick.m_GameTick = -1;
+		Tick.m_NumInputs = 0;
+	}
+	for(auto &Entry : m_aEntries)
+		Entry.m_GameTick = -1;
+	m_NextSeq = 0;
+}
+
+void CInputRing::Add(int GameTick, const int *pData)
+{
+	const uint32_t Seq = m_NextSeq++;
+	CEntry &Entry = m_aEntries[Seq & (SIZE - 1)];
+
+	// the overwritten input is the oldest one, so it can only be the first
+	// of its tick
+	CTick &OldTick = m_aTicks[Entry.m_GameTick & (SIZE - 1)];
+	if(Entry.m_GameTick >= 0 && OldTick.m_GameTick == Entry.m_GameTick && OldTick.m_NumInputs > 0 && OldTick.m_FirstSeq == Seq - SIZE)
+	{
+		OldTick.m_FirstSeq = Entry.m_NextSeq;
+		OldTick.m_NumInputs--;
+	}
+
+	mem_copy(Entry.m_aData, pData, sizeof(Entry.m_aData));
+	Entry.m_GameTick = GameTick;
+
+	CTick &Tick = m_aTicks[GameTick & (SIZE - 1)];
+	if(Tick.m_GameTick != GameTick || Tick.m_NumInputs == 0 || !IsStored(Tick.m_LastSeq))
+	{
+		Tick.m_GameTick = GameTick;
+		Tick.m_NumInputs = 1;
+		Tick.m_FirstSeq = Seq;
+	}
+	else
+	{
+		m_aEntries[Tick.m_LastSeq & (SIZE - 1)].m_NextSeq = Seq;
+		Tick.m_NumInputs++;
+	}
+	Tick.m_LastSeq = Seq;
+}
+
+const int *CInputRing::First(int GameTick) const
+{
+	const CTick &Tick = m_aTicks[GameTick & (SIZE - 1)];
+	if(Tick.m_GameTick != GameTick || Tick.m_NumInputs == 0 || !IsStored(Tick.m_FirstSeq))
+		return nullptr;
+	return m_aEntries[Tick.m_FirstSeq & (SIZE - 1)].m_aData;
+}
@@ -0,0 +1,88 @@
+#ifndef ENGINE_SERVER_INPUT_RING_H
+#define ENGINE_SERVER_INPUT_RING_H
+
+#include <engine/shared/protocol.h>
+
+#include <cstdint>
+
+/**
+ * Inputs of one client, indexed by the tick they are meant for.
+ *
+ * Finding the inputs of a tick is a single lookup instead of a scan over
+ * all stored inputs. Several inputs can be meant for the same tick, for
+ * example when they arrive late and are moved to the next tick. Those are
+ * chained in the order they arrived.
+ */
+class CInputRing
+{
+public:
+	enum
+	{
+		// must be a power of two
+		SIZE = 256,
+	};
+
+	CInputRing();
+
+	void Reset();
+
+	/**
+	 * Stores an input.
+	 *
+	 * Overwrites the oldest input once @link SIZE @endlink inputs are
+	 * stored, and the inputs of a tick @link SIZE @endlink ticks apart.
+	 */
+	void Add(int GameTick, const int *pData);
+
+	/**
+	 * @return The first input that arrived for the tick, or `nullptr`.
+	 */
+	const int *First(int GameTick) const;
+
+	/**
+	 * Calls `Fn` with the data of every input for the tick, in the order
+	 * they arrived.
+	 */
+	template<typename F>
+	void ForEach(int GameTick, F &&Fn) const
+	{
+		const CTick &Tick = m_aTicks[GameTick & (SIZE - 1)];
+		if(Tick.m_GameTick != GameTick)
+			return;
+		uint32_t Seq = Tick.m_FirstSeq;
+		for(int i = 0; i < Tick.m_NumInputs && IsStored(Seq); i++)
+		{
+			const CEntry &Entry = m_aEntries[Seq & (SIZE - 1)];
+			Fn(Entry.m_aData);
+			Seq = Entry.m_NextSeq;
+		}
+	}
+
+private:
+	class CEntry
+	{
+	public:
+		int m_aData[MAX_INPUT_SIZE];
+		int m_GameTick;
+		// next input for the same tick
+		uint32_t m_NextSeq;
+	};
+
+	class CTick
+	{
+	public:
+		int m_GameTick;
+		int m_NumInputs;
+		uint32_t m_FirstSeq;
+		uint32_t m_LastSeq;
+	};
+
+	CEntry m_aEntries[SIZE];
+	CTick m_aTicks[SIZE];
+	// sequence number of the next input, wraps around
+	uint32_t m_NextSeq;
+
+	bool IsStored(uint32_t Seq) const { return m_NextSeq - Seq - 1 < (uint32_t)SIZE; }
+};
+
+#endif // ENGINE_SERVER_INPUT_RING_H
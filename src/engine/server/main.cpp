@@ -48,7 +48,6 @@ void HandleSigIntTerm(int Param)
 void CreateMqttAsync(IMqtt *pMqtt)
 {
 	dbg_msg("mqtt", "Starting MQTT thread");
-	pMqtt->Init();
 	pMqtt->Run();
 }
 #endif
@@ -213,8 +212,10 @@ int main(int argc, const char **argv)
 	pEngine->SetAdditionalLogger(pServerLogger);
 
 #ifdef CONF_MQTTSERVICES
+	// initialized before the thread starts, so the tick thread and the
+	// MQTT thread see the same interfaces without further synchronization
+	pMqtt->Init();
 	std::thread MqttThread{CreateMqttAsync, pMqtt};
-	MqttThread.detach();
 	pServer->setMqtt(pMqtt);
 #endif
 
@@ -222,6 +223,11 @@ int main(int argc, const char **argv)
 	log_trace("server", "initialization finished after %.2fms, starting...", (time_get() - MainStart) * 1000.0f / (float)time_freq());
 	int Ret = pServer->Run();
 
+#ifdef CONF_MQTTSERVICES
+	pMqtt->Shutdown();
+	MqttThread.join();
+#endif
+
 	pServerLogger->OnServerDeletion();
 	// free
 	delete pKernel;
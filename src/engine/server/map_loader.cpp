@@ -0,0 +1,143 @@
+#include "map_loader.h"
+
+#include <base/system.h>
+
+#include <engine/server.h>
+#include <engine/storage.h>
+
+#include <game/mapitems.h>
+
+#include <zlib.h>
+
+// decompresses the tiles the game reads when it starts, which is most of
+// the time it takes to initialize it
+static void UnpackTileLayers(IMap *pMap)
+{
+	int LayersStart, LayersNum;
+	pMap->GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+	for(int i = LayersStart; i < LayersStart + LayersNum; i++)
+	{
+		const CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(pMap->GetItem(i));
+		if(pLayer->m_Type != LAYERTYPE_TILES)
+			continue;
+		const CMapItemLayerTilemap *pTilemap = reinterpret_cast<const CMapItemLayerTilemap *>(pLayer);
+		pMap->GetData(pTilemap->m_Data);
+
+		// older versions store the indices elsewhere, the game fixes them up
+		if(pTilemap->m_Version <= 2 || pMap->GetItemSize(i) < (int)sizeof(CMapItemLayerTilemap))
+			continue;
+		if(pTilemap->m_Flags & TILESLAYERFLAG_TELE)
+			pMap->GetData(pTilemap->m_Tele);
+		if(pTilemap->m_Flags & TILESLAYERFLAG_SPEEDUP)
+			pMap->GetData(pTilemap->m_Speedup);
+		if(pTilemap->m_Flags & TILESLAYERFLAG_FRONT)
+			pMap->GetData(pTilemap->m_Front);
+		if(pTilemap->m_Flags & TILESLAYERFLAG_SWITCH)
+			pMap->GetData(pTilemap->m_Switch);
+		if(pTilemap->m_Flags & TILESLAYERFLAG_TUNE)
+			pMap->GetData(pTilemap->m_Tune);
+	}
+}
+
+CMapLoader::CMapLoader(IStorage *pStorage, IGameServer *pGameServer, const char *pMapName, bool Sixup) :
+	m_pStorage(pStorage),
+	m_pGameServer(pGameServer),
+	m_Sixup(Sixup),
+	m_Success(false),
+	m_pMap(CreateEngineMap()),
+	m_pData(nullptr),
+	m_DataSize(0),
+	m_pSixupData(nullptr),
+	m_SixupDataSize(0),
+	m_SixupSha256(SHA256_ZEROED),
+	m_SixupCrc(0),
+	m_Duration(0)
+{
+	str_copy(m_aMapName, pMapName);
+	str_format(m_aPath, sizeof(m_aPath), "maps/%s.map", pMapName);
+	m_aTempfile[0] = '\0';
+}
+
+CMapLoader::~CMapLoader()
+{
+	free(m_pData);
+	free(m_pSixupData);
+	// the map wasn't used, e.g. because sv_map changed while loading
+	if(m_aTempfile[0] != '\0')
+	{
+		m_pMap.reset();
+		m_pStorage->RemoveFile(m_aTempfile, IStorage::TYPE_SAVE);
+	}
+}
+
+void CMapLoader::Run()
+{
+	Load();
+}
+
+void CMapLoader::Load()
+{
+	const int64_t Start = time_get_impl();
+
+	if(m_pGameServer)
+	{
+		char aPath[IO_MAX_PATH_LENGTH];
+		str_copy(aPath, m_aPath);
+		m_pGameServer->OnMapChange(m_aPath, sizeof(m_aPath));
+		if(str_comp(m_aPath, aPath) != 0)
+			str_copy(m_aTempfile, m_aPath);
+	}
+
+	if(!m_pMap->Load(m_pStorage, m_aPath))
+		return;
+	UnpackTileLayers(m_pMap.get());
+	// the hashes are computed on first use, which should not be the main thread
+	m_pMap->Sha256();
+
+	// load complete map into memory for download
+	void *pData;
+	if(!m_pStorage->ReadFile(m_aPath, IStorage::TYPE_ALL, &pData, &m_DataSize))
+		return;
+	m_pData = (unsigned char *)pData;
+
+	if(m_Sixup)
+	{
+		char aSixupPath[IO_MAX_PATH_LENGTH];
+		str_format(aSixupPath, sizeof(aSixupPath), "maps7/%s.map", m_aMapName);
+		if(m_pStorage->ReadFile(aSixupPath, IStorage::TYPE_ALL, &pData, &m_SixupDataSize))
+		{
+			m_pSixupData = (unsigned char *)pData;
+			m_SixupSha256 = sha256(m_pSixupData, m_SixupDataSize);
+			m_SixupCrc = crc32(0, m_pSixupData, m_SixupDataSize);
+		}
+	}
+
+	m_Success = true;
+	m_Duration = time_get_impl() - Start;
+}
+
+unsigned char *CMapLoader::TakeData(unsigned *pSize)
+{
+	unsigned char *pData = m_pData;
+	*pSize = m_DataSize;
+	m_pData = nullptr;
+	m_DataSize = 0;
+	return pData;
+}
+
+unsigned char *CMapLoader::TakeSixupData(unsigned *pSize, SHA256_DIGEST *pSha256, unsigned *pCrc)
+{
+	unsigned char *pData = m_pSixupData;
+	*pSize = m_SixupDataSize;
+	*pSha256 = m_SixupSha256;
+	*pCrc = m_SixupCrc;
+	m_pSixupData = nullptr;
+	m_SixupDataSize = 0;
+	return pData;
+}
+
+void CMapLoader::TakeTempfile(char *pBuf, int BufSize)
+{
+	str_copy(pBuf, m_aTempfile, BufSize);
+	m_aTempfile[0] = '\0';
+}
@@ -0,0 +1,85 @@
+#ifndef ENGINE_SERVER_MAP_LOADER_H
+#define ENGINE_SERVER_MAP_LOADER_H
+
+#include <base/hash.h>
+#include <base/system.h>
+
+#include <engine/map.h>
+#include <engine/shared/jobs.h>
+
+#include <memory>
+
+class IGameServer;
+class IStorage;
+
+/**
+ * Prepares the next map of the server in the background.
+ *
+ * Reads the map and the files sent to the clients, computes their hashes
+ * and unpacks the tile layers. All that is left for the main thread is to
+ * take over the results and initialize the game with them.
+ */
+class CMapLoader : public IJob
+{
+	IStorage *m_pStorage;
+	IGameServer *m_pGameServer;
+	char m_aMapName[MAX_MAP_LENGTH];
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	// copy of the map written by the game, deleted unless taken
+	char m_aTempfile[IO_MAX_PATH_LENGTH];
+	bool m_Sixup;
+
+	bool m_Success;
+	std::unique_ptr<IEngineMap> m_pMap;
+	unsigned char *m_pData;
+	unsigned m_DataSize;
+	unsigned char *m_pSixupData;
+	unsigned m_SixupDataSize;
+	SHA256_DIGEST m_SixupSha256;
+	unsigned m_SixupCrc;
+	int64_t m_Duration;
+
+	void Run() override;
+
+public:
+	/**
+	 * @param pGameServer Gets to modify the map before it is loaded, can be
+	 * `nullptr`.
+	 * @param Sixup Whether to load the 0.7 version of the map too.
+	 */
+	CMapLoader(IStorage *pStorage, IGameServer *pGameServer, const char *pMapName, bool Sixup);
+	~CMapLoader() override;
+
+	/**
+	 * Loads the map in the calling thread.
+	 */
+	void Load();
+
+	const char *MapName() const { return m_aMapName; }
+	const char *Path() const { return m_aPath; }
+	bool Sixup() const { return m_Sixup; }
+	bool Success() const { return m_Success; }
+	int64_t Duration() const { return m_Duration; }
+
+	IEngineMap *Map() { return m_pMap.get(); }
+	/**
+	 * Passes the ownership of the map file to the caller, to be freed with
+	 * `free`.
+	 */
+	unsigned char *TakeData(unsigned *pSize);
+	/**
+	 * Like @link TakeData @endlink for the 0.7 map.
+	 *
+	 * @return `nullptr` if 0.7 is disabled or the 0.7 map is missing.
+	 */
+	unsigned char *TakeSixupData(unsigned *pSize, SHA256_DIGEST *pSha256, unsigned *pCrc);
+	/**
+	 * Passes the ownership of the temporary copy of the map that the game
+	 * wrote to the caller. Otherwise it is deleted with the loader.
+	 *
+	 * @return Empty if there is none.
+	 */
+	void TakeTempfile(char *pBuf, int BufSize);
+};
+
+#endif // ENGINE_SERVER_MAP_LOADER_H
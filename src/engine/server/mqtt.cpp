@@ -3,29 +3,32 @@
 #include "mqtt.h"
 
 #include <atomic>
+#include <base/math.h>
 #include <base/system.h>
+#include <engine/storage.h>
+#include <game/collision.h>
 #include <game/server/entities/character.h>
 #include <game/server/player.h>
 #include <thread>
 
 #ifdef CONF_MQTTSERVICES
 
+// Set while the tick thread executes a command received over MQTT, the
+// lines it prints are not published to avoid feedback loops
+static thread_local bool s_ExecutingCommand = false;
+
 IMqtt *CreateMqtt() { return new CMqtt(); }
 
 CMqtt::CMqtt() :
-	m_pServer(0), m_pConsole(0), m_pGameServer(0), m_lastHeartBeat(0), m_rMapUpdate(true), m_rHeartbeat(true), m_connected(false)
+	m_pServer(0), m_pConsole(0), m_pGameServer(0), m_pGameContext(0), m_lastHeartBeat(0), m_rMapUpdate(false), m_rMapResend(false), m_rHeartbeat(true), m_rServerUpdate(false), m_rPlayersUpdate(false), m_Disabled(false), m_Shutdown(false), m_DroppedMessages(0), m_FilteredConsole(0), m_SuppressedMessages(0), m_ConsoleBatch(json::array()), m_ConsoleBatchStart(0), m_BatchedLines(0), m_NumConsoleBatches(0), m_PlayersTick(0), m_DroppedCommands(0), m_InvalidCommands(0)
 {
-	connOpts_.set_keep_alive_interval(20);
-	connOpts_.set_clean_session(true);
 	dbg_msg("mqtt", "MQTT service initialized");
 }
 
 CMqtt::~CMqtt()
 {
-	if(client_ && m_connected)
-	{
-		client_->disconnect()->wait();
-	}
+	// disconnects before the link it reports to goes away
+	m_pTransport.reset();
 }
 
 void CMqtt::Init()
@@ -38,78 +41,284 @@ void CMqtt::Init()
 	if(str_comp_nocase(g_Config.m_SvMQTTAddresse, "") == 0 || str_comp_nocase(g_Config.m_SvMQTTUsername, "") == 0 || str_comp_nocase(g_Config.m_SvMQTTPassword, "") == 0)
 	{
 		dbg_msg("mqtt", "MQTT service not initialized, missing configuration");
+		Disable();
 		return;
 	}
 
-	dbg_msg("mqtt", "Connecting to MQTT server over interface");
-	try
+	InitSpool();
+	InitEncodings();
+
+	m_pTransport.reset(CreateMqttPahoTransport(g_Config.m_SvMQTTAddresse, "DDNetServer", g_Config.m_SvMQTTUsername, g_Config.m_SvMQTTPassword));
+	if(!m_pTransport)
 	{
-		client_ = std::make_unique<mqtt::async_client>(g_Config.m_SvMQTTAddresse, "DDNetServer");
-		connOpts_.set_user_name(g_Config.m_SvMQTTUsername);
-		connOpts_.set_password(g_Config.m_SvMQTTPassword);
-		prefix = std::string(g_Config.m_SvMQTTTopic) + "/" + std::string(g_Config.m_SvSID);
+		Disable();
+		return;
+	}
 
-		client_->connect(connOpts_)->wait();
-		m_connected = true;
-		client_->set_message_callback([this](mqtt::const_message_ptr msg) {
-			const std::string topic = msg->get_topic();
-			const std::string payload = msg->to_string();
+	prefix = std::string(g_Config.m_SvMQTTTopic) + "/" + std::string(g_Config.m_SvSID);
+	m_LoginResponseTopic = GetChannelName(CHANNEL_RESPONSE) + "/login";
 
-			if(m_responseCallbacks.find(topic) != m_responseCallbacks.end())
-			{
-				// Rufe den Callback für dieses Antwortthema auf
-				m_responseCallbacks[topic](payload);
+	m_pTransport->SetMessageCallback([this](const std::string &topic, const std::string &Payload, const std::string &CorrelationData) {
+		const char *pRest = str_startswith(topic.c_str(), m_LoginResponseTopic.c_str());
+		if(pRest && (pRest[0] == '\0' || pRest[0] == '/'))
+			HandleLoginResponse(Payload, CorrelationData);
+		else
+			HandleMessage(topic, Payload);
+	});
 
-				// Optional vom Antwortthema abmelden
-				client_->unsubscribe(topic)->wait();
+	m_PlayerTracker.Init(g_Config.m_SvMQTTPlayerKeyframe * Server()->TickSpeed());
+	m_LoginRequests.Init(g_Config.m_SvMQTTLoginTimeout * time_freq(), time_freq() / LOGIN_TIMER_RESOLUTION, (uint32_t)secure_rand());
 
-				// Entferne den Callback aus der Map
-				m_responseCallbacks.erase(topic);
-			}
+	std::vector<std::string> vTopics;
+	for(int Channel = 0; Channel < NUM_CHANNELS; Channel++)
+		vTopics.push_back(GetChannelName(Channel));
+	m_Link.Init(m_pTransport.get(), std::move(vTopics),
+		(int64_t)g_Config.m_SvMQTTReconnectMin * time_freq() / 1000,
+		(int64_t)g_Config.m_SvMQTTReconnectMax * time_freq() / 1000,
+		0.25f, [this]() { Wakeup(); });
+}
 
-			HandleMessage(topic, payload);
-		});
+void CMqtt::UpdateConnection()
+{
+	if(!m_Link.Update(time_get()))
+		return;
 
-		Subscribe(CHANNEL_RESPONSE);
+	dbg_msg("mqtt", "Connected to the MQTT broker with topic %s", prefix.c_str());
+
+	m_PlayerTracker.RequestKeyframe();
+
+	// the session is clean, so subscriptions have to be renewed
+	Subscribe(CHANNEL_RESPONSE);
+	// one subscription for the responses to all login requests, they are
+	// told apart by their correlation id
+	m_Link.Subscribe((m_LoginResponseTopic + "/#").c_str(), 1);
+
+	Publish(CHANNEL_SERVER, std::string("Connected to the MQTT broker"));
+}
 
-		dbg_msg("mqtt", "Connected to the MQTT broker with topic %s", prefix.c_str());
-		Publish(CHANNEL_SERVER, std::string("Connected to the MQTT broker"));
+void CMqtt::InitEncodings()
+{
+	for(int &Encoding : m_aChannelEncodings)
+		Encoding = MQTT_ENCODING_JSON;
+	if(!MqttParseEncodings(g_Config.m_SvMQTTEncoding, m_aChannelEncodings, NUM_CHANNELS, ChannelSuffix))
+		dbg_msg("mqtt", "Invalid entries in sv_mqtt_encoding '%s'", g_Config.m_SvMQTTEncoding);
+}
+
+void CMqtt::InitSpool()
+{
+	if(g_Config.m_SvMQTTSpoolSize <= 0)
+		return;
+
+	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
+	if(!pStorage || !pStorage->CreateFolder("mqtt_spool", IStorage::TYPE_SAVE))
+	{
+		dbg_msg("mqtt", "Failed to create the spool folder, messages are dropped while disconnected");
+		return;
 	}
-	catch(const mqtt::exception &exc)
+
+	// several servers usually share one storage path, give each its own spool
+	char aSid[128];
+	str_copy(aSid, g_Config.m_SvSID);
+	str_sanitize_filename(aSid);
+	char aDir[IO_MAX_PATH_LENGTH];
+	str_format(aDir, sizeof(aDir), "mqtt_spool/%s", aSid);
+	char aPath[IO_MAX_PATH_LENGTH];
+	pStorage->GetCompletePath(IStorage::TYPE_SAVE, aDir, aPath, sizeof(aPath));
+
+	const int64_t MaxBytes = (int64_t)g_Config.m_SvMQTTSpoolSize * 1024 * 1024;
+	if(!m_Link.Spool().Init(aPath, MaxBytes, g_Config.m_SvMQTTSpoolMaxAge, MaxBytes / 16))
+		dbg_msg("mqtt", "Failed to initialize the spool in '%s'", aPath);
+}
+
+void CMqtt::Disable()
+{
+	m_Disabled = true;
+	while(m_Queue.TryPop([](CQueuedMessage &Message) { Message.m_Json = json(); }))
+	{
+	}
+}
+
+void CMqtt::Shutdown()
+{
+	m_Shutdown = true;
+	Wakeup();
+}
+
+void CMqtt::OnTick()
+{
+	if(m_Disabled || !m_pGameContext)
+		return;
+
+	// apply login results on the tick thread, the player may have left
+	// and the slot been taken by someone else in the meantime
+	while(m_LoginResults.TryPop([this](CLoginResult &Result) {
+		CPlayer *pPlayer = m_pGameContext->m_apPlayers[Result.m_ClientId];
+		if(pPlayer && pPlayer->GetUniqueCid() == Result.m_UniqueClientId)
+			m_pGameContext->OnMqttLogin(Result.m_ClientId, Result.m_Status, Result.m_aMessage);
+	}))
 	{
-		dbg_msg("mqtt", "MQTT connect error: %s", exc.what());
+	}
+
+	ExecuteCommands();
+
+	// nobody would get the changes, the first update after reconnecting
+	// is a keyframe anyway
+	if(!m_Link.Connected())
+		return;
+
+	const int Rate = g_Config.m_SvMQTTPlayerRate;
+	if(Rate <= 0 || Server()->Tick() % Rate != 0)
 		return;
+
+	CapturePlayers();
+	m_rPlayersUpdate = true;
+	Wakeup();
+}
+
+void CMqtt::SetMapUpdate(bool update)
+{
+	m_rMapUpdate = update;
+	if(update)
+		Wakeup();
+}
+
+void CMqtt::SetHeartbeat(bool update)
+{
+	// the heartbeat counts the players, take them while still on the
+	// tick thread
+	if(update && !m_Disabled && m_pGameContext)
+		CapturePlayers();
+	m_rHeartbeat = update;
+	if(update)
+		Wakeup();
+}
+
+void CMqtt::SetServerUpdate(bool update)
+{
+	m_rServerUpdate = update;
+	if(update)
+		Wakeup();
+}
+
+void CMqtt::Wakeup()
+{
+	m_Wakeup.Wakeup();
+}
+
+void CMqtt::WaitForWork()
+{
+	// replaying the spool and the next connection attempt
+	int64_t Timeout = m_Link.Timeout(time_get());
+	if(!m_ConsoleBatch.empty())
+	{
+		// wake up to send the collected console lines
+		const int64_t Remaining = maximum<int64_t>((ConsoleBatchDeadline() - time_get()) * 1000 / time_freq(), 0) + 1;
+		Timeout = Timeout >= 0 ? minimum(Timeout, Remaining) : Remaining;
 	}
+	if(m_LoginRequests.NumPending() > 0)
+	{
+		// wake up to time out login requests
+		const int64_t Resolution = 1000 / LOGIN_TIMER_RESOLUTION;
+		Timeout = Timeout >= 0 ? minimum(Timeout, Resolution) : Resolution;
+	}
+
+	m_Wakeup.Wait(Timeout, [this]() { return HasWork(); });
+}
+
+bool CMqtt::HasWork() const
+{
+	return m_Shutdown || m_Link.HasEvents() || (m_rMapUpdate && m_Link.Connected()) || m_rHeartbeat || m_rPlayersUpdate || !m_Queue.Empty();
+}
+
+int CMqtt::CurrentTick() const
+{
+	// the console already publishes while the config is executed, before
+	// Init() resolved the interfaces and the server started ticking
+	return m_pServer ? m_pServer->Tick() : 0;
+}
+
+template<typename F>
+bool CMqtt::Enqueue(int Topic, int Kind, F &&Fill)
+{
+	if(m_Disabled || m_Shutdown)
+		return false;
+
+	const int Tick = CurrentTick();
+	const bool Pushed = m_Queue.TryPush([&](CQueuedMessage &Message) {
+		Message.m_Topic = Topic;
+		Message.m_Tick = Tick;
+		Message.m_Kind = Kind;
+		Fill(Message);
+	});
+	if(!Pushed)
+	{
+		m_DroppedMessages.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	Wakeup();
+	return true;
 }
 
 void CMqtt::Run()
 {
 	try
 	{
-		while(m_connected)
+		if(m_Disabled)
+			return;
+
+		uint64_t ReportedDrops = 0;
+		while(!m_Shutdown)
 		{
-			if(m_rMapUpdate)
+			UpdateConnection();
+			WaitForWork();
+
+			if(m_Shutdown)
+				break;
+
+			UpdateConnection();
+
+			// keep the map update for when the broker is back, the
+			// heartbeat is outdated by then anyway
+			if(m_Link.Connected() && m_rMapUpdate.exchange(false))
 			{
-				Publish(CHANNEL_MAP, SerializeMapInfo());
-				m_rMapUpdate = false;
+				SendMap(m_rMapResend.exchange(false));
 			}
 
-			if(m_rHeartbeat)
+			if(m_rHeartbeat.exchange(false) && m_Link.Connected())
 			{
-				Publish(CHANNEL_SERVERINFO, SerializeServer());
-				m_rHeartbeat = false;
+				SendJson(CHANNEL_SERVERINFO, Server()->Tick(), SerializeServer());
 			}
 
-			if(!m_missedMessages.empty())
+			if(m_rPlayersUpdate.exchange(false) && m_Link.Connected())
 			{
-				for(auto &message : m_missedMessages)
-				{
-					Publish(message.first, message.second);
-				}
-				m_missedMessages.clear();
+				SendPlayers();
+			}
+
+			m_Link.Drain(time_get(), g_Config.m_SvMQTTSpoolDrainRate);
+			ExpireLoginRequests();
+
+			while(m_Queue.TryPop([this](CQueuedMessage &Message) {
+				// the JSON payload is moved out and sent without a copy,
+				// make sure the slot doesn't keep anything left over
+				Send(Message);
+				Message.m_Json = json();
+			}))
+			{
+			}
+
+			if(!m_ConsoleBatch.empty() && (g_Config.m_SvMQTTConsoleBatch <= 0 || time_get() >= ConsoleBatchDeadline()))
+				FlushConsoleBatch();
+
+			const uint64_t Drops = m_DroppedMessages.load(std::memory_order_relaxed);
+			if(Drops != ReportedDrops)
+			{
+				dbg_msg("mqtt", "Outbound queue full, dropped %" PRIu64 " messages", Drops - ReportedDrops);
+				ReportedDrops = Drops;
 			}
-			//std::this_thread::sleep_for(std::chrono::milliseconds(20));
 		}
+
+		// the last lines before the shutdown are the interesting ones
+		FlushConsoleBatch();
 	}
 	catch(const std::exception &e)
 	{
@@ -119,337 +328,547 @@ void CMqtt::Run()
 
 bool CMqtt::Subscribe(const int &topic)
 {
-	if(!m_connected)
+	if(!m_Link.Connected())
 		return false;
 
-	try
+	return m_Link.Subscribe(GetChannelName(topic).c_str(), 1);
+}
+
+bool CMqtt::Publish(const int &topic, const std::string &payload)
+{
+	return Enqueue(topic, MESSAGE_TEXT, [&](CQueuedMessage &Message) {
+		str_copy(Message.m_aText, payload.c_str());
+	});
+}
+
+bool CMqtt::Publish(const int &topic, const json &payload)
+{
+	return Enqueue(topic, MESSAGE_JSON, [&](CQueuedMessage &Message) {
+		Message.m_Json = payload;
+	});
+}
+
+bool CMqtt::Publish(const int &topic, json &&payload)
+{
+	return Enqueue(topic, MESSAGE_JSON, [&](CQueuedMessage &Message) {
+		Message.m_Json = std::move(payload);
+	});
+}
+
+int64_t CMqtt::RateInterval(int Rate)
+{
+	return Rate > 0 ? time_freq() / Rate : 0;
+}
+
+bool CMqtt::PublishConsole(int Level, const char *pFrom, const char *pStr)
+{
+	if(s_ExecutingCommand)
 	{
-		client_->subscribe(GetChannelName(topic), 1)->wait();
-        return true;
+		m_SuppressedMessages.fetch_add(1, std::memory_order_relaxed);
+		return false;
 	}
-	catch(const mqtt::exception &exc)
+	if(Level > g_Config.m_SvMQTTConsoleLevel)
 	{
-		dbg_msg("mqtt", "MQTT subscribe error: %s", exc.what());
+		m_FilteredConsole.fetch_add(1, std::memory_order_relaxed);
 		return false;
 	}
+	if(!m_ConsoleLimiter.Allow(time_get(), RateInterval(g_Config.m_SvMQTTConsoleRate), g_Config.m_SvMQTTConsoleBurst))
+		return false;
 
-	return true;
+	return Enqueue(CHANNEL_CONSOLE, MESSAGE_CONSOLE, [&](CQueuedMessage &Message) {
+		Message.m_aArgs[0] = Level;
+		str_copy(Message.m_aName, pFrom);
+		str_copy(Message.m_aText, pStr);
+	});
 }
 
-bool CMqtt::Publish(const int &topic, const std::string &payload)
+bool CMqtt::PublishRcon(const char *pCommand, int ClientId)
 {
-	if(!m_connected)
+	if(s_ExecutingCommand)
 	{
-		dbg_msg("mqtt", "Cannot publish: Not connected");
+		m_SuppressedMessages.fetch_add(1, std::memory_order_relaxed);
 		return false;
 	}
+	if(!m_RconLimiter.Allow(time_get(), RateInterval(g_Config.m_SvMQTTRconRate), g_Config.m_SvMQTTRconBurst))
+		return false;
 
-	try
+	return Enqueue(CHANNEL_RCON, MESSAGE_RCON, [&](CQueuedMessage &Message) {
+		Message.m_aArgs[0] = ClientId;
+		str_copy(Message.m_aText, pCommand);
+	});
+}
+
+bool CMqtt::PublishChat(int ClientId, const char *pName, const char *pMessage, int Team)
+{
+	return Enqueue(CHANNEL_CHAT, MESSAGE_CHAT, [&](CQueuedMessage &Message) {
+		Message.m_aArgs[0] = ClientId;
+		Message.m_aArgs[1] = Team;
+		str_copy(Message.m_aName, pName);
+		str_copy(Message.m_aText, pMessage);
+	});
+}
+
+bool CMqtt::Send(CQueuedMessage &Message)
+{
+	switch(Message.m_Kind)
 	{
-		client_->publish(GetChannelName(topic), payload.c_str(), payload.size(), 1, false);
+	case MESSAGE_TEXT:
+		return m_Link.Send(Message.m_Topic, MQTT_ENCODING_TEXT, Message.m_aText, str_length(Message.m_aText));
+	case MESSAGE_JSON:
+		return SendJson(Message.m_Topic, Message.m_Tick, std::move(Message.m_Json));
+	case MESSAGE_LOGIN:
+		return SendLogin(Message);
+	case MESSAGE_CONSOLE:
+	{
+		json response;
+		response["level"] = Message.m_aArgs[0];
+		response["from"] = Message.m_aName;
+		response["str"] = Message.m_aText;
+		if(g_Config.m_SvMQTTConsoleBatch <= 0)
+			return SendJson(Message.m_Topic, Message.m_Tick, std::move(response));
+
+		if(m_ConsoleBatch.empty())
+			m_ConsoleBatchStart = time_get();
+		response["tick"] = Message.m_Tick;
+		m_ConsoleBatch.push_back(std::move(response));
+		m_BatchedLines++;
+		if(m_ConsoleBatch.size() >= CONSOLE_BATCH_LINES)
+			FlushConsoleBatch();
 		return true;
 	}
-	catch(const mqtt::exception &exc)
+	case MESSAGE_RCON:
+	{
+		json response;
+		response["command"] = Message.m_aText;
+		response["clientid"] = Message.m_aArgs[0];
+		return SendJson(Message.m_Topic, Message.m_Tick, std::move(response));
+	}
+	case MESSAGE_CHAT:
 	{
-		dbg_msg("mqtt", "Publish failed: %s", exc.what());
+		json result;
+		result["cid"] = Message.m_aArgs[0];
+		result["name"] = Message.m_aName;
+		result["message"] = Message.m_aText;
+		result["team"] = Message.m_aArgs[1];
+		return SendJson(Message.m_Topic, Message.m_Tick, std::move(result));
+	}
+	default:
+		dbg_msg("mqtt", "Unknown queued message kind %d", Message.m_Kind);
 		return false;
 	}
 }
 
-bool CMqtt::Publish(const int &topic, const json &payload)
+void CMqtt::FlushConsoleBatch()
 {
-	if(!m_connected)
-	{
-		m_missedMessages.emplace(topic, payload);
-		return false;
-	}
+	if(m_ConsoleBatch.empty())
+		return;
+	json batch;
+	batch["lines"] = std::move(m_ConsoleBatch);
+	m_ConsoleBatch = json::array();
+	m_NumConsoleBatches++;
+	SendJson(CHANNEL_CONSOLE, CurrentTick(), std::move(batch));
+}
 
-	try
+int64_t CMqtt::ConsoleBatchDeadline() const
+{
+	return m_ConsoleBatchStart + (int64_t)g_Config.m_SvMQTTConsoleBatch * time_freq() / 1000;
+}
+
+bool CMqtt::SendLogin(CQueuedMessage &Message)
+{
+	// The payload carries the response topic and the correlation id as
+	// well, the spool drops the properties. The request times out if the
+	// response doesn't arrive in time.
+	const int Encoding = m_aChannelEncodings[CHANNEL_LOGIN];
+	MqttEncode(Encoding, Message.m_Json, m_EncodeBuffer);
+	return m_Link.Send(CHANNEL_LOGIN, Encoding, m_EncodeBuffer.data(), m_EncodeBuffer.size(), m_LoginResponseTopic.c_str(), Message.m_aName);
+}
+
+bool CMqtt::SendJson(int Topic, int Tick, json &&Payload)
+{
+	// the payload is thrown away afterwards, add the tick without copying it
+	Payload["tick"] = Tick;
+	const int Encoding = Topic >= 0 && Topic < NUM_CHANNELS ? m_aChannelEncodings[Topic] : (int)MQTT_ENCODING_JSON;
+	MqttEncode(Encoding, Payload, m_EncodeBuffer);
+	return m_Link.Send(Topic, Encoding, m_EncodeBuffer.data(), m_EncodeBuffer.size());
+}
+
+const char *CMqtt::ChannelSuffix(int channel)
+{
+	switch(channel)
 	{
-		json payloadEx = payload;
-		payloadEx["tick"] = Server()->Tick();
-		client_->publish(GetChannelName(topic), payloadEx.dump().c_str(), payloadEx.dump().size(), 1, false);
-		return true;
-	}
-	catch(const mqtt::exception &exc)
-	{
-		dbg_msg("mqtt", "Publish failed: %s", exc.what());
-		return false;
+	case CHANNEL_SERVER: return "server";
+	case CHANNEL_CONSOLE: return "console";
+	case CHANNEL_CHAT: return "chat";
+	case CHANNEL_RCON: return "rcon";
+	case CHANNEL_LOGIN: return "login";
+	case CHANNEL_MAP: return "map";
+	case CHANNEL_CONNECTION: return "connection";
+	case CHANNEL_RESPONSE: return "response";
+	case CHANNEL_VOTE: return "vote";
+	case CHANNEL_PLAYERINFO: return "playerinfo";
+	case CHANNEL_SERVERINFO: return "serverinfo";
+	case CHANNEL_INGAME: return "ingame";
+	case CHANNEL_PLAYERS: return "players";
+	default: return "default";
 	}
 }
 
-bool CMqtt::PublishWithResponse(const int &topic, const std::string &payload, const std::string &responseTopic)
+std::string CMqtt::GetChannelName(int channel)
 {
-	try
-	{
-		if(!m_connected)
-		{
-			dbg_msg("mqtt", "Not connected to MQTT broker, cannot publish with response");
-			return false;
-		}
-		// Subscribe to the response topic
-		client_->subscribe(responseTopic, 1)->wait();
+	return prefix + "/" + ChannelSuffix(channel);
+}
 
-		// Add a callback to handle the response
-		m_responseCallbacks[responseTopic] = [](const std::string &response) {
-			// Handle the response (e.g., log it or process it)
-			dbg_msg("mqtt", "Received response: %s", response.c_str());
-		};
+int CMqtt::RequestLogin(int ClientId, const char *pLoginToken)
+{
+	if(!m_Link.Connected())
+		return MQTT_LOGIN_UNAVAILABLE;
+	if(ClientId < 0 || ClientId >= MAX_CLIENTS || !m_pGameContext->m_apPlayers[ClientId] || pLoginToken[0] == '\0')
+		return MQTT_LOGIN_FAILED;
 
-		// Publish the message
-		client_->publish(GetChannelName(topic), payload.c_str(), payload.size(), 1, false)->wait();
-		return true;
-	}
-	catch(const mqtt::exception &exc)
+	const uint64_t Id = m_LoginRequests.Add(ClientId, m_pGameContext->m_apPlayers[ClientId]->GetUniqueCid(), time_get());
+	if(Id == 0)
+		return MQTT_LOGIN_PENDING;
+
+	char aCorrelationId[CMqttPendingRequests::CORRELATION_ID_LENGTH + 1];
+	CMqttPendingRequests::FormatId(Id, aCorrelationId, sizeof(aCorrelationId));
+	char aIp[NETADDR_MAXSTRSIZE];
+	Server()->GetClientAddr(ClientId, aIp, sizeof(aIp));
+
+	json payload;
+	payload["clientid"] = ClientId;
+	payload["logintoken"] = pLoginToken;
+	payload["username"] = Server()->ClientName(ClientId);
+	payload["ip"] = aIp;
+	payload["tick"] = Server()->Tick();
+	// for consumers that don't speak MQTT 5 and can't see the properties
+	payload["responseTopic"] = m_LoginResponseTopic;
+	payload["correlation_id"] = aCorrelationId;
+
+	// published by the MQTT thread like everything else, so the tick
+	// doesn't wait for the client
+	const bool Queued = Enqueue(CHANNEL_LOGIN, MESSAGE_LOGIN, [&](CQueuedMessage &Message) {
+		str_copy(Message.m_aName, aCorrelationId);
+		Message.m_Json = std::move(payload);
+	});
+	if(!Queued)
 	{
-		dbg_msg("mqtt", "Publish with response failed: %s", exc.what());
-		return false;
+		CMqttPendingRequests::CRequest Request;
+		m_LoginRequests.Complete(Id, Request);
+		return MQTT_LOGIN_UNAVAILABLE;
 	}
+	return MQTT_LOGIN_REQUESTED;
 }
 
-bool CMqtt::WaitForResponse(const std::string &responseTopic, std::function<void(const std::string &)> callback)
+void CMqtt::HandleLoginResponse(const std::string &Payload, const std::string &CorrelationData)
 {
-	if(!m_connected)
+	const json Response = json::parse(Payload, nullptr, false);
+
+	std::string CorrelationId = CorrelationData;
+	if(CorrelationId.empty() && Response.is_object() && Response.contains("correlation_id") && Response["correlation_id"].is_string())
+		CorrelationId = Response["correlation_id"].get<std::string>();
+
+	uint64_t Id;
+	CMqttPendingRequests::CRequest Request;
+	if(!CMqttPendingRequests::ParseId(CorrelationId.c_str(), &Id) || !m_LoginRequests.Complete(Id, Request))
 	{
-		dbg_msg("mqtt", "Not connected to MQTT broker, cannot wait for response");
-		return false;
+		// timed out already or not meant for this server
+		dbg_msg("mqtt", "Dropped login response with unknown correlation id '%s'", CorrelationId.c_str());
+		return;
 	}
 
-	// Store the callback for the response topic
-	m_responseCallbacks[responseTopic] = callback;
-	return true;
+	int Status = MQTT_LOGIN_FAILED;
+	std::string Text;
+	if(Response.is_object())
+	{
+		if(Response.contains("status") && Response["status"] == "success")
+			Status = MQTT_LOGIN_SUCCESS;
+		if(Response.contains("message") && Response["message"].is_string())
+			Text = Response["message"].get<std::string>();
+	}
+	PushLoginResult(Request, Status, Text.c_str());
 }
 
-std::string CMqtt::GetChannelName(int channel)
+void CMqtt::ExpireLoginRequests()
 {
-	switch(channel)
-	{
-	case CHANNEL_SERVER:
-		return std::string(prefix) + "/server";
-	case CHANNEL_CONSOLE:
-		return std::string(prefix) + "/console";
-	case CHANNEL_CHAT:
-		return std::string(prefix) + "/chat";
-	case CHANNEL_RCON:
-		return std::string(prefix) + "/rcon";
-	case CHANNEL_LOGIN:
-		return std::string(prefix) + "/login";
-	case CHANNEL_MAP:
-		return std::string(prefix) + "/map";
-	case CHANNEL_CONNECTION:
-		return std::string(prefix) + "/connection";
-	case CHANNEL_RESPONSE:
-		return std::string(prefix) + "/response";
-	case CHANNEL_VOTE:
-		return std::string(prefix) + "/vote";
-	case CHANNEL_PLAYERINFO:
-		return std::string(prefix) + "/playerinfo";
-	case CHANNEL_SERVERINFO:
-		return std::string(prefix) + "/serverinfo";
-	case CHANNEL_INGAME:
-		return std::string(prefix) + "/ingame";
-	default:
-		return std::string(prefix) + "/default";
-	}
+	m_vExpiredLogins.clear();
+	m_LoginRequests.Expire(time_get(), m_vExpiredLogins);
+	for(const CMqttPendingRequests::CRequest &Request : m_vExpiredLogins)
+		PushLoginResult(Request, MQTT_LOGIN_TIMEOUT, "");
 }
 
-std::string CMqtt::RandomUuid()
+void CMqtt::PushLoginResult(const CMqttPendingRequests::CRequest &Request, int Status, const char *pMessage)
 {
-	std::string uuid = "4y4yxxxxxxxxxxx";
-	for(int i = 0; i < (int)uuid.size(); ++i)
+	const bool Pushed = m_LoginResults.TryPush([&](CLoginResult &Result) {
+		Result.m_ClientId = Request.m_ClientId;
+		Result.m_UniqueClientId = Request.m_UniqueClientId;
+		Result.m_Status = Status;
+		str_copy(Result.m_aMessage, pMessage);
+	});
+	if(!Pushed)
+		dbg_msg("mqtt", "Login result queue full, dropped result for client %d", Request.m_ClientId);
+}
+
+void CMqtt::HandleMessage(const std::string &topic, const std::string &payload)
+{
+	if(str_comp_nocase(topic.c_str(), GetChannelName(CHANNEL_RESPONSE).c_str()) != 0)
+		return;
+
+	// only parse here, the commands touch the game and run on the tick thread
+	CInboundCommand Command;
+	if(!ParseCommand(json::parse(payload, nullptr, false), Command))
 	{
-		if(uuid[i] == 'x')
-		{
-			uuid[i] = "0123456789abcdef"[rand() % 16];
-		}
-		else if(uuid[i] == 'y')
-		{
-			uuid[i] = "89ab"[rand() % 4];
-		}
+		m_InvalidCommands.fetch_add(1, std::memory_order_relaxed);
+		dbg_msg("mqtt", "Invalid command received on the response channel");
+		return;
 	}
-	return uuid;
+	if(!m_Commands.TryPush([&](CInboundCommand &Slot) { Slot = Command; }))
+		m_DroppedCommands.fetch_add(1, std::memory_order_relaxed);
 }
 
-bool CMqtt::RequestLogin(const int &clientId, const std::string &logintoken)
+bool CMqtt::ParseCommand(const json &Command, CInboundCommand &Out)
 {
-	if(!m_connected)
-	{
-		dbg_msg("mqtt", "Not connected to MQTT broker, cannot request login");
+	if(!Command.is_object() || !Command.contains("type") || !Command["type"].is_number_integer())
 		return false;
-	}
 
-	if(clientId < 0 || clientId >= MAX_CLIENTS)
+	Out.m_Type = Command["type"].get<int>();
+	Out.m_ClientId = -1;
+	Out.m_Team = 0;
+	Out.m_aText[0] = '\0';
+
+	const json *pData = Command.contains("data") ? &Command["data"] : nullptr;
+	switch(Out.m_Type)
 	{
-		return false;
-	}
-	if(m_pGameContext->m_apPlayers[clientId] == nullptr)
+	case CHANNEL_RESPONSETYPE_RCON:
 	{
-		return false;
+		if(!pData || !pData->is_string())
+			return false;
+		// a truncated console command could do something else entirely
+		const std::string &Line = pData->get_ref<const std::string &>();
+		if(Line.size() >= sizeof(Out.m_aText))
+			return false;
+		str_copy(Out.m_aText, Line.c_str());
+		return true;
 	}
-	if(logintoken.empty())
+	case CHANNEL_RESPONSETYPE_CHAT:
 	{
+		if(!pData || !pData->is_object() ||
+			!pData->contains("cid") || !(*pData)["cid"].is_number_integer() ||
+			!pData->contains("team") || !(*pData)["team"].is_number_integer() ||
+			!pData->contains("message") || !(*pData)["message"].is_string())
+			return false;
+		Out.m_ClientId = (*pData)["cid"].get<int>();
+		Out.m_Team = (*pData)["team"].get<int>();
+		if(Out.m_ClientId < -1 || Out.m_ClientId >= MAX_CLIENTS)
+			return false;
+		str_copy(Out.m_aText, (*pData)["message"].get_ref<const std::string &>().c_str());
+		return true;
+	}
+	case CHANNEL_RESPONSETYPE_RESENDMAP:
+		return true;
+	default:
 		return false;
 	}
+}
 
-	json payload;
-	std::string responseTopic = GetChannelName(CHANNEL_RESPONSE) + "/" + RandomUuid();
-	char pLoginToken[128];
-	char pUsername[MAX_NAME_LENGTH];
-	char pIp[NETADDR_MAXSTRSIZE];
-	int pClientID = clientId;
-	str_copy(pLoginToken, logintoken.c_str(), sizeof(pLoginToken));
-	str_copy(pUsername, m_pServer->ClientName(clientId), sizeof(pUsername));
-	m_pGameContext->Server()->GetClientAddr(pClientID, pIp, sizeof(pIp));
-
-	payload["clientid"] = pClientID;
-	payload["logintoken"] = pLoginToken;
-	payload["username"] = pUsername;
-	payload["responseTopic"] = responseTopic;
-	payload["ip"] = pIp;
-	PublishWithResponse(CHANNEL_LOGIN, payload.dump(), responseTopic);
-
-	WaitForResponse(responseTopic, [this](const std::string &response) {
-		json jsonResponse = json::parse(response);
-		// TODO: Handle the response
-		//! Server should crash if status is not set. 
-		//! This is just a placeholder. Make sure to handle the response properly with try-catch
-		if(jsonResponse["status"] == "success")
-		{
-			dbg_msg("mqtt", "Login successful");
-		}
-		else
-		{
-			dbg_msg("mqtt", "Login failed");
-		}
-	});
+void CMqtt::ExecuteCommand(const CInboundCommand &Command)
+{
+	switch(Command.m_Type)
+	{
+	case CHANNEL_RESPONSETYPE_RCON:
+		s_ExecutingCommand = true;
+		Console()->ExecuteLine(Command.m_aText);
+		s_ExecutingCommand = false;
+		break;
+	case CHANNEL_RESPONSETYPE_CHAT:
+		GameContext()->SendChat(Command.m_ClientId, Command.m_Team, Command.m_aText);
+		break;
+	case CHANNEL_RESPONSETYPE_RESENDMAP:
+		// Resend the map, including the tiles in case the broker
+		// lost the retained message
+		m_rMapResend = true;
+		m_rMapUpdate = true;
+		Wakeup();
+		break;
+	}
+}
 
-	return true;
+void CMqtt::ExecuteCommands()
+{
+	// the rest waits for the next tick, so a burst of commands can't
+	// stall the game
+	const int Budget = g_Config.m_SvMQTTCommandBudget;
+	for(int i = 0; i < Budget; i++)
+	{
+		if(!m_Commands.TryPop([this](CInboundCommand &Command) {
+			   ExecuteCommand(Command);
+		   }))
+			break;
+	}
 }
 
-void CMqtt::HandleMessage(const std::string &topic, const std::string &payload)
+void CMqtt::OnMapChange()
 {
-	try
+	if(m_Disabled)
+		return;
+
+	std::shared_ptr<CMapState> pState = std::make_shared<CMapState>();
+	char aMapName[IO_MAX_PATH_LENGTH];
+	int MapSize, MapCrc;
+	Server()->GetMapInfo(aMapName, sizeof(aMapName), &MapSize, &pState->m_Sha256, &MapCrc);
 	{
-		if(!(str_comp_nocase(topic.c_str(), GetChannelName(CHANNEL_RESPONSE).c_str()) == 0))
+		std::unique_lock Lock(m_MapLock);
+		if(m_pMapState && m_pMapState->m_Sha256 == pState->m_Sha256)
 		{
+			// the same map was reloaded, only announce it again
+			Lock.unlock();
+			SetMapUpdate(true);
 			return;
 		}
+	}
 
-		json response = json::parse(payload);
-		const int type = response["type"].get<int>();
-
-		switch(type)
-		{
-		case CHANNEL_RESPONSETYPE_RCON:
-		{
-			// Execute a console command
-			const std::string data = response["data"].get<std::string>();
-			Console()->ExecuteLine(data.c_str());
-			break;
-		}
-		case CHANNEL_RESPONSETYPE_CHAT:
-		{
-			// Send a chat message
-			const int cid = response["data"]["cid"].get<int>();
-			const int team = response["data"]["team"].get<int>();
-			const std::string message = response["data"]["message"].get<std::string>();
-			GameContext()->SendChat(cid, team, message.c_str());
-			break;
-		}
-		case CHANNEL_RESPONSETYPE_RESENDMAP:
-		{
-			// Resend the map
-			m_rMapUpdate = true;
-			break;
-		}
-		default:
-		{
-			dbg_msg("mqtt", "Unhandled type received in JSON response.");
-			break;
-		}
-		}
+	const CCollision *pCollision = m_pGameContext->Collision();
+	pState->m_Width = pCollision->GetWidth();
+	pState->m_Height = pCollision->GetHeight();
+	pState->m_Name = g_Config.m_SvMap;
+	if(!CMqttMapPayload::Encode(pState->m_Sha256, pState->m_Width, pState->m_Height, pCollision->GameLayer(), pCollision->FrontLayer(), pState->m_vPayload))
+	{
+		dbg_msg("mqtt", "Failed to encode the map payload");
+		pState = nullptr;
 	}
-	catch(const std::exception &e)
 	{
-		dbg_msg("mqtt", "Error handling message: %s", e.what());
+		std::unique_lock Lock(m_MapLock);
+		m_pMapState = std::move(pState);
 	}
+	SetMapUpdate(true);
 }
 
-json CMqtt::SerializeMapInfo()
+void CMqtt::SendMap(bool Force)
 {
-	json mapInfo;
-	mapInfo["sv_map"] = g_Config.m_SvMap;
+	std::shared_ptr<const CMapState> pState;
+	{
+		std::unique_lock Lock(m_MapLock);
+		pState = m_pMapState;
+	}
+	if(!pState)
+		return;
+
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(pState->m_Sha256, aSha256, sizeof(aSha256));
+	const std::string MapTopic = GetChannelName(CHANNEL_MAP) + "/" + aSha256;
 
-	mapInfo["map"]["game"] = json::array();
-	mapInfo["map"]["front"] = json::array();
-	for(int y = 0; y < m_pGameContext->Collision()->GetHeight(); ++y)
+	// The tiles are published once per map as a retained message under a
+	// topic named after the map hash. Consumers that already know the
+	// hash from the announcement below don't have to fetch them again.
+	if(pState != m_pSentMap || Force)
 	{
-		mapInfo["map"]["game"][y] = json::array();
-		mapInfo["map"]["front"][y] = json::array();
-		for(int x = 0; x < m_pGameContext->Collision()->GetWidth(); ++x)
+		CMqttTransportMessage Message;
+		Message.m_pTopic = MapTopic.c_str();
+		Message.m_pData = pState->m_vPayload.data();
+		Message.m_Size = pState->m_vPayload.size();
+		Message.m_Qos = 1;
+		Message.m_Retained = true;
+		Message.m_pContentType = "application/octet-stream";
+		Message.m_pResponseTopic = nullptr;
+		Message.m_pCorrelationData = nullptr;
+		if(!m_Link.Publish(Message))
 		{
-			mapInfo["map"]["game"][y][x] = m_pGameContext->Collision()->GetIndex(x, y);
-			mapInfo["map"]["front"][y][x] = m_pGameContext->Collision()->GetFIndex(x, y);
+			dbg_msg("mqtt", "Failed to publish the map");
+			m_rMapResend = true;
+			m_rMapUpdate = true;
+			return;
 		}
+		m_pSentMap = pState;
 	}
-	return mapInfo;
+
+	json mapInfo;
+	mapInfo["sv_map"] = pState->m_Name;
+	mapInfo["sha256"] = aSha256;
+	mapInfo["width"] = pState->m_Width;
+	mapInfo["height"] = pState->m_Height;
+	mapInfo["size"] = pState->m_vPayload.size();
+	mapInfo["topic"] = MapTopic;
+	SendJson(CHANNEL_MAP, CurrentTick(), std::move(mapInfo));
 }
 
-json CMqtt::SerializePlayer(CPlayer *pPlayer, int JID)
+void CMqtt::CapturePlayers()
 {
-	CCharacter *pChar = pPlayer->GetCharacter();
-	json data;
-	char aBuf[64];
-	str_format(aBuf, 64, "%d", JID);
-	data[aBuf]["cid"] = pPlayer->GetCid();
-	data[aBuf]["team"] = pPlayer->GetTeam();
-	data[aBuf]["name"] = m_pServer->ClientName(pPlayer->GetCid());
-	data[aBuf]["clan"] = m_pServer->ClientClan(pPlayer->GetCid());
-	data[aBuf]["clientversion"] = pPlayer->GetClientVersion();
-	data[aBuf]["afk"] = pPlayer->IsAfk();
-	data[aBuf]["moderating"] = pPlayer->m_Moderating;
-
-	data[aBuf]["teeinfo"]["skinname"] = pPlayer->m_TeeInfos.m_aSkinName;
-	data[aBuf]["teeinfo"]["usecustomcolor"] = pPlayer->m_TeeInfos.m_UseCustomColor;
-	data[aBuf]["teeinfo"]["colorbody"] = pPlayer->m_TeeInfos.m_ColorBody;
-	data[aBuf]["teeinfo"]["colorfeet"] = pPlayer->m_TeeInfos.m_ColorFeet;
-
-	data[aBuf]["latency"]["accum"] = pPlayer->m_Latency.m_Accum;
-	data[aBuf]["latency"]["accummax"] = pPlayer->m_Latency.m_AccumMax;
-	data[aBuf]["latency"]["accummin"] = pPlayer->m_Latency.m_AccumMin;
-	data[aBuf]["latency"]["avg"] = pPlayer->m_Latency.m_Avg;
-	data[aBuf]["latency"]["max"] = pPlayer->m_Latency.m_Max;
-	data[aBuf]["latency"]["min"] = pPlayer->m_Latency.m_Min;
-	data[aBuf]["ischaracter"] = (pChar != nullptr);
+	std::unique_lock Lock(m_PlayersLock);
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		CapturePlayer(m_pGameContext->m_apPlayers[i], m_aPlayerStates[i]);
+	m_PlayersTick = Server()->Tick();
+}
 
+void CMqtt::CapturePlayer(CPlayer *pPlayer, CMqttPlayerState &State)
+{
+	mem_zero(&State, sizeof(State));
+	if(!pPlayer)
+		return;
+
+	State.m_Active = true;
+	State.m_Team = pPlayer->GetTeam();
+	str_copy(State.m_aName, m_pServer->ClientName(pPlayer->GetCid()));
+	str_copy(State.m_aClan, m_pServer->ClientClan(pPlayer->GetCid()));
+	State.m_ClientVersion = pPlayer->GetClientVersion();
+	State.m_Afk = pPlayer->IsAfk();
+	State.m_Moderating = pPlayer->m_Moderating;
+
+	str_copy(State.m_aSkinName, pPlayer->m_TeeInfos.m_aSkinName);
+	State.m_UseCustomColor = pPlayer->m_TeeInfos.m_UseCustomColor;
+	State.m_ColorBody = pPlayer->m_TeeInfos.m_ColorBody;
+	State.m_ColorFeet = pPlayer->m_TeeInfos.m_ColorFeet;
+
+	State.m_LatencyAccum = pPlayer->m_Latency.m_Accum;
+	State.m_LatencyAccumMax = pPlayer->m_Latency.m_AccumMax;
+	State.m_LatencyAccumMin = pPlayer->m_Latency.m_AccumMin;
+	State.m_LatencyAvg = pPlayer->m_Latency.m_Avg;
+	State.m_LatencyMax = pPlayer->m_Latency.m_Max;
+	State.m_LatencyMin = pPlayer->m_Latency.m_Min;
+
+	CCharacter *pChar = pPlayer->GetCharacter();
+	State.m_IsCharacter = pChar != nullptr;
 	if(pChar)
 	{
-		data[aBuf]["character"]["input"]["direction"] = (int)pChar->Core()->m_Input.m_Direction;
-		data[aBuf]["character"]["input"]["fire"] = (int)pChar->Core()->m_Input.m_Fire;
-		data[aBuf]["character"]["input"]["hook"] = (int)pChar->Core()->m_Input.m_Hook;
-		data[aBuf]["character"]["input"]["jump"] = (int)pChar->Core()->m_Input.m_Jump;
-		data[aBuf]["character"]["input"]["nextweapon"] = (int)pChar->Core()->m_Input.m_NextWeapon;
-		data[aBuf]["character"]["input"]["playerflags"] = (int)pChar->Core()->m_Input.m_PlayerFlags;
-		data[aBuf]["character"]["input"]["prevweapon"] = (int)pChar->Core()->m_Input.m_PrevWeapon;
-		data[aBuf]["character"]["input"]["targetx"] = (int)pChar->Core()->m_Input.m_TargetX;
-		data[aBuf]["character"]["input"]["targety"] = (int)pChar->Core()->m_Input.m_TargetY;
-		data[aBuf]["character"]["input"]["wantedweapon"] = (int)pChar->Core()->m_Input.m_WantedWeapon;
-
-		data[aBuf]["character"]["activeweapon"] = (int)pChar->Core()->m_ActiveWeapon;
-		data[aBuf]["character"]["freeze_start"] = (int)pChar->Core()->m_FreezeStart;
-		data[aBuf]["character"]["freeze_end"] = (int)pChar->Core()->m_FreezeEnd;
-		data[aBuf]["character"]["jumped"] = (int)pChar->Core()->m_Jumped;
-		data[aBuf]["character"]["solo"] = (int)pChar->Core()->m_Solo;
-
-		data[aBuf]["character"]["pos"]["x"] = (int)pChar->Core()->m_Pos.x;
-		data[aBuf]["character"]["pos"]["y"] = (int)pChar->Core()->m_Pos.y;
-		data[aBuf]["character"]["vel"]["x"] = (int)pChar->Core()->m_Vel.x;
-		data[aBuf]["character"]["vel"]["y"] = (int)pChar->Core()->m_Vel.y;
-		data[aBuf]["character"]["hookpos"]["x"] = (int)pChar->Core()->m_HookPos.x;
-		data[aBuf]["character"]["hookpos"]["y"] = (int)pChar->Core()->m_HookPos.y;
-		data[aBuf]["character"]["hookstate"] = (int)pChar->Core()->m_HookState;
-	}
-	return data;
+		const CCharacterCore *pCore = pChar->Core();
+		State.m_InputDirection = pCore->m_Input.m_Direction;
+		State.m_InputFire = pCore->m_Input.m_Fire;
+		State.m_InputHook = pCore->m_Input.m_Hook;
+		State.m_InputJump = pCore->m_Input.m_Jump;
+		State.m_InputNextWeapon = pCore->m_Input.m_NextWeapon;
+		State.m_InputPlayerFlags = pCore->m_Input.m_PlayerFlags;
+		State.m_InputPrevWeapon = pCore->m_Input.m_PrevWeapon;
+		State.m_InputTargetX = pCore->m_Input.m_TargetX;
+		State.m_InputTargetY = pCore->m_Input.m_TargetY;
+		State.m_InputWantedWeapon = pCore->m_Input.m_WantedWeapon;
+
+		State.m_ActiveWeapon = pCore->m_ActiveWeapon;
+		State.m_FreezeStart = pCore->m_FreezeStart;
+		State.m_FreezeEnd = pCore->m_FreezeEnd;
+		State.m_Jumped = pCore->m_Jumped;
+		State.m_Solo = pCore->m_Solo;
+
+		State.m_PosX = (int)pCore->m_Pos.x;
+		State.m_PosY = (int)pCore->m_Pos.y;
+		State.m_VelX = (int)pCore->m_Vel.x;
+		State.m_VelY = (int)pCore->m_Vel.y;
+		State.m_HookPosX = (int)pCore->m_HookPos.x;
+		State.m_HookPosY = (int)pCore->m_HookPos.y;
+		State.m_HookState = pCore->m_HookState;
+	}
+}
+
+void CMqtt::SendPlayers()
+{
+	int Tick;
+	{
+		std::unique_lock Lock(m_PlayersLock);
+		mem_copy(m_aSendPlayerStates, m_aPlayerStates, sizeof(m_aSendPlayerStates));
+		Tick = m_PlayersTick;
+	}
+
+	json Update;
+	if(m_PlayerTracker.Update(m_aSendPlayerStates, Tick, Update))
+		SendJson(CHANNEL_PLAYERS, Tick, std::move(Update));
 }
 
 json CMqtt::SerializeServer()
@@ -459,14 +878,16 @@ json CMqtt::SerializeServer()
 
 	result["sv_name"] = g_Config.m_SvName;
 	result["sv_map"] = g_Config.m_SvMap;
-	result["tick"] = m_pServer->Tick();
 
-	for(int i = 0; i < MAX_CLIENTS; ++i)
+	// the players themselves are on the player stream, only count the
+	// copies taken on the tick thread
 	{
-		if(m_pGameContext->m_apPlayers[i])
+		std::unique_lock Lock(m_PlayersLock);
+		result["tick"] = m_PlayersTick;
+		for(const CMqttPlayerState &State : m_aPlayerStates)
 		{
-			result["players"].merge_patch(SerializePlayer(m_pGameContext->m_apPlayers[i], playerCount));
-			++playerCount;
+			if(State.m_Active)
+				++playerCount;
 		}
 	}
 	result["playercount"] = playerCount;
@@ -500,6 +921,23 @@ json CMqtt::SerializeServer()
 	result["config"]["sv_practice"] = g_Config.m_SvPractice;
 	result["config"]["sv_sid"] = g_Config.m_SvSID;
 
+	result["mqtt"]["reconnects"] = m_Link.Connection().NumReconnects();
+	result["mqtt"]["queue_dropped"] = m_DroppedMessages.load(std::memory_order_relaxed);
+	result["mqtt"]["console"]["dropped"] = m_ConsoleLimiter.Dropped();
+	result["mqtt"]["console"]["filtered"] = m_FilteredConsole.load(std::memory_order_relaxed);
+	result["mqtt"]["console"]["batched"] = m_BatchedLines;
+	result["mqtt"]["console"]["batches"] = m_NumConsoleBatches;
+	result["mqtt"]["rcon"]["dropped"] = m_RconLimiter.Dropped();
+	result["mqtt"]["suppressed"] = m_SuppressedMessages.load(std::memory_order_relaxed);
+	result["mqtt"]["commands"]["queued"] = m_Commands.Size();
+	result["mqtt"]["commands"]["dropped"] = m_DroppedCommands.load(std::memory_order_relaxed);
+	result["mqtt"]["commands"]["invalid"] = m_InvalidCommands.load(std::memory_order_relaxed);
+	const CMqttSpool &Spool = m_Link.Spool();
+	result["mqtt"]["spool"]["messages"] = Spool.NumMessages();
+	result["mqtt"]["spool"]["bytes"] = Spool.NumBytes();
+	for(int Channel = CHANNEL_SERVER; Channel < NUM_CHANNELS; Channel++)
+		result["mqtt"]["spool"]["dropped"][ChannelSuffix(Channel)] = Spool.Dropped(Channel);
+
 	return result;
 }
 
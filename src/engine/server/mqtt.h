@@ -2,8 +2,11 @@
 #ifndef ENGINE_SERVER_MQTT_H
 #define ENGINE_SERVER_MQTT_H
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <mqtt/async_client.h>
 #include <engine/mqtt.h>
 #include <game/server/gamecontext.h>
 #include <engine/console.h>
@@ -12,6 +15,18 @@
 #include <engine/config.h>
 #include <engine/engine.h>
 #include <engine/shared/config.h>
+#include <engine/shared/mpsc_queue.h>
+#include <engine/shared/spsc_queue.h>
+#include "mqtt_connection.h"
+#include "mqtt_encoding.h"
+#include "mqtt_limiter.h"
+#include "mqtt_link.h"
+#include "mqtt_map.h"
+#include "mqtt_players.h"
+#include "mqtt_requests.h"
+#include "mqtt_spool.h"
+#include "mqtt_transport.h"
+#include "mqtt_wakeup.h"
 #include <nlohmann/json.hpp>
 
 class CConfig;
@@ -29,9 +44,6 @@ class CMqtt : public IMqtt
     class IGameServer *GameServer() const { return m_pGameServer; }
     class CGameContext *GameContext() const { return m_pGameContext; }
 
-    std::unique_ptr<mqtt::async_client> client_; // Verwenden Sie unique_ptr für den Client
-    mqtt::connect_options connOpts_;
-
 public:
     CMqtt();
     virtual ~CMqtt();
@@ -41,14 +53,16 @@ public:
     std::string prefix;
 
     int m_lastHeartBeat;
-    bool m_rMapUpdate;
-    bool m_rHeartbeat;
-    bool m_rServerUpdate;
+    std::atomic<bool> m_rMapUpdate;
+    std::atomic<bool> m_rMapResend;
+    std::atomic<bool> m_rHeartbeat;
+    std::atomic<bool> m_rServerUpdate;
+    std::atomic<bool> m_rPlayersUpdate;
 
     /* SETTER AND GETTER */
-    void SetMapUpdate(bool update) override { m_rMapUpdate = update; }
-    void SetHeartbeat(bool update) override { m_rHeartbeat = update; }
-    void SetServerUpdate(bool update) override { m_rServerUpdate = update; }
+    void SetMapUpdate(bool update) override;
+    void SetHeartbeat(bool update) override;
+    void SetServerUpdate(bool update) override;
     void SetLastHeartbeat(int lastHeartBeat) override { m_lastHeartBeat = lastHeartBeat; }
 
     int GetLastHeartbeat() override { return m_lastHeartBeat; }
@@ -56,27 +70,172 @@ public:
     /* MQTT FUNCTIONS */
     void Run() override;
     void Init() override;
+    void OnTick() override;
+    void OnMapChange() override;
+    void Shutdown() override;
     bool Subscribe(const int& topic) override;
     bool Publish(const int& topic, const std::string& payload) override;
     bool Publish(const int& topic, const json& payload) override;
-    bool PublishWithResponse(const int& topic, const std::string& payload, const std::string& responseTopic) override;
-    bool WaitForResponse(const std::string& responseTopic, std::function<void(const std::string&)> callback) override;
+    bool Publish(const int& topic, json&& payload) override;
+    bool PublishConsole(int Level, const char *pFrom, const char *pStr) override;
+    bool PublishRcon(const char *pCommand, int ClientId) override;
+    bool PublishChat(int ClientId, const char *pName, const char *pMessage, int Team) override;
 
     /* EXTRA FUNCTIONS */
     std::string GetChannelName(int channel);
-    std::string RandomUuid();
+    static const char *ChannelSuffix(int channel);
 
-    bool RequestLogin(const int& clientId, const std::string& logintoken) override;
+    int RequestLogin(int ClientId, const char *pLoginToken) override;
 
 private:
-    std::unordered_map<std::string, std::function<void(const std::string&)>> m_responseCallbacks;
-    bool m_connected;
-    std::unordered_map<int, json> m_missedMessages;
+    enum
+    {
+        MESSAGE_TEXT = 0,
+        MESSAGE_JSON,
+        MESSAGE_CONSOLE,
+        MESSAGE_RCON,
+        MESSAGE_CHAT,
+        MESSAGE_LOGIN,
+
+        QUEUE_SIZE = 2048,
+
+        LOGIN_RESULTS_SIZE = 1024,
+        COMMAND_QUEUE_SIZE = 256,
+        CONSOLE_BATCH_LINES = 64,
+        LOGIN_TIMER_RESOLUTION = 4, // wheel slots per second
+    };
+
+    // A message waiting to be sent by the MQTT thread. The slots are
+    // allocated once, so the hot channels only copy their strings into
+    // them and the JSON is built on the MQTT thread.
+    struct CQueuedMessage
+    {
+        int m_Topic;
+        int m_Tick;
+        int m_Kind;
+        int m_aArgs[2];
+        char m_aName[64];
+        char m_aText[1024];
+        json m_Json;
+    };
+
+    std::atomic<bool> m_Disabled;
+    std::atomic<bool> m_Shutdown;
+
+    // Connection to the broker with the spool for the messages that
+    // couldn't be delivered. Declared before the transport, which is
+    // destroyed first and may report to the link until then.
+    CMqttLink m_Link;
+    std::unique_ptr<IMqttTransport> m_pTransport;
+
+    // Producers (tick thread, paho callbacks) push into the lock-free
+    // queue and only wake the MQTT thread if it is sleeping
+    CMpscQueue<CQueuedMessage, QUEUE_SIZE> m_Queue;
+    CMqttWakeup m_Wakeup;
+    std::atomic<uint64_t> m_DroppedMessages;
+
+    void UpdateConnection();
+    // Encoding of each channel
+    int m_aChannelEncodings[NUM_CHANNELS];
+    std::string m_EncodeBuffer;
+
+    void InitEncodings();
+    void InitSpool();
+    void Disable();
+    void Wakeup();
+    void WaitForWork();
+    bool HasWork() const;
+    int CurrentTick() const;
+    template<typename F>
+    bool Enqueue(int Topic, int Kind, F &&Fill);
+    bool Send(CQueuedMessage &Message);
+    bool SendJson(int Topic, int Tick, json &&Payload);
+    bool SendLogin(CQueuedMessage &Message);
+
+    // The current map, encoded on the tick thread when the map changes.
+    // The MQTT thread only sends the finished payload and never touches
+    // the map or the collision, which are replaced during a map change.
+    struct CMapState
+    {
+        SHA256_DIGEST m_Sha256;
+        int m_Width;
+        int m_Height;
+        std::string m_Name;
+        std::vector<unsigned char> m_vPayload;
+    };
+    std::mutex m_MapLock;
+    std::shared_ptr<const CMapState> m_pMapState;
+    // The map that was published last, only touched by the MQTT thread
+    std::shared_ptr<const CMapState> m_pSentMap;
+
+    void SendMap(bool Force);
 
-    json SerializeMapInfo();
     json SerializeServer();
-    json SerializePlayer(CPlayer *pPlayer, int JID);
+
+    // Console and rcon lines are limited before they are queued, so a
+    // flood costs the producing thread as little as possible
+    CMqttRateLimiter m_ConsoleLimiter;
+    CMqttRateLimiter m_RconLimiter;
+    std::atomic<uint64_t> m_FilteredConsole;
+    std::atomic<uint64_t> m_SuppressedMessages;
+    // Console lines collected into one message, only touched by the MQTT thread
+    json m_ConsoleBatch;
+    int64_t m_ConsoleBatchStart;
+    uint64_t m_BatchedLines;
+    uint64_t m_NumConsoleBatches;
+
+    static int64_t RateInterval(int Rate);
+    void FlushConsoleBatch();
+    int64_t ConsoleBatchDeadline() const;
+
+    // Player states captured on the tick thread for the player stream and
+    // the heartbeat
+    std::mutex m_PlayersLock;
+    CMqttPlayerState m_aPlayerStates[MAX_CLIENTS];
+    int m_PlayersTick;
+    // Only touched by the MQTT thread
+    CMqttPlayerState m_aSendPlayerStates[MAX_CLIENTS];
+    CMqttPlayerTracker m_PlayerTracker;
+
+    void CapturePlayers();
+    void CapturePlayer(CPlayer *pPlayer, CMqttPlayerState &State);
+    void SendPlayers();
+
+    // A command received on the response channel. Parsed by the paho
+    // callback thread, the only producer, and executed by the tick thread.
+    struct CInboundCommand
+    {
+        int m_Type;
+        int m_ClientId;
+        int m_Team;
+        char m_aText[1024];
+    };
+    CSpscQueue<CInboundCommand, COMMAND_QUEUE_SIZE> m_Commands;
+    std::atomic<uint64_t> m_DroppedCommands;
+    std::atomic<uint64_t> m_InvalidCommands;
+
     void HandleMessage(const std::string& topic, const std::string& payload);
+    bool ParseCommand(const json &Command, CInboundCommand &Out);
+    void ExecuteCommand(const CInboundCommand &Command);
+    void ExecuteCommands();
+
+    // Login requests waiting for their response, the results go back to
+    // the tick thread through a queue
+    struct CLoginResult
+    {
+        int m_ClientId;
+        uint32_t m_UniqueClientId;
+        int m_Status;
+        char m_aMessage[128];
+    };
+    std::string m_LoginResponseTopic;
+    CMqttPendingRequests m_LoginRequests;
+    CMpscQueue<CLoginResult, LOGIN_RESULTS_SIZE> m_LoginResults;
+    std::vector<CMqttPendingRequests::CRequest> m_vExpiredLogins;
+
+    void HandleLoginResponse(const std::string &Payload, const std::string &CorrelationData);
+    void ExpireLoginRequests();
+    void PushLoginResult(const CMqttPendingRequests::CRequest &Request, int Status, const char *pMessage);
 };
 
 #endif // ENGINE_SERVER_MQTT_H
@@ -0,0 +1,64 @@
+#include "mqtt_connection.h"
+
+#include <base/math.h>
+
+CMqttConnectionState::CMqttConnectionState()
+{
+	Init(0, 0, 0.0f);
+}
+
+void CMqttConnectionState::Init(int64_t MinBackoff, int64_t MaxBackoff, float Jitter)
+{
+	m_State = STATE_OFFLINE;
+	m_MinBackoff = maximum<int64_t>(MinBackoff, 0);
+	m_MaxBackoff = maximum(MaxBackoff, m_MinBackoff);
+	m_Jitter = clamp(Jitter, 0.0f, 1.0f);
+	m_Backoff = m_MinBackoff;
+	m_NextAttempt = 0;
+	m_FailedAttempts = 0;
+	m_NumReconnects = 0;
+	m_WasConnected = false;
+}
+
+bool CMqttConnectionState::StartAttempt(int64_t Now)
+{
+	if(m_State != STATE_OFFLINE || Now < m_NextAttempt)
+		return false;
+	m_State = STATE_CONNECTING;
+	return true;
+}
+
+void CMqttConnectionState::OnConnected()
+{
+	if(m_WasConnected)
+		m_NumReconnects++;
+	m_WasConnected = true;
+	m_State = STATE_CONNECTED;
+	m_Backoff = m_MinBackoff;
+	m_FailedAttempts = 0;
+}
+
+void CMqttConnectionState::OnConnectFailed(int64_t Now)
+{
+	m_FailedAttempts++;
+	ScheduleRetry(Now);
+	m_Backoff = minimum(m_Backoff * 2, m_MaxBackoff);
+}
+
+void CMqttConnectionState::OnConnectionLost(int64_t Now)
+{
+	// the first retry after losing an established connection uses the
+	// minimal delay, a broker restart is usually quick
+	m_Backoff = m_MinBackoff;
+	ScheduleRetry(Now);
+	m_Backoff = minimum(m_Backoff * 2, m_MaxBackoff);
+}
+
+void CMqttConnectionState::ScheduleRetry(int64_t Now)
+{
+	m_State = STATE_OFFLINE;
+	int64_t Delay = m_Backoff;
+	if(m_Jitter > 0.0f)
+		Delay -= (int64_t)(Delay * m_Jitter * random_float());
+	m_NextAttempt = Now + Delay;
+}
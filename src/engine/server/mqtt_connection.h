@@ -0,0 +1,65 @@
+#ifndef ENGINE_SERVER_MQTT_CONNECTION_H
+#define ENGINE_SERVER_MQTT_CONNECTION_H
+
+#include <cstdint>
+
+/**
+ * Connection state of the MQTT client with exponential backoff between
+ * connection attempts.
+ *
+ * Only tracks state and timing, the MQTT thread feeds it the results of
+ * the asynchronous connect and asks it when to try again. Times are in
+ * the units of `time_get()`.
+ */
+class CMqttConnectionState
+{
+public:
+	enum EState
+	{
+		STATE_OFFLINE = 0,
+		STATE_CONNECTING,
+		STATE_CONNECTED,
+	};
+
+	CMqttConnectionState();
+
+	/**
+	 * @param MinBackoff Delay before the first retry.
+	 * @param MaxBackoff Upper limit for the delay between retries.
+	 * @param Jitter Fraction of the delay that is randomized, so several
+	 * servers don't hammer a restarted broker at the same time.
+	 */
+	void Init(int64_t MinBackoff, int64_t MaxBackoff, float Jitter);
+
+	/**
+	 * Checks whether a connection attempt should be started now and moves
+	 * to @link STATE_CONNECTING @endlink if so.
+	 */
+	bool StartAttempt(int64_t Now);
+
+	void OnConnected();
+	void OnConnectFailed(int64_t Now);
+	void OnConnectionLost(int64_t Now);
+
+	EState State() const { return m_State; }
+	bool IsConnected() const { return m_State == STATE_CONNECTED; }
+	int64_t NextAttempt() const { return m_NextAttempt; }
+	int64_t Backoff() const { return m_Backoff; }
+	int FailedAttempts() const { return m_FailedAttempts; }
+	int NumReconnects() const { return m_NumReconnects; }
+
+private:
+	EState m_State;
+	int64_t m_MinBackoff;
+	int64_t m_MaxBackoff;
+	float m_Jitter;
+	int64_t m_Backoff;
+	int64_t m_NextAttempt;
+	int m_FailedAttempts;
+	int m_NumReconnects;
+	bool m_WasConnected;
+
+	void ScheduleRetry(int64_t Now);
+};
+
+#endif // ENGINE_SERVER_MQTT_CONNECTION_H
@@ -0,0 +1,95 @@
+#include "mqtt_encoding.h"
+
+#include <base/system.h>
+
+static const char *const ENCODING_NAMES[NUM_MQTT_ENCODINGS] = {"text", "json", "cbor", "msgpack"};
+static const char *const CONTENT_TYPES[NUM_MQTT_ENCODINGS] = {"text/plain", "application/json", "application/cbor", "application/msgpack"};
+
+const char *MqttEncodingName(int Encoding)
+{
+	if(Encoding < 0 || Encoding >= NUM_MQTT_ENCODINGS)
+		return "unknown";
+	return ENCODING_NAMES[Encoding];
+}
+
+const char *MqttContentType(int Encoding)
+{
+	if(Encoding < 0 || Encoding >= NUM_MQTT_ENCODINGS)
+		return "application/octet-stream";
+	return CONTENT_TYPES[Encoding];
+}
+
+int MqttEncodingFromName(const char *pName)
+{
+	for(int i = MQTT_ENCODING_JSON; i < NUM_MQTT_ENCODINGS; i++)
+	{
+		if(str_comp_nocase(pName, ENCODING_NAMES[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+void MqttEncode(int Encoding, const nlohmann::json &Payload, std::string &Out)
+{
+	Out.clear();
+	switch(Encoding)
+	{
+	case MQTT_ENCODING_CBOR:
+		nlohmann::json::to_cbor(Payload, Out);
+		break;
+	case MQTT_ENCODING_MSGPACK:
+		nlohmann::json::to_msgpack(Payload, Out);
+		break;
+	default:
+		Out = Payload.dump();
+		break;
+	}
+}
+
+bool MqttParseEncodings(const char *pList, int *pEncodings, int NumChannels, const std::function<const char *(int Channel)> &ChannelName)
+{
+	bool Valid = true;
+	char aEntry[64];
+	while((pList = str_next_token(pList, ",", aEntry, sizeof(aEntry))))
+	{
+		const char *pEntry = str_utf8_skip_whitespaces(aEntry);
+		str_utf8_trim_right(aEntry);
+		if(pEntry[0] == '\0')
+			continue;
+
+		char aChannel[64] = "";
+		const char *pEncoding = pEntry;
+		if(const char *pSeparator = str_find(pEntry, "="))
+		{
+			str_truncate(aChannel, sizeof(aChannel), pEntry, pSeparator - pEntry);
+			str_utf8_trim_right(aChannel);
+			pEncoding = str_utf8_skip_whitespaces(pSeparator + 1);
+		}
+
+		const int Encoding = MqttEncodingFromName(pEncoding);
+		if(Encoding < 0)
+		{
+			Valid = false;
+			continue;
+		}
+
+		if(aChannel[0] == '\0')
+		{
+			for(int i = 0; i < NumChannels; i++)
+				pEncodings[i] = Encoding;
+			continue;
+		}
+
+		bool Found = false;
+		for(int i = 0; i < NumChannels; i++)
+		{
+			if(str_comp_nocase(aChannel, ChannelName(i)) == 0)
+			{
+				pEncodings[i] = Encoding;
+				Found = true;
+			}
+		}
+		Valid &= Found;
+	}
+	return Valid;
+}
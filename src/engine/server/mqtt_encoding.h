@@ -0,0 +1,51 @@
+#ifndef ENGINE_SERVER_MQTT_ENCODING_H
+#define ENGINE_SERVER_MQTT_ENCODING_H
+
+#include <nlohmann/json.hpp>
+
+#include <functional>
+#include <string>
+
+/**
+ * Payload encodings of the MQTT channels. The encoding of every message
+ * is announced in the MQTT 5 content type property, consumers without
+ * MQTT 5 can tell them apart by the first byte since all structured
+ * payloads are maps.
+ */
+enum
+{
+	MQTT_ENCODING_TEXT = 0, // plain strings, not selectable
+	MQTT_ENCODING_JSON,
+	MQTT_ENCODING_CBOR,
+	MQTT_ENCODING_MSGPACK,
+	NUM_MQTT_ENCODINGS,
+};
+
+const char *MqttEncodingName(int Encoding);
+const char *MqttContentType(int Encoding);
+
+/**
+ * @return The structured encoding with the given name or `-1`.
+ */
+int MqttEncodingFromName(const char *pName);
+
+/**
+ * Encodes a structured payload.
+ *
+ * @param Out Overwritten with the payload, reusing its memory.
+ */
+void MqttEncode(int Encoding, const nlohmann::json &Payload, std::string &Out);
+
+/**
+ * Parses a list like `json,chat=msgpack,players=cbor`. A plain name sets
+ * the encoding of all channels, `channel=name` that of a single one.
+ *
+ * @param pEncodings Receives the encoding of each channel.
+ * @param ChannelName Maps a channel index to the name used in the list.
+ *
+ * @return `false` if the list contains an unknown channel or encoding,
+ * the valid entries are applied anyway.
+ */
+bool MqttParseEncodings(const char *pList, int *pEncodings, int NumChannels, const std::function<const char *(int Channel)> &ChannelName);
+
+#endif // ENGINE_SERVER_MQTT_ENCODING_H
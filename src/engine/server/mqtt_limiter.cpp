@@ -0,0 +1,30 @@
+#include "mqtt_limiter.h"
+
+#include <base/math.h>
+
+CMqttRateLimiter::CMqttRateLimiter() :
+	m_TheoreticalArrival(0),
+	m_Dropped(0)
+{
+}
+
+bool CMqttRateLimiter::Allow(int64_t Now, int64_t Interval, int Burst)
+{
+	if(Interval <= 0)
+		return true;
+
+	const int64_t Capacity = Interval * maximum(Burst, 1);
+	int64_t Arrival = m_TheoreticalArrival.load(std::memory_order_relaxed);
+	while(true)
+	{
+		// an empty bucket is as good as one that refilled long ago
+		const int64_t NewArrival = maximum(Arrival, Now) + Interval;
+		if(NewArrival - Now > Capacity)
+		{
+			m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		if(m_TheoreticalArrival.compare_exchange_weak(Arrival, NewArrival, std::memory_order_relaxed))
+			return true;
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef ENGINE_SERVER_MQTT_LIMITER_H
+#define ENGINE_SERVER_MQTT_LIMITER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Token bucket for the messages of one MQTT channel.
+ *
+ * Implemented as the equivalent generic cell rate algorithm, which only
+ * has to remember the time at which the bucket is full again. That fits
+ * into one atomic, so any thread can ask it without taking a lock.
+ * Times are in the units of `time_get()`.
+ */
+class CMqttRateLimiter
+{
+public:
+	CMqttRateLimiter();
+
+	/**
+	 * Takes a token if one is available.
+	 *
+	 * The parameters are passed on every call so that config changes
+	 * apply right away.
+	 *
+	 * @param Interval Time it takes to refill one token, `0` or less for
+	 * no limit.
+	 * @param Burst Number of tokens the bucket holds.
+	 *
+	 * @return `false` if the message should be dropped, it is counted in
+	 * that case.
+	 */
+	bool Allow(int64_t Now, int64_t Interval, int Burst);
+
+	uint64_t Dropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> m_TheoreticalArrival;
+	std::atomic<uint64_t> m_Dropped;
+};
+
+#endif // ENGINE_SERVER_MQTT_LIMITER_H
@@ -0,0 +1,138 @@
+#include "mqtt_link.h"
+#include "mqtt_encoding.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+CMqttLink::CMqttLink() :
+	m_pTransport(nullptr), m_Events(0), m_Connected(false), m_LastDrain(0)
+{
+}
+
+void CMqttLink::Init(IMqttTransport *pTransport, std::vector<std::string> vTopics, int64_t MinBackoff, int64_t MaxBackoff, float Jitter, std::function<void()> Wakeup)
+{
+	m_pTransport = pTransport;
+	m_vTopics = std::move(vTopics);
+	m_Wakeup = std::move(Wakeup);
+	m_Connection.Init(MinBackoff, MaxBackoff, Jitter);
+	m_LastDrain = time_get();
+	m_pTransport->SetHandler(this);
+}
+
+void CMqttLink::OnConnected()
+{
+	OnEvent(EVENT_CONNECTED);
+}
+
+void CMqttLink::OnConnectFailed()
+{
+	OnEvent(EVENT_CONNECT_FAILED);
+}
+
+void CMqttLink::OnConnectionLost()
+{
+	OnEvent(EVENT_CONNECTION_LOST);
+}
+
+void CMqttLink::OnEvent(int Event)
+{
+	// called from the transport threads, leave all the work to the MQTT thread
+	m_Events.fetch_or(Event);
+	if(m_Wakeup)
+		m_Wakeup();
+}
+
+bool CMqttLink::Update(int64_t Now)
+{
+	const int Events = m_Events.exchange(0);
+	bool Connected = false;
+
+	if(Events & EVENT_CONNECTED)
+	{
+		m_Connection.OnConnected();
+		m_Connected = true;
+		Connected = true;
+	}
+	if(Events & EVENT_CONNECTION_LOST)
+	{
+		m_Connected = false;
+		Connected = false;
+		m_Connection.OnConnectionLost(Now);
+		dbg_msg("mqtt", "Lost the connection to the MQTT broker, reconnecting");
+	}
+	if(Events & EVENT_CONNECT_FAILED)
+	{
+		m_Connection.OnConnectFailed(Now);
+		dbg_msg("mqtt", "Connecting to the MQTT broker failed (attempt %d), retrying in %.1fs",
+			m_Connection.FailedAttempts(), (m_Connection.NextAttempt() - Now) / (float)time_freq());
+	}
+
+	if(m_Connection.StartAttempt(Now) && !m_pTransport->Connect())
+		m_Connection.OnConnectFailed(Now);
+
+	return Connected;
+}
+
+int64_t CMqttLink::Timeout(int64_t Now) const
+{
+	// wake up regularly to continue replaying the spool
+	if(m_Connected && !m_Spool.Empty())
+		return DRAIN_INTERVAL;
+	// wake up for the next connection attempt
+	if(m_Connection.State() == CMqttConnectionState::STATE_OFFLINE)
+		return maximum<int64_t>((m_Connection.NextAttempt() - Now) * 1000 / time_freq(), 0) + 1;
+	return -1;
+}
+
+bool CMqttLink::PublishChannel(int Channel, int Encoding, const void *pData, size_t Size, const char *pResponseTopic, const char *pCorrelationData)
+{
+	if(Channel < 0 || Channel >= (int)m_vTopics.size())
+		return false;
+	CMqttTransportMessage Message;
+	Message.m_pTopic = m_vTopics[Channel].c_str();
+	Message.m_pData = pData;
+	Message.m_Size = Size;
+	Message.m_Qos = 1;
+	Message.m_Retained = false;
+	Message.m_pContentType = MqttContentType(clamp(Encoding, 0, (int)NUM_MQTT_ENCODINGS - 1));
+	Message.m_pResponseTopic = pResponseTopic;
+	Message.m_pCorrelationData = pCorrelationData;
+	return m_pTransport->Publish(Message);
+}
+
+bool CMqttLink::Send(int Channel, int Encoding, const void *pData, size_t Size, const char *pResponseTopic, const char *pCorrelationData)
+{
+	// queue behind the spooled messages to keep the order
+	if(m_Connected && m_Spool.Empty() && PublishChannel(Channel, Encoding, pData, Size, pResponseTopic, pCorrelationData))
+		return true;
+
+	// counted as dropped if the spool is disabled
+	m_Spool.Push(Channel, Encoding, time_timestamp(), pData, Size);
+	return false;
+}
+
+bool CMqttLink::Publish(const CMqttTransportMessage &Message)
+{
+	return m_pTransport->Publish(Message);
+}
+
+bool CMqttLink::Subscribe(const char *pTopic, int Qos)
+{
+	return m_pTransport->Subscribe(pTopic, Qos);
+}
+
+void CMqttLink::Drain(int64_t Now, int Rate)
+{
+	if(!m_Connected || m_Spool.Empty())
+		return;
+
+	const int64_t Elapsed = minimum(Now - m_LastDrain, time_freq());
+	const int Budget = (int)(Elapsed * Rate / time_freq());
+	if(Budget <= 0)
+		return;
+	m_LastDrain = Now;
+
+	m_Spool.Drain(time_timestamp(), Budget, [this](int Channel, int Encoding, const void *pData, int Size) {
+		return PublishChannel(Channel, Encoding, pData, Size, nullptr, nullptr);
+	});
+}
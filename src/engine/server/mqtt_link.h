@@ -0,0 +1,121 @@
+#ifndef ENGINE_SERVER_MQTT_LINK_H
+#define ENGINE_SERVER_MQTT_LINK_H
+
+#include "mqtt_connection.h"
+#include "mqtt_spool.h"
+#include "mqtt_transport.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * The MQTT thread's end of the connection to the broker.
+ *
+ * Reconnects with the backoff of @link CMqttConnectionState @endlink,
+ * publishes messages while connected, spools them while not and replays
+ * the spool after reconnecting. Knows nothing about the game, the broker
+ * is reached through an @link IMqttTransport @endlink.
+ *
+ * The transport reports its events from its own threads, all other
+ * functions must only be called from the MQTT thread.
+ */
+class CMqttLink : public IMqttTransport::IHandler
+{
+public:
+	enum
+	{
+		DRAIN_INTERVAL = 50, // ms
+	};
+
+	CMqttLink();
+
+	/**
+	 * @param pTransport Connection to the broker, must outlive the link.
+	 * @param vTopics Topic of each channel, spooled messages only store
+	 * the channel.
+	 * @param MinBackoff, MaxBackoff, Jitter See
+	 * @link CMqttConnectionState::Init @endlink.
+	 * @param Wakeup Called from the transport threads after an event, so
+	 * the MQTT thread calls @link Update @endlink.
+	 */
+	void Init(IMqttTransport *pTransport, std::vector<std::string> vTopics, int64_t MinBackoff, int64_t MaxBackoff, float Jitter, std::function<void()> Wakeup);
+
+	/**
+	 * Handles the events of the transport and starts a connection attempt
+	 * when one is due.
+	 *
+	 * @return `true` if the connection was just established. The session
+	 * is clean, so subscriptions have to be renewed then.
+	 */
+	bool Update(int64_t Now);
+
+	/**
+	 * Milliseconds after which @link Update @endlink or
+	 * @link Drain @endlink have something to do, `-1` if only an event of
+	 * the transport can change that.
+	 */
+	int64_t Timeout(int64_t Now) const;
+
+	/**
+	 * Publishes a message on a channel, or spools it if the broker can't
+	 * be reached. While the spool isn't empty, new messages are appended
+	 * to it to keep the order.
+	 *
+	 * @param pResponseTopic, pCorrelationData MQTT 5 properties of a
+	 * request, not kept if the message is spooled.
+	 *
+	 * @return `true` if the message was published.
+	 */
+	bool Send(int Channel, int Encoding, const void *pData, size_t Size, const char *pResponseTopic = nullptr, const char *pCorrelationData = nullptr);
+
+	/**
+	 * Publishes a message without spooling it if that fails.
+	 */
+	bool Publish(const CMqttTransportMessage &Message);
+	bool Subscribe(const char *pTopic, int Qos);
+
+	/**
+	 * Replays spooled messages while connected, at most `Rate` per second
+	 * so a reconnect doesn't flood the broker.
+	 */
+	void Drain(int64_t Now, int Rate);
+
+	// May be called from any thread
+	bool Connected() const { return m_Connected.load(); }
+	bool HasEvents() const { return m_Events.load() != 0; }
+
+	CMqttSpool &Spool() { return m_Spool; }
+	const CMqttSpool &Spool() const { return m_Spool; }
+	const CMqttConnectionState &Connection() const { return m_Connection; }
+
+	void OnConnected() override;
+	void OnConnectFailed() override;
+	void OnConnectionLost() override;
+
+private:
+	enum
+	{
+		EVENT_CONNECTED = 1 << 0,
+		EVENT_CONNECT_FAILED = 1 << 1,
+		EVENT_CONNECTION_LOST = 1 << 2,
+	};
+
+	IMqttTransport *m_pTransport;
+	std::vector<std::string> m_vTopics;
+	std::function<void()> m_Wakeup;
+
+	std::atomic<int> m_Events;
+	std::atomic<bool> m_Connected;
+	CMqttConnectionState m_Connection;
+
+	CMqttSpool m_Spool;
+	int64_t m_LastDrain;
+
+	void OnEvent(int Event);
+	bool PublishChannel(int Channel, int Encoding, const void *pData, size_t Size, const char *pResponseTopic, const char *pCorrelationData);
+};
+
+#endif // ENGINE_SERVER_MQTT_LINK_H
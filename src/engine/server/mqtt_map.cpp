@@ -0,0 +1,101 @@
+#include "mqtt_map.h"
+
+#include <base/system.h>
+
+#include <game/mapitems.h>
+
+#include <zlib.h>
+
+static const char MAP_MAGIC[4] = {'D', 'D', 'M', 'M'};
+
+static void WriteUint(std::vector<unsigned char> &vOut, unsigned Value)
+{
+	unsigned char aBuf[4];
+	uint_to_bytes_be(aBuf, Value);
+	vOut.insert(vOut.end(), aBuf, aBuf + sizeof(aBuf));
+}
+
+static bool AppendLayer(std::vector<unsigned char> &vOut, int Type, int Width, int Height, const CTile *pTiles)
+{
+	const size_t NumTiles = (size_t)Width * Height;
+	std::vector<unsigned char> vIndices(NumTiles);
+	for(size_t i = 0; i < NumTiles; i++)
+	{
+		vIndices[i] = pTiles[i].m_Index;
+		if(i >= (size_t)Width)
+			vIndices[i] -= pTiles[i - Width].m_Index;
+	}
+
+	uLongf CompressedSize = compressBound(NumTiles);
+	const size_t LayerStart = vOut.size();
+	WriteUint(vOut, Type);
+	WriteUint(vOut, 0); // patched below
+	vOut.resize(LayerStart + CMqttMapPayload::LAYER_HEADER_SIZE + CompressedSize);
+	if(compress2(vOut.data() + LayerStart + CMqttMapPayload::LAYER_HEADER_SIZE, &CompressedSize, vIndices.data(), NumTiles, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return false;
+	vOut.resize(LayerStart + CMqttMapPayload::LAYER_HEADER_SIZE + CompressedSize);
+	uint_to_bytes_be(vOut.data() + LayerStart + 4, CompressedSize);
+	return true;
+}
+
+bool CMqttMapPayload::Encode(const SHA256_DIGEST &Sha256, int Width, int Height, const CTile *pGame, const CTile *pFront, std::vector<unsigned char> &vOut)
+{
+	vOut.clear();
+	if(Width <= 0 || Height <= 0 || !pGame)
+		return false;
+
+	vOut.insert(vOut.end(), MAP_MAGIC, MAP_MAGIC + sizeof(MAP_MAGIC));
+	WriteUint(vOut, VERSION);
+	vOut.insert(vOut.end(), Sha256.data, Sha256.data + sizeof(Sha256.data));
+	WriteUint(vOut, Width);
+	WriteUint(vOut, Height);
+	WriteUint(vOut, pFront ? 2 : 1);
+
+	if(!AppendLayer(vOut, LAYER_GAME, Width, Height, pGame))
+		return false;
+	if(pFront && !AppendLayer(vOut, LAYER_FRONT, Width, Height, pFront))
+		return false;
+	return true;
+}
+
+bool CMqttMapPayload::Decode(const void *pData, int Size)
+{
+	const unsigned char *pBytes = static_cast<const unsigned char *>(pData);
+	m_vLayers.clear();
+	if(Size < HEADER_SIZE || mem_comp(pBytes, MAP_MAGIC, sizeof(MAP_MAGIC)) != 0 || bytes_be_to_uint(pBytes + 4) != VERSION)
+		return false;
+
+	mem_copy(m_Sha256.data, pBytes + 8, sizeof(m_Sha256.data));
+	const unsigned Width = bytes_be_to_uint(pBytes + 8 + SHA256_DIGEST_LENGTH);
+	const unsigned Height = bytes_be_to_uint(pBytes + 12 + SHA256_DIGEST_LENGTH);
+	const unsigned NumLayers = bytes_be_to_uint(pBytes + 16 + SHA256_DIGEST_LENGTH);
+	// the same limits as for tilemaps in map files
+	if(Width == 0 || Height == 0 || Width > 100000 || Height > 100000 || (uint64_t)Width * Height > 0x7fffffff || NumLayers > NUM_LAYERS)
+		return false;
+	m_Width = Width;
+	m_Height = Height;
+
+	int Offset = HEADER_SIZE;
+	for(unsigned l = 0; l < NumLayers; l++)
+	{
+		if(Size - Offset < LAYER_HEADER_SIZE)
+			return false;
+		CLayer Layer;
+		Layer.m_Type = bytes_be_to_uint(pBytes + Offset);
+		const unsigned CompressedSize = bytes_be_to_uint(pBytes + Offset + 4);
+		Offset += LAYER_HEADER_SIZE;
+		if(CompressedSize > (unsigned)(Size - Offset))
+			return false;
+
+		uLongf NumTiles = (uLongf)m_Width * m_Height;
+		Layer.m_vIndices.resize(NumTiles);
+		if(uncompress(Layer.m_vIndices.data(), &NumTiles, pBytes + Offset, CompressedSize) != Z_OK || NumTiles != Layer.m_vIndices.size())
+			return false;
+		Offset += CompressedSize;
+
+		for(size_t i = m_Width; i < Layer.m_vIndices.size(); i++)
+			Layer.m_vIndices[i] += Layer.m_vIndices[i - m_Width];
+		m_vLayers.push_back(std::move(Layer));
+	}
+	return Offset == Size;
+}
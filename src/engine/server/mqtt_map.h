@@ -0,0 +1,74 @@
+#ifndef ENGINE_SERVER_MQTT_MAP_H
+#define ENGINE_SERVER_MQTT_MAP_H
+
+#include <base/hash.h>
+
+#include <vector>
+
+class CTile;
+
+/**
+ * Binary encoding of the collision layers published on the MQTT map
+ * channel.
+ *
+ * All integers are big endian. The payload starts with a header
+ *
+ *     char[4] magic "DDMM"
+ *     u32     version
+ *     u8[32]  SHA256 of the map file
+ *     u32     width, height, number of layers
+ *
+ * followed by the layers, each one being
+ *
+ *     u32     layer type (`LAYER_GAME`, `LAYER_FRONT`)
+ *     u32     compressed size
+ *     u8[]    zlib stream of the width * height tile indices
+ *
+ * Before compression every row stores the difference to the row above
+ * it (mod 256), the first row is stored as is. Rows of walls and
+ * freeze repeat a lot in race maps and turn into long runs of zeros
+ * that way.
+ */
+class CMqttMapPayload
+{
+public:
+	enum
+	{
+		VERSION = 1,
+		HEADER_SIZE = 4 + 4 + SHA256_DIGEST_LENGTH + 3 * 4,
+		LAYER_HEADER_SIZE = 2 * 4,
+
+		LAYER_GAME = 0,
+		LAYER_FRONT,
+		NUM_LAYERS,
+	};
+
+	struct CLayer
+	{
+		int m_Type;
+		std::vector<unsigned char> m_vIndices;
+	};
+
+	SHA256_DIGEST m_Sha256;
+	int m_Width;
+	int m_Height;
+	std::vector<CLayer> m_vLayers;
+
+	/**
+	 * Encodes the tile indices of the given layers.
+	 *
+	 * @param pFront Front layer, may be `nullptr` if the map has none.
+	 *
+	 * @return `false` if compressing failed.
+	 */
+	static bool Encode(const SHA256_DIGEST &Sha256, int Width, int Height, const CTile *pGame, const CTile *pFront, std::vector<unsigned char> &vOut);
+
+	/**
+	 * Decodes a payload created by @link Encode @endlink.
+	 *
+	 * @return `false` if the payload is malformed or of another version.
+	 */
+	bool Decode(const void *pData, int Size);
+};
+
+#endif // ENGINE_SERVER_MQTT_MAP_H
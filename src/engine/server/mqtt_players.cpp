@@ -0,0 +1,164 @@
+#include "mqtt_players.h"
+
+#include <base/system.h>
+
+#include <cstddef>
+
+using json = nlohmann::json;
+
+namespace {
+
+enum
+{
+	FIELD_BOOL = 1 << 0,
+	FIELD_CHARACTER = 1 << 1,
+};
+
+struct CIntField
+{
+	const char *m_pPath;
+	int CMqttPlayerState::*m_pMember;
+	int m_Flags;
+};
+
+struct CStringField
+{
+	const char *m_pPath;
+	size_t m_Offset;
+};
+
+// same layout as the player objects of the old heartbeat
+const CIntField INT_FIELDS[] = {
+	{"/team", &CMqttPlayerState::m_Team, 0},
+	{"/clientversion", &CMqttPlayerState::m_ClientVersion, 0},
+	{"/afk", &CMqttPlayerState::m_Afk, FIELD_BOOL},
+	{"/moderating", &CMqttPlayerState::m_Moderating, FIELD_BOOL},
+	{"/teeinfo/usecustomcolor", &CMqttPlayerState::m_UseCustomColor, 0},
+	{"/teeinfo/colorbody", &CMqttPlayerState::m_ColorBody, 0},
+	{"/teeinfo/colorfeet", &CMqttPlayerState::m_ColorFeet, 0},
+	{"/latency/accum", &CMqttPlayerState::m_LatencyAccum, 0},
+	{"/latency/accummax", &CMqttPlayerState::m_LatencyAccumMax, 0},
+	{"/latency/accummin", &CMqttPlayerState::m_LatencyAccumMin, 0},
+	{"/latency/avg", &CMqttPlayerState::m_LatencyAvg, 0},
+	{"/latency/max", &CMqttPlayerState::m_LatencyMax, 0},
+	{"/latency/min", &CMqttPlayerState::m_LatencyMin, 0},
+	{"/ischaracter", &CMqttPlayerState::m_IsCharacter, FIELD_BOOL},
+	{"/character/input/direction", &CMqttPlayerState::m_InputDirection, FIELD_CHARACTER},
+	{"/character/input/fire", &CMqttPlayerState::m_InputFire, FIELD_CHARACTER},
+	{"/character/input/hook", &CMqttPlayerState::m_InputHook, FIELD_CHARACTER},
+	{"/character/input/jump", &CMqttPlayerState::m_InputJump, FIELD_CHARACTER},
+	{"/character/input/nextweapon", &CMqttPlayerState::m_InputNextWeapon, FIELD_CHARACTER},
+	{"/character/input/playerflags", &CMqttPlayerState::m_InputPlayerFlags, FIELD_CHARACTER},
+	{"/character/input/prevweapon", &CMqttPlayerState::m_InputPrevWeapon, FIELD_CHARACTER},
+	{"/character/input/targetx", &CMqttPlayerState::m_InputTargetX, FIELD_CHARACTER},
+	{"/character/input/targety", &CMqttPlayerState::m_InputTargetY, FIELD_CHARACTER},
+	{"/character/input/wantedweapon", &CMqttPlayerState::m_InputWantedWeapon, FIELD_CHARACTER},
+	{"/character/activeweapon", &CMqttPlayerState::m_ActiveWeapon, FIELD_CHARACTER},
+	{"/character/freeze_start", &CMqttPlayerState::m_FreezeStart, FIELD_CHARACTER},
+	{"/character/freeze_end", &CMqttPlayerState::m_FreezeEnd, FIELD_CHARACTER},
+	{"/character/jumped", &CMqttPlayerState::m_Jumped, FIELD_CHARACTER},
+	{"/character/solo", &CMqttPlayerState::m_Solo, FIELD_CHARACTER},
+	{"/character/pos/x", &CMqttPlayerState::m_PosX, FIELD_CHARACTER},
+	{"/character/pos/y", &CMqttPlayerState::m_PosY, FIELD_CHARACTER},
+	{"/character/vel/x", &CMqttPlayerState::m_VelX, FIELD_CHARACTER},
+	{"/character/vel/y", &CMqttPlayerState::m_VelY, FIELD_CHARACTER},
+	{"/character/hookpos/x", &CMqttPlayerState::m_HookPosX, FIELD_CHARACTER},
+	{"/character/hookpos/y", &CMqttPlayerState::m_HookPosY, FIELD_CHARACTER},
+	{"/character/hookstate", &CMqttPlayerState::m_HookState, FIELD_CHARACTER},
+};
+
+const CStringField STRING_FIELDS[] = {
+	{"/name", offsetof(CMqttPlayerState, m_aName)},
+	{"/clan", offsetof(CMqttPlayerState, m_aClan)},
+	{"/teeinfo/skinname", offsetof(CMqttPlayerState, m_aSkinName)},
+};
+
+const char *StringMember(const CMqttPlayerState &State, const CStringField &Field)
+{
+	return reinterpret_cast<const char *>(&State) + Field.m_Offset;
+}
+
+// Writes the fields of `State` that differ from `pLast` into `Out`, all
+// of them if `pLast` is `nullptr`.
+bool DiffPlayer(const CMqttPlayerState &State, const CMqttPlayerState *pLast, json &Out)
+{
+	bool Changed = false;
+	for(const CIntField &Field : INT_FIELDS)
+	{
+		if((Field.m_Flags & FIELD_CHARACTER) && !State.m_IsCharacter)
+			continue;
+		// a new character starts with all its fields
+		const bool Full = !pLast || ((Field.m_Flags & FIELD_CHARACTER) && !pLast->m_IsCharacter);
+		if(!Full && State.*Field.m_pMember == pLast->*Field.m_pMember)
+			continue;
+		if(Field.m_Flags & FIELD_BOOL)
+			Out[json::json_pointer(Field.m_pPath)] = State.*Field.m_pMember != 0;
+		else
+			Out[json::json_pointer(Field.m_pPath)] = State.*Field.m_pMember;
+		Changed = true;
+	}
+	for(const CStringField &Field : STRING_FIELDS)
+	{
+		if(pLast && str_comp(StringMember(State, Field), StringMember(*pLast, Field)) == 0)
+			continue;
+		Out[json::json_pointer(Field.m_pPath)] = StringMember(State, Field);
+		Changed = true;
+	}
+	return Changed;
+}
+
+}
+
+CMqttPlayerTracker::CMqttPlayerTracker() :
+	m_KeyframeInterval(0),
+	m_LastKeyframe(0),
+	m_KeyframeRequested(true)
+{
+	mem_zero(m_aLast, sizeof(m_aLast));
+}
+
+void CMqttPlayerTracker::Init(int KeyframeInterval)
+{
+	m_KeyframeInterval = KeyframeInterval;
+	m_KeyframeRequested = true;
+}
+
+bool CMqttPlayerTracker::Update(const CMqttPlayerState *pStates, int Tick, json &Out)
+{
+	const bool Keyframe = m_KeyframeRequested || Tick - m_LastKeyframe >= m_KeyframeInterval || Tick < m_LastKeyframe;
+	if(Keyframe)
+	{
+		m_KeyframeRequested = false;
+		m_LastKeyframe = Tick;
+	}
+
+	Out = json::object();
+	json Players = json::object();
+	json Left = json::array();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CMqttPlayerState &State = pStates[i];
+		const CMqttPlayerState &Last = m_aLast[i];
+		if(!State.m_Active)
+		{
+			if(Last.m_Active)
+				Left.push_back(i);
+			continue;
+		}
+
+		json Player = json::object();
+		const bool Joined = !Last.m_Active;
+		if(DiffPlayer(State, Keyframe || Joined ? nullptr : &Last, Player))
+			Players[std::to_string(i)] = std::move(Player);
+	}
+	mem_copy(m_aLast, pStates, sizeof(m_aLast));
+
+	if(!Keyframe && Players.empty() && Left.empty())
+		return false;
+
+	Out["keyframe"] = Keyframe;
+	Out["players"] = std::move(Players);
+	if(!Left.empty())
+		Out["left"] = std::move(Left);
+	return true;
+}
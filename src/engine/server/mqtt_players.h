@@ -0,0 +1,93 @@
+#ifndef ENGINE_SERVER_MQTT_PLAYERS_H
+#define ENGINE_SERVER_MQTT_PLAYERS_H
+
+#include <engine/shared/protocol.h>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * Copy of the player fields published on the MQTT player stream, taken
+ * on the tick thread so the MQTT thread never touches the game state.
+ */
+class CMqttPlayerState
+{
+public:
+	bool m_Active;
+
+	int m_Team;
+	char m_aName[MAX_NAME_LENGTH];
+	char m_aClan[MAX_CLAN_LENGTH];
+	int m_ClientVersion;
+	int m_Afk;
+	int m_Moderating;
+
+	char m_aSkinName[24];
+	int m_UseCustomColor;
+	int m_ColorBody;
+	int m_ColorFeet;
+
+	int m_LatencyAccum;
+	int m_LatencyAccumMax;
+	int m_LatencyAccumMin;
+	int m_LatencyAvg;
+	int m_LatencyMax;
+	int m_LatencyMin;
+
+	int m_IsCharacter;
+	int m_InputDirection;
+	int m_InputFire;
+	int m_InputHook;
+	int m_InputJump;
+	int m_InputNextWeapon;
+	int m_InputPlayerFlags;
+	int m_InputPrevWeapon;
+	int m_InputTargetX;
+	int m_InputTargetY;
+	int m_InputWantedWeapon;
+	int m_ActiveWeapon;
+	int m_FreezeStart;
+	int m_FreezeEnd;
+	int m_Jumped;
+	int m_Solo;
+	int m_PosX;
+	int m_PosY;
+	int m_VelX;
+	int m_VelY;
+	int m_HookPosX;
+	int m_HookPosY;
+	int m_HookState;
+};
+
+/**
+ * Turns the player states of consecutive ticks into a stream of changes.
+ *
+ * Each update only contains the fields that changed since the previous
+ * one, keyed by client id. Players that left are listed under `left`.
+ * Every `KeyframeInterval` ticks, and whenever one is requested, a
+ * keyframe with the full state of all players is emitted instead so
+ * consumers can join at any time.
+ */
+class CMqttPlayerTracker
+{
+public:
+	CMqttPlayerTracker();
+
+	void Init(int KeyframeInterval);
+	void RequestKeyframe() { m_KeyframeRequested = true; }
+
+	/**
+	 * @param pStates The states of all `MAX_CLIENTS` clients.
+	 * @param Out Receives the update.
+	 *
+	 * @return `false` if nothing changed, `Out` is left empty then.
+	 */
+	bool Update(const CMqttPlayerState *pStates, int Tick, nlohmann::json &Out);
+
+private:
+	CMqttPlayerState m_aLast[MAX_CLIENTS];
+	int m_KeyframeInterval;
+	int m_LastKeyframe;
+	bool m_KeyframeRequested;
+};
+
+#endif // ENGINE_SERVER_MQTT_PLAYERS_H
@@ -0,0 +1,147 @@
+#include "mqtt_requests.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <cinttypes>
+
+CMqttPendingRequests::CMqttPendingRequests() :
+	m_Timeout(0),
+	m_Resolution(1),
+	m_LastSlot(-1),
+	m_Salt(0),
+	m_Counter(0)
+{
+	mem_zero(m_aNumPending, sizeof(m_aNumPending));
+}
+
+void CMqttPendingRequests::Init(int64_t Timeout, int64_t Resolution, uint32_t Salt)
+{
+	std::unique_lock Lock(m_Lock);
+	m_Timeout = Timeout;
+	m_Resolution = maximum<int64_t>(Resolution, 1);
+	m_LastSlot = -1;
+	m_Salt = Salt;
+}
+
+void CMqttPendingRequests::Clear()
+{
+	std::unique_lock Lock(m_Lock);
+	m_Pending.clear();
+	for(auto &vSlot : m_avWheel)
+		vSlot.clear();
+	mem_zero(m_aNumPending, sizeof(m_aNumPending));
+}
+
+uint64_t CMqttPendingRequests::Add(int ClientId, uint32_t UniqueClientId, int64_t Now)
+{
+	if(ClientId < 0 || ClientId >= MAX_CLIENTS)
+		return 0;
+
+	std::unique_lock Lock(m_Lock);
+	if(m_aNumPending[ClientId] > 0)
+		return 0;
+
+	// never hand out 0, it means failure
+	if(++m_Counter == 0)
+		++m_Counter;
+	const uint64_t Id = ((uint64_t)m_Salt << 32) | m_Counter;
+
+	CRequest Request;
+	Request.m_Id = Id;
+	Request.m_ClientId = ClientId;
+	Request.m_UniqueClientId = UniqueClientId;
+	Request.m_Deadline = Now + m_Timeout;
+	m_Pending[Id] = Request;
+	m_aNumPending[ClientId]++;
+
+	// round up, so the request isn't looked at before its deadline
+	const int64_t Slot = maximum((Request.m_Deadline + m_Resolution - 1) / m_Resolution, m_LastSlot + 1);
+	m_avWheel[Slot % WHEEL_SLOTS].push_back(Id);
+	return Id;
+}
+
+bool CMqttPendingRequests::Complete(uint64_t Id, CRequest &Request)
+{
+	std::unique_lock Lock(m_Lock);
+	auto It = m_Pending.find(Id);
+	if(It == m_Pending.end())
+		return false;
+	Request = It->second;
+	m_aNumPending[Request.m_ClientId]--;
+	m_Pending.erase(It);
+	// the wheel entry is dropped when its slot comes up
+	return true;
+}
+
+void CMqttPendingRequests::Expire(int64_t Now, std::vector<CRequest> &vExpired)
+{
+	std::unique_lock Lock(m_Lock);
+	const int64_t CurrentSlot = Now / m_Resolution;
+	// every slot holds all rounds, one lap covers everything
+	int64_t Slot = maximum(m_LastSlot + 1, CurrentSlot - WHEEL_SLOTS + 1);
+	for(; Slot <= CurrentSlot; Slot++)
+	{
+		std::vector<uint64_t> &vSlot = m_avWheel[Slot % WHEEL_SLOTS];
+		size_t Keep = 0;
+		for(uint64_t Id : vSlot)
+		{
+			auto It = m_Pending.find(Id);
+			if(It == m_Pending.end())
+				continue;
+			if(It->second.m_Deadline > Now)
+			{
+				// due in a later round of the wheel
+				vSlot[Keep++] = Id;
+				continue;
+			}
+			vExpired.push_back(It->second);
+			m_aNumPending[It->second.m_ClientId]--;
+			m_Pending.erase(It);
+		}
+		vSlot.resize(Keep);
+	}
+	m_LastSlot = CurrentSlot;
+}
+
+int CMqttPendingRequests::NumPending() const
+{
+	std::unique_lock Lock(m_Lock);
+	return m_Pending.size();
+}
+
+bool CMqttPendingRequests::HasPending(int ClientId) const
+{
+	if(ClientId < 0 || ClientId >= MAX_CLIENTS)
+		return false;
+	std::unique_lock Lock(m_Lock);
+	return m_aNumPending[ClientId] > 0;
+}
+
+void CMqttPendingRequests::FormatId(uint64_t Id, char *pBuf, int BufSize)
+{
+	str_format(pBuf, BufSize, "%016" PRIx64, Id);
+}
+
+bool CMqttPendingRequests::ParseId(const char *pStr, uint64_t *pId)
+{
+	if(str_length(pStr) != CORRELATION_ID_LENGTH)
+		return false;
+	uint64_t Id = 0;
+	for(int i = 0; i < CORRELATION_ID_LENGTH; i++)
+	{
+		const char c = pStr[i];
+		int Digit;
+		if(c >= '0' && c <= '9')
+			Digit = c - '0';
+		else if(c >= 'a' && c <= 'f')
+			Digit = c - 'a' + 10;
+		else if(c >= 'A' && c <= 'F')
+			Digit = c - 'A' + 10;
+		else
+			return false;
+		Id = (Id << 4) | Digit;
+	}
+	*pId = Id;
+	return Id != 0;
+}
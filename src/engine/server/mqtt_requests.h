@@ -0,0 +1,91 @@
+#ifndef ENGINE_SERVER_MQTT_REQUESTS_H
+#define ENGINE_SERVER_MQTT_REQUESTS_H
+
+#include <engine/shared/protocol.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Requests sent over MQTT that are waiting for a response, identified by
+ * a correlation id.
+ *
+ * Timeouts are tracked in a hashed timer wheel, so expiring them only
+ * looks at the slots that passed since the last call instead of at every
+ * pending request. All functions are thread-safe: requests are added on
+ * the tick thread, completed by the paho callbacks and expired by the
+ * MQTT thread. Times are in the units of `time_get()`.
+ */
+class CMqttPendingRequests
+{
+public:
+	enum
+	{
+		WHEEL_SLOTS = 64,
+		CORRELATION_ID_LENGTH = 16,
+	};
+
+	struct CRequest
+	{
+		uint64_t m_Id;
+		int m_ClientId;
+		uint32_t m_UniqueClientId;
+		int64_t m_Deadline;
+	};
+
+	CMqttPendingRequests();
+
+	/**
+	 * @param Timeout Time after which a request expires.
+	 * @param Resolution Width of a timer wheel slot, requests expire at
+	 * most this late.
+	 * @param Salt Upper bits of the correlation ids, so responses to a
+	 * previous run of the server don't match.
+	 */
+	void Init(int64_t Timeout, int64_t Resolution, uint32_t Salt);
+	void Clear();
+
+	/**
+	 * Registers a request of a client.
+	 *
+	 * @return The correlation id, `0` if the client already has a
+	 * request pending.
+	 */
+	uint64_t Add(int ClientId, uint32_t UniqueClientId, int64_t Now);
+
+	/**
+	 * Removes the request a response belongs to.
+	 *
+	 * @return `false` if no such request is pending, e.g. because it
+	 * timed out already.
+	 */
+	bool Complete(uint64_t Id, CRequest &Request);
+
+	/**
+	 * Removes all requests whose deadline passed and appends them to
+	 * `vExpired`.
+	 */
+	void Expire(int64_t Now, std::vector<CRequest> &vExpired);
+
+	int NumPending() const;
+	bool HasPending(int ClientId) const;
+	int64_t Resolution() const { return m_Resolution; }
+
+	static void FormatId(uint64_t Id, char *pBuf, int BufSize);
+	static bool ParseId(const char *pStr, uint64_t *pId);
+
+private:
+	mutable std::mutex m_Lock;
+	std::unordered_map<uint64_t, CRequest> m_Pending;
+	std::vector<uint64_t> m_avWheel[WHEEL_SLOTS];
+	int m_aNumPending[MAX_CLIENTS];
+	int64_t m_Timeout;
+	int64_t m_Resolution;
+	int64_t m_LastSlot;
+	uint32_t m_Salt;
+	uint32_t m_Counter;
+};
+
+#endif // ENGINE_SERVER_MQTT_REQUESTS_H
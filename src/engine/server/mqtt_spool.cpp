@@ -0,0 +1,287 @@
+#include "mqtt_spool.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+CMqttSpool::CMqttSpool() :
+	m_MaxBytes(0),
+	m_MaxAge(0),
+	m_SegmentBytes(0),
+	m_NextSegmentId(0),
+	m_WriteFile(nullptr),
+	m_ReadFile(nullptr),
+	m_ReadSegmentId(-1),
+	m_WriteDirty(false),
+	m_NumMessages(0),
+	m_NumBytes(0)
+{
+	m_aDirectory[0] = '\0';
+	mem_zero(m_aDropped, sizeof(m_aDropped));
+}
+
+CMqttSpool::~CMqttSpool()
+{
+	Shutdown();
+}
+
+int CMqttSpool::ClearCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CMqttSpool *pSelf = static_cast<CMqttSpool *>(pUser);
+	if(IsDir || !str_endswith(pName, ".spool"))
+		return 0;
+
+	char aPath[IO_MAX_PATH_LENGTH];
+	str_format(aPath, sizeof(aPath), "%s/%s", pSelf->m_aDirectory, pName);
+	fs_remove(aPath);
+	return 0;
+}
+
+bool CMqttSpool::Init(const char *pDirectory, int64_t MaxBytes, int64_t MaxAge, int64_t SegmentBytes)
+{
+	Shutdown();
+
+	if(MaxBytes <= HEADER_SIZE)
+		return false;
+
+	if(fs_makedir(pDirectory) != 0)
+	{
+		dbg_msg("mqtt", "failed to create spool directory '%s'", pDirectory);
+		return false;
+	}
+
+	str_copy(m_aDirectory, pDirectory);
+	m_MaxBytes = MaxBytes;
+	m_MaxAge = MaxAge;
+	// keep a few segments around so dropping one doesn't throw away half the spool
+	m_SegmentBytes = clamp<int64_t>(SegmentBytes, HEADER_SIZE + 1, maximum<int64_t>(MaxBytes / 4, HEADER_SIZE + 1));
+
+	// messages of a previous run belong to a server that is gone by now
+	fs_listdir(m_aDirectory, ClearCallback, 0, this);
+	return true;
+}
+
+void CMqttSpool::Shutdown()
+{
+	CloseFiles();
+	if(IsInitialized())
+	{
+		while(!m_Segments.empty())
+			RemoveFrontSegment(false);
+	}
+	m_Segments.clear();
+	m_NumMessages = 0;
+	m_NumBytes = 0;
+	m_aDirectory[0] = '\0';
+}
+
+void CMqttSpool::CloseFiles()
+{
+	if(m_WriteFile)
+	{
+		io_close(m_WriteFile);
+		m_WriteFile = nullptr;
+	}
+	if(m_ReadFile)
+	{
+		io_close(m_ReadFile);
+		m_ReadFile = nullptr;
+	}
+	m_ReadSegmentId = -1;
+	m_WriteDirty = false;
+}
+
+void CMqttSpool::SegmentPath(int Id, char *pBuf, int BufSize) const
+{
+	str_format(pBuf, BufSize, "%s/%08d.spool", m_aDirectory, Id);
+}
+
+bool CMqttSpool::OpenSegment()
+{
+	if(m_WriteFile)
+	{
+		io_close(m_WriteFile);
+		m_WriteFile = nullptr;
+	}
+
+	CSegment Segment;
+	mem_zero(&Segment, sizeof(Segment));
+	Segment.m_Id = m_NextSegmentId++;
+
+	char aPath[IO_MAX_PATH_LENGTH];
+	SegmentPath(Segment.m_Id, aPath, sizeof(aPath));
+	m_WriteFile = io_open(aPath, IOFLAG_WRITE);
+	if(!m_WriteFile)
+	{
+		dbg_msg("mqtt", "failed to open spool segment '%s'", aPath);
+		return false;
+	}
+	m_Segments.push_back(Segment);
+	return true;
+}
+
+void CMqttSpool::RemoveFrontSegment(bool CountAsDropped)
+{
+	CSegment &Segment = m_Segments.front();
+	if(CountAsDropped)
+	{
+		for(int i = 0; i < MAX_CHANNELS; i++)
+			m_aDropped[i] += Segment.m_aNumMessages[i];
+	}
+	m_NumMessages -= Segment.m_NumMessages;
+	m_NumBytes -= Segment.m_Size;
+
+	if(m_ReadSegmentId == Segment.m_Id && m_ReadFile)
+	{
+		io_close(m_ReadFile);
+		m_ReadFile = nullptr;
+		m_ReadSegmentId = -1;
+	}
+	if(m_Segments.size() == 1 && m_WriteFile)
+	{
+		io_close(m_WriteFile);
+		m_WriteFile = nullptr;
+		m_WriteDirty = false;
+	}
+
+	char aPath[IO_MAX_PATH_LENGTH];
+	SegmentPath(Segment.m_Id, aPath, sizeof(aPath));
+	fs_remove(aPath);
+	m_Segments.pop_front();
+}
+
+bool CMqttSpool::Push(int Channel, int Flags, int64_t Timestamp, const void *pData, int Size)
+{
+	const int ChannelSlot = clamp(Channel, 0, (int)MAX_CHANNELS - 1);
+	const int64_t RecordSize = (int64_t)HEADER_SIZE + Size;
+	if(!IsInitialized() || Size < 0 || RecordSize > m_MaxBytes)
+	{
+		m_aDropped[ChannelSlot]++;
+		return false;
+	}
+
+	if(!m_WriteFile || m_Segments.back().m_Size + RecordSize > m_SegmentBytes)
+	{
+		if(!OpenSegment())
+		{
+			m_aDropped[ChannelSlot]++;
+			return false;
+		}
+	}
+
+	// make room by throwing away the oldest messages
+	while(m_NumBytes + RecordSize > m_MaxBytes && m_Segments.size() > 1)
+		RemoveFrontSegment(true);
+
+	unsigned char aHeader[HEADER_SIZE];
+	uint_to_bytes_be(&aHeader[0], (unsigned)Size);
+	uint_to_bytes_be(&aHeader[4], ((unsigned)ChannelSlot << 16) | ((unsigned)Flags & 0xffffu));
+	uint_to_bytes_be(&aHeader[8], (unsigned)((uint64_t)Timestamp >> 32));
+	uint_to_bytes_be(&aHeader[12], (unsigned)((uint64_t)Timestamp & 0xffffffffu));
+	if(io_write(m_WriteFile, aHeader, sizeof(aHeader)) != sizeof(aHeader) ||
+		(Size > 0 && io_write(m_WriteFile, pData, Size) != (unsigned)Size))
+	{
+		// the segment is in an unknown state now, start over with a new one
+		dbg_msg("mqtt", "failed to write to spool segment %d", m_Segments.back().m_Id);
+		io_close(m_WriteFile);
+		m_WriteFile = nullptr;
+		m_aDropped[ChannelSlot]++;
+		return false;
+	}
+	m_WriteDirty = true;
+
+	CSegment &Segment = m_Segments.back();
+	Segment.m_Size += RecordSize;
+	Segment.m_NumMessages++;
+	Segment.m_aNumMessages[ChannelSlot]++;
+	m_NumMessages++;
+	m_NumBytes += RecordSize;
+	return true;
+}
+
+int CMqttSpool::Drain(int64_t Now, int MaxMessages, const std::function<bool(int Channel, int Flags, const void *pData, int Size)> &Send)
+{
+	if(m_WriteDirty)
+	{
+		io_flush(m_WriteFile);
+		m_WriteDirty = false;
+	}
+
+	int Sent = 0;
+	while(Sent < MaxMessages && !m_Segments.empty())
+	{
+		CSegment &Segment = m_Segments.front();
+		if(Segment.m_ReadOffset >= Segment.m_Size)
+		{
+			// keep appending to the last segment unless it was read completely
+			RemoveFrontSegment(false);
+			continue;
+		}
+
+		if(m_ReadSegmentId != Segment.m_Id)
+		{
+			if(m_ReadFile)
+				io_close(m_ReadFile);
+			char aPath[IO_MAX_PATH_LENGTH];
+			SegmentPath(Segment.m_Id, aPath, sizeof(aPath));
+			m_ReadFile = io_open(aPath, IOFLAG_READ);
+			m_ReadSegmentId = m_ReadFile ? Segment.m_Id : -1;
+		}
+
+		unsigned char aHeader[HEADER_SIZE];
+		bool Valid = m_ReadFile &&
+			     io_seek(m_ReadFile, Segment.m_ReadOffset, IOSEEK_START) == 0 &&
+			     io_read(m_ReadFile, aHeader, sizeof(aHeader)) == sizeof(aHeader);
+		const int Size = Valid ? (int)bytes_be_to_uint(&aHeader[0]) : 0;
+		if(Valid && (Size < 0 || Segment.m_ReadOffset + HEADER_SIZE + Size > Segment.m_Size))
+			Valid = false;
+		if(Valid)
+		{
+			m_vReadBuffer.resize(maximum(Size, 1));
+			Valid = Size == 0 || io_read(m_ReadFile, m_vReadBuffer.data(), Size) == (unsigned)Size;
+		}
+		if(!Valid)
+		{
+			dbg_msg("mqtt", "spool segment %d is corrupt, dropping it", Segment.m_Id);
+			RemoveFrontSegment(true);
+			continue;
+		}
+
+		const unsigned ChannelFlags = bytes_be_to_uint(&aHeader[4]);
+		const int64_t Timestamp = (int64_t)(((uint64_t)bytes_be_to_uint(&aHeader[8]) << 32) | bytes_be_to_uint(&aHeader[12]));
+		const int ChannelSlot = clamp((int)(ChannelFlags >> 16), 0, (int)MAX_CHANNELS - 1);
+
+		const bool Expired = m_MaxAge > 0 && Now - Timestamp > m_MaxAge;
+		if(!Expired && !Send(ChannelSlot, ChannelFlags & 0xffffu, m_vReadBuffer.data(), Size))
+			break;
+
+		Segment.m_ReadOffset += HEADER_SIZE + Size;
+		Segment.m_NumMessages--;
+		Segment.m_aNumMessages[ChannelSlot]--;
+		m_NumMessages--;
+		if(Expired)
+			m_aDropped[ChannelSlot]++;
+		else
+			Sent++;
+	}
+
+	// clean up a completely replayed segment right away
+	if(!m_Segments.empty() && m_Segments.front().m_ReadOffset >= m_Segments.front().m_Size && m_Segments.front().m_Size > 0)
+		RemoveFrontSegment(false);
+
+	return Sent;
+}
+
+int64_t CMqttSpool::Dropped(int Channel) const
+{
+	if(Channel < 0 || Channel >= MAX_CHANNELS)
+		return 0;
+	return m_aDropped[Channel];
+}
+
+int64_t CMqttSpool::DroppedTotal() const
+{
+	int64_t Total = 0;
+	for(int64_t Dropped : m_aDropped)
+		Total += Dropped;
+	return Total;
+}
@@ -0,0 +1,104 @@
+#ifndef ENGINE_SERVER_MQTT_SPOOL_H
+#define ENGINE_SERVER_MQTT_SPOOL_H
+
+#include <base/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * Ordered on-disk queue for MQTT messages that could not be delivered
+ * while the broker was unreachable.
+ *
+ * Messages are appended to segment files in one directory and replayed
+ * oldest first. When the spool grows beyond its byte limit the oldest
+ * segment is dropped, messages older than the age limit are skipped on
+ * replay. Both are counted per channel.
+ */
+class CMqttSpool
+{
+public:
+	enum
+	{
+		MAX_CHANNELS = 32,
+		HEADER_SIZE = 16,
+	};
+
+	CMqttSpool();
+	~CMqttSpool();
+
+	/**
+	 * Opens the spool directory and removes leftover segments from a
+	 * previous run.
+	 *
+	 * @param pDirectory Directory for the segment files, created if missing.
+	 * @param MaxBytes Maximum size of all segments together.
+	 * @param MaxAge Maximum age of a message in seconds, 0 for no limit.
+	 * @param SegmentBytes Size after which a new segment file is started.
+	 */
+	bool Init(const char *pDirectory, int64_t MaxBytes, int64_t MaxAge, int64_t SegmentBytes);
+	void Shutdown();
+	bool IsInitialized() const { return m_aDirectory[0] != '\0'; }
+
+	/**
+	 * Appends a message, dropping the oldest segments if necessary.
+	 *
+	 * @param Flags Stored with the message and handed back on replay,
+	 * up to 16 bits.
+	 *
+	 * @return `false` if the message was dropped.
+	 */
+	bool Push(int Channel, int Flags, int64_t Timestamp, const void *pData, int Size);
+
+	/**
+	 * Replays up to `MaxMessages` messages in the order they were pushed.
+	 * Stops at the first message `Send` returns `false` for, that message
+	 * stays in the spool.
+	 *
+	 * @return The number of messages successfully sent.
+	 */
+	int Drain(int64_t Now, int MaxMessages, const std::function<bool(int Channel, int Flags, const void *pData, int Size)> &Send);
+
+	bool Empty() const { return m_NumMessages == 0; }
+	int NumMessages() const { return m_NumMessages; }
+	int64_t NumBytes() const { return m_NumBytes; }
+	int64_t Dropped(int Channel) const;
+	int64_t DroppedTotal() const;
+
+private:
+	struct CSegment
+	{
+		int m_Id;
+		int64_t m_Size;
+		int64_t m_ReadOffset;
+		int m_NumMessages;
+		int m_aNumMessages[MAX_CHANNELS];
+	};
+
+	char m_aDirectory[IO_MAX_PATH_LENGTH];
+	int64_t m_MaxBytes;
+	int64_t m_MaxAge;
+	int64_t m_SegmentBytes;
+
+	std::deque<CSegment> m_Segments;
+	int m_NextSegmentId;
+	IOHANDLE m_WriteFile;
+	IOHANDLE m_ReadFile;
+	int m_ReadSegmentId;
+	bool m_WriteDirty;
+	std::vector<unsigned char> m_vReadBuffer;
+
+	int m_NumMessages;
+	int64_t m_NumBytes;
+	int64_t m_aDropped[MAX_CHANNELS];
+
+	void SegmentPath(int Id, char *pBuf, int BufSize) const;
+	bool OpenSegment();
+	void RemoveFrontSegment(bool CountAsDropped);
+	void CloseFiles();
+	static int ClearCallback(const char *pName, int IsDir, int StorageType, void *pUser);
+};
+
+#endif // ENGINE_SERVER_MQTT_SPOOL_H
@@ -0,0 +1,80 @@
+#ifndef ENGINE_SERVER_MQTT_TRANSPORT_H
+#define ENGINE_SERVER_MQTT_TRANSPORT_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/**
+ * An outgoing MQTT message. The MQTT 5 properties are only sent if they
+ * are not `nullptr`.
+ */
+struct CMqttTransportMessage
+{
+	const char *m_pTopic;
+	const void *m_pData;
+	size_t m_Size;
+	int m_Qos;
+	bool m_Retained;
+	const char *m_pContentType;
+	const char *m_pResponseTopic;
+	const char *m_pCorrelationData;
+};
+
+/**
+ * Connection to an MQTT broker.
+ *
+ * The functions are called from the MQTT thread. The results of a
+ * connection attempt, a lost connection and received messages are
+ * reported from threads of the transport.
+ */
+class IMqttTransport
+{
+public:
+	class IHandler
+	{
+	public:
+		virtual ~IHandler() {}
+		virtual void OnConnected() = 0;
+		virtual void OnConnectFailed() = 0;
+		virtual void OnConnectionLost() = 0;
+	};
+
+	/**
+	 * Called for every message received on a subscribed topic. The
+	 * correlation data is empty if the message didn't have any.
+	 */
+	using FMessageCallback = std::function<void(const std::string &Topic, const std::string &Payload, const std::string &CorrelationData)>;
+
+	virtual ~IMqttTransport() {}
+
+	// Both must be set before the first call to Connect
+	virtual void SetHandler(IHandler *pHandler) = 0;
+	virtual void SetMessageCallback(FMessageCallback Callback) = 0;
+
+	/**
+	 * Starts connecting without waiting for the result, which is reported
+	 * to the handler.
+	 *
+	 * @return `false` if the attempt couldn't be started, the handler isn't
+	 * called in that case.
+	 */
+	virtual bool Connect() = 0;
+	virtual bool Subscribe(const char *pTopic, int Qos) = 0;
+
+	/**
+	 * @return `false` if the message couldn't be handed to the broker
+	 * connection, e.g. because it is down.
+	 */
+	virtual bool Publish(const CMqttTransportMessage &Message) = 0;
+};
+
+/**
+ * Creates the transport through the Paho MQTT C++ client with MQTT 5.
+ *
+ * @return `nullptr` if the client couldn't be created, e.g. because of an
+ * invalid address.
+ */
+IMqttTransport *CreateMqttPahoTransport(const char *pAddress, const char *pClientId, const char *pUsername, const char *pPassword);
+
+#endif // ENGINE_SERVER_MQTT_TRANSPORT_H
@@ -0,0 +1,136 @@
+#include "mqtt_transport.h"
+
+#ifdef CONF_MQTTSERVICES
+
+#include <base/system.h>
+
+#include <mqtt/async_client.h>
+
+class CMqttPahoTransport : public IMqttTransport
+{
+	// Reports the result of the asynchronous connect to the handler
+	class CConnectListener : public mqtt::iaction_listener
+	{
+		CMqttPahoTransport *m_pTransport;
+
+	public:
+		CConnectListener(CMqttPahoTransport *pTransport) :
+			m_pTransport(pTransport) {}
+		void on_success(const mqtt::token &Token) override { m_pTransport->m_pHandler->OnConnected(); }
+		void on_failure(const mqtt::token &Token) override { m_pTransport->m_pHandler->OnConnectFailed(); }
+	};
+
+	mqtt::async_client m_Client;
+	mqtt::connect_options m_ConnOpts;
+	CConnectListener m_ConnectListener;
+	IHandler *m_pHandler;
+	FMessageCallback m_MessageCallback;
+
+public:
+	CMqttPahoTransport(const char *pAddress, const char *pClientId, const char *pUsername, const char *pPassword) :
+		m_Client(pAddress, pClientId, mqtt::create_options(MQTTVERSION_5)),
+		m_ConnOpts(mqtt::connect_options::v5()),
+		m_ConnectListener(this),
+		m_pHandler(nullptr)
+	{
+		// MQTT 5 for the content type of the payloads
+		m_ConnOpts.set_keep_alive_interval(20);
+		m_ConnOpts.set_clean_start(true);
+		m_ConnOpts.set_connect_timeout(10);
+		m_ConnOpts.set_user_name(pUsername);
+		m_ConnOpts.set_password(pPassword);
+
+		m_Client.set_message_callback([this](mqtt::const_message_ptr pMessage) {
+			std::string CorrelationData;
+			if(pMessage->get_properties().contains(mqtt::property::CORRELATION_DATA))
+				CorrelationData = mqtt::get<mqtt::binary>(pMessage->get_properties(), mqtt::property::CORRELATION_DATA);
+			m_MessageCallback(pMessage->get_topic(), pMessage->to_string(), CorrelationData);
+		});
+		m_Client.set_connection_lost_handler([this](const std::string &Cause) {
+			m_pHandler->OnConnectionLost();
+		});
+	}
+
+	~CMqttPahoTransport() override
+	{
+		if(!m_Client.is_connected())
+			return;
+		try
+		{
+			m_Client.disconnect()->wait();
+		}
+		catch(const mqtt::exception &exc)
+		{
+			dbg_msg("mqtt", "MQTT disconnect error: %s", exc.what());
+		}
+	}
+
+	void SetHandler(IHandler *pHandler) override { m_pHandler = pHandler; }
+	void SetMessageCallback(FMessageCallback Callback) override { m_MessageCallback = std::move(Callback); }
+
+	bool Connect() override
+	{
+		try
+		{
+			m_Client.connect(m_ConnOpts, nullptr, m_ConnectListener);
+			return true;
+		}
+		catch(const mqtt::exception &exc)
+		{
+			dbg_msg("mqtt", "MQTT connect error: %s", exc.what());
+			return false;
+		}
+	}
+
+	bool Subscribe(const char *pTopic, int Qos) override
+	{
+		try
+		{
+			m_Client.subscribe(pTopic, Qos);
+			return true;
+		}
+		catch(const mqtt::exception &exc)
+		{
+			dbg_msg("mqtt", "MQTT subscribe error: %s", exc.what());
+			return false;
+		}
+	}
+
+	bool Publish(const CMqttTransportMessage &Message) override
+	{
+		try
+		{
+			mqtt::message_ptr pMessage = mqtt::make_message(Message.m_pTopic, Message.m_pData, Message.m_Size, Message.m_Qos, Message.m_Retained);
+			mqtt::properties Properties;
+			if(Message.m_pContentType)
+				Properties.add({mqtt::property::CONTENT_TYPE, std::string(Message.m_pContentType)});
+			if(Message.m_pResponseTopic)
+				Properties.add({mqtt::property::RESPONSE_TOPIC, std::string(Message.m_pResponseTopic)});
+			if(Message.m_pCorrelationData)
+				Properties.add({mqtt::property::CORRELATION_DATA, std::string(Message.m_pCorrelationData)});
+			pMessage->set_properties(Properties);
+			m_Client.publish(pMessage);
+			return true;
+		}
+		catch(const mqtt::exception &exc)
+		{
+			dbg_msg("mqtt", "Publish to '%s' failed: %s", Message.m_pTopic, exc.what());
+			return false;
+		}
+	}
+};
+
+IMqttTransport *CreateMqttPahoTransport(const char *pAddress, const char *pClientId, const char *pUsername, const char *pPassword)
+{
+	try
+	{
+		return new CMqttPahoTransport(pAddress, pClientId, pUsername, pPassword);
+	}
+	catch(const mqtt::exception &exc)
+	{
+		dbg_msg("mqtt", "MQTT client error: %s", exc.what());
+		return nullptr;
+	}
+}
+
+#endif
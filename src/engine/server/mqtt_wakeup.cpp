@@ -0,0 +1,17 @@
+#include "mqtt_wakeup.h"
+
+void CMqttWakeup::Wakeup()
+{
+	// pairs with the fence in Wait: either the waiting thread sees the new
+	// work or we see that it went to sleep
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(!m_Sleeping.load(std::memory_order_relaxed))
+		return;
+
+	// take the lock so the notification can't slip in between the
+	// predicate check and the wait
+	{
+		std::unique_lock Lock(m_Lock);
+	}
+	m_Cv.notify_one();
+}
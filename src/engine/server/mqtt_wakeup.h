@@ -0,0 +1,54 @@
+#ifndef ENGINE_SERVER_MQTT_WAKEUP_H
+#define ENGINE_SERVER_MQTT_WAKEUP_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Lets the MQTT thread sleep until there is work.
+ *
+ * Producers only pay for a fence and a load while the thread is awake,
+ * the lock and the notification are only taken when it actually sleeps.
+ */
+class CMqttWakeup
+{
+public:
+	CMqttWakeup() :
+		m_Sleeping(false) {}
+
+	/**
+	 * Wakes the waiting thread. Must be called after the work was made
+	 * visible to the predicate of @link Wait @endlink.
+	 */
+	void Wakeup();
+
+	/**
+	 * Sleeps until the predicate is `true`.
+	 *
+	 * @param Timeout Milliseconds after which to wake up anyway, `-1` for
+	 * none.
+	 * @param HasWork Checked with the lock held, must not block.
+	 */
+	template<typename F>
+	void Wait(int64_t Timeout, F &&HasWork)
+	{
+		std::unique_lock Lock(m_Lock);
+		m_Sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(Timeout >= 0)
+			m_Cv.wait_for(Lock, std::chrono::milliseconds(Timeout), HasWork);
+		else
+			m_Cv.wait(Lock, HasWork);
+		m_Sleeping.store(false, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<bool> m_Sleeping;
+	std::mutex m_Lock;
+	std::condition_variable m_Cv;
+};
+
+#endif // ENGINE_SERVER_MQTT_WAKEUP_H
@@ -206,9 +206,7 @@ void CRconClientLogger::Log(const CLogMessage *pMessage)
 void CServer::CClient::Reset()
 {
 	// reset input
-	for(auto &Input : m_aInputs)
-		Input.m_GameTick = -1;
-	m_CurrentInput = 0;
+	m_Inputs.Reset();
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
 
 	m_Snapshots.PurgeAll();
@@ -878,6 +876,35 @@ void CServer::SendMsgRaw(int ClientId, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
+// The snapshot builder of the current thread while the snapshots of the
+// clients are built in parallel, the main thread uses m_SnapshotBuilder
+static thread_local CSnapshotBuilder *s_pSnapshotBuilder = nullptr;
+
+void CServer::UpdateSnapshotWorkers()
+{
+	const int NumThreads = Config()->m_SvSnapshotThreads;
+	if(m_SnapshotPool.NumThreads() != NumThreads)
+	{
+		m_SnapshotPool.Init(NumThreads);
+		m_vpSnapshotWorkers.clear();
+	}
+	if(NumThreads <= 1)
+		return;
+
+	while((int)m_vpSnapshotWorkers.size() < NumThreads)
+		m_vpSnapshotWorkers.push_back(std::make_unique<CSnapshotWorker>());
+	for(auto &pWorker : m_vpSnapshotWorkers)
+	{
+		// the game sets the item sizes once per map, copy them when they
+		// changed instead of every snapshot
+		if(pWorker->m_DeltaVersion != m_SnapshotDeltaVersion)
+		{
+			pWorker->m_pDelta = std::make_unique<CSnapshotDelta>(m_SnapshotDelta);
+			pWorker->m_DeltaVersion = m_SnapshotDeltaVersion;
+		}
+	}
+}
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
@@ -899,7 +926,15 @@ void CServer::DoSnapshot()
 			m_aDemoRecorder[RECORDER_AUTO].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
+	UpdateSnapshotWorkers();
+	const bool Parallel = m_SnapshotPool.NumThreads() > 1;
+	// time_get() isn't thread-safe
+	const int64_t Now = time_get();
+
 	// create snapshots for all clients
+	int aParallelClients[MAX_CLIENTS];
+	int NumParallelClients = 0;
+	bool aSnapped[MAX_CLIENTS] = {false};
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -914,101 +949,143 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick() % 10) != 0)
 			continue;
 
+		// demo recorders share m_SnapshotDelta, record on this thread
+		if(Parallel && !m_aDemoRecorder[i].IsRecording())
 		{
-			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+			aParallelClients[NumParallelClients++] = i;
+			aSnapped[i] = true;
+			continue;
+		}
 
-			GameServer()->OnSnap(i);
+		SnapClient(i, Now, m_SnapshotBuilder, m_SnapshotDelta);
+		if(Parallel)
+			aSnapped[i] = true;
+		else
+			SendSnapshotMessages(i);
+	}
 
-			// finish snapshot
-			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
-			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+	if(Parallel)
+	{
+		// the game only reads the world while snapping, so the clients
+		// can be snapped at the same time with one builder per thread
+		m_SnapshotPool.Run(NumParallelClients, [&](int Item, int Thread) {
+			CSnapshotWorker *pWorker = m_vpSnapshotWorkers[Thread].get();
+			s_pSnapshotBuilder = &pWorker->m_Builder;
+			SnapClient(aParallelClients[Item], Now, pWorker->m_Builder, *pWorker->m_pDelta);
+			s_pSnapshotBuilder = nullptr;
+		});
 
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
-			}
+		// the network isn't thread-safe, send in the same order as before
+		for(int i = 0; i < MaxClients(); i++)
+		{
+			if(aSnapped[i])
+				SendSnapshotMessages(i);
+		}
+	}
 
-			int Crc = pData->Crc();
+	GameServer()->OnPostSnap();
+}
 
-			// remove old snapshots
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
+void CServer::SnapClient(int ClientId, int64_t Now, CSnapshotBuilder &Builder, CSnapshotDelta &Delta)
+{
+	CClient &Client = m_aClients[ClientId];
+	std::deque<CMsgPacker> &vMessages = m_avSnapshotMessages[ClientId];
+	vMessages.clear();
 
-			// save the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
+	Builder.Init(Client.m_Sixup);
 
-			// find snapshot that we can perform delta against
-			int DeltaTick = -1;
-			const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
-			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
-			}
+	GameServer()->OnSnap(ClientId);
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+	// finish snapshot
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
+	int SnapshotSize = Builder.Finish(pData);
 
-			if(DeltaSize)
-			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+	if(m_aDemoRecorder[ClientId].IsRecording())
+	{
+		// write snapshot
+		m_aDemoRecorder[ClientId].RecordSnapshot(Tick(), aData, SnapshotSize);
+	}
 
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+	int Crc = pData->Crc();
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	// remove old snapshots
+	// keep 3 seconds worth of snapshots
+	Client.m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
+	// save the snapshot
+	Client.m_Snapshots.Add(m_CurrentGameTick, Now, SnapshotSize, pData, 0, nullptr);
+
+	// find snapshot that we can perform delta against
+	int DeltaTick = -1;
+	const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
+	{
+		int DeltashotSize = Client.m_Snapshots.Get(Client.m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
+		if(DeltashotSize >= 0)
+			DeltaTick = Client.m_LastAckedSnapshot;
+		else
+		{
+			// no acked package found, force client to recover rate
+			if(Client.m_SnapRate == CClient::SNAPRATE_FULL)
+				Client.m_SnapRate = CClient::SNAPRATE_RECOVER;
+		}
+	}
+
+	// create delta
+	Delta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, Client.m_Sixup);
+	Delta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, Client.m_Sixup);
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	int DeltaSize = Delta.CreateDelta(pDeltashot, pData, aDeltaData);
+
+	if(DeltaSize)
+	{
+		// compress it
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+
+		char aCompData[CSnapshot::MAX_SIZE];
+		SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
+		int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker &Msg = vMessages.emplace_back(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+				CMsgPacker &Msg = vMessages.emplace_back(NETMSG_SNAP, true);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
 			}
 		}
 	}
+	else
+	{
+		CMsgPacker &Msg = vMessages.emplace_back(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+	}
+}
 
-	GameServer()->OnPostSnap();
+void CServer::SendSnapshotMessages(int ClientId)
+{
+	for(CMsgPacker &Msg : m_avSnapshotMessages[ClientId])
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+	m_avSnapshotMessages[ClientId].clear();
 }
 
 int CServer::ClientRejoinCallback(int ClientId, void *pUser)
@@ -1663,27 +1740,22 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			m_aClients[ClientId].m_LastInputTick = IntendedTick;
 
-			CClient::CInput *pInput = &m_aClients[ClientId].m_aInputs[m_aClients[ClientId].m_CurrentInput];
-
 			if(IntendedTick <= Tick())
 				IntendedTick = Tick() + 1;
 
-			pInput->m_GameTick = IntendedTick;
-
+			int aData[MAX_INPUT_SIZE] = {0};
 			for(int i = 0; i < Size / 4; i++)
 			{
-				pInput->m_aData[i] = Unpacker.GetInt();
+				aData[i] = Unpacker.GetInt();
 			}
 			if(Unpacker.Error())
 			{
 				return;
 			}
 
-			GameServer()->OnClientPrepareInput(ClientId, pInput->m_aData);
-			mem_copy(m_aClients[ClientId].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE * sizeof(int));
-
-			m_aClients[ClientId].m_CurrentInput++;
-			m_aClients[ClientId].m_CurrentInput %= 200;
+			GameServer()->OnClientPrepareInput(ClientId, aData);
+			m_aClients[ClientId].m_Inputs.Add(IntendedTick, aData);
+			mem_copy(m_aClients[ClientId].m_LatestInput.m_aData, aData, MAX_INPUT_SIZE * sizeof(int));
 
 			// call the mod with the fresh input data
 			if(m_aClients[ClientId].m_State == CClient::STATE_INGAME)
@@ -2570,13 +2642,25 @@ int CServer::LoadMap(const char *pMapName)
 	m_MapReload = false;
 	m_SameMapReload = false;
 
-	char aBuf[IO_MAX_PATH_LENGTH];
-	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
-	GameServer()->OnMapChange(aBuf, sizeof(aBuf));
+	CMapLoader Loader(Storage(), GameServer(), pMapName, Config()->m_SvSixup);
+	Loader.Load();
+	return FinishLoadMap(Loader);
+}
+
+void CServer::StartLoadMap()
+{
+	m_MapReload = false;
+	m_pMapLoader = std::make_shared<CMapLoader>(Storage(), GameServer(), Config()->m_SvMap, Config()->m_SvSixup);
+	Engine()->AddJob(m_pMapLoader);
+}
 
-	if(!m_pMap->Load(aBuf))
+int CServer::FinishLoadMap(CMapLoader &Loader)
+{
+	if(!Loader.Success())
 		return 0;
 
+	m_pMap->Take(Loader.Map());
+
 	// reinit snapshot ids
 	m_IdPool.TimeoutIds();
 
@@ -2586,43 +2670,47 @@ int CServer::LoadMap(const char *pMapName)
 	char aBufMsg[256];
 	char aSha256[SHA256_MAXSTRSIZE];
 	sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIX], aSha256, sizeof(aSha256));
-	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
+	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", Loader.Path(), aSha256);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
 
-	str_copy(m_aCurrentMap, pMapName);
+	str_copy(m_aCurrentMap, Loader.MapName());
 
-	// load complete map into memory for download
-	{
-		free(m_apCurrentMapData[MAP_TYPE_SIX]);
-		void *pData;
-		Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
-		m_apCurrentMapData[MAP_TYPE_SIX] = (unsigned char *)pData;
-	}
+	// the game deletes the copy of the map with its settings, the map is
+	// loaded by now
+	char aTempfile[IO_MAX_PATH_LENGTH];
+	Loader.TakeTempfile(aTempfile, sizeof(aTempfile));
+	if(aTempfile[0] != '\0')
+		GameServer()->OnMapTempfile(aTempfile);
+
+	free(m_apCurrentMapData[MAP_TYPE_SIX]);
+	m_apCurrentMapData[MAP_TYPE_SIX] = Loader.TakeData(&m_aCurrentMapSize[MAP_TYPE_SIX]);
 
 	// load sixup version of the map
-	if(Config()->m_SvSixup)
+	if(Loader.Sixup())
 	{
-		str_format(aBuf, sizeof(aBuf), "maps7/%s.map", pMapName);
-		void *pData;
-		if(!Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIXUP]))
+		unsigned SixupSize;
+		SHA256_DIGEST SixupSha256;
+		unsigned SixupCrc;
+		unsigned char *pSixupData = Loader.TakeSixupData(&SixupSize, &SixupSha256, &SixupCrc);
+		if(!pSixupData)
 		{
 			Config()->m_SvSixup = 0;
 			if(m_pRegister)
 			{
 				m_pRegister->OnConfigChange();
 			}
-			log_error("sixup", "couldn't load map %s", aBuf);
+			log_error("sixup", "couldn't load map maps7/%s.map", Loader.MapName());
 			log_info("sixup", "disabling 0.7 compatibility");
 		}
 		else
 		{
 			free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
-			m_apCurrentMapData[MAP_TYPE_SIXUP] = (unsigned char *)pData;
-
-			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
-			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+			m_apCurrentMapData[MAP_TYPE_SIXUP] = pSixupData;
+			m_aCurrentMapSize[MAP_TYPE_SIXUP] = SixupSize;
+			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = SixupSha256;
+			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = SixupCrc;
 			sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIXUP], aSha256, sizeof(aSha256));
-			str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
+			str_format(aBufMsg, sizeof(aBufMsg), "maps7/%s.map sha256 is %s", Loader.MapName(), aSha256);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", aBufMsg);
 		}
 	}
@@ -2641,6 +2729,17 @@ int CServer::LoadMap(const char *pMapName)
 #ifdef CONF_DEBUG
 void CServer::UpdateDebugDummies(bool ForceDisconnect)
 {
+	// act like clients that receive every snapshot, so the dummies cost as
+	// much as real players in DoSnapshot
+	for(auto &Client : m_aClients)
+	{
+		if(Client.m_DebugDummy && Client.m_State == CClient::STATE_INGAME && Client.m_Snapshots.m_pLast)
+		{
+			Client.m_LastAckedSnapshot = Client.m_Snapshots.m_pLast->m_Tick;
+			Client.m_SnapRate = CClient::SNAPRATE_FULL;
+		}
+	}
+
 	if(m_PreviousDebugDummies == g_Config.m_DbgDummies && !ForceDisconnect)
 		return;
 
@@ -2667,15 +2766,59 @@ void CServer::UpdateDebugDummies(bool ForceDisconnect)
 		{
 			CNetObj_PlayerInput Input = {0};
 			Input.m_Direction = (ClientId & 1) ? -1 : 1;
-			m_aClients[ClientId].m_aInputs[0].m_GameTick = Tick() + 1;
-			mem_copy(m_aClients[ClientId].m_aInputs[0].m_aData, &Input, minimum(sizeof(Input), sizeof(m_aClients[ClientId].m_aInputs[0].m_aData)));
-			m_aClients[ClientId].m_LatestInput = m_aClients[ClientId].m_aInputs[0];
-			m_aClients[ClientId].m_CurrentInput = 0;
+			CClient::CInput &LatestInput = m_aClients[ClientId].m_LatestInput;
+			mem_zero(&LatestInput, sizeof(LatestInput));
+			LatestInput.m_GameTick = Tick() + 1;
+			mem_copy(LatestInput.m_aData, &Input, minimum(sizeof(Input), sizeof(LatestInput.m_aData)));
+			m_aClients[ClientId].m_Inputs.Add(LatestInput.m_GameTick, LatestInput.m_aData);
 		}
 	}
 
 	m_PreviousDebugDummies = ForceDisconnect ? 0 : g_Config.m_DbgDummies;
 }
+
+void CServer::UpdateSnapshotBench(int64_t TickStart, int64_t SnapStart, int64_t End)
+{
+	if(m_SnapshotBenchRemaining <= 0)
+		return;
+
+	// let the dummies spawn and the worker threads start first
+	if(m_SnapshotBenchWarmup > 0)
+	{
+		m_SnapshotBenchWarmup--;
+		return;
+	}
+
+	int NumClients = 0;
+	for(const auto &Client : m_aClients)
+	{
+		if(Client.m_State == CClient::STATE_INGAME)
+			NumClients++;
+	}
+	m_SnapshotBenchClients = maximum(m_SnapshotBenchClients, NumClients);
+	m_SnapshotBenchTickTime += End - TickStart;
+	m_SnapshotBenchSnapTime += End - SnapStart;
+	m_SnapshotBenchTicks++;
+
+	if(--m_SnapshotBenchRemaining == 0)
+	{
+		const double Freq = time_freq() / 1000.0;
+		log_info("server", "snapshot benchmark: %d clients, %d threads, %d ticks: tick %.3f ms, snapshot %.3f ms",
+			m_SnapshotBenchClients, m_SnapshotPool.NumThreads(), m_SnapshotBenchTicks,
+			m_SnapshotBenchTickTime / Freq / m_SnapshotBenchTicks, m_SnapshotBenchSnapTime / Freq / m_SnapshotBenchTicks);
+	}
+}
+
+void CServer::ConDbgBenchSnapshots(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	pThis->m_SnapshotBenchWarmup = 50;
+	pThis->m_SnapshotBenchRemaining = pResult->NumArguments() ? maximum(pResult->GetInteger(0), 1) : 500;
+	pThis->m_SnapshotBenchTicks = 0;
+	pThis->m_SnapshotBenchClients = 0;
+	pThis->m_SnapshotBenchTickTime = 0;
+	pThis->m_SnapshotBenchSnapTime = 0;
+}
 #endif
 
 int CServer::Run()
@@ -2707,6 +2850,10 @@ int CServer::Run()
 		return -1;
 	}
 
+	DbPool()->SetNumReadWorkers(Config()->m_SvSqlReadWorkers);
+	DbPool()->SetWriteBatch(Config()->m_SvSqlWriteBatch, Config()->m_SvSqlWriteBatchDelay);
+	DbPool()->SetMaxCachedStatements(Config()->m_SvSqlCachedStatements);
+
 	if(Config()->m_SvSqliteFile[0] != '\0')
 	{
 		char aFullPath[IO_MAX_PATH_LENGTH];
@@ -2749,6 +2896,9 @@ int CServer::Run()
 	if(Port == 0)
 		log_info("server", "using port %d", BindAddr.port);
 
+	// the packets of a tick are sent together before waiting for new ones
+	net_udp_set_batching(m_NetServer.Socket(), Config()->m_SvSendBatching);
+
 #if defined(CONF_UPNP)
 	m_UPnP.Open(BindAddr);
 #endif
@@ -2778,6 +2928,9 @@ int CServer::Run()
 	{
 		m_RunServer = STOPPING;
 	}
+#ifdef CONF_MQTTSERVICES
+	m_pMqtt->OnMapChange();
+#endif
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "version " GAME_RELEASE_VERSION " on " CONF_PLATFORM_STRING " " CONF_ARCH_STRING);
 	if(GIT_SHORTREV_HASH)
 	{
@@ -2816,13 +2969,28 @@ int CServer::Run()
 			int64_t t = time_get();
 			int NewTicks = 0;
 
-			// load new map
-			if(m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK) // force reload to make sure the ticks stay within a valid range
+			// load new map in the background
+			if(!m_pMapLoader && (m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK)) // force reload to make sure the ticks stay within a valid range
 			{
-				const bool SameMapReload = m_SameMapReload;
-				// load map
-				if(LoadMap(Config()->m_SvMap))
+				StartLoadMap();
+			}
+
+			// switch to it once it is ready
+			if(m_pMapLoader && m_pMapLoader->Done())
+			{
+				std::shared_ptr<CMapLoader> pMapLoader = std::move(m_pMapLoader);
+				const int64_t SwitchStart = time_get_impl();
+				if(str_comp(pMapLoader->MapName(), Config()->m_SvMap) != 0 || pMapLoader->Sixup() != (Config()->m_SvSixup != 0))
 				{
+					// sv_map or sv_sixup changed while loading, start over
+					m_MapReload = str_comp(Config()->m_SvMap, m_aCurrentMap) != 0 || (m_apCurrentMapData[MAP_TYPE_SIXUP] != nullptr) != (Config()->m_SvSixup != 0);
+				}
+				else if(FinishLoadMap(*pMapLoader))
+				{
+					const bool SameMapReload = m_SameMapReload;
+					m_MapReload = false;
+					m_SameMapReload = false;
+
 					// new map loaded
 
 					// ask the game to for the data it wants to persist past a map change
@@ -2865,7 +3033,7 @@ int CServer::Run()
 					}
 					UpdateServerInfo(true);
 					#ifdef CONF_MQTTSERVICES
-					m_pMqtt->SetMapUpdate(true);
+					m_pMqtt->OnMapChange();
 					#endif
 					for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
 					{
@@ -2877,15 +3045,22 @@ int CServer::Run()
 						// Record PlayerJoin events here to record the Sixup version and player join event.
 						GameServer()->TeehistorianRecordPlayerJoin(ClientId, m_aClients[ClientId].m_Sixup);
 					}
+
+					log_info("server", "changed map to '%s', loading took %.2f ms in the background, switching stalled the server for %.2f ms",
+						m_aCurrentMap, pMapLoader->Duration() * 1000.0 / time_freq(), (time_get_impl() - SwitchStart) * 1000.0 / time_freq());
 				}
 				else
 				{
+					m_SameMapReload = false;
 					str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Config()->m_SvMap);
 					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 					str_copy(Config()->m_SvMap, m_aCurrentMap);
 				}
 			}
 
+#ifdef CONF_DEBUG
+			const int64_t BenchTickStart = time_get_impl();
+#endif
 			while(t > TickStartTime(m_CurrentGameTick + 1))
 			{
 				GameServer()->OnPreTickTeehistorian();
@@ -2894,21 +3069,22 @@ int CServer::Run()
 				UpdateDebugDummies(false);
 #endif
 
+				// every input of the next tick is applied early, the first
+				// one is also the predicted input once the tick started
+				const int *apPredictedInputs[MAX_CLIENTS] = {nullptr};
 				for(int c = 0; c < MAX_CLIENTS; c++)
 				{
 					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
+					apPredictedInputs[c] = m_aClients[c].m_Inputs.First(Tick() + 1);
+					if(!apPredictedInputs[c])
 					{
-						if(Input.m_GameTick == Tick() + 1)
-						{
-							GameServer()->OnClientPredictedEarlyInput(c, Input.m_aData);
-							ClientHadInput = true;
-						}
-					}
-					if(!ClientHadInput)
 						GameServer()->OnClientPredictedEarlyInput(c, nullptr);
+						continue;
+					}
+					m_aClients[c].m_Inputs.ForEach(Tick() + 1, [&](const int *pData) {
+						GameServer()->OnClientPredictedEarlyInput(c, (void *)pData);
+					});
 				}
 
 				m_CurrentGameTick++;
@@ -2926,21 +3102,13 @@ int CServer::Run()
 				{
 					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick())
-						{
-							GameServer()->OnClientPredictedInput(c, Input.m_aData);
-							ClientHadInput = true;
-							break;
-						}
-					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedInput(c, nullptr);
+					GameServer()->OnClientPredictedInput(c, (void *)apPredictedInputs[c]);
 				}
 
 				GameServer()->OnTick();
+#ifdef CONF_MQTTSERVICES
+				m_pMqtt->OnTick();
+#endif
 				if(ErrorShutdown())
 				{
 					break;
@@ -2951,7 +3119,15 @@ int CServer::Run()
 			if(NewTicks)
 			{
 				if(Config()->m_SvHighBandwidth || (m_CurrentGameTick % 2) == 0)
+				{
+#ifdef CONF_DEBUG
+					const int64_t BenchSnapStart = time_get_impl();
+					DoSnapshot();
+					UpdateSnapshotBench(BenchTickStart, BenchSnapStart, time_get_impl());
+#else
 					DoSnapshot();
+#endif
+				}
 
 				UpdateClientRconCommands();
 
@@ -3037,6 +3213,8 @@ int CServer::Run()
 				}
 			}
 
+			net_udp_flush(m_NetServer.Socket());
+
 			// wait for incoming data
 			if(NonActive)
 			{
@@ -3093,6 +3271,8 @@ int CServer::Run()
 	m_Econ.Shutdown();
 	m_Fifo.Shutdown();
 	Engine()->ShutdownJobs();
+	// a map that was still loading is not needed anymore
+	m_pMapLoader = nullptr;
 
 	GameServer()->OnShutdown(nullptr);
 	m_pMap->Unload();
@@ -3877,6 +4057,9 @@ void CServer::RegisterCommands()
 
 	// register console commands
 	Console()->Register("kick", "i[id] ?r[reason]", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
+#ifdef CONF_DEBUG
+	Console()->Register("dbg_bench_snapshots", "?i[ticks]", CFGFLAG_SERVER, ConDbgBenchSnapshots, this, "Measure the average tick and snapshot times over the next ticks (default 500)");
+#endif
 	Console()->Register("status", "?r[name]", CFGFLAG_SERVER, ConStatus, this, "List players containing name or all players");
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
@@ -3940,12 +4123,15 @@ void CServer::SnapFreeId(int Id)
 void *CServer::SnapNewItem(int Type, int Id, int Size)
 {
 	dbg_assert(Id >= -1 && Id <= 0xffff, "incorrect id");
-	return Id < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, Id, Size);
+	if(Id < 0)
+		return 0;
+	return s_pSnapshotBuilder ? s_pSnapshotBuilder->NewItem(Type, Id, Size) : m_SnapshotBuilder.NewItem(Type, Id, Size);
 }
 
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	m_SnapshotDeltaVersion++;
 }
 
 CServer *CreateServer() { return new CServer(); }
@@ -17,7 +17,9 @@
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
 #include <engine/shared/uuid_manager.h>
+#include <engine/shared/worker_pool.h>
 
+#include <deque>
 #include <list>
 #include <memory>
 #include <optional>
@@ -25,6 +27,8 @@
 
 #include "antibot.h"
 #include "authmanager.h"
+#include "input_ring.h"
+#include "map_loader.h"
 #include "name_ban.h"
 #include "snap_id_pool.h"
 #ifdef CONF_MQTTSERVICES
@@ -95,6 +99,16 @@ class CServer : public IServer
 #ifdef CONF_DEBUG
 	int m_PreviousDebugDummies = 0;
 	void UpdateDebugDummies(bool ForceDisconnect);
+
+	// Measures the tick and snapshot times, see dbg_bench_snapshots
+	int m_SnapshotBenchWarmup = 0;
+	int m_SnapshotBenchRemaining = 0;
+	int m_SnapshotBenchTicks = 0;
+	int m_SnapshotBenchClients = 0;
+	int64_t m_SnapshotBenchTickTime = 0;
+	int64_t m_SnapshotBenchSnapTime = 0;
+	void UpdateSnapshotBench(int64_t TickStart, int64_t SnapStart, int64_t End);
+	static void ConDbgBenchSnapshots(IConsole::IResult *pResult, void *pUser);
 #endif
 
 public:
@@ -164,8 +178,7 @@ public:
 		CSnapshotStorage m_Snapshots;
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		CInputRing m_Inputs;
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -213,6 +226,21 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// State of one thread building the snapshots of the clients in
+	// parallel, see sv_snapshot_threads
+	struct CSnapshotWorker
+	{
+		CSnapshotBuilder m_Builder;
+		std::unique_ptr<CSnapshotDelta> m_pDelta;
+		int m_DeltaVersion = -1;
+	};
+	CWorkerPool m_SnapshotPool;
+	std::vector<std::unique_ptr<CSnapshotWorker>> m_vpSnapshotWorkers;
+	// Changes whenever the static item sizes of m_SnapshotDelta change
+	int m_SnapshotDeltaVersion = 0;
+	// Messages of the current snapshot of each client, sent in client order
+	std::deque<CMsgPacker> m_avSnapshotMessages[MAX_CLIENTS];
 	CSnapIdPool m_IdPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -221,6 +249,8 @@ public:
 	CHttp m_Http;
 
 	IEngineMap *m_pMap;
+	// the next map, prepared in the background
+	std::shared_ptr<CMapLoader> m_pMapLoader;
 
 	int64_t m_GameStartTime;
 	//int m_CurrentGameTick;
@@ -329,6 +359,9 @@ public:
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientId) override;
 
 	void DoSnapshot();
+	void SnapClient(int ClientId, int64_t Now, CSnapshotBuilder &Builder, CSnapshotDelta &Delta);
+	void SendSnapshotMessages(int ClientId);
+	void UpdateSnapshotWorkers();
 
 	static int NewClientCallback(int ClientId, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientId, void *pUser);
@@ -398,6 +431,8 @@ public:
 	const char *GetMapName() const override;
 	void ReloadMap() override;
 	int LoadMap(const char *pMapName);
+	void StartLoadMap();
+	int FinishLoadMap(CMapLoader &Loader);
 
 	void SaveDemo(int ClientId, float Time) override;
 	void StartRecord(int ClientId) override;
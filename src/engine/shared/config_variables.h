@@ -423,6 +423,22 @@ MACRO_CONFIG_STR(SvMQTTAddresse, sv_mqtt_address, 128, "", CFGFLAG_SERVER, "MQTT
 MACRO_CONFIG_STR(SvMQTTUsername, sv_mqtt_username, 128, "", CFGFLAG_SERVER, "MQTT username")
 MACRO_CONFIG_STR(SvMQTTPassword, sv_mqtt_password, 128, "", CFGFLAG_SERVER, "MQTT password")
 MACRO_CONFIG_STR(SvMQTTTopic, sv_mqtt_topic, 128, "ddnet", CFGFLAG_SERVER, "MQTT topic")
+MACRO_CONFIG_INT(SvMQTTReconnectMin, sv_mqtt_reconnect_min, 1000, 100, 600000, CFGFLAG_SERVER, "Delay in milliseconds before the first attempt to reconnect to the MQTT broker")
+MACRO_CONFIG_INT(SvMQTTReconnectMax, sv_mqtt_reconnect_max, 60000, 100, 3600000, CFGFLAG_SERVER, "Maximum delay in milliseconds between attempts to reconnect to the MQTT broker")
+MACRO_CONFIG_STR(SvMQTTEncoding, sv_mqtt_encoding, 256, "json", CFGFLAG_SERVER, "Payload encoding of the MQTT channels (json, cbor, msgpack), e.g. \"json,players=msgpack\"")
+MACRO_CONFIG_INT(SvMQTTConsoleLevel, sv_mqtt_console_level, 1, 0, 2, CFGFLAG_SERVER, "Highest level of console lines published over MQTT (0 = normal, 1 = additional info, 2 = debug)")
+MACRO_CONFIG_INT(SvMQTTConsoleRate, sv_mqtt_console_rate, 50, 0, 10000, CFGFLAG_SERVER, "Console lines per second published over MQTT (0 for no limit)")
+MACRO_CONFIG_INT(SvMQTTConsoleBurst, sv_mqtt_console_burst, 500, 1, 100000, CFGFLAG_SERVER, "Console lines published over MQTT in a burst before sv_mqtt_console_rate applies")
+MACRO_CONFIG_INT(SvMQTTConsoleBatch, sv_mqtt_console_batch, 200, 0, 10000, CFGFLAG_SERVER, "Milliseconds to collect console lines into one MQTT message (0 to publish every line on its own)")
+MACRO_CONFIG_INT(SvMQTTRconRate, sv_mqtt_rcon_rate, 20, 0, 10000, CFGFLAG_SERVER, "Executed commands per second published over MQTT (0 for no limit)")
+MACRO_CONFIG_INT(SvMQTTRconBurst, sv_mqtt_rcon_burst, 500, 1, 100000, CFGFLAG_SERVER, "Executed commands published over MQTT in a burst before sv_mqtt_rcon_rate applies")
+MACRO_CONFIG_INT(SvMQTTCommandBudget, sv_mqtt_command_budget, 16, 1, 256, CFGFLAG_SERVER, "Maximum number of commands received over MQTT that are executed per tick")
+MACRO_CONFIG_INT(SvMQTTLoginTimeout, sv_mqtt_login_timeout, 10, 1, 120, CFGFLAG_SERVER, "Seconds to wait for the response to a login request")
+MACRO_CONFIG_INT(SvMQTTPlayerRate, sv_mqtt_player_rate, 5, 0, 1000, CFGFLAG_SERVER, "Publish changes of the players every this many ticks (0 to disable)")
+MACRO_CONFIG_INT(SvMQTTPlayerKeyframe, sv_mqtt_player_keyframe, 10, 1, 3600, CFGFLAG_SERVER, "Seconds between full player states on the player stream")
+MACRO_CONFIG_INT(SvMQTTSpoolSize, sv_mqtt_spool_size, 64, 0, 4096, CFGFLAG_SERVER, "Maximum size in MiB of the on-disk spool for MQTT messages while the broker is unreachable (0 to disable)")
+MACRO_CONFIG_INT(SvMQTTSpoolMaxAge, sv_mqtt_spool_max_age, 3600, 0, 604800, CFGFLAG_SERVER, "Discard spooled MQTT messages older than this many seconds (0 for no limit)")
+MACRO_CONFIG_INT(SvMQTTSpoolDrainRate, sv_mqtt_spool_drain_rate, 500, 1, 100000, CFGFLAG_SERVER, "Maximum number of spooled MQTT messages replayed per second after reconnecting")
 #endif
 
 MACRO_CONFIG_STR(SvName, sv_name, 128, "unnamed server", CFGFLAG_SERVER, "Server name")
@@ -434,6 +450,8 @@ MACRO_CONFIG_STR(SvMap, sv_map, 128, "Sunny Side Up", CFGFLAG_SERVER, "Map to us
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, MAX_CLIENTS, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIp, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvSnapshotThreads, sv_snapshot_threads, 1, 1, 16, CFGFLAG_SERVER, "Number of threads building the snapshots of the clients")
+MACRO_CONFIG_INT(SvSendBatching, sv_send_batching, 1, 0, 1, CFGFLAG_SERVER, "Send the packets of a tick together instead of one system call per packet (Linux only, needs restart)")
 MACRO_CONFIG_STR(SvRegister, sv_register, 16, "1", CFGFLAG_SERVER, "Register server with master server for public listing, can also accept a comma-separated list of protocols to register on, like 'ipv4,ipv6'")
 MACRO_CONFIG_STR(SvRegisterExtra, sv_register_extra, 256, "", CFGFLAG_SERVER, "Extra headers to send to the register endpoint, comma separated 'Header: Value' pairs")
 MACRO_CONFIG_STR(SvRegisterUrl, sv_register_url, 128, "https://master1.ddnet.org/ddnet/15/register", CFGFLAG_SERVER, "Masterserver URL to register to")
@@ -445,6 +463,7 @@ MACRO_CONFIG_INT(SvRconBantime, sv_rcon_bantime, 5, 0, 1440, CFGFLAG_SERVER, "Th
 MACRO_CONFIG_INT(SvAutoDemoRecord, sv_auto_demo_record, 0, 0, 1, CFGFLAG_SERVER, "Automatically record demos")
 MACRO_CONFIG_INT(SvAutoDemoMax, sv_auto_demo_max, 10, 0, 1000, CFGFLAG_SERVER, "Maximum number of automatically recorded demos (0 = no limit)")
 MACRO_CONFIG_INT(SvTeeHistorian, sv_tee_historian, 0, 0, 1, CFGFLAG_SERVER, "Activate the tee historian that writes complete gameplay data to disk (WARNING: This will use a lot of disk space)")
+MACRO_CONFIG_INT(SvTeeHistorianCompression, sv_tee_historian_compression, 0, 0, 9, CFGFLAG_SERVER, "Gzip compression level of the tee historian files, they get a .gz extension (0 = uncompressed)")
 MACRO_CONFIG_INT(SvVanillaAntiSpoof, sv_vanilla_antispoof, 1, 0, 1, CFGFLAG_SERVER, "Enable vanilla Antispoof")
 MACRO_CONFIG_INT(SvDnsbl, sv_dnsbl, 0, 0, 1, CFGFLAG_SERVER, "Enable DNSBL (DNS-based Blackhole List)")
 MACRO_CONFIG_STR(SvDnsblHost, sv_dnsbl_host, 128, "", CFGFLAG_SERVER, "Hostname of DNSBL provider to use for IP Verification")
@@ -534,6 +553,11 @@ MACRO_CONFIG_INT(SvSwap, sv_swap, 1, 0, 1, CFGFLAG_SERVER, "Enable /swap")
 MACRO_CONFIG_INT(SvTeam0Mode, sv_team0mode, 1, 0, 1, CFGFLAG_SERVER, "Enables /team0mode")
 MACRO_CONFIG_INT(SvUseSql, sv_use_sql, 0, 0, 1, CFGFLAG_SERVER, "Enables MySQL backend instead of SQLite backend (sv_sqlite_file is still used as fallback write server when no MySQL server is reachable)")
 MACRO_CONFIG_INT(SvSqlQueriesDelay, sv_sql_queries_delay, 1, 0, 20, CFGFLAG_SERVER, "Delay in seconds between SQL queries of a single player")
+MACRO_CONFIG_INT(SvSqlLeaderboardRefresh, sv_sql_leaderboard_refresh, 10, 0, 1440, CFGFLAG_SERVER, "Minutes after which the leaderboard of the map used by /rank and /top5 is reloaded to include finishes on other servers (0 = always query the database)")
+MACRO_CONFIG_INT(SvSqlReadWorkers, sv_sql_read_workers, 2, 1, 16, CFGFLAG_SERVER, "Number of threads executing the read queries (ranks, top5, player data) at the same time, takes effect on server start")
+MACRO_CONFIG_INT(SvSqlWriteBatch, sv_sql_write_batch, 32, 1, 1000, CFGFLAG_SERVER, "Maximum number of write queries (finishes, saves) executed in one transaction, takes effect on server start")
+MACRO_CONFIG_INT(SvSqlWriteBatchDelay, sv_sql_write_batch_delay, 10, 0, 1000, CFGFLAG_SERVER, "Milliseconds to wait for more write queries to execute them in one transaction, takes effect on server start")
+MACRO_CONFIG_INT(SvSqlCachedStatements, sv_sql_cached_statements, 16, 0, 1024, CFGFLAG_SERVER, "Number of prepared statements each database connection keeps for reuse, on MySQL they count against the server wide max_prepared_stmt_count (0 = prepare every statement again)")
 MACRO_CONFIG_STR(SvSqliteFile, sv_sqlite_file, 64, "ddnet-server.sqlite", CFGFLAG_SERVER, "File to store ranks in case sv_use_sql is turned off or used as backup sql server")
 
 #if defined(CONF_UPNP)
@@ -337,11 +337,7 @@ LOG_COLOR ColorToLogColor(ColorRGBA Color)
 void CConsole::Print(int Level, const char *pFrom, const char *pStr, ColorRGBA PrintColor) const
 {
 #ifdef CONF_MQTTSERVICES
-	json response;
-	response["level"] = Level;
-	response["from"] = pFrom;
-	response["str"] = pStr;
-	m_pMqtt->Publish(CHANNEL_CONSOLE, response);
+	m_pMqtt->PublishConsole(Level, pFrom, pStr);
 #endif
 
 	LEVEL LogLevel = IConsole::ToLogLevel(Level);
@@ -630,10 +626,7 @@ CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 void CConsole::ExecuteLine(const char *pStr, int ClientId, bool InterpretSemicolons)
 {
 #ifdef CONF_MQTTSERVICES
-	json response;
-	response["command"] = pStr;
-	response["clientid"] = ClientId;
-	m_pMqtt->Publish(CHANNEL_RCON, response);
+	m_pMqtt->PublishRcon(pStr, ClientId);
 #endif
 
 
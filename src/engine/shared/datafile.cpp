@@ -4,6 +4,7 @@
 #include "datafile.h"
 
 #include <base/hash_ctxt.h>
+#include <base/lock.h>
 #include <base/log.h>
 #include <base/math.h>
 #include <base/system.h>
@@ -13,6 +14,10 @@
 
 #include <cstdlib>
 #include <limits>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
 
 #include <zlib.h>
 
@@ -90,6 +95,14 @@ struct CDatafileInfo
 struct CDatafile
 {
 	IOHANDLE m_File;
+	// contents of the whole file, nullptr if it couldn't be mapped
+	const unsigned char *m_pMapped;
+	size_t m_MappedSize;
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	// the hashes are only computed when they are needed, which can happen
+	// on several threads at once, e.g. the map loader job and the MQTT
+	// thread
+	std::once_flag m_HashesOnce;
 	SHA256_DIGEST m_Sha256;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
@@ -100,41 +113,140 @@ struct CDatafile
 	char *m_pData;
 };
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+// Hashes of the files opened before, so opening the same map again, for
+// example on a map rotation, doesn't have to hash it again. Files are
+// recognized by their path, size and modification time.
+class CHashCache
 {
-	log_trace("datafile", "loading. filename='%s'", pFilename);
+	enum
+	{
+		MAX_ENTRIES = 256,
+		// a file that was modified this recently could be modified again
+		// within the same second, without the time changing
+		MIN_AGE = 2,
+	};
+
+	struct CEntry
+	{
+		size_t m_Size;
+		time_t m_Modified;
+		SHA256_DIGEST m_Sha256;
+		unsigned m_Crc;
+	};
+
+	CLock m_Lock;
+	std::unordered_map<std::string, CEntry> m_Entries GUARDED_BY(m_Lock);
+
+public:
+	bool Find(const char *pPath, size_t Size, SHA256_DIGEST *pSha256, unsigned *pCrc) REQUIRES(!m_Lock)
+	{
+		time_t Created, Modified;
+		if(fs_file_time(pPath, &Created, &Modified) != 0)
+			return false;
+		const CLockScope LockScope(m_Lock);
+		auto It = m_Entries.find(pPath);
+		if(It == m_Entries.end() || It->second.m_Size != Size || It->second.m_Modified != Modified)
+			return false;
+		*pSha256 = It->second.m_Sha256;
+		*pCrc = It->second.m_Crc;
+		return true;
+	}
 
-	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	void Add(const char *pPath, size_t Size, const SHA256_DIGEST &Sha256, unsigned Crc) REQUIRES(!m_Lock)
+	{
+		time_t Created, Modified;
+		if(fs_file_time(pPath, &Created, &Modified) != 0 || time(nullptr) - Modified < MIN_AGE)
+			return;
+		const CLockScope LockScope(m_Lock);
+		if(m_Entries.size() >= MAX_ENTRIES)
+			m_Entries.clear();
+		m_Entries[pPath] = CEntry{Size, Modified, Sha256, Crc};
+	}
+};
+
+static CHashCache s_HashCache;
+
+// Only call this through std::call_once on m_HashesOnce.
+static void UpdateHashes(CDatafile *pDataFile)
+{
+	if(pDataFile->m_pMapped && io_map_valid(pDataFile->m_File, pDataFile->m_MappedSize))
+	{
+		if(s_HashCache.Find(pDataFile->m_aPath, pDataFile->m_MappedSize, &pDataFile->m_Sha256, &pDataFile->m_Crc))
+			return;
+		pDataFile->m_Sha256 = sha256(pDataFile->m_pMapped, pDataFile->m_MappedSize);
+		pDataFile->m_Crc = crc32(0, pDataFile->m_pMapped, pDataFile->m_MappedSize);
+		s_HashCache.Add(pDataFile->m_aPath, pDataFile->m_MappedSize, pDataFile->m_Sha256, pDataFile->m_Crc);
+		return;
+	}
+
+	// use a handle of its own, the reader may be reading data from m_File
+	// on another thread
+	IOHANDLE File = io_open(pDataFile->m_aPath, IOFLAG_READ);
 	if(!File)
+		return;
+	const size_t Size = io_length(File);
+	if(s_HashCache.Find(pDataFile->m_aPath, Size, &pDataFile->m_Sha256, &pDataFile->m_Crc))
 	{
-		dbg_msg("datafile", "could not open '%s'", pFilename);
-		return false;
+		io_close(File);
+		return;
 	}
 
-	// take the CRC of the file and store it
+	enum
+	{
+		BUFFER_SIZE = 64 * 1024
+	};
+
+	SHA256_CTX Sha256Ctxt;
+	sha256_init(&Sha256Ctxt);
+	unsigned char aBuffer[BUFFER_SIZE];
 	unsigned Crc = 0;
-	SHA256_DIGEST Sha256;
+
+	while(true)
 	{
-		enum
-		{
-			BUFFER_SIZE = 64 * 1024
-		};
+		unsigned Bytes = io_read(File, aBuffer, BUFFER_SIZE);
+		if(Bytes == 0)
+			break;
+		Crc = crc32(Crc, aBuffer, Bytes);
+		sha256_update(&Sha256Ctxt, aBuffer, Bytes);
+	}
+	io_close(File);
+	pDataFile->m_Sha256 = sha256_finish(&Sha256Ctxt);
+	pDataFile->m_Crc = Crc;
 
-		SHA256_CTX Sha256Ctxt;
-		sha256_init(&Sha256Ctxt);
-		unsigned char aBuffer[BUFFER_SIZE];
+	s_HashCache.Add(pDataFile->m_aPath, Size, pDataFile->m_Sha256, pDataFile->m_Crc);
+}
 
-		while(true)
-		{
-			unsigned Bytes = io_read(File, aBuffer, BUFFER_SIZE);
-			if(Bytes == 0)
-				break;
-			Crc = crc32(Crc, aBuffer, Bytes);
-			sha256_update(&Sha256Ctxt, aBuffer, Bytes);
-		}
-		Sha256 = sha256_finish(&Sha256Ctxt);
+// Returns the raw data of the file, which points into the mapping if the
+// file is mapped. Otherwise the data is read into pBuffer, which must hold
+// Size bytes. Returns nullptr if the file is too short.
+static const void *FileData(CDatafile *pDataFile, int Index, unsigned Size, void *pBuffer)
+{
+	const int64_t Offset = (int64_t)pDataFile->m_DataStartOffset + pDataFile->m_Info.m_pDataOffsets[Index];
+	if(pDataFile->m_pMapped)
+	{
+		if(Offset < 0 || Offset + Size > (int64_t)pDataFile->m_MappedSize)
+			return nullptr;
+		// accessing the mapping of a file that was truncated since it was
+		// opened crashes with SIGBUS, so report it like a short read instead
+		if(!io_map_valid(pDataFile->m_File, Offset + Size))
+			return nullptr;
+		return pDataFile->m_pMapped + Offset;
+	}
+	if(io_seek(pDataFile->m_File, Offset, IOSEEK_START) != 0 || io_read(pDataFile->m_File, pBuffer, Size) != Size)
+		return nullptr;
+	return pBuffer;
+}
 
-		io_seek(File, 0, IOSEEK_START);
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	log_trace("datafile", "loading. filename='%s'", pFilename);
+
+	char aPath[IO_MAX_PATH_LENGTH];
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType, aPath, sizeof(aPath));
+	if(!File)
+	{
+		dbg_msg("datafile", "could not open '%s'", pFilename);
+		return false;
 	}
 
 	// TODO: change this header
@@ -181,15 +293,16 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
-	CDatafile *pTmpDataFile = (CDatafile *)malloc(AllocSize);
+	CDatafile *pTmpDataFile = new(malloc(AllocSize)) CDatafile;
 	pTmpDataFile->m_Header = Header;
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
 	pTmpDataFile->m_File = File;
-	pTmpDataFile->m_Sha256 = Sha256;
-	pTmpDataFile->m_Crc = Crc;
+	str_copy(pTmpDataFile->m_aPath, aPath);
+	pTmpDataFile->m_Sha256 = SHA256_ZEROED;
+	pTmpDataFile->m_Crc = 0;
 
 	// clear the data pointers and sizes
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
@@ -200,11 +313,17 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(ReadSize != Size)
 	{
 		io_close(pTmpDataFile->m_File);
+		pTmpDataFile->~CDatafile();
 		free(pTmpDataFile);
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
 		return false;
 	}
 
+	// the data is read from the mapping when it is needed, without copying
+	// the compressed data first. Files on network filesystems are not
+	// mapped and read as before.
+	pTmpDataFile->m_pMapped = static_cast<const unsigned char *>(io_map(File, &pTmpDataFile->m_MappedSize));
+
 	Close();
 	m_pDataFile = pTmpDataFile;
 
@@ -249,7 +368,9 @@ bool CDataFileReader::Close()
 		m_pDataFile->m_pDataSizes[i] = 0;
 	}
 
+	io_unmap((void *)m_pDataFile->m_pMapped, m_pDataFile->m_MappedSize);
 	io_close(m_pDataFile->m_File);
+	m_pDataFile->~CDatafile();
 	free(m_pDataFile);
 	m_pDataFile = nullptr;
 	return true;
@@ -342,13 +463,11 @@ void *CDataFileReader::GetDataImpl(int Index, bool Swap)
 			log_trace("datafile", "loading data. index=%d size=%u uncompressed=%u", Index, DataSize, OriginalUncompressedSize);
 
 			// read the compressed data
-			void *pCompressedData = malloc(DataSize);
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
-				ActualDataSize = io_read(m_pDataFile->m_File, pCompressedData, DataSize);
-			if(DataSize != ActualDataSize)
+			void *pCompressedData = m_pDataFile->m_pMapped ? nullptr : malloc(DataSize);
+			const void *pSource = FileData(m_pDataFile, Index, DataSize, pCompressedData);
+			if(!pSource)
 			{
-				log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u got=%u", Index, DataSize, ActualDataSize);
+				log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u", Index, DataSize);
 				free(pCompressedData);
 				m_pDataFile->m_ppDataPtrs[Index] = nullptr;
 				m_pDataFile->m_pDataSizes[Index] = -1;
@@ -358,7 +477,7 @@ void *CDataFileReader::GetDataImpl(int Index, bool Swap)
 			// decompress the data
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
 			m_pDataFile->m_pDataSizes[Index] = UncompressedSize;
-			const int Result = uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &UncompressedSize, (Bytef *)pCompressedData, DataSize);
+			const int Result = uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &UncompressedSize, (const Bytef *)pSource, DataSize);
 			free(pCompressedData);
 			if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
 			{
@@ -379,12 +498,12 @@ void *CDataFileReader::GetDataImpl(int Index, bool Swap)
 			log_trace("datafile", "loading data. index=%d size=%d", Index, DataSize);
 			m_pDataFile->m_ppDataPtrs[Index] = static_cast<char *>(malloc(DataSize));
 			m_pDataFile->m_pDataSizes[Index] = DataSize;
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
-				ActualDataSize = io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
-			if(DataSize != ActualDataSize)
+			const void *pSource = FileData(m_pDataFile, Index, DataSize, m_pDataFile->m_ppDataPtrs[Index]);
+			if(pSource && pSource != m_pDataFile->m_ppDataPtrs[Index])
+				mem_copy(m_pDataFile->m_ppDataPtrs[Index], pSource, DataSize);
+			if(!pSource)
 			{
-				log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u got=%u", Index, DataSize, ActualDataSize);
+				log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u", Index, DataSize);
 				free(m_pDataFile->m_ppDataPtrs[Index]);
 				m_pDataFile->m_ppDataPtrs[Index] = nullptr;
 				m_pDataFile->m_pDataSizes[Index] = -1;
@@ -596,6 +715,7 @@ SHA256_DIGEST CDataFileReader::Sha256() const
 		}
 		return Result;
 	}
+	std::call_once(m_pDataFile->m_HashesOnce, UpdateHashes, m_pDataFile);
 	return m_pDataFile->m_Sha256;
 }
 
@@ -603,6 +723,7 @@ unsigned CDataFileReader::Crc() const
 {
 	if(!m_pDataFile)
 		return 0xFFFFFFFF;
+	std::call_once(m_pDataFile->m_HashesOnce, UpdateHashes, m_pDataFile);
 	return m_pDataFile->m_Crc;
 }
 
@@ -75,7 +75,11 @@ bool CMap::Load(const char *pMapName)
 	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
 	if(!pStorage)
 		return false;
+	return Load(pStorage, pMapName);
+}
 
+bool CMap::Load(IStorage *pStorage, const char *pMapName)
+{
 	// Ensure current datafile is not left in an inconsistent state if loading fails,
 	// by loading the new datafile separately first.
 	CDataFileReader NewDataFile;
@@ -130,6 +134,13 @@ bool CMap::Load(const char *pMapName)
 	return true;
 }
 
+void CMap::Take(IEngineMap *pOther)
+{
+	CMap *pOtherMap = static_cast<CMap *>(pOther);
+	m_DataFile.Close();
+	m_DataFile = std::move(pOtherMap->m_DataFile);
+}
+
 void CMap::Unload()
 {
 	m_DataFile.Close();
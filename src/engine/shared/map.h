@@ -32,6 +32,8 @@ public:
 	int NumItems() const override;
 
 	bool Load(const char *pMapName) override;
+	bool Load(class IStorage *pStorage, const char *pMapName) override;
+	void Take(IEngineMap *pOther) override;
 	void Unload() override;
 	bool IsLoaded() const override;
 	IOHANDLE File() const override;
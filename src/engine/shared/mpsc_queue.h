@@ -0,0 +1,134 @@
+#ifndef ENGINE_SHARED_MPSC_QUEUE_H
+#define ENGINE_SHARED_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/**
+ * Bounded lock-free queue for many producer threads and a single consumer
+ * thread.
+ *
+ * All slots are allocated once up front, pushing and popping never allocates.
+ * Items are written and read in place through a callback so that large
+ * records don't have to be copied.
+ *
+ * @tparam T Type of the slots, must be default constructible.
+ * @tparam Capacity Number of slots, must be a power of two.
+ */
+template<typename T, size_t Capacity>
+class CMpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	struct CCell
+	{
+		std::atomic<size_t> m_Sequence;
+		T m_Data;
+	};
+
+	std::unique_ptr<CCell[]> m_pCells;
+	alignas(64) std::atomic<size_t> m_EnqueuePos;
+	alignas(64) std::atomic<size_t> m_DequeuePos;
+
+public:
+	CMpscQueue() :
+		m_pCells(new CCell[Capacity]),
+		m_EnqueuePos(0),
+		m_DequeuePos(0)
+	{
+		for(size_t i = 0; i < Capacity; i++)
+			m_pCells[i].m_Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	CMpscQueue(const CMpscQueue &Other) = delete;
+	CMpscQueue &operator=(const CMpscQueue &Other) = delete;
+
+	/**
+	 * Reserves a slot and lets the caller fill it.
+	 *
+	 * @param Fill Called with a reference to the reserved slot.
+	 *
+	 * @return `false` if the queue is full, `Fill` is not called in that case.
+	 *
+	 * @remark May be called from any thread.
+	 */
+	template<typename F>
+	bool TryPush(F &&Fill)
+	{
+		CCell *pCell;
+		size_t Pos = m_EnqueuePos.load(std::memory_order_relaxed);
+		while(true)
+		{
+			pCell = &m_pCells[Pos & (Capacity - 1)];
+			const size_t Sequence = pCell->m_Sequence.load(std::memory_order_acquire);
+			const ptrdiff_t Diff = (ptrdiff_t)Sequence - (ptrdiff_t)Pos;
+			if(Diff == 0)
+			{
+				if(m_EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if(Diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Pos = m_EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		Fill(pCell->m_Data);
+		pCell->m_Sequence.store(Pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Takes the oldest item out of the queue.
+	 *
+	 * @param Consume Called with a reference to the item. The slot is reused
+	 * afterwards, so anything that should be kept must be moved out.
+	 *
+	 * @return `false` if the queue is empty.
+	 *
+	 * @remark Must only be called from the consumer thread.
+	 */
+	template<typename F>
+	bool TryPop(F &&Consume)
+	{
+		const size_t Pos = m_DequeuePos.load(std::memory_order_relaxed);
+		CCell *pCell = &m_pCells[Pos & (Capacity - 1)];
+		const size_t Sequence = pCell->m_Sequence.load(std::memory_order_acquire);
+		if((ptrdiff_t)Sequence - (ptrdiff_t)(Pos + 1) < 0)
+			return false;
+		Consume(pCell->m_Data);
+		pCell->m_Sequence.store(Pos + Capacity, std::memory_order_release);
+		m_DequeuePos.store(Pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * Checks whether an item is ready to be popped.
+	 *
+	 * @remark Must only be called from the consumer thread.
+	 */
+	bool Empty() const
+	{
+		const size_t Pos = m_DequeuePos.load(std::memory_order_relaxed);
+		const CCell *pCell = &m_pCells[Pos & (Capacity - 1)];
+		return (ptrdiff_t)pCell->m_Sequence.load(std::memory_order_acquire) - (ptrdiff_t)(Pos + 1) < 0;
+	}
+
+	/**
+	 * Approximate number of items in the queue, may be called from any thread.
+	 */
+	size_t Size() const
+	{
+		const size_t Enqueued = m_EnqueuePos.load(std::memory_order_relaxed);
+		const size_t Dequeued = m_DequeuePos.load(std::memory_order_relaxed);
+		return Enqueued > Dequeued ? Enqueued - Dequeued : 0;
+	}
+
+	static constexpr size_t CAPACITY = Capacity;
+};
+
+#endif
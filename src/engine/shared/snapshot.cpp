@@ -611,50 +611,155 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 
 // CSnapshotStorage
 
+static constexpr size_t AlignSnapshotStorage(size_t Size)
+{
+	return (Size + alignof(int64_t) - 1) & ~(alignof(int64_t) - 1);
+}
+
+CSnapshotStorage::CSnapshotStorage() :
+	m_pFirstChunk(nullptr),
+	m_pLastChunk(nullptr),
+	m_pSpareChunks(nullptr),
+	m_NumSpareChunks(0),
+	m_NumChunks(0),
+	m_ChunkBytes(0)
+{
+	Init();
+}
+
+CSnapshotStorage::~CSnapshotStorage()
+{
+	PurgeAll();
+}
+
 void CSnapshotStorage::Init()
 {
 	m_pFirst = nullptr;
 	m_pLast = nullptr;
+
+	while(m_pFirstChunk)
+	{
+		CChunk *pNext = m_pFirstChunk->m_pNext;
+		RecycleChunk(m_pFirstChunk);
+		m_pFirstChunk = pNext;
+	}
+	m_pLastChunk = nullptr;
 }
 
 void CSnapshotStorage::PurgeAll()
+{
+	Init();
+
+	// nothing is going to be added for a while, give the memory back
+	while(m_pSpareChunks)
+	{
+		CChunk *pNext = m_pSpareChunks->m_pNext;
+		FreeChunk(m_pSpareChunks);
+		m_pSpareChunks = pNext;
+	}
+	m_NumSpareChunks = 0;
+}
+
+void CSnapshotStorage::PurgeUntil(int Tick)
 {
 	while(m_pFirst)
 	{
+		if(m_pFirst->m_Tick >= Tick)
+			return; // no more to remove
+
 		CHolder *pNext = m_pFirst->m_pNext;
-		free(m_pFirst->m_pSnap);
-		free(m_pFirst->m_pAltSnap);
-		free(m_pFirst);
+		FreeFirst();
 		m_pFirst = pNext;
+		if(m_pFirst)
+			m_pFirst->m_pPrev = nullptr;
 	}
+
+	// no more snapshots in storage
 	m_pLast = nullptr;
 }
 
-void CSnapshotStorage::PurgeUntil(int Tick)
+void *CSnapshotStorage::Allocate(size_t Size)
 {
-	CHolder *pHolder = m_pFirst;
+	if(m_pLastChunk && m_pLastChunk->m_Used + Size > m_pLastChunk->m_Size && m_pLastChunk->m_NumHolders == 0)
+	{
+		// an empty chunk is the only one, but too small
+		RecycleChunk(m_pLastChunk);
+		m_pFirstChunk = nullptr;
+		m_pLastChunk = nullptr;
+	}
 
-	while(pHolder)
+	if(!m_pLastChunk || m_pLastChunk->m_Used + Size > m_pLastChunk->m_Size)
 	{
-		CHolder *pNext = pHolder->m_pNext;
-		if(pHolder->m_Tick >= Tick)
-			return; // no more to remove
-		free(pHolder->m_pSnap);
-		free(pHolder->m_pAltSnap);
-		free(pHolder);
+		CChunk *pChunk = nullptr;
+		for(CChunk **ppSpare = &m_pSpareChunks; *ppSpare; ppSpare = &(*ppSpare)->m_pNext)
+		{
+			if((*ppSpare)->m_Size >= Size)
+			{
+				pChunk = *ppSpare;
+				*ppSpare = pChunk->m_pNext;
+				m_NumSpareChunks--;
+				break;
+			}
+		}
+		if(!pChunk)
+		{
+			const size_t ChunkSize = maximum<size_t>(CHUNK_SIZE, Size);
+			pChunk = static_cast<CChunk *>(malloc(sizeof(CChunk) + ChunkSize));
+			pChunk->m_Size = ChunkSize;
+			m_NumChunks++;
+			m_ChunkBytes += ChunkSize;
+		}
+		pChunk->m_pNext = nullptr;
+		pChunk->m_Used = 0;
+		pChunk->m_NumHolders = 0;
 
-		// did we come to the end of the list?
-		if(!pNext)
-			break;
+		if(m_pLastChunk)
+			m_pLastChunk->m_pNext = pChunk;
+		else
+			m_pFirstChunk = pChunk;
+		m_pLastChunk = pChunk;
+	}
 
-		m_pFirst = pNext;
-		pNext->m_pPrev = nullptr;
-		pHolder = pNext;
+	void *pData = m_pLastChunk->Data() + m_pLastChunk->m_Used;
+	m_pLastChunk->m_Used += Size;
+	m_pLastChunk->m_NumHolders++;
+	return pData;
+}
+
+void CSnapshotStorage::FreeFirst()
+{
+	// holders are purged in the order they were added, so the first one
+	// always lives in the first chunk
+	CChunk *pChunk = m_pFirstChunk;
+	if(--pChunk->m_NumHolders > 0)
+		return;
+
+	if(pChunk == m_pLastChunk)
+	{
+		pChunk->m_Used = 0;
+		return;
 	}
+	m_pFirstChunk = pChunk->m_pNext;
+	RecycleChunk(pChunk);
+}
 
-	// no more snapshots in storage
-	m_pFirst = nullptr;
-	m_pLast = nullptr;
+void CSnapshotStorage::RecycleChunk(CChunk *pChunk)
+{
+	if(m_NumSpareChunks >= MAX_SPARE_CHUNKS)
+	{
+		FreeChunk(pChunk);
+		return;
+	}
+	pChunk->m_pNext = m_pSpareChunks;
+	m_pSpareChunks = pChunk;
+	m_NumSpareChunks++;
+}
+
+void CSnapshotStorage::FreeChunk(CChunk *pChunk)
+{
+	m_NumChunks--;
+	m_ChunkBytes -= pChunk->m_Size;
+	free(pChunk);
 }
 
 void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const void *pData, size_t AltDataSize, const void *pAltData)
@@ -662,17 +767,21 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 	dbg_assert(DataSize <= (size_t)CSnapshot::MAX_SIZE, "Snapshot data size invalid");
 	dbg_assert(AltDataSize <= (size_t)CSnapshot::MAX_SIZE, "Alt snapshot data size invalid");
 
-	CHolder *pHolder = static_cast<CHolder *>(malloc(sizeof(CHolder)));
+	const size_t HolderSize = AlignSnapshotStorage(sizeof(CHolder));
+	const size_t SnapSize = AlignSnapshotStorage(DataSize);
+	unsigned char *pMem = static_cast<unsigned char *>(Allocate(HolderSize + SnapSize + AlignSnapshotStorage(AltDataSize)));
+
+	CHolder *pHolder = reinterpret_cast<CHolder *>(pMem);
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
 
-	pHolder->m_pSnap = static_cast<CSnapshot *>(malloc(DataSize));
+	pHolder->m_pSnap = reinterpret_cast<CSnapshot *>(pMem + HolderSize);
 	mem_copy(pHolder->m_pSnap, pData, DataSize);
 	pHolder->m_SnapSize = DataSize;
 
 	if(AltDataSize) // create alternative if wanted
 	{
-		pHolder->m_pAltSnap = static_cast<CSnapshot *>(malloc(AltDataSize));
+		pHolder->m_pAltSnap = reinterpret_cast<CSnapshot *>(pMem + HolderSize + SnapSize);
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
 	}
@@ -133,13 +133,55 @@ public:
 	CHolder *m_pFirst;
 	CHolder *m_pLast;
 
-	CSnapshotStorage() { Init(); }
-	~CSnapshotStorage() { PurgeAll(); }
+	CSnapshotStorage();
+	~CSnapshotStorage();
+	CSnapshotStorage(const CSnapshotStorage &Other) = delete;
+	CSnapshotStorage &operator=(const CSnapshotStorage &Other) = delete;
 	void Init();
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64_t Tagtime, size_t DataSize, const void *pData, size_t AltDataSize, const void *pAltData);
 	int Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const;
+
+	int NumChunks() const { return m_NumChunks; }
+	size_t ChunkBytes() const { return m_ChunkBytes; }
+
+private:
+	// Holders and their snapshots are stored back to back in chunks. They
+	// are always added at the end and purged from the front, so a chunk can
+	// be reused as soon as its last holder is purged. The chunks that are
+	// in use therefore form a ring that covers the stored ticks.
+	class CChunk
+	{
+	public:
+		CChunk *m_pNext;
+		size_t m_Size;
+		size_t m_Used;
+		int m_NumHolders;
+
+		unsigned char *Data() { return (unsigned char *)(this + 1); }
+	};
+
+	enum
+	{
+		CHUNK_SIZE = 64 * 1024,
+		MAX_SPARE_CHUNKS = 1,
+	};
+
+	// oldest chunk, contains m_pFirst
+	CChunk *m_pFirstChunk;
+	// chunk that new holders are added to
+	CChunk *m_pLastChunk;
+	// emptied chunks kept for reuse
+	CChunk *m_pSpareChunks;
+	int m_NumSpareChunks;
+	int m_NumChunks;
+	size_t m_ChunkBytes;
+
+	void *Allocate(size_t Size);
+	void FreeFirst();
+	void RecycleChunk(CChunk *pChunk);
+	void FreeChunk(CChunk *pChunk);
 };
 
 class CSnapshotBuilder
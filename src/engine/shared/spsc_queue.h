@@ -0,0 +1,102 @@
+#ifndef ENGINE_SHARED_SPSC_QUEUE_H
+#define ENGINE_SHARED_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer
+ * thread.
+ *
+ * Same interface as @link CMpscQueue @endlink, but without the per-slot
+ * sequence numbers and compare-exchange that multiple producers need.
+ *
+ * @tparam T Type of the slots, must be default constructible.
+ * @tparam Capacity Number of slots, must be a power of two.
+ */
+template<typename T, size_t Capacity>
+class CSpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	std::unique_ptr<T[]> m_pSlots;
+	alignas(64) std::atomic<size_t> m_WritePos;
+	alignas(64) std::atomic<size_t> m_ReadPos;
+
+public:
+	CSpscQueue() :
+		m_pSlots(new T[Capacity]),
+		m_WritePos(0),
+		m_ReadPos(0)
+	{
+	}
+
+	CSpscQueue(const CSpscQueue &Other) = delete;
+	CSpscQueue &operator=(const CSpscQueue &Other) = delete;
+
+	/**
+	 * Reserves a slot and lets the caller fill it.
+	 *
+	 * @param Fill Called with a reference to the reserved slot.
+	 *
+	 * @return `false` if the queue is full, `Fill` is not called in that case.
+	 *
+	 * @remark Must only be called from the producer thread.
+	 */
+	template<typename F>
+	bool TryPush(F &&Fill)
+	{
+		const size_t Pos = m_WritePos.load(std::memory_order_relaxed);
+		if(Pos - m_ReadPos.load(std::memory_order_acquire) >= Capacity)
+			return false;
+		Fill(m_pSlots[Pos & (Capacity - 1)]);
+		m_WritePos.store(Pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Takes the oldest item out of the queue.
+	 *
+	 * @param Consume Called with a reference to the item. The slot is reused
+	 * afterwards, so anything that should be kept must be moved out.
+	 *
+	 * @return `false` if the queue is empty.
+	 *
+	 * @remark Must only be called from the consumer thread.
+	 */
+	template<typename F>
+	bool TryPop(F &&Consume)
+	{
+		const size_t Pos = m_ReadPos.load(std::memory_order_relaxed);
+		if(Pos == m_WritePos.load(std::memory_order_acquire))
+			return false;
+		Consume(m_pSlots[Pos & (Capacity - 1)]);
+		m_ReadPos.store(Pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Checks whether an item is ready to be popped.
+	 *
+	 * @remark Must only be called from the consumer thread.
+	 */
+	bool Empty() const
+	{
+		return m_ReadPos.load(std::memory_order_relaxed) == m_WritePos.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Approximate number of items in the queue, may be called from any thread.
+	 */
+	size_t Size() const
+	{
+		const size_t Written = m_WritePos.load(std::memory_order_relaxed);
+		const size_t Read = m_ReadPos.load(std::memory_order_relaxed);
+		return Written > Read ? Written - Read : 0;
+	}
+
+	static constexpr size_t CAPACITY = Capacity;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "worker_pool.h"
+
+CWorkerPool::CWorkerPool() :
+	m_Generation(0),
+	m_NumBusy(0),
+	m_Shutdown(false),
+	m_pWork(nullptr),
+	m_NumItems(0),
+	m_NextItem(0)
+{
+}
+
+CWorkerPool::~CWorkerPool()
+{
+	Shutdown();
+}
+
+void CWorkerPool::Init(int NumThreads)
+{
+	Shutdown();
+
+	m_Shutdown = false;
+	for(int i = 1; i < NumThreads; i++)
+		m_vThreads.emplace_back([this, i]() { WorkerMain(i); });
+}
+
+void CWorkerPool::Shutdown()
+{
+	{
+		std::unique_lock Lock(m_Lock);
+		m_Shutdown = true;
+	}
+	m_WorkCv.notify_all();
+	for(auto &Thread : m_vThreads)
+		Thread.join();
+	m_vThreads.clear();
+	// new workers start waiting for the first generation again
+	m_Generation = 0;
+}
+
+void CWorkerPool::ProcessItems(int Thread)
+{
+	while(true)
+	{
+		const int Item = m_NextItem.fetch_add(1, std::memory_order_relaxed);
+		if(Item >= m_NumItems)
+			break;
+		(*m_pWork)(Item, Thread);
+	}
+}
+
+void CWorkerPool::WorkerMain(int Thread)
+{
+	uint64_t Generation = 0;
+	while(true)
+	{
+		{
+			std::unique_lock Lock(m_Lock);
+			m_WorkCv.wait(Lock, [&]() { return m_Shutdown || m_Generation != Generation; });
+			if(m_Shutdown)
+				return;
+			Generation = m_Generation;
+		}
+
+		ProcessItems(Thread);
+
+		std::unique_lock Lock(m_Lock);
+		if(--m_NumBusy == 0)
+			m_DoneCv.notify_one();
+	}
+}
+
+void CWorkerPool::Run(int NumItems, const std::function<void(int Item, int Thread)> &Work)
+{
+	if(NumItems <= 0)
+		return;
+
+	// not worth waking anybody up for
+	if(m_vThreads.empty() || NumItems == 1)
+	{
+		for(int i = 0; i < NumItems; i++)
+			Work(i, 0);
+		return;
+	}
+
+	{
+		std::unique_lock Lock(m_Lock);
+		m_pWork = &Work;
+		m_NumItems = NumItems;
+		m_NextItem.store(0, std::memory_order_relaxed);
+		m_NumBusy = m_vThreads.size();
+		m_Generation++;
+	}
+	m_WorkCv.notify_all();
+
+	ProcessItems(0);
+
+	// the workers still reference `Work` until they are done
+	std::unique_lock Lock(m_Lock);
+	m_DoneCv.wait(Lock, [this]() { return m_NumBusy == 0; });
+	m_pWork = nullptr;
+}
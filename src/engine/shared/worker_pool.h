@@ -0,0 +1,72 @@
+#ifndef ENGINE_SHARED_WORKER_POOL_H
+#define ENGINE_SHARED_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads that split one batch of work items between them
+ * and the calling thread.
+ *
+ * Unlike @link CJobPool @endlink, which runs independent jobs at some
+ * point in the future, @link Run @endlink blocks until every item of the
+ * batch is done. That makes it suitable for fanning out work that has to
+ * finish within the current tick.
+ */
+class CWorkerPool
+{
+public:
+	CWorkerPool();
+	~CWorkerPool();
+
+	CWorkerPool(const CWorkerPool &Other) = delete;
+	CWorkerPool &operator=(const CWorkerPool &Other) = delete;
+
+	/**
+	 * Starts the worker threads, stopping previous ones first.
+	 *
+	 * @param NumThreads Number of threads working on a batch, including
+	 * the thread calling @link Run @endlink. `1` doesn't start any threads.
+	 */
+	void Init(int NumThreads);
+	void Shutdown();
+
+	int NumThreads() const { return (int)m_vThreads.size() + 1; }
+
+	/**
+	 * Calls `Work` once for every item in `[0, NumItems)` and returns once
+	 * all calls returned.
+	 *
+	 * Items are handed out in ascending order to whichever thread is free.
+	 * `Thread` is in `[0, NumThreads())` and stays the same for all items
+	 * processed by the same thread during this call, `0` is the calling
+	 * thread.
+	 *
+	 * @remark Must not be called from multiple threads at once.
+	 */
+	void Run(int NumItems, const std::function<void(int Item, int Thread)> &Work);
+
+private:
+	std::vector<std::thread> m_vThreads;
+
+	std::mutex m_Lock;
+	std::condition_variable m_WorkCv;
+	std::condition_variable m_DoneCv;
+	uint64_t m_Generation;
+	int m_NumBusy;
+	bool m_Shutdown;
+
+	const std::function<void(int Item, int Thread)> *m_pWork;
+	int m_NumItems;
+	std::atomic<int> m_NextItem;
+
+	void WorkerMain(int Thread);
+	void ProcessItems(int Thread);
+};
+
+#endif
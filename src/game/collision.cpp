@@ -8,6 +8,7 @@
 
 #include <cmath>
 #include <engine/map.h>
+#include <limits>
 
 #include <game/collision.h>
 #include <game/layers.h>
@@ -36,6 +37,103 @@ vec2 ClampVel(int MoveRestriction, vec2 Vel)
 	return Vel;
 }
 
+// The line intersection functions test points on the line one pixel apart.
+// Each test only depends on the tiles the rounded point (and possibly a point
+// next to it) falls into, so only the first point in every tile has to be
+// tested. The points still have to be computed exactly like before to find
+// the same first point, so this finds the next tile by computing points and
+// not by intersecting the line with the tile borders.
+
+// Coordinate of the tile a rounded coordinate is in. Far outside of any map
+// every pixel is its own "tile" because converting the coordinates back to
+// float, like some of the tests do, loses precision there.
+static int TileCoord(int Value)
+{
+	if(Value >= (1 << 23) || Value <= -(1 << 23))
+		return Value;
+	return Value / 32;
+}
+
+class CLineTile
+{
+public:
+	int m_X;
+	int m_Y;
+	int m_OffsetX;
+	int m_OffsetY;
+
+	CLineTile(vec2 Pos, int OffsetX, int OffsetY)
+	{
+		const int x = round_to_int(Pos.x);
+		const int y = round_to_int(Pos.y);
+		m_X = TileCoord(x);
+		m_Y = TileCoord(y);
+		m_OffsetX = OffsetX ? TileCoord(x + OffsetX) : m_X;
+		m_OffsetY = OffsetY ? TileCoord(y + OffsetY) : m_Y;
+	}
+
+	bool operator==(const CLineTile &Other) const
+	{
+		return m_X == Other.m_X && m_Y == Other.m_Y && m_OffsetX == Other.m_OffsetX && m_OffsetY == Other.m_OffsetY;
+	}
+	bool operator!=(const CLineTile &Other) const { return !(*this == Other); }
+};
+
+// Index of the point where the rounded x coordinate probably reaches the
+// next tile, `Scale` converts fractions of the line to point indices.
+static double NextTileIndex(float Pos, float From, float To, double Scale)
+{
+	if(From == To)
+		return std::numeric_limits<double>::infinity();
+	const double Tile = std::floor((Pos + 0.5) / 32.0);
+	const double Border = To > From ? (Tile + 1) * 32.0 - 0.5 : Tile * 32.0 - 0.5;
+	return std::ceil((Border - From) / ((double)To - From) * Scale);
+}
+
+// Calls `Test` with the points `Point(0)` to `Point(Num - 1)`, skipping points
+// that are in the same tiles as the previous one, until it returns true. The
+// points must move along the line from `Pos0` to `Pos1`.
+//
+// Returns the index of that point or -1 if there is none.
+template<typename FPoint, typename FTest>
+static int FirstLineHit(int Num, vec2 Pos0, vec2 Pos1, double Scale, int OffsetX, int OffsetY, FPoint &&Point, FTest &&Test, int *pResult)
+{
+	int i = 0;
+	while(i < Num)
+	{
+		const vec2 Pos = Point(i);
+		if(Test(Pos, pResult))
+			return i;
+
+		// find the first point in another tile, the tiles of the points
+		// change monotonically so it can be searched for
+		const CLineTile Tile(Pos, OffsetX, OffsetY);
+		int Lo = i;
+		int Hi = Num;
+		const double Guess = minimum(NextTileIndex(Pos.x, Pos0.x, Pos1.x, Scale), NextTileIndex(Pos.y, Pos0.y, Pos1.y, Scale));
+		const int Next = Guess >= Num ? Num : Guess > i ? (int)Guess : i + 1;
+		for(int Probe : {Next - 1, Next})
+		{
+			if(Probe <= Lo || Probe >= Hi)
+				continue;
+			if(CLineTile(Point(Probe), OffsetX, OffsetY) == Tile)
+				Lo = Probe;
+			else
+				Hi = Probe;
+		}
+		while(Hi - Lo > 1)
+		{
+			const int Mid = Lo + (Hi - Lo) / 2;
+			if(CLineTile(Point(Mid), OffsetX, OffsetY) == Tile)
+				Lo = Mid;
+			else
+				Hi = Mid;
+		}
+		i = Hi;
+	}
+	return -1;
+}
+
 CCollision::CCollision()
 {
 	m_pDoor = nullptr;
@@ -326,30 +424,32 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
-// TODO: rewrite this smarter!
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
-	{
+	auto Point = [&](int i) {
 		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		return mix(Pos0, Pos1, a);
+	};
+	auto Test = [&](vec2 Pos, int *pHit) {
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
-
-		if(CheckPoint(ix, iy))
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
-		}
-
-		Last = Pos;
+		if(!CheckPoint(ix, iy))
+			return false;
+		*pHit = GetCollisionAt(ix, iy);
+		return true;
+	};
+	int Hit = 0;
+	int i = FirstLineHit(End + 1, Pos0, Pos1, End, 0, 0, Point, Test, &Hit);
+	if(i >= 0)
+	{
+		if(pOutCollision)
+			*pOutCollision = Point(i);
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = i > 0 ? Point(i - 1) : Pos0;
+		return Hit;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -362,13 +462,13 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
-	{
+	auto Point = [&](int i) {
 		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		return mix(Pos0, Pos1, a);
+	};
+	auto Test = [&](vec2 Pos, int *pHit) {
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
@@ -383,11 +483,8 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 		}
 		if(pTeleNr && *pTeleNr)
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return TILE_TELEINHOOK;
+			*pHit = TILE_TELEINHOOK;
+			return true;
 		}
 
 		int hit = 0;
@@ -400,16 +497,18 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 		{
 			hit = TILE_NOHOOK;
 		}
-		if(hit)
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return hit;
-		}
-
-		Last = Pos;
+		*pHit = hit;
+		return hit != 0;
+	};
+	int Hit = 0;
+	int i = FirstLineHit(End + 1, Pos0, Pos1, End, dx, dy, Point, Test, &Hit);
+	if(i >= 0)
+	{
+		if(pOutCollision)
+			*pOutCollision = Point(i);
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = i > 0 ? Point(i - 1) : Pos0;
+		return Hit;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -422,11 +521,11 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
-	{
+	auto Point = [&](int i) {
 		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		return mix(Pos0, Pos1, a);
+	};
+	auto Test = [&](vec2 Pos, int *pHit) {
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
@@ -441,23 +540,24 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 		}
 		if(pTeleNr && *pTeleNr)
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return TILE_TELEINWEAPON;
-		}
-
-		if(CheckPoint(ix, iy))
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
+			*pHit = TILE_TELEINWEAPON;
+			return true;
 		}
 
-		Last = Pos;
+		if(!CheckPoint(ix, iy))
+			return false;
+		*pHit = GetCollisionAt(ix, iy);
+		return true;
+	};
+	int Hit = 0;
+	int i = FirstLineHit(End + 1, Pos0, Pos1, End, 0, 0, Point, Test, &Hit);
+	if(i >= 0)
+	{
+		if(pOutCollision)
+			*pOutCollision = Point(i);
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = i > 0 ? Point(i - 1) : Pos0;
+		return Hit;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1156,26 +1256,32 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *pOffsetX, int *pOffsetY)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
-
-	for(int i = 0, id = std::ceil(d); i < id; i++)
-	{
+	auto Point = [&](int i) {
 		float a = i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		return mix(Pos0, Pos1, a);
+	};
+	auto Test = [&](vec2 Pos, int *pHit) {
 		int Nx = clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
 		int Ny = clamp(round_to_int(Pos.y) / 32, 0, m_Height - 1);
 		if(GetIndex(Nx, Ny) == TILE_SOLID || GetIndex(Nx, Ny) == TILE_NOHOOK || GetIndex(Nx, Ny) == TILE_NOLASER || GetFIndex(Nx, Ny) == TILE_NOLASER)
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
 			if(GetFIndex(Nx, Ny) == TILE_NOLASER)
-				return GetFCollisionAt(Pos.x, Pos.y);
+				*pHit = GetFCollisionAt(Pos.x, Pos.y);
 			else
-				return GetCollisionAt(Pos.x, Pos.y);
+				*pHit = GetCollisionAt(Pos.x, Pos.y);
+			return true;
 		}
-		Last = Pos;
+		return false;
+	};
+	int Hit = 0;
+	int i = FirstLineHit((int)std::ceil(d), Pos0, Pos1, d, 0, 0, Point, Test, &Hit);
+	if(i >= 0)
+	{
+		if(pOutCollision)
+			*pOutCollision = Point(i);
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = i > 0 ? Point(i - 1) : Pos0;
+		return Hit;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1187,24 +1293,30 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
-
-	for(int i = 0, id = std::ceil(d); i < id; i++)
-	{
+	auto Point = [&](int i) {
 		float a = (float)i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		return mix(Pos0, Pos1, a);
+	};
+	auto Test = [&](vec2 Pos, int *pHit) {
 		if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || IsFNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
 			if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
-				return GetCollisionAt(Pos.x, Pos.y);
+				*pHit = GetCollisionAt(Pos.x, Pos.y);
 			else
-				return GetFCollisionAt(Pos.x, Pos.y);
+				*pHit = GetFCollisionAt(Pos.x, Pos.y);
+			return true;
 		}
-		Last = Pos;
+		return false;
+	};
+	int Hit = 0;
+	int i = FirstLineHit((int)std::ceil(d), Pos0, Pos1, d, 0, 0, Point, Test, &Hit);
+	if(i >= 0)
+	{
+		if(pOutCollision)
+			*pOutCollision = Point(i);
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = i > 0 ? Point(i - 1) : Pos0;
+		return Hit;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1216,26 +1328,32 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
-
-	for(int i = 0, id = std::ceil(d); i < id; i++)
-	{
+	auto Point = [&](int i) {
 		float a = (float)i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		return mix(Pos0, Pos1, a);
+	};
+	auto Test = [&](vec2 Pos, int *pHit) {
 		if(IsSolid(round_to_int(Pos.x), round_to_int(Pos.y)) || (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y))))
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
 			if(!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y)))
-				return -1;
+				*pHit = -1;
 			else if(!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)))
-				return GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
+				*pHit = GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
 			else
-				return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
+				*pHit = GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
+			return true;
 		}
-		Last = Pos;
+		return false;
+	};
+	int Hit = 0;
+	int i = FirstLineHit((int)std::ceil(d), Pos0, Pos1, d, 0, 0, Point, Test, &Hit);
+	if(i >= 0)
+	{
+		if(pOutCollision)
+			*pOutCollision = Point(i);
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = i > 0 ? Point(i - 1) : Pos0;
+		return Hit;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
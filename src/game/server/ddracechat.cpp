@@ -2275,9 +2275,44 @@ void CGameContext::ConLogin(IConsole::IResult *pResult, void *pUserData)
 		return;
 	}
 
-	char loginToken[128];
-	str_format(loginToken, sizeof(loginToken), "%s", pResult->GetString(0));
-	pSelf->Mqtt()->RequestLogin(pPlayer->GetCid(), loginToken);
+	switch(pSelf->Mqtt()->RequestLogin(pPlayer->GetCid(), pResult->GetString(0)))
+	{
+	case MQTT_LOGIN_REQUESTED:
+		pSelf->SendChatTarget(pResult->m_ClientId, "Logging in...");
+		break;
+	case MQTT_LOGIN_PENDING:
+		pSelf->SendChatTarget(pResult->m_ClientId, "Your last login attempt is still being processed");
+		break;
+	case MQTT_LOGIN_UNAVAILABLE:
+		pSelf->SendChatTarget(pResult->m_ClientId, "Login is currently unavailable, try again later");
+		break;
+	default:
+		pSelf->SendChatTarget(pResult->m_ClientId, "Login failed");
+		break;
+	}
+}
+
+void CGameContext::OnMqttLogin(int ClientId, int Status, const char *pMessage)
+{
+	char aBuf[256];
+	switch(Status)
+	{
+	case MQTT_LOGIN_SUCCESS:
+		str_copy(aBuf, "Login successful");
+		break;
+	case MQTT_LOGIN_TIMEOUT:
+		str_copy(aBuf, "Login timed out, try again later");
+		break;
+	default:
+		str_copy(aBuf, "Login failed");
+		break;
+	}
+	if(pMessage[0] != '\0')
+	{
+		str_append(aBuf, ": ");
+		str_append(aBuf, pMessage);
+	}
+	SendChatTarget(ClientId, aBuf);
 }
 
 #endif
\ No newline at end of file
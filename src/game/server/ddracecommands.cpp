@@ -361,6 +361,7 @@ void CGameContext::Teleport(CCharacter *pChr, vec2 Pos)
 	pChr->SetPosition(Pos);
 	pChr->m_Pos = Pos;
 	pChr->m_PrevPos = Pos;
+	m_World.UpdateEntityPos(pChr);
 	pChr->m_DDRaceState = DDRACE_CHEAT;
 }
 
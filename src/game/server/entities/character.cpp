@@ -998,6 +998,34 @@ bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon)
 	return true;
 }
 
+void CCharacter::UpdateFaketuning()
+{
+	// solo, collision, jetpack and ninjajetpack prediction
+	int Faketuning = 0;
+	if(m_pPlayer->GetClientVersion() < VERSION_DDNET_NEW_HUD)
+	{
+		// frozen characters are shown with the ninja to old clients
+		const bool NinjaGraphic = m_Core.m_ActiveWeapon == WEAPON_NINJA || m_Core.m_DeepFrozen || m_FreezeTime > 0;
+		if(m_Core.m_Jetpack && !NinjaGraphic)
+			Faketuning |= FAKETUNE_JETPACK;
+		if(m_Core.m_Solo)
+			Faketuning |= FAKETUNE_SOLO;
+		if(m_Core.m_HammerHitDisabled)
+			Faketuning |= FAKETUNE_NOHAMMER;
+		if(m_Core.m_CollisionDisabled)
+			Faketuning |= FAKETUNE_NOCOLL;
+		if(m_Core.m_HookHitDisabled)
+			Faketuning |= FAKETUNE_NOHOOK;
+		if(!m_Core.m_EndlessJump && m_Core.m_Jumps == 0)
+			Faketuning |= FAKETUNE_NOJUMP;
+	}
+	if(Faketuning != m_NeededFaketuning)
+	{
+		m_NeededFaketuning = Faketuning;
+		GameServer()->SendTuningParams(m_pPlayer->GetCid(), m_TuneZone); // update tunings
+	}
+}
+
 //TODO: Move the emote stuff to a function
 void CCharacter::SnapCharacter(int SnappingClient, int Id)
 {
@@ -1026,32 +1054,6 @@ void CCharacter::SnapCharacter(int SnappingClient, int Id)
 			Weapon = WEAPON_NINJA;
 	}
 
-	// solo, collision, jetpack and ninjajetpack prediction
-	if(m_pPlayer->GetCid() == SnappingClient)
-	{
-		int Faketuning = 0;
-		if(m_pPlayer->GetClientVersion() < VERSION_DDNET_NEW_HUD)
-		{
-			if(m_Core.m_Jetpack && Weapon != WEAPON_NINJA)
-				Faketuning |= FAKETUNE_JETPACK;
-			if(m_Core.m_Solo)
-				Faketuning |= FAKETUNE_SOLO;
-			if(m_Core.m_HammerHitDisabled)
-				Faketuning |= FAKETUNE_NOHAMMER;
-			if(m_Core.m_CollisionDisabled)
-				Faketuning |= FAKETUNE_NOCOLL;
-			if(m_Core.m_HookHitDisabled)
-				Faketuning |= FAKETUNE_NOHOOK;
-			if(!m_Core.m_EndlessJump && m_Core.m_Jumps == 0)
-				Faketuning |= FAKETUNE_NOJUMP;
-		}
-		if(Faketuning != m_NeededFaketuning)
-		{
-			m_NeededFaketuning = Faketuning;
-			GameServer()->SendTuningParams(m_pPlayer->GetCid(), m_TuneZone); // update tunings
-		}
-	}
-
 	// change eyes, use ninja graphic and set ammo count if player has ninjajetpack
 	if(m_pPlayer->m_NinjaJetpack && m_Core.m_Jetpack && m_Core.m_ActiveWeapon == WEAPON_GUN && !m_Core.m_DeepFrozen && m_FreezeTime == 0 && !m_Core.m_HasTelegunGun)
 	{
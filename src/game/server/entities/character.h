@@ -43,6 +43,9 @@ public:
 
 	bool CanSnapCharacter(int SnappingClient);
 	bool IsSnappingCharacterInView(int SnappingClientId);
+	// Sends new tunings to the own client if its fake tunings changed, must
+	// not be done from Snap() which may run on several threads
+	void UpdateFaketuning();
 
 	bool IsGrounded();
 
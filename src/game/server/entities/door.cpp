@@ -81,3 +81,10 @@ void CDoor::Snap(int SnappingClient)
 	GameServer()->SnapLaserObject(CSnapContext(SnappingClientVersion), GetId(),
 		m_Pos, From, StartTick, -1, LASERTYPE_DOOR, 0, m_Number);
 }
+
+bool CDoor::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_To.x), minimum(m_Pos.y, m_To.y));
+	*pMax = vec2(maximum(m_Pos.x, m_To.x), maximum(m_Pos.y, m_To.y));
+	return true;
+}
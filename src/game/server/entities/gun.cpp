@@ -179,3 +179,10 @@ void CGun::Snap(int SnappingClient)
 	GameServer()->SnapLaserObject(CSnapContext(SnappingClientVersion), GetId(),
 		m_Pos, m_Pos, StartTick, -1, LASERTYPE_GUN, Subtype, m_Number);
 }
+
+bool CGun::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
@@ -33,6 +33,7 @@ CLaser::CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEner
 
 	GameWorld()->InsertEntity(this);
 	DoBounce();
+	GameWorld()->UpdateEntityPos(this);
 }
 
 bool CLaser::HitCharacter(vec2 From, vec2 To)
@@ -319,6 +320,13 @@ void CLaser::Snap(int SnappingClient)
 		m_Pos, m_From, m_EvalTick, m_Owner, LaserType, 0, m_Number);
 }
 
+bool CLaser::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_From.x), minimum(m_Pos.y, m_From.y));
+	*pMax = vec2(maximum(m_Pos.x, m_From.x), maximum(m_Pos.y, m_From.y));
+	return true;
+}
+
 void CLaser::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
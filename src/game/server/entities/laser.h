@@ -14,6 +14,7 @@ public:
 	virtual void Tick() override;
 	virtual void TickPaused() override;
 	virtual void Snap(int SnappingClient) override;
+	virtual bool GetSnapBounds(vec2 *pMin, vec2 *pMax) override;
 	virtual void SwapClients(int Client1, int Client2) override;
 
 	virtual int GetOwnerId() const override { return m_Owner; }
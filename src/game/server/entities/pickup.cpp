@@ -186,6 +186,13 @@ void CPickup::Snap(int SnappingClient)
 	GameServer()->SnapPickup(CSnapContext(SnappingClientVersion, Sixup), GetId(), m_Pos, m_Type, m_Subtype, m_Number);
 }
 
+bool CPickup::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
+
 void CPickup::Move()
 {
 	if(Server()->Tick() % (int)(Server()->TickSpeed() * 0.15f) == 0)
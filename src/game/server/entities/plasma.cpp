@@ -125,6 +125,13 @@ void CPlasma::Snap(int SnappingClient)
 		m_Pos, m_Pos, m_EvalTick, -1, LASERTYPE_PLASMA, Subtype, m_Number);
 }
 
+bool CPlasma::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
+
 void CPlasma::SwapClients(int Client1, int Client2)
 {
 	m_ForClientId = m_ForClientId == Client1 ? Client2 : m_ForClientId == Client2 ? Client1 : m_ForClientId;
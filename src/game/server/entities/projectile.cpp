@@ -361,6 +361,15 @@ void CProjectile::Snap(int SnappingClient)
 	}
 }
 
+bool CProjectile::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	// the same position Snap checks
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+	*pMin = GetPos(Ct);
+	*pMax = *pMin;
+	return true;
+}
+
 void CProjectile::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
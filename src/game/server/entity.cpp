@@ -22,6 +22,7 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+	m_InsertIndex = 0;
 }
 
 CEntity::~CEntity()
@@ -25,6 +25,9 @@ private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CSpatialGrid<CEntity>::CHandle m_GridHandle;
+	// entities inserted later come first in the list
+	uint64_t m_InsertIndex;
 
 	/* Identity */
 	CGameWorld *m_pGameWorld;
@@ -123,6 +126,22 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: GetSnapBounds
+			Called once before the snapshots of a tick are generated,
+			to only call Snap for the clients that can see the entity.
+
+		Arguments:
+			pMin - Receives the top left corner of the box.
+			pMax - Receives the bottom right corner of the box.
+
+		Returns:
+			True if Snap skips the entity for every client whose view
+			doesn't reach into the box, false if Snap has to be called
+			for every client.
+	*/
+	virtual bool GetSnapBounds(vec2 *pMin, vec2 *pMax) { return false; }
+
 	/*
 		Function: PostSnap
 			Called after all clients received their snapshot.
@@ -70,7 +70,7 @@ void CEventHandler::Snap(int SnappingClient)
 
 void CEventHandler::EventToSixup(int *pType, int *pSize, const char **ppData)
 {
-	static char s_aEventStore[128];
+	static thread_local char s_aEventStore[128];
 	if(*pType == NETEVENTTYPE_DAMAGEIND)
 	{
 		const CNetEvent_DamageInd *pEvent = (const CNetEvent_DamageInd *)(*ppData);
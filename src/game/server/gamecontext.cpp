@@ -1041,6 +1041,7 @@ void CGameContext::OnTick()
 
 	//if(world.paused) // make sure that the game object always updates
 	m_pController->Tick();
+	Score()->OnTick();
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
@@ -2145,12 +2146,7 @@ void CGameContext::OnSayNetMessage(const CNetMsg_Cl_Say *pMsg, int ClientId, con
 		Team = TEAM_ALL;
 
 	#ifdef CONF_MQTTSERVICES
-	json result;
-	result["cid"] = ClientId;
-	result["name"] = Server()->ClientName(ClientId);
-	result["message"] = pMsg->m_pMessage;
-	result["team"] = Team;
-	m_pMqtt->Publish(CHANNEL_CHAT, result);
+	m_pMqtt->PublishChat(ClientId, Server()->ClientName(ClientId), pMsg->m_pMessage, Team);
 	#endif
 
 	if(pMsg->m_pMessage[0] == '/')
@@ -2245,7 +2241,7 @@ void CGameContext::OnCallVoteNetMessage(const CNetMsg_Cl_CallVote *pMsg, int Cli
 	result["victim"] = str_comp_nocase(pMsg->m_pType, "option") == 0 ? "" : Server()->ClientName(str_toint(pMsg->m_pValue));
 	result["type"] = pMsg->m_pType;
 	result["aReason"] = aReason;
-	m_pMqtt->Publish(CHANNEL_VOTE, result);
+	m_pMqtt->Publish(CHANNEL_VOTE, std::move(result));
 	#endif
 
 	int Authed = Server()->GetAuthedState(ClientId);
@@ -2513,7 +2509,7 @@ void CGameContext::OnVoteNetMessage(const CNetMsg_Cl_Vote *pMsg, int ClientId)
 	result["cid"] = ClientId;
 	result["name"] = Server()->ClientName(ClientId);
 	result["vote"] = pMsg->m_Vote;
-	m_pMqtt->Publish(CHANNEL_VOTE, result);
+	m_pMqtt->Publish(CHANNEL_VOTE, std::move(result));
 	#endif
 
 	CNetMsg_Sv_YourVote Msg = {pMsg->m_Vote};
@@ -2771,7 +2767,7 @@ void CGameContext::OnChangeInfoNetMessage(const CNetMsg_Cl_ChangeInfo *pMsg, int
 	result["new"]["useCustomColor"] = pMsg->m_UseCustomColor;
 	result["new"]["colorBody"] = pMsg->m_ColorBody;
 	result["new"]["colorFeet"] = pMsg->m_ColorFeet;
-	m_pMqtt->Publish(CHANNEL_PLAYERINFO, result);
+	m_pMqtt->Publish(CHANNEL_PLAYERINFO, std::move(result));
 	#endif
 
 
@@ -3933,6 +3929,7 @@ void CGameContext::OnInit(const void *pPersistentData)
 
 	m_Layers.Init(Kernel());
 	m_Collision.Init(&m_Layers);
+	m_World.InitGrid(m_Collision.GetWidth(), m_Collision.GetHeight());
 	m_World.m_pTuningList = m_aTuningList;
 	m_World.m_Core.InitSwitchers(m_Collision.m_HighestSwitchNumber);
 
@@ -4025,7 +4022,7 @@ void CGameContext::OnInit(const void *pPersistentData)
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, g_Config.m_SvTeeHistorianCompression ? ".gz" : "");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -4038,7 +4035,15 @@ void CGameContext::OnInit(const void *pPersistentData)
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(THFile);
+		if(g_Config.m_SvTeeHistorianCompression)
+		{
+			m_pTeeHistorianCompression = std::make_unique<CTeeHistorianCompression>(g_Config.m_SvTeeHistorianCompression);
+			m_pTeeHistorianFile = aio_new_filtered(THFile, CTeeHistorianCompression::Filter, m_pTeeHistorianCompression.get());
+		}
+		else
+		{
+			m_pTeeHistorianFile = aio_new(THFile);
+		}
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -4216,8 +4221,12 @@ void CGameContext::DeleteTempfile()
 
 void CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
 {
+	// the map is loaded in the background, so the config belongs to the map
+	// that is loaded and not to the current sv_map
 	char aConfig[IO_MAX_PATH_LENGTH];
-	str_format(aConfig, sizeof(aConfig), "maps/%s.cfg", g_Config.m_SvMap);
+	const char *pExtension = str_endswith(pNewMapName, ".map");
+	str_truncate(aConfig, sizeof(aConfig), pNewMapName, pExtension ? pExtension - pNewMapName : str_length(pNewMapName));
+	str_append(aConfig, ".cfg");
 
 	CLineReader LineReader;
 	if(!LineReader.OpenFile(Storage()->OpenFile(aConfig, IOFLAG_READ, IStorage::TYPE_ALL)))
@@ -4328,7 +4337,12 @@ void CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
 	Writer.Finish();
 
 	str_copy(pNewMapName, aTemp, MapNameSize);
-	str_copy(m_aDeleteTempfile, aTemp, sizeof(m_aDeleteTempfile));
+}
+
+void CGameContext::OnMapTempfile(const char *pTempfile)
+{
+	DeleteTempfile();
+	str_copy(m_aDeleteTempfile, pTempfile, sizeof(m_aDeleteTempfile));
 }
 
 void CGameContext::OnShutdown(void *pPersistentData)
@@ -4354,6 +4368,13 @@ void CGameContext::OnShutdown(void *pPersistentData)
 			Server()->SetErrorShutdown("teehistorian close error");
 		}
 		aio_free(m_pTeeHistorianFile);
+		if(m_pTeeHistorianCompression)
+		{
+			const CTeeHistorianCompression *pCompression = m_pTeeHistorianCompression.get();
+			dbg_msg("teehistorian", "compressed %" PRId64 " to %" PRId64 " bytes (%.1f%%) in %.2f s", pCompression->InputSize(), pCompression->OutputSize(),
+				pCompression->InputSize() ? pCompression->OutputSize() * 100.0 / pCompression->InputSize() : 100.0, pCompression->CompressTime() / (double)time_freq());
+			m_pTeeHistorianCompression = nullptr;
+		}
 	}
 
 	// Stop any demos being recorded.
@@ -4431,7 +4452,15 @@ void CGameContext::OnSnap(int ClientId)
 	m_World.Snap(ClientId);
 	m_Events.Snap(ClientId);
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	for(CPlayer *pPlayer : m_apPlayers)
+	{
+		if(pPlayer && pPlayer->GetCharacter())
+			pPlayer->GetCharacter()->UpdateFaketuning();
+	}
+	m_World.PreSnap();
+}
 void CGameContext::OnPostSnap()
 {
 	m_World.PostSnap();
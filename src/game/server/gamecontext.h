@@ -106,6 +106,7 @@ class CGameContext : public IGameServer
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
 	ASYNCIO *m_pTeeHistorianFile;
+	std::unique_ptr<CTeeHistorianCompression> m_pTeeHistorianCompression;
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 	CPrng m_Prng;
@@ -181,6 +182,7 @@ public:
 	CTeeHistorian *TeeHistorian() { return &m_TeeHistorian; }
 	#ifdef CONF_MQTTSERVICES
 	IMqtt *Mqtt() { return m_pMqtt; }
+	void OnMqttLogin(int ClientId, int Status, const char *pMessage);
 	using json = nlohmann::json;
 	#endif
 	bool TeeHistorianActive() const { return m_TeeHistorianActive; }
@@ -305,6 +307,7 @@ public:
 	void RegisterDDRaceCommands();
 	void RegisterChatCommands();
 	void OnMapChange(char *pNewMapName, int MapNameSize) override;
+	void OnMapTempfile(const char *pTempfile) override;
 	void OnShutdown(void *pPersistentData) override;
 
 	void OnTick() override;
@@ -384,6 +384,7 @@ bool IGameController::OnEntity(int Index, int x, int y, int Layer, int Flags, bo
 	{
 		CPickup *pPickup = new CPickup(&GameServer()->m_World, Type, SubType, Layer, Number);
 		pPickup->m_Pos = Pos;
+		GameServer()->m_World.UpdateEntityPos(pPickup);
 		return true; // NOLINT(clang-analyzer-unix.Malloc)
 	}
 
@@ -140,7 +140,7 @@ void CGameControllerDDRace::OnPlayerConnect(CPlayer *pPlayer)
 		response["type"] = "join";
 		response["player"] = ClientId;
 		response["name"] = Server()->ClientName(ClientId);
-		GameServer()->Mqtt()->Publish(CHANNEL_INGAME, response);
+		GameServer()->Mqtt()->Publish(CHANNEL_INGAME, std::move(response));
 #endif
 
 		GameServer()->SendChatTarget(ClientId, "DDraceNetwork Mod. Version: " GAME_VERSION);
@@ -159,7 +159,7 @@ void CGameControllerDDRace::OnPlayerDisconnect(CPlayer *pPlayer, const char *pRe
 		response["type"] = "leave";
 		response["player"] = ClientId;
 		response["name"] = Server()->ClientName(ClientId);
-		GameServer()->Mqtt()->Publish(CHANNEL_INGAME, response);
+		GameServer()->Mqtt()->Publish(CHANNEL_INGAME, std::move(response));
 #endif
 	if(!GameServer()->PlayerModerating() && WasModerator)
 		GameServer()->SendChat(-1, TEAM_ALL, "Server kick/spec votes are no longer actively moderated.");
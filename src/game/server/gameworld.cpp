@@ -6,10 +6,12 @@
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
+#include "player.h"
 
 #include <engine/shared/config.h>
 
 #include <algorithm>
+#include <cmath>
 #include <utility>
 
 //////////////////////////////////////////////////
@@ -25,6 +27,8 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		pFirstEntityType = 0;
+	for(auto &MaxProximityRadius : m_aMaxProximityRadius)
+		MaxProximityRadius = 0.0f;
 }
 
 CGameWorld::~CGameWorld()
@@ -42,6 +46,14 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 	m_pServer = m_pGameServer->Server();
 }
 
+void CGameWorld::InitGrid(int Width, int Height)
+{
+	for(auto &Grid : m_aGrids)
+		Grid.Init(Width, Height);
+	m_SnapGrid.Init(Width, Height);
+	m_SnapGridValid = false;
+}
+
 CEntity *CGameWorld::FindFirst(int Type)
 {
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
@@ -53,7 +65,9 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	std::vector<CEntity *> vpCandidates;
+	FindCandidates(Type, Pos, Pos, Radius, vpCandidates);
+	for(CEntity *pEnt : vpCandidates)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
@@ -81,10 +95,18 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	pEnt->m_InsertIndex = m_NextInsertIndex++;
+	m_aGrids[pEnt->m_ObjType].Insert(pEnt, &pEnt->m_GridHandle, pEnt->m_Pos);
+	m_aMaxProximityRadius[pEnt->m_ObjType] = maximum(m_aMaxProximityRadius[pEnt->m_ObjType], pEnt->m_ProximityRadius);
+	m_SnapGridValid = false;
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
+	if(m_pCurrentEntity == pEnt)
+		m_pCurrentEntity = nullptr;
+
 	// not in the list
 	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
 		return;
@@ -103,34 +125,161 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+	m_aGrids[pEnt->m_ObjType].Remove(&pEnt->m_GridHandle);
+	m_SnapGridValid = false;
 }
 
-//
-void CGameWorld::Snap(int SnappingClient)
+void CGameWorld::UpdateEntityPos(CEntity *pEnt)
+{
+	// not in the world
+	if(!pEnt->m_GridHandle.IsInserted())
+		return;
+	m_aGrids[pEnt->m_ObjType].Move(pEnt, &pEnt->m_GridHandle, pEnt->m_Pos);
+}
+
+void CGameWorld::UpdateCurrentEntityPos()
+{
+	if(m_pCurrentEntity)
+		UpdateEntityPos(m_pCurrentEntity);
+	m_pCurrentEntity = nullptr;
+}
+
+void CGameWorld::SyncGrids()
 {
-	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
+	// catches entities that were moved without UpdateEntityPos, so a missed
+	// call only affects the queries until the next tick
+	int Missed = 0;
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			if(m_aGrids[i].Move(pEnt, &pEnt->m_GridHandle, pEnt->m_Pos))
+				Missed++;
+
+	if(Missed > 0 && !m_ReportedMissedUpdate)
 	{
-		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-		pEnt->Snap(SnappingClient);
-		pEnt = m_pNextTraverseEntity;
+		dbg_msg("gameworld", "%d entities moved without UpdateEntityPos", Missed);
+		m_ReportedMissedUpdate = true;
+	}
+}
+
+void CGameWorld::FindCandidates(int Type, vec2 Pos0, vec2 Pos1, float Radius, std::vector<CEntity *> &vpCandidates)
+{
+	const vec2 Min(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y));
+	const vec2 Max(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y));
+	// leave room for the rounding errors of the exact checks, they grow
+	// with the coordinates
+	const float Extent = maximum(maximum(absolute(Min.x), absolute(Min.y)), maximum(absolute(Max.x), absolute(Max.y)));
+	const float Margin = Radius + m_aMaxProximityRadius[Type] + 1.0f + Extent * 0.0001f;
+	const vec2 QueryMin = Min - vec2(Margin, Margin);
+	const vec2 QueryMax = Max + vec2(Margin, Margin);
+
+	vpCandidates.clear();
+	// visiting lots of mostly empty cells is slower than looking at every
+	// entity, e.g. for few characters and a large range
+	if(m_aGrids[Type].NumCells(QueryMin, QueryMax) > m_aGrids[Type].Size())
+	{
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			vpCandidates.push_back(pEnt);
+		return;
 	}
 
+	m_aGrids[Type].Query(QueryMin, QueryMax, [&](CEntity *pEnt) { vpCandidates.push_back(pEnt); });
+	// the results depend on the order of the entity list
+	std::sort(vpCandidates.begin(), vpCandidates.end(), [](const CEntity *pA, const CEntity *pB) {
+		return pA->m_InsertIndex > pB->m_InsertIndex;
+	});
+
+#ifdef CONF_DEBUG
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	{
+		if(pEnt->m_Pos.x >= QueryMin.x && pEnt->m_Pos.x <= QueryMax.x && pEnt->m_Pos.y >= QueryMin.y && pEnt->m_Pos.y <= QueryMax.y)
+			dbg_assert(std::find(vpCandidates.begin(), vpCandidates.end(), pEnt) != vpCandidates.end(), "entity moved without UpdateEntityPos");
+	}
+#endif
+}
+
+void CGameWorld::PreSnap()
+{
+	m_SnapGrid.Clear();
+	m_vpSnapAlways.clear();
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 	{
+		// characters check more than their position and are few anyway
 		if(i == ENTTYPE_CHARACTER)
 			continue;
 
-		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
 		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
-			pEnt = m_pNextTraverseEntity;
+			vec2 Min, Max;
+			if(pEnt->GetSnapBounds(&Min, &Max) && std::isfinite(Min.x) && std::isfinite(Min.y) && std::isfinite(Max.x) && std::isfinite(Max.y))
+				m_SnapGrid.Add(pEnt, Min, Max);
+			else
+				m_vpSnapAlways.push_back(pEnt);
+		}
+	}
+	m_SnapGrid.Build();
+	m_SnapGridValid = true;
+}
+
+// the area in which the entities can be seen by the client, false if it
+// sees everything
+static bool SnapView(const CPlayer *pPlayer, vec2 *pMin, vec2 *pMax)
+{
+	const vec2 View = pPlayer->m_ViewPos;
+	const vec2 ShowDistance = pPlayer->m_ShowDistance;
+	if(pPlayer->m_ShowAll || !std::isfinite(View.x) || !std::isfinite(View.y) || !std::isfinite(ShowDistance.x) || !std::isfinite(ShowDistance.y))
+		return false;
+
+	// NetworkClippedLine uses the larger distance for both axes, also
+	// leave room for the rounding errors of the exact checks
+	const float Distance = maximum(ShowDistance.x, ShowDistance.y);
+	const float Extent = maximum(absolute(View.x), absolute(View.y)) + absolute(Distance);
+	const float Range = Distance + 1.0f + Extent * 0.0001f;
+	*pMin = View - vec2(Range, Range);
+	*pMax = View + vec2(Range, Range);
+	return true;
+}
+
+//
+void CGameWorld::Snap(int SnappingClient)
+{
+	// snapping doesn't modify the world and may run on several threads at
+	// once, so don't use m_pNextTraverseEntity here
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		pEnt->Snap(SnappingClient);
+
+	vec2 ViewMin, ViewMax;
+	if(!m_SnapGridValid || SnappingClient == SERVER_DEMO_CLIENT || !SnapView(GameServer()->m_apPlayers[SnappingClient], &ViewMin, &ViewMax) ||
+		m_SnapGrid.NumCells(ViewMin, ViewMax) > m_SnapGrid.Size())
+	{
+		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			if(i == ENTTYPE_CHARACTER)
+				continue;
+
+			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+				pEnt->Snap(SnappingClient);
 		}
+		return;
 	}
+
+	// the entities outside of the view would not snap anything, skip them
+	static thread_local std::vector<CEntity *> s_vpEntities;
+	s_vpEntities.assign(m_vpSnapAlways.begin(), m_vpSnapAlways.end());
+	m_SnapGrid.Query(ViewMin, ViewMax, [](CEntity *pEnt) { s_vpEntities.push_back(pEnt); });
+	// keep the order of the entity lists, it decides which entities are
+	// dropped if the snapshot is full
+	std::sort(s_vpEntities.begin(), s_vpEntities.end(), [](const CEntity *pA, const CEntity *pB) {
+		if(pA->m_ObjType != pB->m_ObjType)
+			return pA->m_ObjType < pB->m_ObjType;
+		return pA->m_InsertIndex > pB->m_InsertIndex;
+	});
+	for(CEntity *pEnt : s_vpEntities)
+		pEnt->Snap(SnappingClient);
 }
 
 void CGameWorld::PostSnap()
 {
+	m_SnapGridValid = false;
 	for(auto *pEnt : m_apFirstEntityTypes)
 	{
 		for(; pEnt;)
@@ -149,7 +298,9 @@ void CGameWorld::Reset()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			m_pCurrentEntity = pEnt;
 			pEnt->Reset();
+			UpdateCurrentEntityPos();
 			pEnt = m_pNextTraverseEntity;
 		}
 	RemoveEntities();
@@ -209,6 +360,8 @@ void CGameWorld::Tick()
 	if(m_ResetRequested)
 		Reset();
 
+	SyncGrids();
+
 	if(!m_Paused)
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
@@ -225,7 +378,9 @@ void CGameWorld::Tick()
 				for(; pEnt;)
 				{
 					m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+					m_pCurrentEntity = pEnt;
 					((CCharacter *)pEnt)->PreTick();
+					UpdateCurrentEntityPos();
 					pEnt = m_pNextTraverseEntity;
 				}
 			}
@@ -234,7 +389,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pCurrentEntity = pEnt;
 				pEnt->Tick();
+				UpdateCurrentEntityPos();
 				pEnt = m_pNextTraverseEntity;
 			}
 		}
@@ -243,7 +400,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pCurrentEntity = pEnt;
 				pEnt->TickDeferred();
+				UpdateCurrentEntityPos();
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
@@ -254,7 +413,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pCurrentEntity = pEnt;
 				pEnt->TickPaused();
+				UpdateCurrentEntityPos();
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
@@ -304,9 +465,11 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	std::vector<CEntity *> vpCandidates;
+	FindCandidates(ENTTYPE_CHARACTER, Pos0, Pos1, Radius, vpCandidates);
+	for(CEntity *pEnt : vpCandidates)
 	{
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
 			continue;
 
@@ -342,9 +505,11 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	std::vector<CEntity *> vpCandidates;
+	FindCandidates(ENTTYPE_CHARACTER, Pos, Pos, Radius, vpCandidates);
+	for(CEntity *pEnt : vpCandidates)
 	{
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
 			continue;
 
@@ -365,9 +530,11 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	std::vector<CEntity *> vpCandidates;
+	FindCandidates(ENTTYPE_CHARACTER, Pos0, Pos1, Radius, vpCandidates);
+	for(CEntity *pEnt : vpCandidates)
 	{
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
 			continue;
 
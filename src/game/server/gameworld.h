@@ -6,6 +6,7 @@
 #include <game/gamecore.h>
 
 #include "save.h"
+#include "spatial_grid.h"
 
 #include <vector>
 
@@ -37,6 +38,25 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// entities of each type sorted by position, for the queries
+	CSpatialGrid<CEntity> m_aGrids[NUM_ENTTYPES];
+	float m_aMaxProximityRadius[NUM_ENTTYPES];
+	uint64_t m_NextInsertIndex = 0;
+	bool m_ReportedMissedUpdate = false;
+	// entity whose tick is running, reset if it is removed meanwhile
+	CEntity *m_pCurrentEntity = nullptr;
+
+	// entities that only some clients can see, sorted by their snap
+	// bounds once per snapshot tick
+	CSpatialBoxGrid<CEntity> m_SnapGrid;
+	std::vector<CEntity *> m_vpSnapAlways;
+	bool m_SnapGridValid = false;
+
+	// the entities of a type that may be close to the line, in list order
+	void FindCandidates(int Type, vec2 Pos0, vec2 Pos1, float Radius, std::vector<CEntity *> &vpCandidates);
+	void UpdateCurrentEntityPos();
+	void SyncGrids();
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -55,6 +75,16 @@ public:
 
 	void SetGameServer(CGameContext *pGameServer);
 
+	/*
+		Function: InitGrid
+			Sizes the grid used to find entities by position.
+
+		Arguments:
+			Width - Width of the map in tiles.
+			Height - Height of the map in tiles.
+	*/
+	void InitGrid(int Width, int Height);
+
 	CEntity *FindFirst(int Type);
 
 	/*
@@ -121,9 +151,28 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: UpdateEntityPos
+			Needs to be called after changing the position of an entity
+			from outside of its own tick, so that the queries find it at
+			the new position.
+
+		Arguments:
+			pEntity - Entity that moved
+	*/
+	void UpdateEntityPos(CEntity *pEntity);
+
 	void RemoveEntitiesFromPlayer(int PlayerId);
 	void RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers);
 
+	/*
+		Function: PreSnap
+			Called before the snapshots of a tick are created, sorts
+			the entities by what they snap so that Snap only has to
+			look at the entities a client can see.
+	*/
+	void PreSnap();
+
 	/*
 		Function: Snap
 			Calls Snap on all the entities in the world to create
@@ -191,6 +191,7 @@ bool CSaveTee::Load(CCharacter *pChr, int Team, bool IsSwap)
 
 	pChr->m_Pos = m_Pos;
 	pChr->m_PrevPos = m_PrevPos;
+	pChr->GameWorld()->UpdateEntityPos(pChr);
 	pChr->m_TeleCheckpoint = m_TeleCheckpoint;
 	pChr->m_LastPenalty = m_LastPenalty;
 
@@ -36,15 +36,40 @@ void CScore::ExecPlayerThread(
 	if(pResult == nullptr)
 		return;
 	auto Tmp = std::make_unique<CSqlPlayerRequest>(pResult);
-	str_copy(Tmp->m_aName, pName, sizeof(Tmp->m_aName));
-	str_copy(Tmp->m_aMap, Server()->GetMapName(), sizeof(Tmp->m_aMap));
-	str_copy(Tmp->m_aServer, g_Config.m_SvSqlServerName, sizeof(Tmp->m_aServer));
-	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientId), sizeof(Tmp->m_aRequestingPlayer));
-	Tmp->m_Offset = Offset;
-
+	InitPlayerRequest(Tmp.get(), ClientId, pName, Offset);
 	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
 }
 
+void CScore::InitPlayerRequest(CSqlPlayerRequest *pRequest, int ClientId, const char *pName, int Offset)
+{
+	str_copy(pRequest->m_aName, pName, sizeof(pRequest->m_aName));
+	str_copy(pRequest->m_aMap, Server()->GetMapName(), sizeof(pRequest->m_aMap));
+	str_copy(pRequest->m_aServer, g_Config.m_SvSqlServerName, sizeof(pRequest->m_aServer));
+	str_copy(pRequest->m_aRequestingPlayer, Server()->ClientName(ClientId), sizeof(pRequest->m_aRequestingPlayer));
+	pRequest->m_Offset = Offset;
+}
+
+bool CScore::ShowFromLeaderboard(
+	void (*pFuncPtr)(const CLeaderboard &, const CLeaderboard &, const CSqlPlayerRequest *, CScorePlayerResult *),
+	int ClientId,
+	const char *pName,
+	int Offset)
+{
+	if(!m_LeaderboardLoaded || g_Config.m_SvSqlLeaderboardRefresh == 0 || str_comp(m_aLeaderboardServer, g_Config.m_SvSqlServerName) != 0)
+		return false;
+
+	auto pResult = NewSqlPlayerResult(ClientId);
+	if(pResult == nullptr)
+		return true;
+	CSqlPlayerRequest Request(pResult);
+	InitPlayerRequest(&Request, ClientId, pName, Offset);
+	pFuncPtr(m_GlobalLeaderboard, m_RegionalLeaderboard, &Request, pResult.get());
+	// handed to the player like the result of a query
+	pResult->m_Success = true;
+	pResult->m_Completed = true;
+	return true;
+}
+
 bool CScore::RateLimitPlayer(int ClientId)
 {
 	CPlayer *pPlayer = GameServer()->m_apPlayers[ClientId];
@@ -71,8 +96,11 @@ void CScore::GeneratePassphrase(char *pBuf, int BufSize)
 CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	m_pPool(pPool),
 	m_pGameServer(pGameServer),
-	m_pServer(pGameServer->Server())
+	m_pServer(pGameServer->Server()),
+	m_LeaderboardLoaded(false),
+	m_LeaderboardLoadTick(-1)
 {
+	m_aLeaderboardServer[0] = '\0';
 	LoadBestTime();
 
 	uint64_t aSeed[2];
@@ -117,6 +145,48 @@ void CScore::LoadBestTime()
 	m_pPool->Execute(CScoreWorker::LoadBestTime, std::move(Tmp), "load best time");
 }
 
+void CScore::LoadLeaderboard()
+{
+	m_pLeaderboardResult = std::make_shared<CScoreLeaderboardResult>();
+	m_LeaderboardLoadTick = Server()->Tick();
+	m_vLeaderboardPending.clear();
+
+	auto Tmp = std::make_unique<CSqlLoadLeaderboardData>(m_pLeaderboardResult);
+	str_copy(Tmp->m_aMap, Server()->GetMapName(), sizeof(Tmp->m_aMap));
+	str_copy(Tmp->m_aServer, g_Config.m_SvSqlServerName, sizeof(Tmp->m_aServer));
+	m_pPool->Execute(CScoreWorker::LoadLeaderboard, std::move(Tmp), "load leaderboard");
+}
+
+void CScore::OnTick()
+{
+	if(m_pLeaderboardResult != nullptr && m_pLeaderboardResult->m_Completed)
+	{
+		if(m_pLeaderboardResult->m_Success)
+		{
+			m_GlobalLeaderboard = std::move(m_pLeaderboardResult->m_Global);
+			m_RegionalLeaderboard = std::move(m_pLeaderboardResult->m_Regional);
+			str_copy(m_aLeaderboardServer, m_pLeaderboardResult->m_aServer, sizeof(m_aLeaderboardServer));
+			for(const auto &[Name, Time] : m_vLeaderboardPending)
+			{
+				m_GlobalLeaderboard.Insert(Name.c_str(), Time);
+				m_RegionalLeaderboard.Insert(Name.c_str(), Time);
+			}
+			m_LeaderboardLoaded = true;
+		}
+		m_vLeaderboardPending.clear();
+		m_pLeaderboardResult = nullptr;
+	}
+
+	if(m_pLeaderboardResult != nullptr || g_Config.m_SvSqlLeaderboardRefresh == 0)
+		return;
+	if(m_LeaderboardLoadTick == -1 ||
+		Server()->Tick() > m_LeaderboardLoadTick + (int64_t)g_Config.m_SvSqlLeaderboardRefresh * 60 * Server()->TickSpeed() ||
+		(m_LeaderboardLoaded && str_comp(m_aLeaderboardServer, g_Config.m_SvSqlServerName) != 0))
+	{
+		LoadLeaderboard();
+	}
+}
+
 void CScore::LoadPlayerData(int ClientId, const char *pName)
 {
 	ExecPlayerThread(CScoreWorker::LoadPlayerData, "load player data", ClientId, pName, 0);
@@ -163,6 +233,15 @@ void CScore::SaveScore(int ClientId, int TimeTicks, const char *pTimestamp, cons
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCurrentTimeCp[i] = aTimeCp[i];
 
+	// finishes on this server always count for the regional ranks
+	if(m_LeaderboardLoaded)
+	{
+		m_GlobalLeaderboard.Insert(Tmp->m_aName, Tmp->m_Time);
+		m_RegionalLeaderboard.Insert(Tmp->m_aName, Tmp->m_Time);
+	}
+	if(m_pLeaderboardResult != nullptr)
+		m_vLeaderboardPending.emplace_back(Tmp->m_aName, Tmp->m_Time);
+
 	m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(Tmp), "save score");
 }
 
@@ -196,6 +275,8 @@ void CScore::ShowRank(int ClientId, const char *pName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
+	if(ShowFromLeaderboard(CScoreWorker::ShowRank, ClientId, pName, 0))
+		return;
 	ExecPlayerThread(CScoreWorker::ShowRank, "show rank", ClientId, pName, 0);
 }
 
@@ -210,6 +291,8 @@ void CScore::ShowTop(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
+	if(ShowFromLeaderboard(CScoreWorker::ShowTop, ClientId, "", Offset))
+		return;
 	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientId, "", Offset);
 }
 
@@ -27,6 +27,7 @@ class CScore
 
 	// returns new SqlResult bound to the player, if no current Thread is active for this player
 	std::shared_ptr<CScorePlayerResult> NewSqlPlayerResult(int ClientId);
+	void InitPlayerRequest(CSqlPlayerRequest *pRequest, int ClientId, const char *pName, int Offset);
 	// Creates for player database requests
 	void ExecPlayerThread(
 		bool (*pFuncPtr)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize),
@@ -38,12 +39,31 @@ class CScore
 	// returns true if the player should be rate limited
 	bool RateLimitPlayer(int ClientId);
 
+	// best times on the current map, answer /rank and /top5 once loaded
+	CLeaderboard m_GlobalLeaderboard;
+	CLeaderboard m_RegionalLeaderboard;
+	char m_aLeaderboardServer[5];
+	bool m_LeaderboardLoaded;
+	int m_LeaderboardLoadTick;
+	std::shared_ptr<CScoreLeaderboardResult> m_pLeaderboardResult;
+	// finishes while the leaderboard is loading, they might be missing from the result
+	std::vector<std::pair<std::string, float>> m_vLeaderboardPending;
+	void LoadLeaderboard();
+	// returns false if the leaderboard can't answer the request yet
+	bool ShowFromLeaderboard(
+		void (*pFuncPtr)(const CLeaderboard &, const CLeaderboard &, const CSqlPlayerRequest *, CScorePlayerResult *),
+		int ClientId,
+		const char *pName,
+		int Offset);
+
 public:
 	CScore(CGameContext *pGameServer, CDbConnectionPool *pPool);
 	~CScore() {}
 
 	CPlayerData *PlayerData(int Id) { return &m_aPlayerData[Id]; }
 
+	void OnTick();
+
 	void LoadBestTime();
 	void MapInfo(int ClientId, const char *pMapName);
 	void MapVote(int ClientId, const char *pMapName);
@@ -7,6 +7,7 @@
 #include <engine/server/sql_string_helpers.h>
 #include <engine/shared/config.h>
 
+#include <algorithm>
 #include <cmath>
 
 // "6b407e81-8b77-3e04-a207-8da17f37d000"
@@ -99,6 +100,81 @@ bool CTeamrank::SamePlayers(const std::vector<std::string> *pvSortedNames)
 	return true;
 }
 
+static bool CompareLeaderboardEntries(const CLeaderboard::CEntry &Left, const CLeaderboard::CEntry &Right)
+{
+	if(Left.m_Time != Right.m_Time)
+		return Left.m_Time < Right.m_Time;
+	return Left.m_Name < Right.m_Name;
+}
+
+void CLeaderboard::Clear()
+{
+	m_vEntries.clear();
+	m_BestTimes.clear();
+}
+
+void CLeaderboard::Add(const char *pName, float Time)
+{
+	auto [It, Inserted] = m_BestTimes.emplace(pName, Time);
+	if(!Inserted)
+		It->second = minimum(It->second, Time);
+}
+
+void CLeaderboard::Sort()
+{
+	m_vEntries.clear();
+	m_vEntries.reserve(m_BestTimes.size());
+	for(const auto &[Name, Time] : m_BestTimes)
+		m_vEntries.push_back({Time, Name});
+	std::sort(m_vEntries.begin(), m_vEntries.end(), CompareLeaderboardEntries);
+}
+
+void CLeaderboard::Insert(const char *pName, float Time)
+{
+	// same rounding as the database, so that the ranks don't change on the
+	// next load
+	char aTime[32];
+	str_format(aTime, sizeof(aTime), "%.2f", Time);
+	Time = str_tofloat(aTime);
+
+	auto [It, Inserted] = m_BestTimes.emplace(pName, Time);
+	if(!Inserted)
+	{
+		if(It->second <= Time)
+			return;
+		CEntry Old{It->second, pName};
+		m_vEntries.erase(std::lower_bound(m_vEntries.begin(), m_vEntries.end(), Old, CompareLeaderboardEntries));
+		It->second = Time;
+	}
+	CEntry New{Time, pName};
+	auto Pos = std::upper_bound(m_vEntries.begin(), m_vEntries.end(), New, CompareLeaderboardEntries);
+	m_vEntries.insert(Pos, std::move(New));
+}
+
+bool CLeaderboard::Find(const char *pName, float *pTime) const
+{
+	auto It = m_BestTimes.find(pName);
+	if(It == m_BestTimes.end())
+		return false;
+	*pTime = It->second;
+	return true;
+}
+
+int CLeaderboard::Rank(float Time) const
+{
+	auto It = std::partition_point(m_vEntries.begin(), m_vEntries.end(), [Time](const CEntry &Entry) {
+		return Entry.m_Time < Time;
+	});
+	return It - m_vEntries.begin() + 1;
+}
+
+float CLeaderboard::PercentRank(int Rank) const
+{
+	if(Size() <= 1)
+		return 0.0f;
+	return (double)(Rank - 1) / (Size() - 1);
+}
+
 bool CScoreWorker::LoadBestTime(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlLoadBestTimeData *>(pGameData);
@@ -128,6 +204,47 @@ bool CScoreWorker::LoadBestTime(IDbConnection *pSqlServer, const ISqlData *pGame
 	return false;
 }
 
+bool CScoreWorker::LoadLeaderboard(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlLoadLeaderboardData *>(pGameData);
+	auto *pResult = dynamic_cast<CScoreLeaderboardResult *>(pGameData->m_pResult.get());
+
+	str_copy(pResult->m_aServer, pData->m_aServer, sizeof(pResult->m_aServer));
+	char aServerLike[16];
+	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_aServer);
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, MIN(Time), MIN(CASE WHEN Server LIKE ? THEN Time END) "
+		"FROM %s_race "
+		"WHERE Map = ? "
+		"GROUP BY Name",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, aServerLike);
+	pSqlServer->BindString(2, pData->m_aMap);
+
+	bool End = false;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(1, aName, sizeof(aName));
+		pResult->m_Global.Add(aName, pSqlServer->GetFloat(2));
+		if(!pSqlServer->IsNull(3))
+			pResult->m_Regional.Add(aName, pSqlServer->GetFloat(3));
+	}
+	if(!End)
+	{
+		return true;
+	}
+	pResult->m_Global.Sort();
+	pResult->m_Regional.Sort();
+	return false;
+}
+
 // update stuff
 bool CScoreWorker::LoadPlayerData(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
@@ -575,32 +692,34 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 		"	cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, "
 		"	cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, "
 		"	GameId, DDNet7) "
-		"VALUES (?, ?, %s, %.2f, ?, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
+		"VALUES (?, ?, %s, ?, ?, "
+		"	?, ?, ?, ?, ?, ?, ?, ?, ?, "
+		"	?, ?, ?, ?, ?, ?, ?, ?, ?, "
+		"	?, ?, ?, ?, ?, ?, ?, "
 		"	?, %s)",
 		pSqlServer->InsertIgnore(), pSqlServer->GetPrefix(),
 		w == Write::NORMAL ? "" : "_backup",
-		pSqlServer->InsertTimestampAsUtc(), pData->m_Time,
-		pData->m_aCurrentTimeCp[0], pData->m_aCurrentTimeCp[1], pData->m_aCurrentTimeCp[2],
-		pData->m_aCurrentTimeCp[3], pData->m_aCurrentTimeCp[4], pData->m_aCurrentTimeCp[5],
-		pData->m_aCurrentTimeCp[6], pData->m_aCurrentTimeCp[7], pData->m_aCurrentTimeCp[8],
-		pData->m_aCurrentTimeCp[9], pData->m_aCurrentTimeCp[10], pData->m_aCurrentTimeCp[11],
-		pData->m_aCurrentTimeCp[12], pData->m_aCurrentTimeCp[13], pData->m_aCurrentTimeCp[14],
-		pData->m_aCurrentTimeCp[15], pData->m_aCurrentTimeCp[16], pData->m_aCurrentTimeCp[17],
-		pData->m_aCurrentTimeCp[18], pData->m_aCurrentTimeCp[19], pData->m_aCurrentTimeCp[20],
-		pData->m_aCurrentTimeCp[21], pData->m_aCurrentTimeCp[22], pData->m_aCurrentTimeCp[23],
-		pData->m_aCurrentTimeCp[24], pSqlServer->False());
+		pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
 	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
 	{
 		return true;
 	}
+	// the times are bound as text to store the same rounded values as
+	// literals in the query would, while the statement stays the same
+	char aTime[32];
+	char aaTimeCp[NUM_CHECKPOINTS][32];
+	str_format(aTime, sizeof(aTime), "%.2f", pData->m_Time);
 	pSqlServer->BindString(1, pData->m_aMap);
 	pSqlServer->BindString(2, pData->m_aName);
 	pSqlServer->BindString(3, pData->m_aTimestamp);
-	pSqlServer->BindString(4, g_Config.m_SvSqlServerName);
-	pSqlServer->BindString(5, pData->m_aGameUuid);
+	pSqlServer->BindString(4, aTime);
+	pSqlServer->BindString(5, g_Config.m_SvSqlServerName);
+	for(int i = 0; i < NUM_CHECKPOINTS; i++)
+	{
+		str_format(aaTimeCp[i], sizeof(aaTimeCp[i]), "%.2f", pData->m_aCurrentTimeCp[i]);
+		pSqlServer->BindString(6 + i, aaTimeCp[i]);
+	}
+	pSqlServer->BindString(6 + NUM_CHECKPOINTS, pData->m_aGameUuid);
 	pSqlServer->Print();
 	int NumInserted;
 	return pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize);
@@ -723,15 +842,18 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 			if(pData->m_Time < Time)
 			{
 				str_format(aBuf, sizeof(aBuf),
-					"UPDATE %s_teamrace SET Time=%.2f, Timestamp=%s, DDNet7=%s, GameId=? WHERE Id = ?",
-					pSqlServer->GetPrefix(), pData->m_Time, pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
+					"UPDATE %s_teamrace SET Time=?, Timestamp=%s, DDNet7=%s, GameId=? WHERE Id = ?",
+					pSqlServer->GetPrefix(), pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
 				if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
 				{
 					return true;
 				}
-				pSqlServer->BindString(1, pData->m_aTimestamp);
-				pSqlServer->BindString(2, pData->m_aGameUuid);
-				pSqlServer->BindBlob(3, Teamrank.m_TeamId.m_aData, sizeof(Teamrank.m_TeamId.m_aData));
+				char aTime[32];
+				str_format(aTime, sizeof(aTime), "%.2f", pData->m_Time);
+				pSqlServer->BindString(1, aTime);
+				pSqlServer->BindString(2, pData->m_aTimestamp);
+				pSqlServer->BindString(3, pData->m_aGameUuid);
+				pSqlServer->BindBlob(4, Teamrank.m_TeamId.m_aData, sizeof(Teamrank.m_TeamId.m_aData));
 				pSqlServer->Print();
 				int NumUpdated;
 				if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
@@ -745,15 +867,17 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 		}
 	}
 
+	char aTime[32];
+	str_format(aTime, sizeof(aTime), "%.2f", pData->m_Time);
 	for(unsigned int i = 0; i < pData->m_Size; i++)
 	{
 		// if no entry found... create a new one
 		str_format(aBuf, sizeof(aBuf),
 			"%s INTO %s_teamrace%s(Map, Name, Timestamp, Time, Id, GameId, DDNet7) "
-			"VALUES (?, ?, %s, %.2f, ?, ?, %s)",
+			"VALUES (?, ?, %s, ?, ?, ?, %s)",
 			pSqlServer->InsertIgnore(), pSqlServer->GetPrefix(),
 			w == Write::NORMAL ? "" : "_backup",
-			pSqlServer->InsertTimestampAsUtc(), pData->m_Time, pSqlServer->False());
+			pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
 		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
 		{
 			return true;
@@ -761,10 +885,11 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 		pSqlServer->BindString(1, pData->m_aMap);
 		pSqlServer->BindString(2, pData->m_aaNames[i]);
 		pSqlServer->BindString(3, pData->m_aTimestamp);
+		pSqlServer->BindString(4, aTime);
 		// copy uuid, because mysql BindBlob doesn't support const buffers
 		CUuid TeamrankId = pData->m_TeamrankUuid;
-		pSqlServer->BindBlob(4, TeamrankId.m_aData, sizeof(TeamrankId.m_aData));
-		pSqlServer->BindString(5, pData->m_aGameUuid);
+		pSqlServer->BindBlob(5, TeamrankId.m_aData, sizeof(TeamrankId.m_aData));
+		pSqlServer->BindString(6, pData->m_aGameUuid);
 		pSqlServer->Print();
 		int NumInserted;
 		if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
@@ -775,6 +900,48 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 	return false;
 }
 
+static void FormatRank(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult, int Rank, float Time, float PercentRank, const char *pRegionalRank)
+{
+	// CEIL and FLOOR are not supported in SQLite
+	int BetterThanPercent = std::floor(100.0f - 100.0f * PercentRank);
+	char aTime[32];
+	str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+	if(g_Config.m_SvHideScore)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"Your time: %s, better than %d%%", aTime, BetterThanPercent);
+	}
+	else
+	{
+		pResult->m_MessageKind = CScorePlayerResult::ALL;
+
+		if(str_comp_nocase(pData->m_aRequestingPlayer, pData->m_aName) == 0)
+		{
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%s - %s - better than %d%%",
+				pData->m_aName, aTime, BetterThanPercent);
+		}
+		else
+		{
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%s - %s - better than %d%% - requested by %s",
+				pData->m_aName, aTime, BetterThanPercent, pData->m_aRequestingPlayer);
+		}
+
+		if(g_Config.m_SvRegionalRankings)
+		{
+			str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+				"Global rank %d - %s %s",
+				Rank, pData->m_aServer, pRegionalRank);
+		}
+		else
+		{
+			str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+				"Global rank %d", Rank);
+		}
+	}
+}
+
 bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
@@ -839,45 +1006,7 @@ bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData
 
 	if(!End)
 	{
-		int Rank = pSqlServer->GetInt(1);
-		float Time = pSqlServer->GetFloat(2);
-		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0f - 100.0f * pSqlServer->GetFloat(3));
-		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-		if(g_Config.m_SvHideScore)
-		{
-			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-				"Your time: %s, better than %d%%", aBuf, BetterThanPercent);
-		}
-		else
-		{
-			pResult->m_MessageKind = CScorePlayerResult::ALL;
-
-			if(str_comp_nocase(pData->m_aRequestingPlayer, pData->m_aName) == 0)
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%%",
-					pData->m_aName, aBuf, BetterThanPercent);
-			}
-			else
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%% - requested by %s",
-					pData->m_aName, aBuf, BetterThanPercent, pData->m_aRequestingPlayer);
-			}
-
-			if(g_Config.m_SvRegionalRankings)
-			{
-				str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
-					"Global rank %d - %s %s",
-					Rank, pData->m_aServer, aRegionalRank);
-			}
-			else
-			{
-				str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
-					"Global rank %d", Rank);
-			}
-		}
+		FormatRank(pData, pResult, pSqlServer->GetInt(1), pSqlServer->GetFloat(2), pSqlServer->GetFloat(3), aRegionalRank);
 	}
 	else
 	{
@@ -970,6 +1099,13 @@ bool CScoreWorker::ShowTeamRank(IDbConnection *pSqlServer, const ISqlData *pGame
 	return false;
 }
 
+static void FormatTopLine(char *pBuf, int BufSize, int Rank, const char *pName, float Time)
+{
+	char aTime[32];
+	str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+	str_format(pBuf, BufSize, "%d. %s Time: %s", Rank, pName, aTime);
+}
+
 bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
@@ -1010,19 +1146,14 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
 	Line++;
 
-	char aTime[32];
 	bool End = false;
 
 	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
 	{
 		char aName[MAX_NAME_LENGTH];
 		pSqlServer->GetString(1, aName, sizeof(aName));
-		float Time = pSqlServer->GetFloat(2);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
-		int Rank = pSqlServer->GetInt(3);
-		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-			"%d. %s Time: %s", Rank, aName, aTime);
-
+		FormatTopLine(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+			pSqlServer->GetInt(3), aName, pSqlServer->GetFloat(2));
 		Line++;
 	}
 
@@ -1052,17 +1183,68 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	{
 		char aName[MAX_NAME_LENGTH];
 		pSqlServer->GetString(1, aName, sizeof(aName));
-		float Time = pSqlServer->GetFloat(2);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
-		int Rank = pSqlServer->GetInt(3);
-		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-			"%d. %s Time: %s", Rank, aName, aTime);
+		FormatTopLine(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+			pSqlServer->GetInt(3), aName, pSqlServer->GetFloat(2));
 		Line++;
 	}
 
 	return !End;
 }
 
+void CScoreWorker::ShowRank(const CLeaderboard &Global, const CLeaderboard &Regional, const CSqlPlayerRequest *pData, CScorePlayerResult *pResult)
+{
+	float Time;
+	char aRegionalRank[16];
+	if(Regional.Find(pData->m_aName, &Time))
+	{
+		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", Regional.Rank(Time));
+	}
+	else
+	{
+		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+	}
+
+	if(Global.Find(pData->m_aName, &Time))
+	{
+		int Rank = Global.Rank(Time);
+		FormatRank(pData, pResult, Rank, Time, Global.PercentRank(Rank), aRegionalRank);
+	}
+	else
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s is not ranked", pData->m_aName);
+	}
+}
+
+void CScoreWorker::ShowTop(const CLeaderboard &Global, const CLeaderboard &Regional, const CSqlPlayerRequest *pData, CScorePlayerResult *pResult)
+{
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+	int LimitStart = maximum(absolute(pData->m_Offset) - 1, 0);
+	bool Descending = pData->m_Offset < 0;
+
+	int Line = 0;
+	str_copy(paMessages[Line], "------------ Global Top ------------", sizeof(paMessages[Line]));
+	Line++;
+	Global.Top(LimitStart, 5, Descending, [&](int Rank, const char *pName, float Time) {
+		FormatTopLine(paMessages[Line], sizeof(paMessages[Line]), Rank, pName, Time);
+		Line++;
+	});
+
+	if(!g_Config.m_SvRegionalRankings)
+	{
+		str_copy(paMessages[Line], "-----------------------------------------", sizeof(paMessages[Line]));
+		return;
+	}
+
+	str_format(paMessages[Line], sizeof(paMessages[Line]),
+		"------------ %s Top ------------", pData->m_aServer);
+	Line++;
+	Regional.Top(LimitStart, 3, Descending, [&](int Rank, const char *pName, float Time) {
+		FormatTopLine(paMessages[Line], sizeof(paMessages[Line]), Rank, pName, Time);
+		Line++;
+	});
+}
+
 bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
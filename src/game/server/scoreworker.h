@@ -4,6 +4,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -83,6 +84,72 @@ struct CSqlLoadBestTimeData : ISqlData
 	char m_aMap[MAX_MAP_LENGTH];
 };
 
+// Best time of every player that finished a map, sorted to answer /rank
+// and /top5 without asking the database.
+class CLeaderboard
+{
+public:
+	struct CEntry
+	{
+		float m_Time;
+		std::string m_Name;
+	};
+
+	void Clear();
+	int Size() const { return m_vEntries.size(); }
+
+	// Adds a finish without keeping the entries sorted, faster when loading
+	// a whole map. Call Sort afterwards.
+	void Add(const char *pName, float Time);
+	void Sort();
+	// Adds a finish and keeps the entries sorted, only the best time of a
+	// player is kept.
+	void Insert(const char *pName, float Time);
+
+	// returns false if the player didn't finish the map
+	bool Find(const char *pName, float *pTime) const;
+	// 1 + the number of players that are faster, like RANK() OVER (ORDER BY Time)
+	int Rank(float Time) const;
+	// like PERCENT_RANK() OVER (ORDER BY Time)
+	float PercentRank(int Rank) const;
+
+	// Calls `Fn(Rank, pName, Time)` for up to Num entries, skipping the
+	// first Start ones. Starts with the slowest time if Descending.
+	template<typename F>
+	void Top(int Start, int Num, bool Descending, F &&Fn) const
+	{
+		for(int i = Start; i < Start + Num && i < Size(); i++)
+		{
+			const CEntry &Entry = m_vEntries[Descending ? Size() - 1 - i : i];
+			Fn(Rank(Entry.m_Time), Entry.m_Name.c_str(), Entry.m_Time);
+		}
+	}
+
+private:
+	// sorted by time, then name
+	std::vector<CEntry> m_vEntries;
+	std::unordered_map<std::string, float> m_BestTimes;
+};
+
+struct CScoreLeaderboardResult : ISqlResult
+{
+	CLeaderboard m_Global;
+	// only the finishes on servers whose name contains m_aServer
+	CLeaderboard m_Regional;
+	char m_aServer[5];
+};
+
+struct CSqlLoadLeaderboardData : ISqlData
+{
+	CSqlLoadLeaderboardData(std::shared_ptr<CScoreLeaderboardResult> pResult) :
+		ISqlData(std::move(pResult))
+	{
+	}
+
+	char m_aMap[MAX_MAP_LENGTH];
+	char m_aServer[5];
+};
+
 struct CSqlPlayerRequest : ISqlData
 {
 	CSqlPlayerRequest(std::shared_ptr<CScorePlayerResult> pResult) :
@@ -286,6 +353,7 @@ struct CTeamrank
 struct CScoreWorker
 {
 	static bool LoadBestTime(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool LoadLeaderboard(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 
 	static bool RandomMap(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 	static bool RandomUnfinishedMap(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
@@ -304,6 +372,10 @@ struct CScoreWorker
 	static bool ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 	static bool GetSaves(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 
+	// same messages as the queries above, from the loaded leaderboard of the map
+	static void ShowRank(const CLeaderboard &Global, const CLeaderboard &Regional, const CSqlPlayerRequest *pData, CScorePlayerResult *pResult);
+	static void ShowTop(const CLeaderboard &Global, const CLeaderboard &Regional, const CSqlPlayerRequest *pData, CScorePlayerResult *pResult);
+
 	static bool SaveTeam(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
 	static bool LoadTeam(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
 
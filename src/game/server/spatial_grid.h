@@ -0,0 +1,330 @@
+#ifndef GAME_SERVER_SPATIAL_GRID_H
+#define GAME_SERVER_SPATIAL_GRID_H
+
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <vector>
+
+// the cell a coordinate falls into, clamped to the grid
+inline int SpatialGridCell(float Value, int CellSize, int Num)
+{
+	const float Cell = Value / CellSize;
+	// also catches NaN
+	if(!(Cell >= 0.0f))
+		return 0;
+	if(Cell >= Num)
+		return Num - 1;
+	return (int)Cell;
+}
+
+/**
+ * Uniform grid over the map that sorts items by the cell their position
+ * falls into.
+ *
+ * Finding the items close to a point or a line only has to look at the
+ * cells around it instead of at every item. Positions outside of the map
+ * are clamped to the border cells, so every position belongs to exactly
+ * one cell.
+ *
+ * The grid does not know when an item moves, the owner has to call @link
+ * Move @endlink after changing its position.
+ */
+template<typename T>
+class CSpatialGrid
+{
+public:
+	enum
+	{
+		// size of a cell in tiles
+		CELL_TILES = 8,
+		CELL_SIZE = CELL_TILES * 32,
+	};
+
+	/**
+	 * Where an item is stored in the grid, kept by the owner of the item.
+	 */
+	class CHandle
+	{
+		friend CSpatialGrid;
+		int m_Cell = -1;
+		int m_Index = -1;
+
+	public:
+		bool IsInserted() const { return m_Cell != -1; }
+	};
+
+	CSpatialGrid() :
+		m_Width(1), m_Height(1), m_NumItems(0), m_vvCells(1)
+	{
+	}
+
+	/**
+	 * Resizes the grid to cover a map, keeps the inserted items.
+	 *
+	 * @param Width Width of the map in tiles.
+	 * @param Height Height of the map in tiles.
+	 */
+	void Init(int Width, int Height)
+	{
+		std::vector<std::vector<CItem>> vvOld;
+		vvOld.swap(m_vvCells);
+		m_Width = maximum(1, (Width + CELL_TILES - 1) / CELL_TILES);
+		m_Height = maximum(1, (Height + CELL_TILES - 1) / CELL_TILES);
+		m_vvCells.resize(m_Width * m_Height);
+		for(auto &vCell : vvOld)
+		{
+			for(auto &Item : vCell)
+			{
+				Item.m_pHandle->m_Cell = -1;
+				InsertIntoCell(Item.m_pItem, Item.m_pHandle, Item.m_Pos);
+			}
+		}
+	}
+
+	void Insert(T *pItem, CHandle *pHandle, vec2 Pos)
+	{
+		dbg_assert(!pHandle->IsInserted(), "item already inserted");
+		InsertIntoCell(pItem, pHandle, Pos);
+		m_NumItems++;
+	}
+
+	void Remove(CHandle *pHandle)
+	{
+		if(!pHandle->IsInserted())
+			return;
+		std::vector<CItem> &vCell = m_vvCells[pHandle->m_Cell];
+		if(pHandle->m_Index != (int)vCell.size() - 1)
+		{
+			vCell[pHandle->m_Index] = vCell.back();
+			vCell[pHandle->m_Index].m_pHandle->m_Index = pHandle->m_Index;
+		}
+		vCell.pop_back();
+		pHandle->m_Cell = -1;
+		pHandle->m_Index = -1;
+		m_NumItems--;
+	}
+
+	/**
+	 * Moves an item to the cell of its new position, cheap if it stays in
+	 * the same cell.
+	 *
+	 * @return `true` if the item changed cells.
+	 */
+	bool Move(T *pItem, CHandle *pHandle, vec2 Pos)
+	{
+		if(pHandle->IsInserted() && CellIndex(Pos) == pHandle->m_Cell)
+		{
+			m_vvCells[pHandle->m_Cell][pHandle->m_Index].m_Pos = Pos;
+			return false;
+		}
+		Remove(pHandle);
+		InsertIntoCell(pItem, pHandle, Pos);
+		m_NumItems++;
+		return true;
+	}
+
+	int Size() const { return m_NumItems; }
+
+	/**
+	 * @return The number of cells @link Query @endlink visits for the box.
+	 */
+	int NumCells(vec2 Min, vec2 Max) const
+	{
+		return (CellX(Max.x) - CellX(Min.x) + 1) * (CellY(Max.y) - CellY(Min.y) + 1);
+	}
+
+	/**
+	 * Calls `Fn` with every item in the cells the box overlaps.
+	 *
+	 * This is a superset of the items inside the box, in no particular
+	 * order.
+	 */
+	template<typename F>
+	void Query(vec2 Min, vec2 Max, F &&Fn) const
+	{
+		const int MinX = CellX(Min.x);
+		const int MaxX = CellX(Max.x);
+		const int MinY = CellY(Min.y);
+		const int MaxY = CellY(Max.y);
+		for(int y = MinY; y <= MaxY; y++)
+			for(int x = MinX; x <= MaxX; x++)
+				for(const CItem &Item : m_vvCells[y * m_Width + x])
+					Fn(Item.m_pItem);
+	}
+
+private:
+	class CItem
+	{
+	public:
+		T *m_pItem;
+		CHandle *m_pHandle;
+		vec2 m_Pos;
+	};
+
+	int m_Width;
+	int m_Height;
+	int m_NumItems;
+	std::vector<std::vector<CItem>> m_vvCells;
+
+	int CellX(float x) const { return SpatialGridCell(x, CELL_SIZE, m_Width); }
+	int CellY(float y) const { return SpatialGridCell(y, CELL_SIZE, m_Height); }
+	int CellIndex(vec2 Pos) const { return CellY(Pos.y) * m_Width + CellX(Pos.x); }
+
+	void InsertIntoCell(T *pItem, CHandle *pHandle, vec2 Pos)
+	{
+		std::vector<CItem> &vCell = m_vvCells[CellIndex(Pos)];
+		pHandle->m_Cell = CellIndex(Pos);
+		pHandle->m_Index = vCell.size();
+		vCell.push_back({pItem, pHandle, Pos});
+	}
+};
+
+/**
+ * Uniform grid over the map for items that cover a box, like lasers.
+ *
+ * Unlike @link CSpatialGrid @endlink it is filled from scratch: @link Add
+ * @endlink all items, then @link Build @endlink the grid before querying
+ * it. An item is stored in every cell its box overlaps. Queries don't
+ * modify the grid, so several threads can query it at once.
+ */
+template<typename T>
+class CSpatialBoxGrid
+{
+public:
+	enum
+	{
+		CELL_TILES = CSpatialGrid<T>::CELL_TILES,
+		CELL_SIZE = CSpatialGrid<T>::CELL_SIZE,
+	};
+
+	CSpatialBoxGrid() :
+		m_Width(1), m_Height(1), m_vCellStart(2, 0)
+	{
+	}
+
+	/**
+	 * Resizes the grid to cover a map and removes all items.
+	 *
+	 * @param Width Width of the map in tiles.
+	 * @param Height Height of the map in tiles.
+	 */
+	void Init(int Width, int Height)
+	{
+		m_Width = maximum(1, (Width + CELL_TILES - 1) / CELL_TILES);
+		m_Height = maximum(1, (Height + CELL_TILES - 1) / CELL_TILES);
+		Clear();
+	}
+
+	void Clear()
+	{
+		m_vItems.clear();
+		m_vEntries.clear();
+		m_vCellStart.assign(m_Width * m_Height + 1, 0);
+	}
+
+	/**
+	 * Adds an item, it is found by the queries after the next @link Build
+	 * @endlink.
+	 */
+	void Add(T *pItem, vec2 Min, vec2 Max)
+	{
+		CItem Item;
+		Item.m_pItem = pItem;
+		Item.m_Min = Min;
+		Item.m_Max = Max;
+		Item.m_MinX = CellX(Min.x);
+		Item.m_MinY = CellY(Min.y);
+		Item.m_MaxX = CellX(Max.x);
+		Item.m_MaxY = CellY(Max.y);
+		m_vItems.push_back(Item);
+	}
+
+	/**
+	 * Sorts the added items into the cells.
+	 */
+	void Build()
+	{
+		m_vCellStart.assign(m_Width * m_Height + 1, 0);
+		for(const CItem &Item : m_vItems)
+			for(int y = Item.m_MinY; y <= Item.m_MaxY; y++)
+				for(int x = Item.m_MinX; x <= Item.m_MaxX; x++)
+					m_vCellStart[y * m_Width + x + 1]++;
+		for(int i = 1; i < (int)m_vCellStart.size(); i++)
+			m_vCellStart[i] += m_vCellStart[i - 1];
+
+		m_vEntries.resize(m_vCellStart.back());
+		std::vector<int> vNext(m_vCellStart.begin(), m_vCellStart.end() - 1);
+		for(int i = 0; i < (int)m_vItems.size(); i++)
+		{
+			const CItem &Item = m_vItems[i];
+			for(int y = Item.m_MinY; y <= Item.m_MaxY; y++)
+				for(int x = Item.m_MinX; x <= Item.m_MaxX; x++)
+					m_vEntries[vNext[y * m_Width + x]++] = i;
+		}
+	}
+
+	int Size() const { return m_vItems.size(); }
+
+	/**
+	 * @return The number of cells @link Query @endlink visits for the box.
+	 */
+	int NumCells(vec2 Min, vec2 Max) const
+	{
+		return (CellX(Max.x) - CellX(Min.x) + 1) * (CellY(Max.y) - CellY(Min.y) + 1);
+	}
+
+	/**
+	 * Calls `Fn` once with every item whose box overlaps the given box, in
+	 * no particular order.
+	 */
+	template<typename F>
+	void Query(vec2 Min, vec2 Max, F &&Fn) const
+	{
+		const int MinX = CellX(Min.x);
+		const int MaxX = CellX(Max.x);
+		const int MinY = CellY(Min.y);
+		const int MaxY = CellY(Max.y);
+		for(int y = MinY; y <= MaxY; y++)
+		{
+			for(int x = MinX; x <= MaxX; x++)
+			{
+				const int Cell = y * m_Width + x;
+				for(int e = m_vCellStart[Cell]; e < m_vCellStart[Cell + 1]; e++)
+				{
+					const CItem &Item = m_vItems[m_vEntries[e]];
+					// only report it in the first cell both boxes share
+					if(x != maximum(Item.m_MinX, MinX) || y != maximum(Item.m_MinY, MinY))
+						continue;
+					if(Item.m_Min.x <= Max.x && Item.m_Max.x >= Min.x && Item.m_Min.y <= Max.y && Item.m_Max.y >= Min.y)
+						Fn(Item.m_pItem);
+				}
+			}
+		}
+	}
+
+private:
+	class CItem
+	{
+	public:
+		T *m_pItem;
+		vec2 m_Min;
+		vec2 m_Max;
+		int m_MinX;
+		int m_MinY;
+		int m_MaxX;
+		int m_MaxY;
+	};
+
+	int m_Width;
+	int m_Height;
+	std::vector<CItem> m_vItems;
+	// items of cell i are m_vEntries[m_vCellStart[i]] until m_vCellStart[i + 1]
+	std::vector<int> m_vCellStart;
+	std::vector<int> m_vEntries;
+
+	int CellX(float x) const { return SpatialGridCell(x, CELL_SIZE, m_Width); }
+	int CellY(float y) const { return SpatialGridCell(y, CELL_SIZE, m_Height); }
+};
+
+#endif // GAME_SERVER_SPATIAL_GRID_H
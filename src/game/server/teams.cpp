@@ -91,7 +91,7 @@ void CGameTeams::OnCharacterStart(int ClientId)
 			response["clientid"] = ClientId;
 			response["name"] = Server()->ClientName(ClientId);
 			response["team"] = GameServer()->GetDDRaceTeam(ClientId);
-			GameServer()->Mqtt()->Publish(CHANNEL_INGAME, response);
+			GameServer()->Mqtt()->Publish(CHANNEL_INGAME, std::move(response));
 		}
 #endif
 
@@ -178,7 +178,7 @@ void CGameTeams::OnCharacterStart(int ClientId)
 						response["clientid"] = i;
 						response["name"] = Server()->ClientName(i);
 						response["team"] = GameServer()->GetDDRaceTeam(i);
-						GameServer()->Mqtt()->Publish(CHANNEL_INGAME, response);
+						GameServer()->Mqtt()->Publish(CHANNEL_INGAME, std::move(response));
 					}
 #endif
 					SetDDRaceState(pPlayer, DDRACE_STARTED);
@@ -477,7 +477,7 @@ void CGameTeams::SetForceCharacterTeam(int ClientId, int Team)
 	response["clientid"] = ClientId;
 	response["name"] = Server()->ClientName(ClientId);
 	response["team"] = GameServer()->GetDDRaceTeam(ClientId);
-	GameServer()->Mqtt()->Publish(CHANNEL_INGAME, response);
+	GameServer()->Mqtt()->Publish(CHANNEL_INGAME, std::move(response));
 #endif
 }
 
@@ -802,7 +802,7 @@ void CGameTeams::OnFinish(CPlayer *Player, int TimeTicks, const char *pTimestamp
 	response["team"] = GameServer()->GetDDRaceTeam(ClientId);
 	response["timestamp"] = pTimestamp;
 	response["time"] = Time;
-	GameServer()->Mqtt()->Publish(CHANNEL_INGAME, response);
+	GameServer()->Mqtt()->Publish(CHANNEL_INGAME, std::move(response));
 #endif
 	if(!Server()->IsSixup(ClientId))
 	{
@@ -1201,7 +1201,7 @@ void CGameTeams::OnCharacterDeath(int ClientId, int Weapon)
 	response["clientid"] = ClientId;
 	response["name"] = Server()->ClientName(ClientId);
 	response["team"] = GameServer()->GetDDRaceTeam(ClientId);
-	GameServer()->Mqtt()->Publish(CHANNEL_INGAME, response);
+	GameServer()->Mqtt()->Publish(CHANNEL_INGAME, std::move(response));
 #endif
 }
 
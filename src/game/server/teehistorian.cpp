@@ -7,6 +7,8 @@
 #include <engine/shared/snapshot.h>
 #include <game/gamecore.h>
 
+#include <zlib.h>
+
 static const char TEEHISTORIAN_NAME[] = "teehistorian@ddnet.tw";
 static const CUuid TEEHISTORIAN_UUID = CalculateUuid(TEEHISTORIAN_NAME);
 static const char TEEHISTORIAN_VERSION[] = "2";
@@ -863,3 +865,56 @@ void CTeeHistorian::Finish()
 
 	Write(Buffer.Data(), Buffer.Size());
 }
+
+CTeeHistorianCompression::CTeeHistorianCompression(int Level) :
+	m_pStream(std::make_unique<z_stream_s>()),
+	m_vOutput(64 * 1024),
+	m_LastFlush(time_get_impl()),
+	m_InputSize(0),
+	m_OutputSize(0),
+	m_CompressTime(0)
+{
+	mem_zero(m_pStream.get(), sizeof(*m_pStream));
+	// 15 bits window, +16 for the gzip header
+	int Result = deflateInit2(m_pStream.get(), Level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+	dbg_assert(Result == Z_OK, "failed to initialize teehistorian compression");
+}
+
+CTeeHistorianCompression::~CTeeHistorianCompression()
+{
+	deflateEnd(m_pStream.get());
+}
+
+void CTeeHistorianCompression::Filter(IOHANDLE File, const void *pData, unsigned Size, void *pUser)
+{
+	CTeeHistorianCompression *pSelf = (CTeeHistorianCompression *)pUser;
+	const int64_t Start = time_get_impl();
+	int Flush = Z_NO_FLUSH;
+	if(pData == nullptr)
+	{
+		Flush = Z_FINISH;
+	}
+	else if(Start - pSelf->m_LastFlush >= FLUSH_INTERVAL * time_freq())
+	{
+		Flush = Z_SYNC_FLUSH;
+		pSelf->m_LastFlush = Start;
+	}
+	pSelf->Compress(File, pData, Size, Flush);
+	pSelf->m_InputSize += Size;
+	pSelf->m_CompressTime += time_get_impl() - Start;
+}
+
+void CTeeHistorianCompression::Compress(IOHANDLE File, const void *pData, unsigned Size, int Flush)
+{
+	m_pStream->next_in = (Bytef *)pData;
+	m_pStream->avail_in = Size;
+	do
+	{
+		m_pStream->next_out = m_vOutput.data();
+		m_pStream->avail_out = m_vOutput.size();
+		deflate(m_pStream.get(), Flush);
+		const unsigned Compressed = m_vOutput.size() - m_pStream->avail_out;
+		io_write(File, m_vOutput.data(), Compressed);
+		m_OutputSize += Compressed;
+	} while(m_pStream->avail_out == 0);
+}
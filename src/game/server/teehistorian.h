@@ -2,15 +2,19 @@
 #define GAME_SERVER_TEEHISTORIAN_H
 
 #include <base/hash.h>
+#include <base/types.h>
 #include <engine/console.h>
 #include <engine/shared/protocol.h>
 #include <game/generated/protocol.h>
 
 #include <ctime>
+#include <memory>
+#include <vector>
 
 class CConfig;
 class CTuningParams;
 class CUuidManager;
+struct z_stream_s;
 
 class CTeeHistorian
 {
@@ -148,4 +152,37 @@ private:
 	CTeam m_aPrevTeams[MAX_CLIENTS];
 };
 
+// Gzip stream of the teehistorian file, used as the filter of its ASYNCIO
+// handle so that the data is compressed on the writer thread. The stream
+// is flushed every FLUSH_INTERVAL seconds, so that a file that wasn't
+// finished can still be decompressed up to the last flush.
+class CTeeHistorianCompression
+{
+public:
+	enum
+	{
+		FLUSH_INTERVAL = 1,
+	};
+
+	explicit CTeeHistorianCompression(int Level);
+	~CTeeHistorianCompression();
+
+	static void Filter(IOHANDLE File, const void *pData, unsigned Size, void *pUser);
+
+	// only to be read after the writer thread is done
+	int64_t InputSize() const { return m_InputSize; }
+	int64_t OutputSize() const { return m_OutputSize; }
+	int64_t CompressTime() const { return m_CompressTime; }
+
+private:
+	void Compress(IOHANDLE File, const void *pData, unsigned Size, int Flush);
+
+	std::unique_ptr<z_stream_s> m_pStream;
+	std::vector<unsigned char> m_vOutput;
+	int64_t m_LastFlush;
+	int64_t m_InputSize;
+	int64_t m_OutputSize;
+	int64_t m_CompressTime;
+};
+
 #endif // GAME_SERVER_TEEHISTORIAN_H
@@ -144,3 +144,60 @@ TEST_F(Async, Transaction)
 	}
 	Expect(aText);
 }
+
+class AsyncFilter : public Async
+{
+protected:
+	void SetUp() override
+	{
+		IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+		m_pAio = aio_new_filtered(File, Upper, nullptr);
+		Delete = false;
+	}
+
+	// writes the data in upper case and a marker once the file is closed
+	static void Upper(IOHANDLE File, const void *pData, unsigned Size, void *pUser)
+	{
+		if(!pData)
+		{
+			io_write(File, "!", 1);
+			return;
+		}
+		for(unsigned i = 0; i < Size; i++)
+		{
+			char c = str_uppercase(((const char *)pData)[i]);
+			io_write(File, &c, 1);
+		}
+	}
+};
+
+TEST_F(AsyncFilter, Empty)
+{
+	Expect("!");
+}
+
+TEST_F(AsyncFilter, Simple)
+{
+	Write("abc\n");
+	Write("def");
+	Expect("ABC\nDEF!");
+}
+
+TEST_F(AsyncFilter, Long)
+{
+	char aText[BUF_SIZE];
+	for(unsigned i = 0; i < sizeof(aText) - 2; i++)
+	{
+		aText[i] = 'a' + i % 26;
+	}
+	aText[sizeof(aText) - 2] = 0;
+	Write(aText);
+	for(unsigned i = 0; i < sizeof(aText) - 2; i++)
+	{
+		aText[i] = 'A' + i % 26;
+	}
+	aText[sizeof(aText) - 2] = '!';
+	aText[sizeof(aText) - 1] = 0;
+	Expect(aText);
+}
@@ -0,0 +1,492 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+#include <game/prng.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// the implementations that tested every pixel of the line, the new ones
+// must return exactly the same
+
+static int OldIntersectLine(const CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		if(pCollision->CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return pCollision->GetCollisionAt(ix, iy);
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int OldIntersectLineTeleHook(const CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int dx = 0, dy = 0;
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = pCollision->GetPureMapIndex(Pos);
+		if(pTeleNr)
+		{
+			if(g_Config.m_SvOldTeleportHook)
+				*pTeleNr = pCollision->IsTeleport(Index);
+			else
+				*pTeleNr = pCollision->IsTeleportHook(Index);
+		}
+		if(pTeleNr && *pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int hit = 0;
+		if(pCollision->CheckPoint(ix, iy))
+		{
+			if(!pCollision->IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				hit = pCollision->GetCollisionAt(ix, iy);
+		}
+		else if(pCollision->IsHookBlocker(ix, iy, Pos0, Pos1))
+		{
+			hit = TILE_NOHOOK;
+		}
+		if(hit)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return hit;
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int OldIntersectLineTeleWeapon(const CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = pCollision->GetPureMapIndex(Pos);
+		if(pTeleNr)
+		{
+			if(g_Config.m_SvOldTeleportWeapons)
+				*pTeleNr = pCollision->IsTeleport(Index);
+			else
+				*pTeleNr = pCollision->IsTeleportWeapon(Index);
+		}
+		if(pTeleNr && *pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINWEAPON;
+		}
+
+		if(pCollision->CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return pCollision->GetCollisionAt(ix, iy);
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int OldIntersectNoLaser(const CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+
+	for(int i = 0, id = std::ceil(d); i < id; i++)
+	{
+		float a = i / d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int Nx = clamp(round_to_int(Pos.x) / 32, 0, pCollision->GetWidth() - 1);
+		int Ny = clamp(round_to_int(Pos.y) / 32, 0, pCollision->GetHeight() - 1);
+		if(pCollision->GetIndex(Nx, Ny) == TILE_SOLID || pCollision->GetIndex(Nx, Ny) == TILE_NOHOOK || pCollision->GetIndex(Nx, Ny) == TILE_NOLASER || pCollision->GetFIndex(Nx, Ny) == TILE_NOLASER)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(pCollision->GetFIndex(Nx, Ny) == TILE_NOLASER)
+				return pCollision->GetFCollisionAt(Pos.x, Pos.y);
+			else
+				return pCollision->GetCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int OldIntersectNoLaserNW(const CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+
+	for(int i = 0, id = std::ceil(d); i < id; i++)
+	{
+		float a = (float)i / d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		if(pCollision->IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || pCollision->IsFNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(pCollision->IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
+				return pCollision->GetCollisionAt(Pos.x, Pos.y);
+			else
+				return pCollision->GetFCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int OldIntersectAir(const CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+
+	for(int i = 0, id = std::ceil(d); i < id; i++)
+	{
+		float a = (float)i / d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int x = round_to_int(Pos.x);
+		int y = round_to_int(Pos.y);
+		if(pCollision->IsSolid(x, y) || (!pCollision->GetTile(x, y) && !pCollision->GetFTile(x, y)))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(!pCollision->GetTile(x, y) && !pCollision->GetFTile(x, y))
+				return -1;
+			else if(!pCollision->GetTile(x, y))
+				return pCollision->GetTile(x, y);
+			else
+				return pCollision->GetFTile(x, y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+class CCollisionTest : public ::testing::Test
+{
+protected:
+	static const int WIDTH = 60;
+	static const int HEIGHT = 40;
+
+	CTestInfo m_Info;
+	std::unique_ptr<IStorage> m_pStorage;
+	std::unique_ptr<IEngineMap> m_pMap;
+	std::unique_ptr<IKernel> m_pKernel;
+	CLayers m_Layers;
+	CCollision m_Collision;
+	CPrng m_Prng;
+
+	CCollisionTest()
+	{
+		m_Info.m_DeleteTestStorageFilesOnSuccess = true;
+		m_pStorage = std::unique_ptr<IStorage>(m_Info.CreateTestStorage());
+		uint64_t aSeed[2] = {5, 6};
+		m_Prng.Seed(aSeed);
+	}
+
+	~CCollisionTest() override
+	{
+		m_Collision.Unload();
+	}
+
+	int Random(int Max) { return m_Prng.RandomBits() % Max; }
+
+	// a map with a few random tiles that the line functions look at, on
+	// the game, front and tele layer
+	void WriteMap(const char *pFilename, int Density)
+	{
+		static const int s_aGameTiles[] = {TILE_SOLID, TILE_NOHOOK, TILE_NOLASER, TILE_DEATH, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR};
+		static const int s_aFrontTiles[] = {TILE_THROUGH_CUT, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_NOLASER, TILE_DEATH};
+		static const int s_aTeleTypes[] = {TILE_TELEIN, TILE_TELEINEVIL, TILE_TELEINHOOK, TILE_TELEINWEAPON};
+		static const int s_aRotations[] = {ROTATION_0, ROTATION_90, ROTATION_180, ROTATION_270};
+
+		std::vector<CTile> vGame(WIDTH * HEIGHT);
+		std::vector<CTile> vFront(WIDTH * HEIGHT);
+		std::vector<CTeleTile> vTele(WIDTH * HEIGHT);
+		std::vector<CTile> vEmpty(WIDTH * HEIGHT);
+		mem_zero(vGame.data(), vGame.size() * sizeof(CTile));
+		mem_zero(vFront.data(), vFront.size() * sizeof(CTile));
+		mem_zero(vTele.data(), vTele.size() * sizeof(CTeleTile));
+		mem_zero(vEmpty.data(), vEmpty.size() * sizeof(CTile));
+		for(int i = 0; i < WIDTH * HEIGHT; i++)
+		{
+			if(Random(100) < Density)
+			{
+				vGame[i].m_Index = s_aGameTiles[Random(std::size(s_aGameTiles))];
+				vGame[i].m_Flags = s_aRotations[Random(std::size(s_aRotations))];
+			}
+			if(Random(100) < Density / 2)
+			{
+				vFront[i].m_Index = s_aFrontTiles[Random(std::size(s_aFrontTiles))];
+				vFront[i].m_Flags = s_aRotations[Random(std::size(s_aRotations))];
+			}
+			if(Random(100) < Density / 4)
+			{
+				vTele[i].m_Number = 1 + Random(3);
+				vTele[i].m_Type = s_aTeleTypes[Random(std::size(s_aTeleTypes))];
+			}
+		}
+
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(m_pStorage.get(), pFilename));
+		CMapItemVersion Version;
+		Version.m_Version = CMapItemVersion::CURRENT_VERSION;
+		Writer.AddItem(MAPITEMTYPE_VERSION, 0, sizeof(Version), &Version);
+
+		CMapItemGroup Group;
+		mem_zero(&Group, sizeof(Group));
+		Group.m_Version = CMapItemGroup::CURRENT_VERSION;
+		Group.m_ParallaxX = 100;
+		Group.m_ParallaxY = 100;
+		Group.m_StartLayer = 0;
+		Group.m_NumLayers = 3;
+		Writer.AddItem(MAPITEMTYPE_GROUP, 0, sizeof(Group), &Group);
+
+		const int EmptyData = Writer.AddData(vEmpty.size() * sizeof(CTile), vEmpty.data());
+		const int aFlags[] = {TILESLAYERFLAG_GAME, TILESLAYERFLAG_FRONT, TILESLAYERFLAG_TELE};
+		for(int l = 0; l < 3; l++)
+		{
+			CMapItemLayerTilemap Tilemap;
+			mem_zero(&Tilemap, sizeof(Tilemap));
+			Tilemap.m_Layer.m_Type = LAYERTYPE_TILES;
+			Tilemap.m_Version = CMapItemLayerTilemap::CURRENT_VERSION;
+			Tilemap.m_Width = WIDTH;
+			Tilemap.m_Height = HEIGHT;
+			Tilemap.m_Flags = aFlags[l];
+			Tilemap.m_Image = -1;
+			Tilemap.m_Data = EmptyData;
+			Tilemap.m_Tele = -1;
+			Tilemap.m_Speedup = -1;
+			Tilemap.m_Front = -1;
+			Tilemap.m_Switch = -1;
+			Tilemap.m_Tune = -1;
+			if(aFlags[l] == TILESLAYERFLAG_GAME)
+				Tilemap.m_Data = Writer.AddData(vGame.size() * sizeof(CTile), vGame.data());
+			else if(aFlags[l] == TILESLAYERFLAG_FRONT)
+				Tilemap.m_Front = Writer.AddData(vFront.size() * sizeof(CTile), vFront.data());
+			else
+				Tilemap.m_Tele = Writer.AddData(vTele.size() * sizeof(CTeleTile), vTele.data());
+			Writer.AddItem(MAPITEMTYPE_LAYER, l, sizeof(Tilemap), &Tilemap);
+		}
+		Writer.Finish();
+	}
+
+	void LoadMap(int Density)
+	{
+		m_Collision.Unload();
+		WriteMap("collision.map", Density);
+		m_pMap = std::unique_ptr<IEngineMap>(CreateEngineMap());
+		ASSERT_TRUE(m_pMap->Load(m_pStorage.get(), "collision.map"));
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		m_pKernel->RegisterInterface(static_cast<IMap *>(m_pMap.get()), false);
+		m_Layers.Init(m_pKernel.get());
+		m_Collision.Init(&m_Layers);
+		ASSERT_NE(m_Collision.FrontLayer(), nullptr);
+		ASSERT_NE(m_Collision.TeleLayer(), nullptr);
+	}
+
+	float RandomCoordinate(int Tiles)
+	{
+		switch(Random(4))
+		{
+		case 0:
+			// close to a tile border
+			return Random(Tiles + 2) * 32.0f - 32.0f + (Random(5) - 2) * 0.25f;
+		case 1:
+			return (int)Random((Tiles + 4) * 32) - 64;
+		default:
+			return (Random(1000000) / 1000000.0f) * (Tiles + 4) * 32.0f - 64.0f;
+		}
+	}
+
+	vec2 RandomEnd(vec2 Start)
+	{
+		switch(Random(6))
+		{
+		case 0:
+			return Start;
+		case 1:
+			return vec2(Start.x, RandomCoordinate(HEIGHT));
+		case 2:
+			return vec2(RandomCoordinate(WIDTH), Start.y);
+		case 3:
+		{
+			// short, like projectiles
+			return Start + vec2(Random(4001) / 100.0f - 20.0f, Random(4001) / 100.0f - 20.0f);
+		}
+		default:
+			return vec2(RandomCoordinate(WIDTH), RandomCoordinate(HEIGHT));
+		}
+	}
+};
+
+static bool SameBits(vec2 a, vec2 b)
+{
+	return mem_comp(&a, &b, sizeof(a)) == 0;
+}
+
+TEST_F(CCollisionTest, IntersectLineSameAsPerPixel)
+{
+	for(int Density : {2, 10, 40})
+	{
+		LoadMap(Density);
+		for(int Round = 0; Round < 3000; Round++)
+		{
+			vec2 Pos0(RandomCoordinate(WIDTH), RandomCoordinate(HEIGHT));
+			vec2 Pos1 = RandomEnd(Pos0);
+			SCOPED_TRACE(std::string("line ") + std::to_string(Pos0.x) + "," + std::to_string(Pos0.y) + " -> " + std::to_string(Pos1.x) + "," + std::to_string(Pos1.y));
+
+			vec2 aOut[2], aBefore[2];
+			int aResult[2];
+			int aTeleNr[2];
+
+			aResult[0] = OldIntersectLine(&m_Collision, Pos0, Pos1, &aOut[0], &aBefore[0]);
+			aResult[1] = m_Collision.IntersectLine(Pos0, Pos1, &aOut[1], &aBefore[1]);
+			EXPECT_EQ(aResult[0], aResult[1]);
+			EXPECT_TRUE(SameBits(aOut[0], aOut[1]));
+			EXPECT_TRUE(SameBits(aBefore[0], aBefore[1]));
+
+			for(int Old = 0; Old < 2; Old++)
+			{
+				g_Config.m_SvOldTeleportHook = Old;
+				g_Config.m_SvOldTeleportWeapons = Old;
+
+				aTeleNr[0] = aTeleNr[1] = -1;
+				aResult[0] = OldIntersectLineTeleHook(&m_Collision, Pos0, Pos1, &aOut[0], &aBefore[0], &aTeleNr[0]);
+				aResult[1] = m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aOut[1], &aBefore[1], &aTeleNr[1]);
+				EXPECT_EQ(aResult[0], aResult[1]);
+				EXPECT_EQ(aTeleNr[0], aTeleNr[1]);
+				EXPECT_TRUE(SameBits(aOut[0], aOut[1]));
+				EXPECT_TRUE(SameBits(aBefore[0], aBefore[1]));
+
+				aResult[0] = OldIntersectLineTeleHook(&m_Collision, Pos0, Pos1, &aOut[0], &aBefore[0], nullptr);
+				aResult[1] = m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aOut[1], &aBefore[1], nullptr);
+				EXPECT_EQ(aResult[0], aResult[1]);
+				EXPECT_TRUE(SameBits(aOut[0], aOut[1]));
+				EXPECT_TRUE(SameBits(aBefore[0], aBefore[1]));
+
+				aTeleNr[0] = aTeleNr[1] = -1;
+				aResult[0] = OldIntersectLineTeleWeapon(&m_Collision, Pos0, Pos1, &aOut[0], &aBefore[0], &aTeleNr[0]);
+				aResult[1] = m_Collision.IntersectLineTeleWeapon(Pos0, Pos1, &aOut[1], &aBefore[1], &aTeleNr[1]);
+				EXPECT_EQ(aResult[0], aResult[1]);
+				EXPECT_EQ(aTeleNr[0], aTeleNr[1]);
+				EXPECT_TRUE(SameBits(aOut[0], aOut[1]));
+				EXPECT_TRUE(SameBits(aBefore[0], aBefore[1]));
+			}
+			g_Config.m_SvOldTeleportHook = 0;
+			g_Config.m_SvOldTeleportWeapons = 0;
+
+			aResult[0] = OldIntersectNoLaser(&m_Collision, Pos0, Pos1, &aOut[0], &aBefore[0]);
+			aResult[1] = m_Collision.IntersectNoLaser(Pos0, Pos1, &aOut[1], &aBefore[1]);
+			EXPECT_EQ(aResult[0], aResult[1]);
+			EXPECT_TRUE(SameBits(aOut[0], aOut[1]));
+			EXPECT_TRUE(SameBits(aBefore[0], aBefore[1]));
+
+			aResult[0] = OldIntersectNoLaserNW(&m_Collision, Pos0, Pos1, &aOut[0], &aBefore[0]);
+			aResult[1] = m_Collision.IntersectNoLaserNW(Pos0, Pos1, &aOut[1], &aBefore[1]);
+			EXPECT_EQ(aResult[0], aResult[1]);
+			EXPECT_TRUE(SameBits(aOut[0], aOut[1]));
+			EXPECT_TRUE(SameBits(aBefore[0], aBefore[1]));
+
+			aResult[0] = OldIntersectAir(&m_Collision, Pos0, Pos1, &aOut[0], &aBefore[0]);
+			aResult[1] = m_Collision.IntersectAir(Pos0, Pos1, &aOut[1], &aBefore[1]);
+			EXPECT_EQ(aResult[0], aResult[1]);
+			EXPECT_TRUE(SameBits(aOut[0], aOut[1]));
+			EXPECT_TRUE(SameBits(aBefore[0], aBefore[1]));
+
+			if(HasFailure())
+				return;
+		}
+	}
+}
+
+TEST_F(CCollisionTest, DISABLED_IntersectLineBenchmark)
+{
+	// hooks and lasers over a sparse map, most of them don't hit anything
+	LoadMap(2);
+	static const int NUM_LINES = 2000;
+	std::vector<vec2> vLines;
+	for(int i = 0; i < NUM_LINES; i++)
+	{
+		vec2 Pos0(RandomCoordinate(WIDTH), RandomCoordinate(HEIGHT));
+		vec2 Dir = direction(Random(360) * pi / 180.0f);
+		vLines.push_back(Pos0);
+		vLines.push_back(Pos0 + Dir * (i % 2 ? 380.0f : 800.0f));
+	}
+
+	vec2 Out, Before;
+	int OldSum = 0;
+	int NewSum = 0;
+	int64_t Start = time_get_impl();
+	for(int i = 0; i < NUM_LINES; i++)
+		OldSum += OldIntersectLineTeleHook(&m_Collision, vLines[i * 2], vLines[i * 2 + 1], &Out, &Before, nullptr) + round_to_int(Out.x);
+	int64_t OldTime = time_get_impl() - Start;
+	Start = time_get_impl();
+	for(int i = 0; i < NUM_LINES; i++)
+		NewSum += m_Collision.IntersectLineTeleHook(vLines[i * 2], vLines[i * 2 + 1], &Out, &Before, nullptr) + round_to_int(Out.x);
+	int64_t NewTime = time_get_impl() - Start;
+
+	EXPECT_EQ(OldSum, NewSum);
+	dbg_msg("collision", "%d lines: per pixel %.3f us/line, per tile %.3f us/line",
+		NUM_LINES, OldTime * 1000000.0 / time_freq() / NUM_LINES, NewTime * 1000000.0 / time_freq() / NUM_LINES);
+}
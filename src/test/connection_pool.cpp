@@ -0,0 +1,289 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/databases/connection.h>
+#include <engine/server/databases/connection_pool.h>
+#include <engine/shared/config.h>
+#include <game/server/scoreworker.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+struct CPoolTestResult : ISqlResult
+{
+	int64_t m_Added = 0;
+	int64_t m_Done = 0;
+	int m_Count = 0;
+};
+
+struct CPoolTestRequest : ISqlData
+{
+	CPoolTestRequest(std::shared_ptr<CPoolTestResult> pResult, int Seq) :
+		ISqlData(std::move(pResult)), m_Seq(Seq)
+	{
+	}
+
+	int m_Seq;
+};
+
+static bool CountRows(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	auto *pResult = static_cast<CPoolTestResult *>(pGameData->m_pResult.get());
+	if(pSqlServer->PrepareStatement("SELECT COUNT(*) FROM pool_test", pError, ErrorSize))
+		return true;
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize) || End)
+		return true;
+	pResult->m_Count = pSqlServer->GetInt(1);
+	pResult->m_Done = time_get_impl();
+	return false;
+}
+
+// like a large /top5 on a slow server, counts up to the sequence number
+static bool SlowRead(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = static_cast<const CPoolTestRequest *>(pGameData);
+	auto *pResult = static_cast<CPoolTestResult *>(pGameData->m_pResult.get());
+	if(pSqlServer->PrepareStatement("WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < ?) SELECT COUNT(*) FROM c", pError, ErrorSize))
+		return true;
+	pSqlServer->BindInt(1, pData->m_Seq);
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize) || End)
+		return true;
+	pResult->m_Count = pSqlServer->GetInt(1);
+	pResult->m_Done = time_get_impl();
+	return false;
+}
+
+static bool InsertRow(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	const auto *pData = static_cast<const CPoolTestRequest *>(pGameData);
+	auto *pResult = static_cast<CPoolTestResult *>(pGameData->m_pResult.get());
+	if(w != Write::NORMAL)
+		return false;
+
+	if(pSqlServer->PrepareStatement("CREATE TABLE IF NOT EXISTS pool_test (Seq INTEGER NOT NULL)", pError, ErrorSize))
+		return true;
+	int NumUpdated;
+	if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
+		return true;
+
+	// the writes are executed in order
+	if(pSqlServer->PrepareStatement("SELECT COALESCE(MAX(Seq), -1) FROM pool_test", pError, ErrorSize))
+		return true;
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize) || End)
+		return true;
+	if(pSqlServer->GetInt(1) != pData->m_Seq - 1)
+	{
+		str_format(pError, ErrorSize, "write %d after %d", pData->m_Seq, pSqlServer->GetInt(1));
+		return true;
+	}
+
+	if(pSqlServer->PrepareStatement("INSERT INTO pool_test (Seq) VALUES (?)", pError, ErrorSize))
+		return true;
+	pSqlServer->BindInt(1, pData->m_Seq);
+	if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
+		return true;
+	pResult->m_Done = time_get_impl();
+	return false;
+}
+
+static bool FailingWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	if(w != Write::NORMAL)
+		return false;
+	return pSqlServer->PrepareStatement("INSERT INTO missing_table (Seq) VALUES (1)", pError, ErrorSize);
+}
+
+class CConnectionPool : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	std::unique_ptr<CDbConnectionPool> m_pPool;
+
+	CConnectionPool()
+	{
+		m_Info.Filename(m_aPath, sizeof(m_aPath), ".sqlite");
+		m_pPool = std::make_unique<CDbConnectionPool>();
+		m_pPool->SetNumReadWorkers(4);
+		m_pPool->RegisterSqliteDatabase(CDbConnectionPool::READ, m_aPath);
+		m_pPool->RegisterSqliteDatabase(CDbConnectionPool::WRITE, m_aPath);
+	}
+
+	~CConnectionPool() override
+	{
+		m_pPool.reset();
+		for(const char *pSuffix : {"", "-wal", "-shm"})
+		{
+			char aBuf[IO_MAX_PATH_LENGTH];
+			str_format(aBuf, sizeof(aBuf), "%s%s", m_aPath, pSuffix);
+			fs_remove(aBuf);
+		}
+	}
+
+	std::shared_ptr<CPoolTestResult> Read(CDbConnectionPool::FRead pFunc, const char *pName, int Seq = 0)
+	{
+		auto pResult = std::make_shared<CPoolTestResult>();
+		pResult->m_Added = time_get_impl();
+		m_pPool->Execute(pFunc, std::make_unique<CPoolTestRequest>(pResult, Seq), pName);
+		return pResult;
+	}
+
+	std::shared_ptr<CPoolTestResult> Write(int Seq, CDbConnectionPool::FWrite pFunc = InsertRow)
+	{
+		auto pResult = std::make_shared<CPoolTestResult>();
+		pResult->m_Added = time_get_impl();
+		m_pPool->ExecuteWrite(pFunc, std::make_unique<CPoolTestRequest>(pResult, Seq), "insert row");
+		return pResult;
+	}
+
+	static void WaitFor(const std::vector<std::shared_ptr<CPoolTestResult>> &vpResults)
+	{
+		for(const auto &pResult : vpResults)
+			while(!pResult->m_Completed.load())
+				std::this_thread::sleep_for(1ms);
+	}
+};
+
+TEST_F(CConnectionPool, SlowReadDoesNotBlockWrites)
+{
+	// create the table before the reads look at it
+	std::vector<std::shared_ptr<CPoolTestResult>> vpWrites = {Write(0)};
+	WaitFor(vpWrites);
+
+	auto pSlow = Read(SlowRead, "slow read", 3000000);
+	for(int i = 1; i <= 20; i++)
+		vpWrites.push_back(Write(i));
+	auto pFast = Read(CountRows, "count rows");
+	WaitFor(vpWrites);
+	WaitFor({pFast, pSlow});
+
+	for(const auto &pWrite : vpWrites)
+	{
+		EXPECT_TRUE(pWrite->m_Success);
+		EXPECT_LT(pWrite->m_Done, pSlow->m_Done);
+	}
+	EXPECT_TRUE(pFast->m_Success);
+	EXPECT_LT(pFast->m_Done, pSlow->m_Done);
+	EXPECT_TRUE(pSlow->m_Success);
+	EXPECT_EQ(pSlow->m_Count, 3000000);
+}
+
+TEST_F(CConnectionPool, Flood)
+{
+	// more queries than the fixed queue used to have room for, added
+	// faster than they are executed
+	static const int NUM_WRITES = 500;
+	static const int NUM_READS = 1000;
+	std::vector<std::shared_ptr<CPoolTestResult>> vpWrites = {Write(0)};
+	WaitFor(vpWrites);
+
+	std::vector<std::shared_ptr<CPoolTestResult>> vpReads;
+	std::vector<std::shared_ptr<CPoolTestResult>> vpSlowReads;
+	for(int i = 0; i < NUM_READS + NUM_WRITES; i++)
+	{
+		if(i % 3 == 0)
+			vpWrites.push_back(Write(vpWrites.size()));
+		else if(i % 200 == 1)
+			vpSlowReads.push_back(Read(SlowRead, "slow read", 200000));
+		else
+			vpReads.push_back(Read(CountRows, "count rows"));
+	}
+	EXPECT_GT(m_pPool->NumPending(CDbConnectionPool::READ) + m_pPool->NumPending(CDbConnectionPool::WRITE), 0);
+	WaitFor(vpWrites);
+	WaitFor(vpReads);
+	WaitFor(vpSlowReads);
+	EXPECT_EQ(m_pPool->NumPending(CDbConnectionPool::READ), 0);
+	EXPECT_EQ(m_pPool->NumPending(CDbConnectionPool::WRITE), 0);
+
+	auto Report = [](const char *pName, const std::vector<std::shared_ptr<CPoolTestResult>> &vpResults) {
+		std::vector<int64_t> vLatencies;
+		for(const auto &pResult : vpResults)
+		{
+			EXPECT_TRUE(pResult->m_Success);
+			vLatencies.push_back(pResult->m_Done - pResult->m_Added);
+		}
+		std::sort(vLatencies.begin(), vLatencies.end());
+		dbg_msg("connection_pool", "%d %s: p50 %.1f ms, p99 %.1f ms", (int)vLatencies.size(), pName,
+			vLatencies[vLatencies.size() / 2] * 1000.0 / time_freq(), vLatencies[vLatencies.size() * 99 / 100] * 1000.0 / time_freq());
+	};
+	Report("writes", vpWrites);
+	Report("reads", vpReads);
+	Report("slow reads", vpSlowReads);
+
+	auto pCount = Read(CountRows, "count rows");
+	WaitFor({pCount});
+	EXPECT_EQ(pCount->m_Count, (int)vpWrites.size());
+}
+
+TEST_F(CConnectionPool, WriteBatch)
+{
+	m_pPool->SetWriteBatch(64, 50);
+	std::vector<std::shared_ptr<CPoolTestResult>> vpWrites = {Write(0)};
+	WaitFor(vpWrites);
+
+	// a failing write doesn't take the others of its batch with it
+	std::shared_ptr<CPoolTestResult> pFailing;
+	for(int i = 1; i <= 30; i++)
+	{
+		vpWrites.push_back(Write(i));
+		if(i == 15)
+			pFailing = Write(0, FailingWrite);
+	}
+	WaitFor(vpWrites);
+	WaitFor({pFailing});
+	for(const auto &pWrite : vpWrites)
+		EXPECT_TRUE(pWrite->m_Success);
+	EXPECT_FALSE(pFailing->m_Success);
+
+	auto pCount = Read(CountRows, "count rows");
+	WaitFor({pCount});
+	EXPECT_EQ(pCount->m_Count, (int)vpWrites.size());
+}
+
+TEST_F(CConnectionPool, DISABLED_WriteBatchBenchmark)
+{
+	// many teams finishing at once on a file database
+	static const int NUM_FINISHES = 200;
+	str_copy(g_Config.m_SvSqlServerName, "GER", sizeof(g_Config.m_SvSqlServerName));
+	double aFinishesPerSecond[2];
+	for(int Batch = 0; Batch <= 1; Batch++)
+	{
+		if(Batch)
+			m_pPool->SetWriteBatch(32, 10);
+		std::vector<std::shared_ptr<CScorePlayerResult>> vpResults;
+		const int64_t Start = time_get_impl();
+		for(int i = 0; i < NUM_FINISHES; i++)
+		{
+			auto pResult = std::make_shared<CScorePlayerResult>();
+			auto pData = std::make_unique<CSqlScoreData>(pResult);
+			str_copy(pData->m_aMap, "Kobra 3", sizeof(pData->m_aMap));
+			str_copy(pData->m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(pData->m_aGameUuid));
+			str_format(pData->m_aName, sizeof(pData->m_aName), "tee %d", i);
+			pData->m_ClientId = 0;
+			pData->m_Time = 30.0f + i;
+			str_copy(pData->m_aTimestamp, "2021-11-24 19:24:08", sizeof(pData->m_aTimestamp));
+			for(float &TimeCp : pData->m_aCurrentTimeCp)
+				TimeCp = 0;
+			m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(pData), "save score");
+			vpResults.push_back(pResult);
+		}
+		for(const auto &pResult : vpResults)
+		{
+			while(!pResult->m_Completed.load())
+				std::this_thread::sleep_for(1ms);
+			EXPECT_TRUE(pResult->m_Success);
+		}
+		aFinishesPerSecond[Batch] = NUM_FINISHES * (double)time_freq() / (time_get_impl() - Start);
+	}
+	dbg_msg("connection_pool", "SQLite finishes per second: %.0f one by one, %.0f in batches", aFinishesPerSecond[0], aFinishesPerSecond[1]);
+}
@@ -1,11 +1,36 @@
 #include "test.h"
 #include <gtest/gtest.h>
 #include <memory>
+#include <thread>
+#include <vector>
+
+#include <base/system.h>
 
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 #include <game/mapitems_ex.h>
 
+#include <zlib.h>
+
+#if defined(CONF_FAMILY_WINDOWS)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+// sets the modification time, to get around the minimum age of files in
+// the hash cache
+static bool SetFileTime(const char *pPath, time_t Modified)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	struct _utimbuf Times = {Modified, Modified};
+	return _utime(pPath, &Times) == 0;
+#else
+	struct utimbuf Times = {Modified, Modified};
+	return utime(pPath, &Times) == 0;
+#endif
+}
+
 TEST(Datafile, ExtendedType)
 {
 	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
@@ -105,3 +130,177 @@ TEST(Datafile, StringData)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, DataAndHashes)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	char aLarge[100000];
+	for(size_t i = 0; i < sizeof(aLarge); i++)
+		aLarge[i] = i % 251;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		EXPECT_EQ(Writer.AddData(sizeof(aLarge), aLarge), 0);
+		EXPECT_EQ(Writer.AddData(3, "Abc"), 1);
+		Writer.Finish();
+	}
+
+	void *pFile;
+	unsigned FileSize;
+	ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_ALL, &pFile, &FileSize));
+	const SHA256_DIGEST Sha256 = sha256(pFile, FileSize);
+	const unsigned Crc = crc32(0, (const unsigned char *)pFile, FileSize);
+
+	// recently modified files aren't cached, so the second pass would hash
+	// the file again
+	char aPath[IO_MAX_PATH_LENGTH];
+	pStorage->GetCompletePath(IStorage::TYPE_SAVE, Info.m_aFilename, aPath, sizeof(aPath));
+	time_t Created, Modified;
+	ASSERT_EQ(fs_file_time(aPath, &Created, &Modified), 0);
+	ASSERT_TRUE(SetFileTime(aPath, Modified - 60));
+
+	// the data is the same in any order, before and after hashing, and with
+	// the hashes from the cache
+	for(int Pass = 0; Pass < 2; Pass++)
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_EQ(Reader.GetDataSize(1), 3);
+		EXPECT_EQ(mem_comp(Reader.GetData(1), "Abc", 3), 0);
+		EXPECT_EQ(Reader.Sha256(), Sha256);
+		EXPECT_EQ(Reader.Crc(), Crc);
+		EXPECT_EQ(Reader.MapSize(), (int)FileSize);
+		ASSERT_EQ(Reader.GetDataSize(0), (int)sizeof(aLarge));
+		EXPECT_EQ(mem_comp(Reader.GetData(0), aLarge, sizeof(aLarge)), 0);
+		Reader.Close();
+	}
+
+	// the cache only notices changes of the size or modification time, so
+	// changing a byte shows whether the hashes come from it
+	((unsigned char *)pFile)[FileSize - 1] ^= 0xff;
+	const SHA256_DIGEST ChangedSha256 = sha256(pFile, FileSize);
+	const unsigned ChangedCrc = crc32(0, (const unsigned char *)pFile, FileSize);
+	IOHANDLE File = pStorage->OpenFile(Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	EXPECT_EQ(io_write(File, pFile, FileSize), FileSize);
+	io_close(File);
+	free(pFile);
+
+	ASSERT_TRUE(SetFileTime(aPath, Modified - 60));
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		EXPECT_EQ(Reader.Sha256(), Sha256);
+		EXPECT_EQ(Reader.Crc(), Crc);
+		Reader.Close();
+	}
+
+	ASSERT_TRUE(SetFileTime(aPath, Modified - 30));
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		EXPECT_EQ(Reader.Sha256(), ChangedSha256);
+		EXPECT_EQ(Reader.Crc(), ChangedCrc);
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, HashesOnSeveralThreads)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	char aLarge[100000];
+	for(size_t i = 0; i < sizeof(aLarge); i++)
+		aLarge[i] = i % 251;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		EXPECT_EQ(Writer.AddData(sizeof(aLarge), aLarge), 0);
+		Writer.Finish();
+	}
+
+	void *pFile;
+	unsigned FileSize;
+	ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_ALL, &pFile, &FileSize));
+	const SHA256_DIGEST Sha256 = sha256(pFile, FileSize);
+	const unsigned Crc = crc32(0, (const unsigned char *)pFile, FileSize);
+	free(pFile);
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+
+		// no thread may see the hashes before they are complete
+		const int NUM_THREADS = 4;
+		SHA256_DIGEST aSha256[NUM_THREADS];
+		unsigned aCrc[NUM_THREADS];
+		std::vector<std::thread> vThreads;
+		for(int i = 0; i < NUM_THREADS; i++)
+		{
+			vThreads.emplace_back([&, i]() {
+				aSha256[i] = Reader.Sha256();
+				aCrc[i] = Reader.Crc();
+			});
+		}
+		for(auto &Thread : vThreads)
+			Thread.join();
+		for(int i = 0; i < NUM_THREADS; i++)
+		{
+			EXPECT_EQ(aSha256[i], Sha256);
+			EXPECT_EQ(aCrc[i], Crc);
+		}
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, TruncatedWhileOpen)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	char aLarge[100000];
+	for(size_t i = 0; i < sizeof(aLarge); i++)
+		aLarge[i] = i % 251;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		EXPECT_EQ(Writer.AddData(sizeof(aLarge), aLarge), 0);
+		Writer.Finish();
+	}
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+
+		// a mapped file can't be truncated on all platforms
+		IOHANDLE File = pStorage->OpenFile(Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(File)
+		{
+			io_close(File);
+			// reported like a short read instead of crashing
+			EXPECT_EQ(Reader.GetData(0), nullptr);
+		}
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/input_ring.h>
+
+#include <vector>
+
+static void FillInput(int *pData, int Value)
+{
+	for(int i = 0; i < MAX_INPUT_SIZE; i++)
+		pData[i] = Value;
+}
+
+static std::vector<int> CollectInputs(const CInputRing &Ring, int GameTick)
+{
+	std::vector<int> vValues;
+	Ring.ForEach(GameTick, [&](const int *pData) { vValues.push_back(pData[0]); });
+	return vValues;
+}
+
+TEST(InputRing, Empty)
+{
+	CInputRing Ring;
+	EXPECT_EQ(Ring.First(0), nullptr);
+	EXPECT_EQ(Ring.First(-1), nullptr);
+	EXPECT_TRUE(CollectInputs(Ring, 0).empty());
+}
+
+TEST(InputRing, SameTick)
+{
+	CInputRing Ring;
+	int aData[MAX_INPUT_SIZE];
+	FillInput(aData, 1);
+	Ring.Add(100, aData);
+	FillInput(aData, 2);
+	Ring.Add(101, aData);
+	FillInput(aData, 3);
+	Ring.Add(100, aData);
+	FillInput(aData, 4);
+	Ring.Add(100, aData);
+
+	// the first input that arrived is the predicted one
+	ASSERT_NE(Ring.First(100), nullptr);
+	EXPECT_EQ(Ring.First(100)[0], 1);
+	EXPECT_EQ(Ring.First(100)[MAX_INPUT_SIZE - 1], 1);
+	EXPECT_EQ(CollectInputs(Ring, 100), (std::vector<int>{1, 3, 4}));
+	EXPECT_EQ(CollectInputs(Ring, 101), (std::vector<int>{2}));
+	EXPECT_EQ(Ring.First(102), nullptr);
+
+	Ring.Reset();
+	EXPECT_EQ(Ring.First(100), nullptr);
+}
+
+TEST(InputRing, Overwrite)
+{
+	CInputRing Ring;
+	int aData[MAX_INPUT_SIZE];
+
+	// a tick further ahead replaces the one a whole ring before it
+	FillInput(aData, 1);
+	Ring.Add(10, aData);
+	FillInput(aData, 2);
+	Ring.Add(10 + CInputRing::SIZE, aData);
+	EXPECT_EQ(Ring.First(10), nullptr);
+	ASSERT_NE(Ring.First(10 + CInputRing::SIZE), nullptr);
+	EXPECT_EQ(Ring.First(10 + CInputRing::SIZE)[0], 2);
+
+	// old inputs are dropped once the ring is full
+	Ring.Reset();
+	FillInput(aData, 1);
+	Ring.Add(1000, aData);
+	for(int i = 0; i < CInputRing::SIZE - 1; i++)
+	{
+		FillInput(aData, 2);
+		Ring.Add(1001, aData);
+	}
+	EXPECT_NE(Ring.First(1000), nullptr);
+	Ring.Add(1002, aData);
+	EXPECT_EQ(Ring.First(1000), nullptr);
+	EXPECT_TRUE(CollectInputs(Ring, 1000).empty());
+	EXPECT_EQ((int)CollectInputs(Ring, 1001).size(), CInputRing::SIZE - 1);
+}
+
+TEST(InputRing, ChainOverwritten)
+{
+	CInputRing Ring;
+	int aData[MAX_INPUT_SIZE];
+	FillInput(aData, 1);
+	Ring.Add(7, aData);
+	for(int i = 0; i < CInputRing::SIZE; i++)
+		Ring.Add(8, aData);
+	FillInput(aData, 2);
+	Ring.Add(7, aData);
+
+	// the old chain is gone, the new input starts a new one
+	EXPECT_EQ(CollectInputs(Ring, 7), (std::vector<int>{2}));
+	EXPECT_EQ((int)CollectInputs(Ring, 8).size(), CInputRing::SIZE - 1);
+}
+
+// the linear scan over the last 200 inputs that the ring replaces
+class CInputScan
+{
+public:
+	struct CInput
+	{
+		int m_aData[MAX_INPUT_SIZE];
+		int m_GameTick;
+	};
+	CInput m_aInputs[200];
+	int m_CurrentInput = 0;
+
+	CInputScan()
+	{
+		for(auto &Input : m_aInputs)
+			Input.m_GameTick = -1;
+	}
+
+	void Add(int GameTick, const int *pData)
+	{
+		CInput &Input = m_aInputs[m_CurrentInput];
+		Input.m_GameTick = GameTick;
+		mem_copy(Input.m_aData, pData, sizeof(Input.m_aData));
+		m_CurrentInput = (m_CurrentInput + 1) % 200;
+	}
+};
+
+TEST(InputRing, DISABLED_Benchmark)
+{
+	// 64 clients sending one input per tick a few ticks ahead, and the
+	// server looking them up for the early and the regular input
+	static const int NUM_CLIENTS = 64;
+	static const int NUM_TICKS = 2000;
+	static const int LOOKAHEAD = 3;
+	std::vector<CInputScan> vScans(NUM_CLIENTS);
+	std::vector<CInputRing> vRings(NUM_CLIENTS);
+	int aData[MAX_INPUT_SIZE];
+	FillInput(aData, 0);
+
+	int64_t ScanTime = 0;
+	int64_t RingTime = 0;
+	int64_t ScanSum = 0;
+	int64_t RingSum = 0;
+	for(int Tick = 0; Tick < NUM_TICKS; Tick++)
+	{
+		for(int c = 0; c < NUM_CLIENTS; c++)
+		{
+			aData[0] = Tick * NUM_CLIENTS + c;
+			vScans[c].Add(Tick + LOOKAHEAD, aData);
+			vRings[c].Add(Tick + LOOKAHEAD, aData);
+		}
+
+		int64_t Start = time_get_impl();
+		for(int c = 0; c < NUM_CLIENTS; c++)
+		{
+			for(const auto &Input : vScans[c].m_aInputs)
+			{
+				if(Input.m_GameTick == Tick + 1)
+					ScanSum += Input.m_aData[0];
+			}
+			for(const auto &Input : vScans[c].m_aInputs)
+			{
+				if(Input.m_GameTick == Tick + 1)
+				{
+					ScanSum += Input.m_aData[0];
+					break;
+				}
+			}
+		}
+		ScanTime += time_get_impl() - Start;
+
+		Start = time_get_impl();
+		for(int c = 0; c < NUM_CLIENTS; c++)
+		{
+			const int *pFirst = vRings[c].First(Tick + 1);
+			if(!pFirst)
+				continue;
+			vRings[c].ForEach(Tick + 1, [&](const int *pData) { RingSum += pData[0]; });
+			RingSum += pFirst[0];
+		}
+		RingTime += time_get_impl() - Start;
+	}
+
+	EXPECT_EQ(RingSum, ScanSum);
+	dbg_msg("input_ring", "%d clients, %d ticks: scan %.3f us/tick, ring %.3f us/tick",
+		NUM_CLIENTS, NUM_TICKS, ScanTime / (double)NUM_TICKS * 1000000.0 / time_freq(), RingTime / (double)NUM_TICKS * 1000000.0 / time_freq());
+}
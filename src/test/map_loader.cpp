@@ -0,0 +1,87 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/map_loader.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+
+#include <game/mapitems.h>
+
+#include <memory>
+
+static void WriteMap(IStorage *pStorage, const char *pFilename)
+{
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, pFilename));
+	CMapItemVersion Version;
+	Version.m_Version = CMapItemVersion::CURRENT_VERSION;
+	Writer.AddItem(MAPITEMTYPE_VERSION, 0, sizeof(Version), &Version);
+	Writer.Finish();
+}
+
+TEST(MapLoader, Load)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	auto pStorage = std::unique_ptr<IStorage>(Info.CreateTestStorage());
+	ASSERT_TRUE(pStorage->CreateFolder("maps", IStorage::TYPE_SAVE));
+	ASSERT_TRUE(pStorage->CreateFolder("maps7", IStorage::TYPE_SAVE));
+	WriteMap(pStorage.get(), "maps/test.map");
+	WriteMap(pStorage.get(), "maps7/test.map");
+
+	CMapLoader Loader(pStorage.get(), nullptr, "test", true);
+	Loader.Load();
+	ASSERT_TRUE(Loader.Success());
+	EXPECT_STREQ(Loader.MapName(), "test");
+	EXPECT_STREQ(Loader.Path(), "maps/test.map");
+	ASSERT_TRUE(Loader.Map()->IsLoaded());
+	EXPECT_NE(Loader.Map()->FindItem(MAPITEMTYPE_VERSION, 0), nullptr);
+
+	// the map sent to the clients is the one that was loaded
+	unsigned Size;
+	unsigned char *pData = Loader.TakeData(&Size);
+	ASSERT_NE(pData, nullptr);
+	EXPECT_EQ((int)Size, Loader.Map()->MapSize());
+	EXPECT_EQ(sha256(pData, Size), Loader.Map()->Sha256());
+	free(pData);
+	EXPECT_EQ(Loader.TakeData(&Size), nullptr);
+
+	unsigned SixupSize;
+	SHA256_DIGEST SixupSha256;
+	unsigned SixupCrc;
+	unsigned char *pSixupData = Loader.TakeSixupData(&SixupSize, &SixupSha256, &SixupCrc);
+	ASSERT_NE(pSixupData, nullptr);
+	EXPECT_EQ(SixupSha256, sha256(pSixupData, SixupSize));
+	EXPECT_EQ(SixupCrc, Loader.Map()->Crc());
+	free(pSixupData);
+
+	// the loaded map is handed over, not copied
+	std::unique_ptr<IEngineMap> pMap(CreateEngineMap());
+	pMap->Take(Loader.Map());
+	EXPECT_TRUE(pMap->IsLoaded());
+	EXPECT_FALSE(Loader.Map()->IsLoaded());
+}
+
+TEST(MapLoader, Missing)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	auto pStorage = std::unique_ptr<IStorage>(Info.CreateTestStorage());
+	ASSERT_TRUE(pStorage->CreateFolder("maps", IStorage::TYPE_SAVE));
+	WriteMap(pStorage.get(), "maps/test.map");
+
+	CMapLoader Missing(pStorage.get(), nullptr, "missing", false);
+	Missing.Load();
+	EXPECT_FALSE(Missing.Success());
+
+	// a missing 0.7 map does not fail the load
+	CMapLoader NoSixup(pStorage.get(), nullptr, "test", true);
+	NoSixup.Load();
+	EXPECT_TRUE(NoSixup.Success());
+	unsigned SixupSize;
+	SHA256_DIGEST SixupSha256;
+	unsigned SixupCrc;
+	EXPECT_EQ(NoSixup.TakeSixupData(&SixupSize, &SixupSha256, &SixupCrc), nullptr);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/mpsc_queue.h>
+
+#include <thread>
+#include <vector>
+
+TEST(MpscQueue, Empty)
+{
+	CMpscQueue<int, 4> Queue;
+	EXPECT_TRUE(Queue.Empty());
+	EXPECT_EQ(Queue.Size(), 0u);
+	EXPECT_FALSE(Queue.TryPop([](int &) { FAIL(); }));
+}
+
+TEST(MpscQueue, Order)
+{
+	CMpscQueue<int, 8> Queue;
+	for(int i = 0; i < 5; i++)
+		EXPECT_TRUE(Queue.TryPush([i](int &Slot) { Slot = i; }));
+	EXPECT_EQ(Queue.Size(), 5u);
+	for(int i = 0; i < 5; i++)
+	{
+		int Value = -1;
+		EXPECT_TRUE(Queue.TryPop([&](int &Slot) { Value = Slot; }));
+		EXPECT_EQ(Value, i);
+	}
+	EXPECT_TRUE(Queue.Empty());
+}
+
+TEST(MpscQueue, Full)
+{
+	CMpscQueue<int, 4> Queue;
+	for(int i = 0; i < 4; i++)
+		EXPECT_TRUE(Queue.TryPush([i](int &Slot) { Slot = i; }));
+	EXPECT_FALSE(Queue.TryPush([](int &) { FAIL(); }));
+	EXPECT_TRUE(Queue.TryPop([](int &Slot) { EXPECT_EQ(Slot, 0); }));
+	EXPECT_TRUE(Queue.TryPush([](int &Slot) { Slot = 4; }));
+	for(int i = 1; i <= 4; i++)
+		EXPECT_TRUE(Queue.TryPop([i](int &Slot) { EXPECT_EQ(Slot, i); }));
+	EXPECT_TRUE(Queue.Empty());
+}
+
+TEST(MpscQueue, Wraparound)
+{
+	CMpscQueue<int, 4> Queue;
+	for(int i = 0; i < 1000; i++)
+	{
+		EXPECT_TRUE(Queue.TryPush([i](int &Slot) { Slot = i; }));
+		EXPECT_TRUE(Queue.TryPush([i](int &Slot) { Slot = -i; }));
+		EXPECT_TRUE(Queue.TryPop([i](int &Slot) { EXPECT_EQ(Slot, i); }));
+		EXPECT_TRUE(Queue.TryPop([i](int &Slot) { EXPECT_EQ(Slot, -i); }));
+	}
+}
+
+TEST(MpscQueue, MultipleProducers)
+{
+	static const int NUM_PRODUCERS = 4;
+	static const int NUM_ITEMS = 20000;
+
+	struct CItem
+	{
+		int m_Producer;
+		int m_Index;
+	};
+	CMpscQueue<CItem, 64> Queue;
+
+	std::vector<std::thread> vProducers;
+	for(int p = 0; p < NUM_PRODUCERS; p++)
+	{
+		vProducers.emplace_back([&Queue, p]() {
+			for(int i = 0; i < NUM_ITEMS; i++)
+			{
+				while(!Queue.TryPush([&](CItem &Item) { Item.m_Producer = p; Item.m_Index = i; }))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	// items of each producer must arrive exactly once and in order
+	int aNext[NUM_PRODUCERS] = {0};
+	int Received = 0;
+	while(Received < NUM_PRODUCERS * NUM_ITEMS)
+	{
+		if(!Queue.TryPop([&](CItem &Item) {
+			   ASSERT_EQ(Item.m_Index, aNext[Item.m_Producer]);
+			   aNext[Item.m_Producer]++;
+		   }))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		Received++;
+	}
+
+	for(auto &Producer : vProducers)
+		Producer.join();
+	for(int Next : aNext)
+		EXPECT_EQ(Next, NUM_ITEMS);
+	EXPECT_TRUE(Queue.Empty());
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <engine/server/mqtt_connection.h>
+
+TEST(MqttConnection, FirstAttempt)
+{
+	CMqttConnectionState State;
+	State.Init(100, 1000, 0.0f);
+	EXPECT_EQ(State.State(), CMqttConnectionState::STATE_OFFLINE);
+	EXPECT_TRUE(State.StartAttempt(0));
+	EXPECT_EQ(State.State(), CMqttConnectionState::STATE_CONNECTING);
+	// only one attempt at a time
+	EXPECT_FALSE(State.StartAttempt(0));
+	State.OnConnected();
+	EXPECT_TRUE(State.IsConnected());
+	EXPECT_FALSE(State.StartAttempt(10000));
+	EXPECT_EQ(State.NumReconnects(), 0);
+}
+
+TEST(MqttConnection, Backoff)
+{
+	CMqttConnectionState State;
+	State.Init(100, 1000, 0.0f);
+
+	int64_t Now = 0;
+	const int64_t aExpected[] = {100, 200, 400, 800, 1000, 1000};
+	for(int64_t Expected : aExpected)
+	{
+		ASSERT_TRUE(State.StartAttempt(Now));
+		State.OnConnectFailed(Now);
+		EXPECT_EQ(State.NextAttempt(), Now + Expected);
+		EXPECT_FALSE(State.StartAttempt(Now + Expected - 1));
+		Now += Expected;
+	}
+	EXPECT_EQ(State.FailedAttempts(), 6);
+
+	ASSERT_TRUE(State.StartAttempt(Now));
+	State.OnConnected();
+	EXPECT_EQ(State.FailedAttempts(), 0);
+	EXPECT_EQ(State.Backoff(), 100);
+}
+
+TEST(MqttConnection, ConnectionLost)
+{
+	CMqttConnectionState State;
+	State.Init(100, 1000, 0.0f);
+	ASSERT_TRUE(State.StartAttempt(0));
+	State.OnConnected();
+
+	// lose the connection repeatedly, e.g. a broker being restarted under load
+	int64_t Now = 5000;
+	for(int i = 1; i <= 5; i++)
+	{
+		State.OnConnectionLost(Now);
+		EXPECT_FALSE(State.IsConnected());
+		EXPECT_EQ(State.NextAttempt(), Now + 100);
+		EXPECT_FALSE(State.StartAttempt(Now + 50));
+		ASSERT_TRUE(State.StartAttempt(Now + 100));
+		State.OnConnectFailed(Now + 100);
+		EXPECT_EQ(State.NextAttempt(), Now + 100 + 200);
+		ASSERT_TRUE(State.StartAttempt(Now + 300));
+		State.OnConnected();
+		EXPECT_EQ(State.NumReconnects(), i);
+		Now += 10000;
+	}
+}
+
+TEST(MqttConnection, Jitter)
+{
+	CMqttConnectionState State;
+	State.Init(1000, 1000, 0.5f);
+	for(int i = 0; i < 100; i++)
+	{
+		ASSERT_TRUE(State.StartAttempt(State.NextAttempt()));
+		const int64_t Now = State.NextAttempt();
+		State.OnConnectFailed(Now);
+		EXPECT_GE(State.NextAttempt(), Now + 500);
+		EXPECT_LE(State.NextAttempt(), Now + 1000);
+	}
+}
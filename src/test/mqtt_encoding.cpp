@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <engine/server/mqtt_encoding.h>
+
+using json = nlohmann::json;
+
+static const char *TestChannelName(int Channel)
+{
+	static const char *const s_apNames[] = {"server", "chat", "players"};
+	return s_apNames[Channel];
+}
+
+TEST(MqttEncoding, Names)
+{
+	EXPECT_EQ(MqttEncodingFromName("json"), MQTT_ENCODING_JSON);
+	EXPECT_EQ(MqttEncodingFromName("CBOR"), MQTT_ENCODING_CBOR);
+	EXPECT_EQ(MqttEncodingFromName("msgpack"), MQTT_ENCODING_MSGPACK);
+	EXPECT_EQ(MqttEncodingFromName("text"), -1);
+	EXPECT_EQ(MqttEncodingFromName("xml"), -1);
+	EXPECT_STREQ(MqttContentType(MQTT_ENCODING_MSGPACK), "application/msgpack");
+}
+
+TEST(MqttEncoding, RoundTrip)
+{
+	const json Payload = json::parse(R"({"cid": 3, "name": "nameless tee", "message": "hi", "team": -1, "afk": false, "pos": {"x": 1.5}})");
+	std::string Out;
+
+	MqttEncode(MQTT_ENCODING_JSON, Payload, Out);
+	EXPECT_EQ(json::parse(Out), Payload);
+
+	MqttEncode(MQTT_ENCODING_CBOR, Payload, Out);
+	EXPECT_EQ(json::from_cbor(Out), Payload);
+	// maps start with major type 5
+	EXPECT_EQ((unsigned char)Out[0] & 0xe0, 0xa0);
+
+	MqttEncode(MQTT_ENCODING_MSGPACK, Payload, Out);
+	EXPECT_EQ(json::from_msgpack(Out), Payload);
+	EXPECT_EQ((unsigned char)Out[0] & 0xf0, 0x80);
+	EXPECT_LT(Out.size(), Payload.dump().size());
+}
+
+TEST(MqttEncoding, ParseList)
+{
+	int aEncodings[3] = {MQTT_ENCODING_JSON, MQTT_ENCODING_JSON, MQTT_ENCODING_JSON};
+	EXPECT_TRUE(MqttParseEncodings("msgpack", aEncodings, 3, TestChannelName));
+	EXPECT_EQ(aEncodings[0], MQTT_ENCODING_MSGPACK);
+	EXPECT_EQ(aEncodings[2], MQTT_ENCODING_MSGPACK);
+
+	EXPECT_TRUE(MqttParseEncodings("json, players = cbor,chat=msgpack", aEncodings, 3, TestChannelName));
+	EXPECT_EQ(aEncodings[0], MQTT_ENCODING_JSON);
+	EXPECT_EQ(aEncodings[1], MQTT_ENCODING_MSGPACK);
+	EXPECT_EQ(aEncodings[2], MQTT_ENCODING_CBOR);
+
+	EXPECT_FALSE(MqttParseEncodings("chat=json,unknown=cbor,server=xml", aEncodings, 3, TestChannelName));
+	EXPECT_EQ(aEncodings[0], MQTT_ENCODING_JSON);
+	EXPECT_EQ(aEncodings[1], MQTT_ENCODING_JSON);
+	EXPECT_EQ(aEncodings[2], MQTT_ENCODING_CBOR);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <engine/server/mqtt_limiter.h>
+
+#include <thread>
+#include <vector>
+
+TEST(MqttLimiter, Unlimited)
+{
+	CMqttRateLimiter Limiter;
+	for(int i = 0; i < 1000; i++)
+		EXPECT_TRUE(Limiter.Allow(0, 0, 1));
+	EXPECT_EQ(Limiter.Dropped(), 0u);
+}
+
+TEST(MqttLimiter, Burst)
+{
+	CMqttRateLimiter Limiter;
+	for(int i = 0; i < 5; i++)
+		EXPECT_TRUE(Limiter.Allow(1000, 10, 5));
+	EXPECT_FALSE(Limiter.Allow(1000, 10, 5));
+	EXPECT_FALSE(Limiter.Allow(1009, 10, 5));
+	EXPECT_EQ(Limiter.Dropped(), 2u);
+
+	// one token per interval
+	EXPECT_TRUE(Limiter.Allow(1010, 10, 5));
+	EXPECT_FALSE(Limiter.Allow(1010, 10, 5));
+	EXPECT_TRUE(Limiter.Allow(1020, 10, 5));
+
+	// a long pause refills the bucket, but not beyond its size
+	for(int i = 0; i < 5; i++)
+		EXPECT_TRUE(Limiter.Allow(100000, 10, 5));
+	EXPECT_FALSE(Limiter.Allow(100000, 10, 5));
+}
+
+TEST(MqttLimiter, Rate)
+{
+	CMqttRateLimiter Limiter;
+	int Allowed = 0;
+	// 10 attempts per interval over 1000 intervals
+	for(int64_t Now = 0; Now < 10000; Now++)
+		Allowed += Limiter.Allow(Now, 10, 20);
+	EXPECT_GE(Allowed, 1000);
+	EXPECT_LE(Allowed, 1000 + 20);
+	EXPECT_EQ(Limiter.Dropped(), 10000u - Allowed);
+}
+
+TEST(MqttLimiter, Threads)
+{
+	static const int NUM_THREADS = 4;
+	CMqttRateLimiter Limiter;
+	std::atomic<int> Allowed(0);
+	std::vector<std::thread> vThreads;
+	for(int t = 0; t < NUM_THREADS; t++)
+	{
+		vThreads.emplace_back([&]() {
+			for(int i = 0; i < 10000; i++)
+				Allowed += Limiter.Allow(0, 10, 100);
+		});
+	}
+	for(auto &Thread : vThreads)
+		Thread.join();
+	// the time stands still, exactly the burst gets through
+	EXPECT_EQ(Allowed, 100);
+	EXPECT_EQ(Limiter.Dropped(), NUM_THREADS * 10000u - 100);
+}
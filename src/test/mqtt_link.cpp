@@ -0,0 +1,285 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/mqtt_encoding.h>
+#include <engine/server/mqtt_link.h>
+#include <engine/shared/mpsc_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Broker that can be taken down and restarted, reports to the link like
+// the Paho client does
+class CFakeBroker : public IMqttTransport
+{
+	IHandler *m_pHandler = nullptr;
+	bool m_Up = true;
+	bool m_Connected = false;
+
+public:
+	std::mutex m_Mutex;
+	std::vector<std::string> m_vTopics;
+	std::vector<std::string> m_vReceived;
+	std::atomic<int> m_NumReceived{0};
+	int m_NumConnects = 0;
+	int m_NumRejected = 0;
+
+	void SetHandler(IHandler *pHandler) override { m_pHandler = pHandler; }
+	void SetMessageCallback(FMessageCallback Callback) override {}
+
+	bool Connect() override
+	{
+		std::unique_lock Lock(m_Mutex);
+		m_NumConnects++;
+		m_Connected = m_Up;
+		if(m_Connected)
+			m_pHandler->OnConnected();
+		else
+			m_pHandler->OnConnectFailed();
+		return true;
+	}
+
+	bool Subscribe(const char *pTopic, int Qos) override
+	{
+		std::unique_lock Lock(m_Mutex);
+		return m_Connected;
+	}
+
+	bool Publish(const CMqttTransportMessage &Message) override
+	{
+		std::unique_lock Lock(m_Mutex);
+		if(!m_Connected)
+		{
+			m_NumRejected++;
+			return false;
+		}
+		m_vTopics.emplace_back(Message.m_pTopic);
+		m_vReceived.emplace_back((const char *)Message.m_pData, Message.m_Size);
+		m_NumReceived++;
+		return true;
+	}
+
+	void Kill()
+	{
+		std::unique_lock Lock(m_Mutex);
+		m_Up = false;
+		if(m_Connected)
+		{
+			m_Connected = false;
+			m_pHandler->OnConnectionLost();
+		}
+	}
+
+	void Restart()
+	{
+		std::unique_lock Lock(m_Mutex);
+		m_Up = true;
+	}
+};
+
+class MqttLink : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	CFakeBroker m_Broker;
+	CMqttLink m_Link;
+
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_Link.Spool().Init(m_Info.m_aFilename, 16 * 1024 * 1024, 0, 64 * 1024));
+	}
+
+	void TearDown() override
+	{
+		m_Link.Spool().Shutdown();
+		fs_removedir(m_Info.m_aFilename);
+	}
+
+	bool Send(const char *pText)
+	{
+		return m_Link.Send(1, MQTT_ENCODING_TEXT, pText, str_length(pText));
+	}
+};
+
+TEST_F(MqttLink, SpoolWhileDisconnected)
+{
+	int Wakeups = 0;
+	m_Link.Init(&m_Broker, {"server/a", "server/b"}, time_freq(), 8 * time_freq(), 0.0f, [&]() { Wakeups++; });
+	const int64_t Now = time_get();
+
+	// not connected yet
+	EXPECT_FALSE(Send("a"));
+	EXPECT_EQ(m_Link.Spool().NumMessages(), 1);
+
+	// the result of the connect arrives as an event
+	EXPECT_FALSE(m_Link.Update(Now));
+	EXPECT_EQ(m_Broker.m_NumConnects, 1);
+	EXPECT_EQ(Wakeups, 1);
+	EXPECT_TRUE(m_Link.HasEvents());
+	EXPECT_FALSE(m_Link.Connected());
+	EXPECT_TRUE(m_Link.Update(Now));
+	EXPECT_TRUE(m_Link.Connected());
+	EXPECT_FALSE(m_Link.Update(Now));
+
+	// queued behind the spool, which is replayed at the drain interval
+	EXPECT_EQ(m_Link.Timeout(Now), CMqttLink::DRAIN_INTERVAL);
+	EXPECT_FALSE(Send("b"));
+	EXPECT_TRUE(m_Broker.m_vReceived.empty());
+	m_Link.Drain(Now + time_freq(), 1000);
+	EXPECT_TRUE(m_Link.Spool().Empty());
+	EXPECT_EQ(m_Link.Timeout(Now), -1);
+	EXPECT_TRUE(Send("c"));
+
+	// publishing fails before the link learns about the lost connection
+	m_Broker.Kill();
+	EXPECT_FALSE(Send("d"));
+	EXPECT_EQ(m_Broker.m_NumRejected, 1);
+	EXPECT_FALSE(Send("e"));
+	EXPECT_EQ(m_Broker.m_NumRejected, 1);
+	EXPECT_FALSE(m_Link.Update(Now));
+	EXPECT_FALSE(m_Link.Connected());
+	EXPECT_EQ(m_Link.Timeout(Now), 1001);
+	EXPECT_FALSE(Send("f"));
+	EXPECT_EQ(m_Link.Spool().NumMessages(), 3);
+
+	// the broker is still down, the backoff doubles
+	EXPECT_FALSE(m_Link.Update(Now + time_freq()));
+	EXPECT_EQ(m_Broker.m_NumConnects, 2);
+	EXPECT_FALSE(m_Link.Update(Now + time_freq()));
+	EXPECT_EQ(m_Link.Connection().FailedAttempts(), 1);
+	EXPECT_EQ(m_Link.Timeout(Now + time_freq()), 2001);
+	EXPECT_FALSE(m_Link.Update(Now + 2 * time_freq()));
+	EXPECT_EQ(m_Broker.m_NumConnects, 2);
+
+	m_Broker.Restart();
+	EXPECT_FALSE(m_Link.Update(Now + 3 * time_freq()));
+	EXPECT_TRUE(m_Link.Update(Now + 3 * time_freq()));
+	EXPECT_EQ(m_Link.Connection().NumReconnects(), 1);
+	m_Link.Drain(Now + 4 * time_freq(), 1000);
+	EXPECT_TRUE(m_Link.Spool().Empty());
+
+	const std::vector<std::string> vExpected = {"a", "b", "c", "d", "e", "f"};
+	EXPECT_EQ(m_Broker.m_vReceived, vExpected);
+	for(const std::string &Topic : m_Broker.m_vTopics)
+		EXPECT_EQ(Topic, "server/b");
+}
+
+TEST_F(MqttLink, DrainRate)
+{
+	m_Link.Init(&m_Broker, {"server"}, time_freq(), time_freq(), 0.0f, nullptr);
+	const int64_t Now = time_get();
+	for(int i = 0; i < 100; i++)
+		m_Link.Send(0, MQTT_ENCODING_TEXT, "x", 1);
+	m_Link.Update(Now);
+	EXPECT_TRUE(m_Link.Update(Now));
+
+	// the budget covers at most one second
+	m_Link.Drain(Now + 10 * time_freq(), 30);
+	EXPECT_EQ(m_Broker.m_vReceived.size(), 30u);
+	m_Link.Drain(Now + 10 * time_freq() + time_freq() / 10, 30);
+	EXPECT_EQ(m_Broker.m_vReceived.size(), 33u);
+	m_Link.Drain(Now + 10 * time_freq() + time_freq() / 10, 30);
+	EXPECT_EQ(m_Broker.m_vReceived.size(), 33u);
+}
+
+TEST_F(MqttLink, ReconnectUnderLoad)
+{
+	// the MQTT thread of CMqtt in small: events, drain and the queue
+	static const int NUM_MESSAGES = 10000;
+	static const int NUM_DROPS = 5;
+	CMpscQueue<int, 256> Queue;
+	std::mutex Lock;
+	std::condition_variable Cv;
+	std::atomic<bool> Stop(false);
+	std::atomic<int> NumProduced(0);
+	std::atomic<int> NumSpooled(0);
+	int MaxSpooled = 0;
+
+	auto Wakeup = [&]() {
+		{
+			std::unique_lock WakeupLock(Lock);
+		}
+		Cv.notify_one();
+	};
+	m_Link.Init(&m_Broker, {"server"}, time_freq() / 1000, time_freq() / 200, 0.25f, Wakeup);
+
+	std::thread MqttThread([&]() {
+		while(!Stop)
+		{
+			m_Link.Update(time_get());
+			m_Link.Drain(time_get(), 100000);
+			while(Queue.TryPop([&](int &Value) {
+				char aBuf[16];
+				str_format(aBuf, sizeof(aBuf), "%d", Value);
+				if(!m_Link.Send(0, MQTT_ENCODING_TEXT, aBuf, str_length(aBuf)))
+					NumSpooled++;
+			}))
+			{
+			}
+			MaxSpooled = std::max(MaxSpooled, m_Link.Spool().NumMessages());
+
+			const int64_t Timeout = m_Link.Timeout(time_get());
+			std::unique_lock WaitLock(Lock);
+			auto HasWork = [&]() { return Stop || m_Link.HasEvents() || !Queue.Empty(); };
+			if(Timeout >= 0)
+				Cv.wait_for(WaitLock, std::chrono::milliseconds(Timeout), HasWork);
+			else
+				Cv.wait(WaitLock, HasWork);
+		}
+	});
+
+	std::thread Producer([&]() {
+		for(int i = 0; i < NUM_MESSAGES; i++)
+		{
+			while(!Queue.TryPush([i](int &Slot) { Slot = i; }))
+				std::this_thread::yield();
+			NumProduced++;
+			Wakeup();
+			if(i % 10 == 9)
+				std::this_thread::sleep_for(std::chrono::microseconds(20));
+		}
+	});
+
+	auto WaitFor = [](auto &&Condition) {
+		const int64_t Deadline = time_get() + 20 * time_freq();
+		while(!Condition() && time_get() < Deadline)
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		return Condition();
+	};
+
+	// the threads have to be joined, failures must not return early
+	int Received = 0;
+	for(int Drop = 0; Drop < NUM_DROPS; Drop++)
+	{
+		// kill the broker while messages are flowing again and keep it
+		// down until enough of them went to the spool
+		EXPECT_TRUE(WaitFor([&]() { return m_Broker.m_NumReceived >= Received + 200; }));
+		const int Spooled = NumSpooled;
+		m_Broker.Kill();
+		EXPECT_TRUE(WaitFor([&]() { return NumSpooled >= Spooled + 100; }));
+		Received = m_Broker.m_NumReceived;
+		m_Broker.Restart();
+	}
+
+	EXPECT_TRUE(WaitFor([&]() { return m_Broker.m_NumReceived >= NUM_MESSAGES; }));
+	Producer.join();
+	Stop = true;
+	Wakeup();
+	MqttThread.join();
+
+	EXPECT_EQ(NumProduced, NUM_MESSAGES);
+	ASSERT_EQ(m_Broker.m_vReceived.size(), (size_t)NUM_MESSAGES);
+	for(int i = 0; i < NUM_MESSAGES; i++)
+		ASSERT_EQ(m_Broker.m_vReceived[i], std::to_string(i));
+	EXPECT_EQ(m_Link.Connection().NumReconnects(), NUM_DROPS);
+	EXPECT_GE(NumSpooled, NUM_DROPS * 100);
+	EXPECT_GE(MaxSpooled, 100);
+	EXPECT_TRUE(m_Link.Spool().Empty());
+}
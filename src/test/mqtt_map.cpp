@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/mqtt_map.h>
+
+#include <game/mapitems.h>
+
+#include <vector>
+
+static std::vector<CTile> MakeLayer(int Width, int Height, int Seed)
+{
+	std::vector<CTile> vTiles(Width * Height);
+	for(int y = 0; y < Height; y++)
+	{
+		for(int x = 0; x < Width; x++)
+		{
+			CTile &Tile = vTiles[y * Width + x];
+			mem_zero(&Tile, sizeof(Tile));
+			Tile.m_Index = (x == 0 || y == Height - 1) ? TILE_SOLID : (x * 7 + y * 13 + Seed) % 5 == 0 ? TILE_FREEZE : TILE_AIR;
+			Tile.m_Flags = Seed; // must not end up in the payload
+		}
+	}
+	return vTiles;
+}
+
+TEST(MqttMap, RoundTrip)
+{
+	const int Width = 37;
+	const int Height = 23;
+	SHA256_DIGEST Sha256 = sha256("map", 3);
+	std::vector<CTile> vGame = MakeLayer(Width, Height, 1);
+	std::vector<CTile> vFront = MakeLayer(Width, Height, 2);
+
+	std::vector<unsigned char> vPayload;
+	ASSERT_TRUE(CMqttMapPayload::Encode(Sha256, Width, Height, vGame.data(), vFront.data(), vPayload));
+
+	CMqttMapPayload Map;
+	ASSERT_TRUE(Map.Decode(vPayload.data(), vPayload.size()));
+	EXPECT_EQ(Map.m_Sha256, Sha256);
+	EXPECT_EQ(Map.m_Width, Width);
+	EXPECT_EQ(Map.m_Height, Height);
+	ASSERT_EQ(Map.m_vLayers.size(), 2u);
+	EXPECT_EQ(Map.m_vLayers[0].m_Type, (int)CMqttMapPayload::LAYER_GAME);
+	EXPECT_EQ(Map.m_vLayers[1].m_Type, (int)CMqttMapPayload::LAYER_FRONT);
+	for(int i = 0; i < Width * Height; i++)
+	{
+		EXPECT_EQ(Map.m_vLayers[0].m_vIndices[i], vGame[i].m_Index);
+		EXPECT_EQ(Map.m_vLayers[1].m_vIndices[i], vFront[i].m_Index);
+	}
+}
+
+TEST(MqttMap, NoFront)
+{
+	SHA256_DIGEST Sha256 = sha256("map", 3);
+	std::vector<CTile> vGame = MakeLayer(5, 4, 3);
+
+	std::vector<unsigned char> vPayload;
+	ASSERT_TRUE(CMqttMapPayload::Encode(Sha256, 5, 4, vGame.data(), nullptr, vPayload));
+
+	CMqttMapPayload Map;
+	ASSERT_TRUE(Map.Decode(vPayload.data(), vPayload.size()));
+	ASSERT_EQ(Map.m_vLayers.size(), 1u);
+	EXPECT_EQ(Map.m_vLayers[0].m_vIndices[5], vGame[5].m_Index);
+}
+
+TEST(MqttMap, Malformed)
+{
+	SHA256_DIGEST Sha256 = sha256("map", 3);
+	std::vector<CTile> vGame = MakeLayer(8, 8, 4);
+	std::vector<unsigned char> vPayload;
+	ASSERT_TRUE(CMqttMapPayload::Encode(Sha256, 8, 8, vGame.data(), nullptr, vPayload));
+
+	CMqttMapPayload Map;
+	EXPECT_FALSE(Map.Decode(vPayload.data(), CMqttMapPayload::HEADER_SIZE - 1));
+	EXPECT_FALSE(Map.Decode(vPayload.data(), vPayload.size() - 1));
+
+	std::vector<unsigned char> vCorrupt = vPayload;
+	vCorrupt[0] = 'X';
+	EXPECT_FALSE(Map.Decode(vCorrupt.data(), vCorrupt.size()));
+
+	vCorrupt = vPayload;
+	vCorrupt[vCorrupt.size() - 3] ^= 0xff;
+	EXPECT_FALSE(Map.Decode(vCorrupt.data(), vCorrupt.size()));
+}
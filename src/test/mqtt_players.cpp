@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/mqtt_players.h>
+
+using json = nlohmann::json;
+
+class MqttPlayers : public ::testing::Test
+{
+protected:
+	CMqttPlayerTracker m_Tracker;
+	CMqttPlayerState m_aStates[MAX_CLIENTS];
+
+	MqttPlayers()
+	{
+		mem_zero(m_aStates, sizeof(m_aStates));
+		m_Tracker.Init(100);
+	}
+
+	void AddPlayer(int ClientId, const char *pName)
+	{
+		CMqttPlayerState &State = m_aStates[ClientId];
+		State.m_Active = true;
+		str_copy(State.m_aName, pName);
+		str_copy(State.m_aSkinName, "default");
+		State.m_IsCharacter = true;
+		State.m_PosX = 100;
+		State.m_PosY = 200;
+	}
+};
+
+TEST_F(MqttPlayers, Keyframe)
+{
+	AddPlayer(3, "nameless tee");
+	json Out;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 0, Out));
+	EXPECT_TRUE(Out["keyframe"].get<bool>());
+	EXPECT_EQ(Out["players"].size(), 1u);
+	EXPECT_EQ(Out["players"]["3"]["name"], "nameless tee");
+	EXPECT_EQ(Out["players"]["3"]["teeinfo"]["skinname"], "default");
+	EXPECT_EQ(Out["players"]["3"]["ischaracter"], true);
+	EXPECT_EQ(Out["players"]["3"]["character"]["pos"]["x"], 100);
+	EXPECT_EQ(Out["players"]["3"]["latency"]["avg"], 0);
+}
+
+TEST_F(MqttPlayers, OnlyChanges)
+{
+	AddPlayer(0, "a");
+	AddPlayer(1, "b");
+	json Out;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 0, Out));
+
+	EXPECT_FALSE(m_Tracker.Update(m_aStates, 1, Out));
+
+	m_aStates[1].m_PosX = 101;
+	m_aStates[1].m_LatencyAvg = 20;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 2, Out));
+	EXPECT_FALSE(Out["keyframe"].get<bool>());
+	EXPECT_EQ(Out["players"], json::parse(R"({"1": {"character": {"pos": {"x": 101}}, "latency": {"avg": 20}}})"));
+}
+
+TEST_F(MqttPlayers, JoinAndLeave)
+{
+	AddPlayer(0, "a");
+	json Out;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 0, Out));
+
+	AddPlayer(5, "new");
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 1, Out));
+	ASSERT_EQ(Out["players"].size(), 1u);
+	EXPECT_EQ(Out["players"]["5"]["name"], "new");
+	EXPECT_EQ(Out["players"]["5"]["character"]["pos"]["y"], 200);
+	EXPECT_FALSE(Out.contains("left"));
+
+	m_aStates[0].m_Active = false;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 2, Out));
+	EXPECT_TRUE(Out["players"].empty());
+	EXPECT_EQ(Out["left"], json::array({0}));
+}
+
+TEST_F(MqttPlayers, Character)
+{
+	AddPlayer(2, "a");
+	m_aStates[2].m_IsCharacter = false;
+	json Out;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 0, Out));
+	EXPECT_EQ(Out["players"]["2"]["ischaracter"], false);
+	EXPECT_FALSE(Out["players"]["2"].contains("character"));
+
+	// a spawning character comes with all its fields
+	m_aStates[2].m_IsCharacter = true;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 1, Out));
+	EXPECT_EQ(Out["players"]["2"]["ischaracter"], true);
+	EXPECT_EQ(Out["players"]["2"]["character"]["pos"]["x"], 100);
+	EXPECT_EQ(Out["players"]["2"]["character"]["hookstate"], 0);
+	EXPECT_FALSE(Out["players"]["2"].contains("name"));
+}
+
+TEST_F(MqttPlayers, KeyframeInterval)
+{
+	AddPlayer(0, "a");
+	json Out;
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 0, Out));
+	EXPECT_FALSE(m_Tracker.Update(m_aStates, 99, Out));
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 100, Out));
+	EXPECT_TRUE(Out["keyframe"].get<bool>());
+	EXPECT_EQ(Out["players"]["0"]["name"], "a");
+
+	m_Tracker.RequestKeyframe();
+	ASSERT_TRUE(m_Tracker.Update(m_aStates, 101, Out));
+	EXPECT_TRUE(Out["keyframe"].get<bool>());
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/mqtt_requests.h>
+
+#include <vector>
+
+class MqttRequests : public ::testing::Test
+{
+protected:
+	CMqttPendingRequests m_Requests;
+	std::vector<CMqttPendingRequests::CRequest> m_vExpired;
+
+	MqttRequests()
+	{
+		// requests time out after 100 units, checked every 10
+		m_Requests.Init(100, 10, 0x1234);
+	}
+};
+
+TEST_F(MqttRequests, AddComplete)
+{
+	const uint64_t Id = m_Requests.Add(3, 42, 0);
+	ASSERT_NE(Id, 0u);
+	EXPECT_EQ(Id >> 32, 0x1234u);
+	EXPECT_TRUE(m_Requests.HasPending(3));
+	EXPECT_EQ(m_Requests.NumPending(), 1);
+
+	CMqttPendingRequests::CRequest Request;
+	ASSERT_TRUE(m_Requests.Complete(Id, Request));
+	EXPECT_EQ(Request.m_Id, Id);
+	EXPECT_EQ(Request.m_ClientId, 3);
+	EXPECT_EQ(Request.m_UniqueClientId, 42u);
+	EXPECT_FALSE(m_Requests.HasPending(3));
+	EXPECT_EQ(m_Requests.NumPending(), 0);
+
+	// a duplicate response is ignored
+	EXPECT_FALSE(m_Requests.Complete(Id, Request));
+
+	// nothing left to expire
+	m_Requests.Expire(1000, m_vExpired);
+	EXPECT_TRUE(m_vExpired.empty());
+}
+
+TEST_F(MqttRequests, OnePerClient)
+{
+	const uint64_t Id = m_Requests.Add(0, 1, 0);
+	ASSERT_NE(Id, 0u);
+	EXPECT_EQ(m_Requests.Add(0, 1, 5), 0u);
+	EXPECT_NE(m_Requests.Add(1, 2, 5), 0u);
+	EXPECT_EQ(m_Requests.Add(-1, 0, 5), 0u);
+	EXPECT_EQ(m_Requests.Add(MAX_CLIENTS, 0, 5), 0u);
+
+	CMqttPendingRequests::CRequest Request;
+	ASSERT_TRUE(m_Requests.Complete(Id, Request));
+	EXPECT_NE(m_Requests.Add(0, 1, 10), 0u);
+}
+
+TEST_F(MqttRequests, Expire)
+{
+	const uint64_t Id1 = m_Requests.Add(0, 0, 0);
+	const uint64_t Id2 = m_Requests.Add(1, 0, 55);
+
+	m_Requests.Expire(99, m_vExpired);
+	EXPECT_TRUE(m_vExpired.empty());
+
+	m_Requests.Expire(105, m_vExpired);
+	ASSERT_EQ(m_vExpired.size(), 1u);
+	EXPECT_EQ(m_vExpired[0].m_Id, Id1);
+	EXPECT_FALSE(m_Requests.HasPending(0));
+	EXPECT_TRUE(m_Requests.HasPending(1));
+
+	// never expires before the deadline, at most one slot after it
+	m_Requests.Expire(154, m_vExpired);
+	EXPECT_EQ(m_vExpired.size(), 1u);
+	m_Requests.Expire(160, m_vExpired);
+	ASSERT_EQ(m_vExpired.size(), 2u);
+	EXPECT_EQ(m_vExpired[1].m_Id, Id2);
+
+	// a response after the timeout doesn't match anymore
+	CMqttPendingRequests::CRequest Request;
+	EXPECT_FALSE(m_Requests.Complete(Id1, Request));
+	EXPECT_EQ(m_Requests.NumPending(), 0);
+}
+
+TEST_F(MqttRequests, ExpireLaps)
+{
+	// deadlines further away than one turn of the wheel
+	CMqttPendingRequests LongTimeout;
+	LongTimeout.Init(CMqttPendingRequests::WHEEL_SLOTS * 10 * 3, 10, 0);
+	LongTimeout.Add(0, 0, 0);
+	LongTimeout.Add(1, 0, 15);
+
+	for(int64_t Now = 0; Now < CMqttPendingRequests::WHEEL_SLOTS * 10 * 3; Now += 7)
+		LongTimeout.Expire(Now, m_vExpired);
+	EXPECT_TRUE(m_vExpired.empty());
+	EXPECT_EQ(LongTimeout.NumPending(), 2);
+
+	// skipping several laps at once still finds everything
+	LongTimeout.Expire(CMqttPendingRequests::WHEEL_SLOTS * 10 * 10, m_vExpired);
+	EXPECT_EQ(m_vExpired.size(), 2u);
+	EXPECT_EQ(LongTimeout.NumPending(), 0);
+}
+
+TEST_F(MqttRequests, ExpireMany)
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		ASSERT_NE(m_Requests.Add(i, i, i * 3), 0u);
+
+	for(int64_t Now = 0; Now <= MAX_CLIENTS * 3 + 110; Now += 10)
+	{
+		const size_t Before = m_vExpired.size();
+		m_Requests.Expire(Now, m_vExpired);
+		for(size_t i = Before; i < m_vExpired.size(); i++)
+		{
+			EXPECT_GE(Now, m_vExpired[i].m_Deadline);
+			EXPECT_LT(Now - m_vExpired[i].m_Deadline, 10 + 10);
+		}
+	}
+	EXPECT_EQ(m_vExpired.size(), (size_t)MAX_CLIENTS);
+	EXPECT_EQ(m_Requests.NumPending(), 0);
+}
+
+TEST_F(MqttRequests, Id)
+{
+	char aBuf[CMqttPendingRequests::CORRELATION_ID_LENGTH + 1];
+	CMqttPendingRequests::FormatId(0x00ab0000cd000001ull, aBuf, sizeof(aBuf));
+	EXPECT_STREQ(aBuf, "00ab0000cd000001");
+
+	uint64_t Id;
+	ASSERT_TRUE(CMqttPendingRequests::ParseId(aBuf, &Id));
+	EXPECT_EQ(Id, 0x00ab0000cd000001ull);
+	ASSERT_TRUE(CMqttPendingRequests::ParseId("00AB0000CD000001", &Id));
+	EXPECT_EQ(Id, 0x00ab0000cd000001ull);
+
+	EXPECT_FALSE(CMqttPendingRequests::ParseId("", &Id));
+	EXPECT_FALSE(CMqttPendingRequests::ParseId("00ab0000cd00001", &Id));
+	EXPECT_FALSE(CMqttPendingRequests::ParseId("00ab0000cd0000012", &Id));
+	EXPECT_FALSE(CMqttPendingRequests::ParseId("00ab0000cd00000g", &Id));
+	EXPECT_FALSE(CMqttPendingRequests::ParseId("0000000000000000", &Id));
+}
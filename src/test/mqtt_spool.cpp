@@ -0,0 +1,156 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/mqtt_spool.h>
+
+#include <string>
+#include <vector>
+
+class MqttSpool : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	CMqttSpool m_Spool;
+
+	struct CMessage
+	{
+		int m_Channel;
+		int m_Flags;
+		std::string m_Data;
+	};
+	std::vector<CMessage> m_vSent;
+
+	void TearDown() override
+	{
+		m_Spool.Shutdown();
+		fs_removedir(m_Info.m_aFilename);
+	}
+
+	void Push(int Channel, int64_t Timestamp, const char *pData, int Flags = 0)
+	{
+		EXPECT_TRUE(m_Spool.Push(Channel, Flags, Timestamp, pData, str_length(pData)));
+	}
+
+	int Drain(int64_t Now, int MaxMessages)
+	{
+		return m_Spool.Drain(Now, MaxMessages, [this](int Channel, int Flags, const void *pData, int Size) {
+			m_vSent.push_back({Channel, Flags, std::string((const char *)pData, Size)});
+			return true;
+		});
+	}
+};
+
+TEST_F(MqttSpool, Empty)
+{
+	ASSERT_TRUE(m_Spool.Init(m_Info.m_aFilename, 1024, 0, 256));
+	EXPECT_TRUE(m_Spool.Empty());
+	EXPECT_EQ(Drain(0, 100), 0);
+	EXPECT_EQ(m_Spool.DroppedTotal(), 0);
+}
+
+TEST_F(MqttSpool, Order)
+{
+	ASSERT_TRUE(m_Spool.Init(m_Info.m_aFilename, 1024 * 1024, 0, 64));
+	Push(1, 0, "first");
+	Push(2, 0, "second", 0xbeef);
+	Push(1, 0, "");
+	Push(3, 0, "fourth message spanning a new segment");
+	EXPECT_EQ(m_Spool.NumMessages(), 4);
+
+	EXPECT_EQ(Drain(0, 100), 4);
+	ASSERT_EQ(m_vSent.size(), 4u);
+	EXPECT_EQ(m_vSent[0].m_Channel, 1);
+	EXPECT_EQ(m_vSent[0].m_Data, "first");
+	EXPECT_EQ(m_vSent[0].m_Flags, 0);
+	EXPECT_EQ(m_vSent[1].m_Channel, 2);
+	EXPECT_EQ(m_vSent[1].m_Flags, 0xbeef);
+	EXPECT_EQ(m_vSent[1].m_Data, "second");
+	EXPECT_EQ(m_vSent[2].m_Data, "");
+	EXPECT_EQ(m_vSent[3].m_Channel, 3);
+	EXPECT_EQ(m_vSent[3].m_Data, "fourth message spanning a new segment");
+	EXPECT_TRUE(m_Spool.Empty());
+	EXPECT_EQ(m_Spool.NumBytes(), 0);
+}
+
+TEST_F(MqttSpool, Throttle)
+{
+	ASSERT_TRUE(m_Spool.Init(m_Info.m_aFilename, 1024 * 1024, 0, 1024));
+	for(int i = 0; i < 10; i++)
+	{
+		char aBuf[16];
+		str_format(aBuf, sizeof(aBuf), "%d", i);
+		Push(0, 0, aBuf);
+	}
+	EXPECT_EQ(Drain(0, 3), 3);
+	EXPECT_EQ(m_Spool.NumMessages(), 7);
+
+	// pushing while draining keeps the order
+	Push(0, 0, "10");
+	EXPECT_EQ(Drain(0, 100), 8);
+	ASSERT_EQ(m_vSent.size(), 11u);
+	for(int i = 0; i < 11; i++)
+		EXPECT_EQ(m_vSent[i].m_Data, std::to_string(i));
+}
+
+TEST_F(MqttSpool, SendFailure)
+{
+	ASSERT_TRUE(m_Spool.Init(m_Info.m_aFilename, 1024 * 1024, 0, 1024));
+	Push(0, 0, "a");
+	Push(0, 0, "b");
+
+	int Calls = 0;
+	EXPECT_EQ(m_Spool.Drain(0, 100, [&](int, int, const void *, int) { Calls++; return false; }), 0);
+	EXPECT_EQ(Calls, 1);
+	EXPECT_EQ(m_Spool.NumMessages(), 2);
+
+	EXPECT_EQ(Drain(0, 100), 2);
+	ASSERT_EQ(m_vSent.size(), 2u);
+	EXPECT_EQ(m_vSent[0].m_Data, "a");
+}
+
+TEST_F(MqttSpool, ByteLimit)
+{
+	// room for four segments of two 16 byte messages each
+	ASSERT_TRUE(m_Spool.Init(m_Info.m_aFilename, 4 * 2 * 32, 0, 2 * 32));
+	for(int i = 0; i < 20; i++)
+	{
+		char aBuf[17];
+		str_format(aBuf, sizeof(aBuf), "%016d", i);
+		Push(i % 2, 0, aBuf);
+		EXPECT_LE(m_Spool.NumBytes(), 4 * 2 * 32);
+	}
+	EXPECT_GT(m_Spool.DroppedTotal(), 0);
+	EXPECT_EQ(m_Spool.Dropped(0) + m_Spool.Dropped(1), m_Spool.DroppedTotal());
+	EXPECT_EQ(m_Spool.NumMessages() + m_Spool.DroppedTotal(), 20);
+
+	// the newest messages survive, in order
+	const int Remaining = m_Spool.NumMessages();
+	EXPECT_EQ(Drain(0, 100), Remaining);
+	for(int i = 0; i < Remaining; i++)
+		EXPECT_EQ(std::stoi(m_vSent[i].m_Data), 20 - Remaining + i);
+}
+
+TEST_F(MqttSpool, AgeLimit)
+{
+	ASSERT_TRUE(m_Spool.Init(m_Info.m_aFilename, 1024 * 1024, 60, 1024));
+	Push(4, 100, "old");
+	Push(5, 150, "new");
+	EXPECT_EQ(Drain(200, 100), 1);
+	ASSERT_EQ(m_vSent.size(), 1u);
+	EXPECT_EQ(m_vSent[0].m_Data, "new");
+	EXPECT_EQ(m_Spool.Dropped(4), 1);
+	EXPECT_EQ(m_Spool.Dropped(5), 0);
+	EXPECT_TRUE(m_Spool.Empty());
+}
+
+TEST_F(MqttSpool, TooLarge)
+{
+	ASSERT_TRUE(m_Spool.Init(m_Info.m_aFilename, 32, 0, 32));
+	char aBuf[64];
+	mem_zero(aBuf, sizeof(aBuf));
+	EXPECT_FALSE(m_Spool.Push(2, 0, 0, aBuf, sizeof(aBuf)));
+	EXPECT_EQ(m_Spool.Dropped(2), 1);
+	EXPECT_TRUE(m_Spool.Empty());
+}
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/server/mqtt_encoding.h>
+#include <engine/server/mqtt_link.h>
+#include <engine/server/mqtt_wakeup.h>
+#include <engine/shared/mpsc_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+TEST(MqttWakeup, NoLostWakeups)
+{
+	static const int NUM_PRODUCERS = 4;
+	static const int NUM_MESSAGES = 20000;
+	CMpscQueue<int, 1024> Queue;
+	CMqttWakeup Wakeup;
+
+	std::vector<std::thread> vProducers;
+	for(int p = 0; p < NUM_PRODUCERS; p++)
+	{
+		vProducers.emplace_back([&]() {
+			for(int i = 0; i < NUM_MESSAGES; i++)
+			{
+				while(!Queue.TryPush([i](int &Slot) { Slot = i; }))
+					std::this_thread::yield();
+				Wakeup.Wakeup();
+			}
+		});
+	}
+
+	// a lost wakeup only shows up as a wait that runs into its timeout
+	int Received = 0;
+	int TimedOut = 0;
+	while(Received < NUM_PRODUCERS * NUM_MESSAGES && TimedOut < 3)
+	{
+		while(Queue.TryPop([](int &) {}))
+			Received++;
+		const int64_t Start = time_get();
+		Wakeup.Wait(1000, [&]() { return !Queue.Empty() || Received == NUM_PRODUCERS * NUM_MESSAGES; });
+		if(time_get() - Start >= time_freq())
+			TimedOut++;
+	}
+	for(auto &Producer : vProducers)
+		Producer.join();
+
+	EXPECT_EQ(Received, NUM_PRODUCERS * NUM_MESSAGES);
+	EXPECT_EQ(TimedOut, 0);
+}
+
+// stands in for the Paho client, records the time from the enqueue to
+// the publish that is stored in the payload
+class CLatencyTransport : public IMqttTransport
+{
+public:
+	IHandler *m_pHandler = nullptr;
+	std::vector<int64_t> m_vLatencies;
+
+	void SetHandler(IHandler *pHandler) override { m_pHandler = pHandler; }
+	void SetMessageCallback(FMessageCallback Callback) override {}
+	bool Connect() override
+	{
+		m_pHandler->OnConnected();
+		return true;
+	}
+	bool Subscribe(const char *pTopic, int Qos) override { return true; }
+	bool Publish(const CMqttTransportMessage &Message) override
+	{
+		int64_t Enqueued;
+		mem_copy(&Enqueued, Message.m_pData, sizeof(Enqueued));
+		m_vLatencies.push_back(time_get() - Enqueued);
+		return true;
+	}
+};
+
+struct CWakeupResult
+{
+	double m_P50;
+	double m_P99;
+	double m_Max;
+	double m_LoopsPerMessage;
+	double m_IdleCpu;
+};
+
+// The MQTT thread of CMqtt with the publish stubbed out, fed like the tick
+// thread does: a burst of messages every tick, then an idle phase
+static CWakeupResult RunWakeupBenchmark(bool Spin)
+{
+	static const int TICK_SPEED = 50;
+	static const int NUM_TICKS = 100;
+	static const int MESSAGES_PER_TICK = 20;
+	CMpscQueue<int64_t, 2048> Queue;
+	CMqttWakeup Wakeup;
+	CLatencyTransport Transport;
+	CMqttLink Link;
+	std::atomic<bool> Stop(false);
+	std::atomic<int> Loops(0);
+
+	Link.Init(&Transport, {"server"}, time_freq(), time_freq(), 0.0f, [&]() { Wakeup.Wakeup(); });
+	Link.Update(time_get());
+	Link.Update(time_get());
+
+	std::thread MqttThread([&]() {
+		while(!Stop)
+		{
+			Link.Update(time_get());
+			Link.Drain(time_get(), 500);
+			while(Queue.TryPop([&](int64_t &Enqueued) {
+				Link.Send(0, MQTT_ENCODING_TEXT, &Enqueued, sizeof(Enqueued));
+			}))
+			{
+			}
+			Loops++;
+			// before the wakeup the thread polled without sleeping
+			if(!Spin)
+				Wakeup.Wait(Link.Timeout(time_get()), [&]() { return Stop || Link.HasEvents() || !Queue.Empty(); });
+		}
+	});
+
+	for(int Tick = 0; Tick < NUM_TICKS; Tick++)
+	{
+		for(int i = 0; i < MESSAGES_PER_TICK; i++)
+		{
+			const int64_t Now = time_get();
+			Queue.TryPush([Now](int64_t &Slot) { Slot = Now; });
+			Wakeup.Wakeup();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1000 / TICK_SPEED));
+	}
+	const int ActiveLoops = Loops;
+
+	const std::clock_t IdleStart = std::clock();
+	const int64_t IdleStartTime = time_get();
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	const double IdleCpu = (std::clock() - IdleStart) / (double)CLOCKS_PER_SEC / ((time_get() - IdleStartTime) / (double)time_freq());
+
+	Stop = true;
+	Wakeup.Wakeup();
+	MqttThread.join();
+
+	std::vector<int64_t> &vLatencies = Transport.m_vLatencies;
+	EXPECT_EQ(vLatencies.size(), (size_t)NUM_TICKS * MESSAGES_PER_TICK);
+	std::sort(vLatencies.begin(), vLatencies.end());
+	auto Micros = [](int64_t Time) { return Time * 1000000.0 / time_freq(); };
+	CWakeupResult Result;
+	Result.m_P50 = Micros(vLatencies[vLatencies.size() / 2]);
+	Result.m_P99 = Micros(vLatencies[vLatencies.size() * 99 / 100]);
+	Result.m_Max = Micros(vLatencies.back());
+	Result.m_LoopsPerMessage = ActiveLoops / (double)vLatencies.size();
+	Result.m_IdleCpu = IdleCpu * 100.0;
+	return Result;
+}
+
+TEST(MqttWakeup, DISABLED_Benchmark)
+{
+	for(bool Spin : {true, false})
+	{
+		const CWakeupResult Result = RunWakeupBenchmark(Spin);
+		dbg_msg("mqtt_wakeup", "%s: enqueue to publish p50 %.1f us, p99 %.1f us, max %.1f us, %.1f loops per message, idle %.1f%% cpu",
+			Spin ? "spin" : "wait", Result.m_P50, Result.m_P99, Result.m_Max, Result.m_LoopsPerMessage, Result.m_IdleCpu);
+	}
+}
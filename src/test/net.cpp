@@ -48,3 +48,67 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, Batching)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR Target;
+	ASSERT_FALSE(net_addr_from_str(&Target, "127.0.0.1"));
+	Target.port = Bindaddr.port;
+
+	// more packets than fit into one batch, they must arrive in order
+	const int NUM_PACKETS = 200;
+	NETSTATS Before;
+	net_stats(&Before);
+	net_udp_set_batching(Socket2, true);
+	for(int i = 0; i < NUM_PACKETS; i++)
+		EXPECT_EQ(net_udp_send(Socket2, &Target, &i, sizeof(i)), (int)sizeof(i));
+	EXPECT_GE(net_udp_flush(Socket2), 0);
+	NETSTATS After;
+	net_stats(&After);
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, (uint64_t)NUM_PACKETS);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_LT(After.send_calls - Before.send_calls, (uint64_t)NUM_PACKETS / 10);
+#endif
+
+	NETADDR Addr;
+	unsigned char *pData;
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		// received packets are buffered, only wait once they are used up
+		int Bytes;
+		while((Bytes = net_udp_recv(Socket1, &Addr, &pData)) <= 0)
+			ASSERT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+		ASSERT_EQ(Bytes, (int)sizeof(i));
+		int Value;
+		mem_copy(&Value, pData, sizeof(Value));
+		EXPECT_EQ(Value, i);
+	}
+
+#if defined(CONF_PLATFORM_LINUX)
+	// a queued packet that can't be sent is reported by the flush
+	NETADDR Invalid = Target;
+	Invalid.port = 0;
+	EXPECT_EQ(net_udp_send(Socket2, &Invalid, "xyz", 3), 3);
+	EXPECT_EQ(net_udp_flush(Socket2), -1);
+#endif
+
+	// queued packets are sent when the socket is closed
+	net_udp_send(Socket2, &Target, "abc", 3);
+	net_udp_close(Socket2);
+	ASSERT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+	ASSERT_EQ(net_udp_recv(Socket1, &Addr, &pData), 3);
+	EXPECT_EQ(mem_comp(pData, "abc", 3), 0);
+
+	net_udp_close(Socket1);
+}
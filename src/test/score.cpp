@@ -583,6 +583,289 @@ TEST_P(RandomMap, UnfinishedDoesntExist)
 	EXPECT_STREQ(m_pRandomMapResult->m_aMessage, "nameless tee has no more unfinished maps on this server!");
 }
 
+TEST(Leaderboard, Ties)
+{
+	CLeaderboard Leaderboard;
+	Leaderboard.Insert("b", 12.0f);
+	Leaderboard.Insert("a", 10.0f);
+	Leaderboard.Insert("c", 10.0f);
+	Leaderboard.Insert("b", 15.0f);
+	ASSERT_EQ(Leaderboard.Size(), 3);
+
+	std::vector<std::pair<int, std::string>> vTop;
+	Leaderboard.Top(0, 5, false, [&](int Rank, const char *pName, float Time) {
+		vTop.emplace_back(Rank, pName);
+	});
+	EXPECT_EQ(vTop, (std::vector<std::pair<int, std::string>>{{1, "a"}, {1, "c"}, {3, "b"}}));
+	EXPECT_EQ(Leaderboard.PercentRank(1), 0.0f);
+	EXPECT_EQ(Leaderboard.PercentRank(3), 1.0f);
+
+	Leaderboard.Insert("b", 9.999f);
+	float Time;
+	ASSERT_TRUE(Leaderboard.Find("b", &Time));
+	EXPECT_EQ(Time, 10.0f);
+	EXPECT_EQ(Leaderboard.Rank(Time), 1);
+	EXPECT_FALSE(Leaderboard.Find("d", &Time));
+}
+
+struct CachedScore : public Score
+{
+	CachedScore()
+	{
+		// the regional leaderboard matches servers containing the name
+		const char *apServers[] = {"GER", "USA", "CHL", "GER2"};
+		for(int i = 0; i < NUM_FINISHES; i++)
+		{
+			char aName[MAX_NAME_LENGTH];
+			str_format(aName, sizeof(aName), "tee %d", i % NUM_PLAYERS);
+			InsertFinish(aName, 30.0f + (i * 7919 % 10007) / 100.0f, apServers[i % 3 + (i % 7 == 0)]);
+		}
+	}
+
+	~CachedScore()
+	{
+		g_Config.m_SvRegionalRankings = 1;
+		g_Config.m_SvHideScore = 0;
+	}
+
+	enum
+	{
+		NUM_PLAYERS = 40,
+		NUM_FINISHES = 100,
+	};
+
+	void InsertFinish(const char *pName, float Time, const char *pServer)
+	{
+		str_copy(g_Config.m_SvSqlServerName, pServer, sizeof(g_Config.m_SvSqlServerName));
+		CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
+		str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+		str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+		str_copy(ScoreData.m_aName, pName, sizeof(ScoreData.m_aName));
+		ScoreData.m_ClientId = 0;
+		ScoreData.m_Time = Time;
+		str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+		for(float &TimeCp : ScoreData.m_aCurrentTimeCp)
+			TimeCp = 0;
+		ASSERT_FALSE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+	}
+
+	std::shared_ptr<CScoreLeaderboardResult> LoadLeaderboard(const char *pServer)
+	{
+		auto pResult = std::make_shared<CScoreLeaderboardResult>();
+		CSqlLoadLeaderboardData Data(pResult);
+		str_copy(Data.m_aMap, "Kobra 3", sizeof(Data.m_aMap));
+		str_copy(Data.m_aServer, pServer, sizeof(Data.m_aServer));
+		EXPECT_FALSE(CScoreWorker::LoadLeaderboard(m_pConn, &Data, m_aError, sizeof(m_aError))) << m_aError;
+		return pResult;
+	}
+
+	void ExpectSameAsQuery(const CScoreLeaderboardResult &Leaderboard, bool (*pQuery)(IDbConnection *, const ISqlData *, char *, int),
+		void (*pCached)(const CLeaderboard &, const CLeaderboard &, const CSqlPlayerRequest *, CScorePlayerResult *),
+		const char *pName, int Offset)
+	{
+		auto pQueryResult = std::make_shared<CScorePlayerResult>();
+		auto pCachedResult = std::make_shared<CScorePlayerResult>();
+		CSqlPlayerRequest Request(pQueryResult);
+		str_copy(Request.m_aName, pName, sizeof(Request.m_aName));
+		str_copy(Request.m_aMap, "Kobra 3", sizeof(Request.m_aMap));
+		str_copy(Request.m_aRequestingPlayer, "tee 1", sizeof(Request.m_aRequestingPlayer));
+		str_copy(Request.m_aServer, Leaderboard.m_aServer, sizeof(Request.m_aServer));
+		Request.m_Offset = Offset;
+		ASSERT_FALSE(pQuery(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+		pCached(Leaderboard.m_Global, Leaderboard.m_Regional, &Request, pCachedResult.get());
+
+		EXPECT_EQ(pCachedResult->m_MessageKind, pQueryResult->m_MessageKind);
+		for(int i = 0; i < CScorePlayerResult::MAX_MESSAGES; i++)
+			EXPECT_STREQ(pCachedResult->m_Data.m_aaMessages[i], pQueryResult->m_Data.m_aaMessages[i]) << "name=" << pName << " offset=" << Offset;
+	}
+
+	void ExpectSameAsQueries(const CScoreLeaderboardResult &Leaderboard)
+	{
+		for(int Regional = 0; Regional <= 1; Regional++)
+		{
+			for(int HideScore = 0; HideScore <= 1; HideScore++)
+			{
+				g_Config.m_SvRegionalRankings = Regional;
+				g_Config.m_SvHideScore = HideScore;
+				for(int i = 0; i <= NUM_PLAYERS + 2; i++)
+				{
+					char aName[MAX_NAME_LENGTH];
+					str_format(aName, sizeof(aName), "tee %d", i);
+					ExpectSameAsQuery(Leaderboard, CScoreWorker::ShowRank, CScoreWorker::ShowRank, aName, 0);
+				}
+			}
+			for(int Offset : {0, 1, 2, 5, 17, NUM_PLAYERS - 1, NUM_PLAYERS + 5, -1, -3, -(NUM_PLAYERS - 2), -(NUM_PLAYERS + 5)})
+				ExpectSameAsQuery(Leaderboard, CScoreWorker::ShowTop, CScoreWorker::ShowTop, "", Offset);
+		}
+	}
+};
+
+TEST_P(CachedScore, SameAsQueries)
+{
+	for(const char *pServer : {"GER", "USA", "RUS"})
+	{
+		auto pLeaderboard = LoadLeaderboard(pServer);
+		EXPECT_EQ(pLeaderboard->m_Global.Size(), NUM_PLAYERS);
+		ExpectSameAsQueries(*pLeaderboard);
+	}
+}
+
+TEST_P(CachedScore, Insert)
+{
+	auto pLeaderboard = LoadLeaderboard("GER");
+	// improvements, slower finishes and first finishes, with more decimals
+	// than the database keeps
+	for(int i = 0; i < 20; i++)
+	{
+		char aName[MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "tee %d", i * 3);
+		float Time = 20.0f + i * 7.003f;
+		InsertFinish(aName, Time, "GER");
+		pLeaderboard->m_Global.Insert(aName, Time);
+		pLeaderboard->m_Regional.Insert(aName, Time);
+	}
+	ExpectSameAsQueries(*pLeaderboard);
+
+	auto pReloaded = LoadLeaderboard("GER");
+	EXPECT_EQ(pReloaded->m_Global.Size(), pLeaderboard->m_Global.Size());
+	EXPECT_EQ(pReloaded->m_Regional.Size(), pLeaderboard->m_Regional.Size());
+}
+
+TEST_P(CachedScore, DISABLED_Benchmark)
+{
+	for(int i = NUM_PLAYERS; i < 2000; i++)
+	{
+		char aName[MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "tee %d", i);
+		InsertFinish(aName, 30.0f + (i * 7919 % 10007) / 100.0f, "GER");
+	}
+	auto pLeaderboard = LoadLeaderboard("GER");
+
+	static const int NUM_QUERIES = 100;
+	int64_t aDuration[2] = {0, 0};
+	for(int i = 0; i < NUM_QUERIES; i++)
+	{
+		auto pResult = std::make_shared<CScorePlayerResult>();
+		CSqlPlayerRequest Request(pResult);
+		str_format(Request.m_aName, sizeof(Request.m_aName), "tee %d", i * 19);
+		str_copy(Request.m_aMap, "Kobra 3", sizeof(Request.m_aMap));
+		str_copy(Request.m_aRequestingPlayer, "tee 1", sizeof(Request.m_aRequestingPlayer));
+		str_copy(Request.m_aServer, "GER", sizeof(Request.m_aServer));
+		Request.m_Offset = 0;
+
+		int64_t Start = time_get_impl();
+		ASSERT_FALSE(CScoreWorker::ShowRank(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+		aDuration[0] += time_get_impl() - Start;
+		Start = time_get_impl();
+		CScoreWorker::ShowRank(pLeaderboard->m_Global, pLeaderboard->m_Regional, &Request, pResult.get());
+		aDuration[1] += time_get_impl() - Start;
+	}
+	dbg_msg("score", "%d /rank with 2000 players: query %.1f us, leaderboard %.1f us",
+		NUM_QUERIES, aDuration[0] * 1000000.0 / time_freq() / NUM_QUERIES, aDuration[1] * 1000000.0 / time_freq() / NUM_QUERIES);
+}
+
+struct StatementCache : public Score
+{
+	~StatementCache()
+	{
+		m_pConn->SetMaxCachedStatements(16);
+	}
+
+	CDbStatementStats Stats(const char *pSql)
+	{
+		std::vector<std::pair<std::string, CDbStatementStats>> vStats;
+		m_pConn->GetStatementStats(&vStats);
+		for(const auto &[Sql, Stats] : vStats)
+			if(Sql == pSql)
+				return Stats;
+		return {};
+	}
+
+	int SelectNumber(const char *pSql, int Number)
+	{
+		EXPECT_FALSE(m_pConn->PrepareStatement(pSql, m_aError, sizeof(m_aError))) << m_aError;
+		m_pConn->BindInt(1, Number);
+		bool End;
+		EXPECT_FALSE(m_pConn->Step(&End, m_aError, sizeof(m_aError))) << m_aError;
+		EXPECT_FALSE(End);
+		return m_pConn->GetInt(1);
+	}
+};
+
+TEST_P(StatementCache, Reuse)
+{
+	// the cached statement is executed with the new values, also if the
+	// rows of the last execution weren't all fetched
+	for(int i = 0; i < 5; i++)
+		EXPECT_EQ(SelectNumber("SELECT ? + 1 UNION ALL SELECT 0", i), i + 1);
+	CDbStatementStats Select = Stats("SELECT ? + 1 UNION ALL SELECT 0");
+	EXPECT_EQ(Select.m_NumPrepared, 1);
+	EXPECT_EQ(Select.m_NumExecuted, 5);
+}
+
+TEST_P(StatementCache, Evict)
+{
+	m_pConn->SetMaxCachedStatements(2);
+	EXPECT_EQ(SelectNumber("SELECT ? + 1", 1), 2);
+	EXPECT_EQ(SelectNumber("SELECT ? + 2", 1), 3);
+	EXPECT_EQ(SelectNumber("SELECT ? + 1", 2), 3);
+	// the least recently used statement is closed
+	EXPECT_EQ(SelectNumber("SELECT ? + 3", 1), 4);
+	EXPECT_EQ(Stats("SELECT ? + 2").m_NumPrepared, 0);
+	EXPECT_EQ(SelectNumber("SELECT ? + 2", 2), 4);
+	EXPECT_EQ(Stats("SELECT ? + 2").m_NumPrepared, 1);
+	EXPECT_EQ(Stats("SELECT ? + 1").m_NumPrepared, 0);
+
+	std::vector<std::pair<std::string, CDbStatementStats>> vStats;
+	m_pConn->GetStatementStats(&vStats);
+	EXPECT_EQ(vStats.size(), 2u);
+}
+
+TEST_P(StatementCache, DISABLED_Benchmark)
+{
+	// what a round on a server does: players join, finish and look at
+	// their rank
+	static const int NUM_ROUNDS = 300;
+	int64_t aDuration[2] = {0, 0};
+	for(int Cached = 0; Cached <= 1; Cached++)
+	{
+		m_pConn->SetMaxCachedStatements(Cached ? 16 : 0);
+		int64_t Start = time_get_impl();
+		for(int i = 0; i < NUM_ROUNDS; i++)
+		{
+			auto pResult = std::make_shared<CScorePlayerResult>();
+			CSqlPlayerRequest Request(pResult);
+			str_format(Request.m_aName, sizeof(Request.m_aName), "tee %d", i % 50);
+			str_copy(Request.m_aRequestingPlayer, Request.m_aName, sizeof(Request.m_aRequestingPlayer));
+			str_copy(Request.m_aMap, "Kobra 3", sizeof(Request.m_aMap));
+			str_copy(Request.m_aServer, "GER", sizeof(Request.m_aServer));
+			Request.m_Offset = 0;
+			ASSERT_FALSE(CScoreWorker::LoadPlayerData(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+
+			CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
+			str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+			str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+			str_copy(ScoreData.m_aName, Request.m_aName, sizeof(ScoreData.m_aName));
+			ScoreData.m_ClientId = 0;
+			ScoreData.m_Time = 30.0f + i % 97;
+			str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+			for(float &TimeCp : ScoreData.m_aCurrentTimeCp)
+				TimeCp = 0;
+			ASSERT_FALSE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+
+			ASSERT_FALSE(CScoreWorker::ShowRank(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+		}
+		aDuration[Cached] = time_get_impl() - Start;
+	}
+	dbg_msg("score", "%d rounds of LoadPlayerData, SaveScore and ShowRank: uncached %.2f ms, cached %.2f ms",
+		NUM_ROUNDS, aDuration[0] * 1000.0 / time_freq(), aDuration[1] * 1000.0 / time_freq());
+
+	std::vector<std::pair<std::string, CDbStatementStats>> vStats;
+	m_pConn->GetStatementStats(&vStats);
+	for(const auto &[Sql, Stats] : vStats)
+		dbg_msg("score", "prepared %d, executed %d, %.2f ms: %.60s", Stats.m_NumPrepared, Stats.m_NumExecuted, Stats.m_ExecuteTime * 1000.0 / time_freq(), Sql.c_str());
+}
+
 auto g_pSqliteConn = CreateSqliteConnection(":memory:", true);
 #if defined(CONF_TEST_MYSQL)
 CMysqlConfig gMysqlConfig{
@@ -624,3 +907,5 @@ INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
 INSTANTIATE(RandomMap);
+INSTANTIATE(CachedScore);
+INSTANTIATE(StatementCache);
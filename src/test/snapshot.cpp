@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/shared/snapshot.h>
 #include <game/generated/protocol.h>
@@ -83,3 +84,93 @@ TEST(Snapshot, CrcOverflow)
 
 	ASSERT_EQ(pSnapshot->Crc(), 1);
 }
+
+TEST(SnapshotStorage, AddGetPurge)
+{
+	CSnapshotStorage Storage;
+	char aData[CSnapshot::MAX_SIZE];
+	char aAltData[64];
+	for(int Tick = 0; Tick < 10; Tick++)
+	{
+		mem_zero(aData, sizeof(aData));
+		mem_zero(aAltData, sizeof(aAltData));
+		aData[0] = Tick;
+		aAltData[0] = -Tick;
+		Storage.Add(Tick, Tick * 100, 100 + Tick, aData, Tick % 2 ? sizeof(aAltData) : 0, aAltData);
+	}
+
+	int64_t Tagtime;
+	const CSnapshot *pData;
+	const CSnapshot *pAltData;
+	ASSERT_EQ(Storage.Get(3, &Tagtime, &pData, &pAltData), 103);
+	EXPECT_EQ(Tagtime, 300);
+	EXPECT_EQ(((const char *)pData)[0], 3);
+	ASSERT_NE(pAltData, nullptr);
+	EXPECT_EQ(((const char *)pAltData)[0], -3);
+	ASSERT_EQ(Storage.Get(4, nullptr, &pData, &pAltData), 104);
+	EXPECT_EQ(pAltData, nullptr);
+	EXPECT_EQ(Storage.Get(10, nullptr, nullptr, nullptr), -1);
+
+	Storage.PurgeUntil(5);
+	EXPECT_EQ(Storage.Get(4, nullptr, nullptr, nullptr), -1);
+	ASSERT_NE(Storage.m_pFirst, nullptr);
+	EXPECT_EQ(Storage.m_pFirst->m_Tick, 5);
+	EXPECT_EQ(Storage.m_pFirst->m_pPrev, nullptr);
+	EXPECT_EQ(Storage.m_pLast->m_Tick, 9);
+	ASSERT_EQ(Storage.Get(9, nullptr, &pData, nullptr), 109);
+	EXPECT_EQ(((const char *)pData)[0], 9);
+
+	Storage.PurgeUntil(100);
+	EXPECT_EQ(Storage.m_pFirst, nullptr);
+	EXPECT_EQ(Storage.m_pLast, nullptr);
+
+	Storage.PurgeAll();
+	EXPECT_EQ(Storage.NumChunks(), 0);
+	EXPECT_EQ(Storage.ChunkBytes(), 0u);
+}
+
+TEST(SnapshotStorage, ReuseChunks)
+{
+	CSnapshotStorage Storage;
+	char aData[CSnapshot::MAX_SIZE];
+	mem_zero(aData, sizeof(aData));
+
+	// keep a window of 150 ticks like the server does
+	int MaxChunks = 0;
+	for(int Tick = 0; Tick < 2000; Tick++)
+	{
+		Storage.PurgeUntil(Tick - 150);
+		Storage.Add(Tick, Tick, 2000 + (Tick * 37) % 3000, aData, 0, nullptr);
+		if(Tick == 500)
+			MaxChunks = Storage.NumChunks();
+		ASSERT_EQ(Storage.m_pFirst->m_Tick, maximum(Tick - 150, 0));
+	}
+	// no new chunks once the window is full
+	EXPECT_EQ(Storage.NumChunks(), MaxChunks);
+}
+
+TEST(SnapshotStorage, Large)
+{
+	CSnapshotStorage Storage;
+	static char s_aData[CSnapshot::MAX_SIZE];
+	for(int i = 0; i < (int)sizeof(s_aData); i++)
+		s_aData[i] = i;
+
+	// bigger than a chunk with the alternative snapshot
+	for(int Tick = 0; Tick < 10; Tick++)
+	{
+		Storage.PurgeUntil(Tick - 2);
+		Storage.Add(Tick, 0, sizeof(s_aData), s_aData, sizeof(s_aData), s_aData);
+		if(Tick % 3 == 0)
+			Storage.Add(Tick, 0, 16, s_aData, 0, nullptr);
+	}
+
+	const CSnapshot *pData;
+	const CSnapshot *pAltData;
+	for(int Tick = 7; Tick < 10; Tick++)
+	{
+		ASSERT_EQ(Storage.Get(Tick, nullptr, &pData, &pAltData), (int)sizeof(s_aData));
+		EXPECT_EQ(mem_comp(pData, s_aData, sizeof(s_aData)), 0);
+		EXPECT_EQ(mem_comp(pAltData, s_aData, sizeof(s_aData)), 0);
+	}
+}
@@ -0,0 +1,326 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <game/prng.h>
+#include <game/server/spatial_grid.h>
+
+#include <algorithm>
+#include <vector>
+
+class CGridTestItem
+{
+public:
+	vec2 m_Pos;
+	CSpatialGrid<CGridTestItem>::CHandle m_Handle;
+};
+
+static std::vector<CGridTestItem *> QueryItems(const CSpatialGrid<CGridTestItem> &Grid, vec2 Min, vec2 Max)
+{
+	std::vector<CGridTestItem *> vpItems;
+	Grid.Query(Min, Max, [&](CGridTestItem *pItem) { vpItems.push_back(pItem); });
+	return vpItems;
+}
+
+static bool Contains(const std::vector<CGridTestItem *> &vpItems, const CGridTestItem *pItem)
+{
+	return std::find(vpItems.begin(), vpItems.end(), pItem) != vpItems.end();
+}
+
+static float RandomCoordinate(CPrng *pPrng, float Size)
+{
+	// a bit outside of the map too
+	return (pPrng->RandomBits() % 100000) / 100000.0f * Size * 1.2f - Size * 0.1f;
+}
+
+TEST(SpatialGrid, InsertMoveRemove)
+{
+	CSpatialGrid<CGridTestItem> Grid;
+	Grid.Init(100, 100);
+	const float Cell = CSpatialGrid<CGridTestItem>::CELL_SIZE;
+
+	CGridTestItem aItems[3];
+	aItems[0].m_Pos = vec2(10, 10);
+	aItems[1].m_Pos = vec2(15, 15);
+	aItems[2].m_Pos = vec2(Cell * 10 + 5, Cell * 10 + 5);
+	for(auto &Item : aItems)
+	{
+		Grid.Insert(&Item, &Item.m_Handle, Item.m_Pos);
+		EXPECT_TRUE(Item.m_Handle.IsInserted());
+	}
+
+	EXPECT_EQ(Grid.Size(), 3);
+	EXPECT_EQ(Grid.NumCells(vec2(0, 0), vec2(Cell, Cell / 2)), 2);
+
+	std::vector<CGridTestItem *> vpItems = QueryItems(Grid, vec2(0, 0), vec2(1, 1));
+	EXPECT_EQ(vpItems.size(), 2u);
+	EXPECT_TRUE(Contains(vpItems, &aItems[0]));
+	EXPECT_TRUE(Contains(vpItems, &aItems[1]));
+
+	// removing the first item of a cell keeps the others
+	Grid.Remove(&aItems[0].m_Handle);
+	EXPECT_FALSE(aItems[0].m_Handle.IsInserted());
+	vpItems = QueryItems(Grid, vec2(0, 0), vec2(1, 1));
+	EXPECT_EQ(vpItems, std::vector<CGridTestItem *>{&aItems[1]});
+	Grid.Remove(&aItems[0].m_Handle);
+	EXPECT_EQ(Grid.Size(), 2);
+
+	// moving within the cell
+	aItems[1].m_Pos = vec2(20, 20);
+	EXPECT_FALSE(Grid.Move(&aItems[1], &aItems[1].m_Handle, aItems[1].m_Pos));
+
+	// moving to another cell
+	aItems[1].m_Pos = vec2(Cell * 10 + 20, Cell * 10 + 20);
+	EXPECT_TRUE(Grid.Move(&aItems[1], &aItems[1].m_Handle, aItems[1].m_Pos));
+	EXPECT_TRUE(QueryItems(Grid, vec2(0, 0), vec2(1, 1)).empty());
+	vpItems = QueryItems(Grid, aItems[2].m_Pos, aItems[2].m_Pos);
+	EXPECT_EQ(vpItems.size(), 2u);
+	EXPECT_TRUE(Contains(vpItems, &aItems[1]));
+	EXPECT_TRUE(Contains(vpItems, &aItems[2]));
+	EXPECT_EQ(Grid.Size(), 2);
+
+	// positions outside of the map end up at the border
+	aItems[2].m_Pos = vec2(-10000, 1e9);
+	Grid.Move(&aItems[2], &aItems[2].m_Handle, aItems[2].m_Pos);
+	EXPECT_EQ(QueryItems(Grid, vec2(-20000, 5e8), vec2(-5000, 2e9)), std::vector<CGridTestItem *>{&aItems[2]});
+	EXPECT_EQ(QueryItems(Grid, vec2(0, 100 * 32 - 1), vec2(1, 100 * 32 - 1)), std::vector<CGridTestItem *>{&aItems[2]});
+
+	// resizing keeps the items
+	Grid.Init(1000, 1000);
+	vpItems = QueryItems(Grid, vec2(-1e9, -1e9), vec2(1e9, 1e9));
+	EXPECT_EQ(vpItems.size(), 2u);
+	EXPECT_TRUE(QueryItems(Grid, vec2(0, 100 * 32 - 1), vec2(1, 100 * 32 - 1)).empty());
+}
+
+TEST(SpatialGrid, Random)
+{
+	CPrng Prng;
+	uint64_t aSeed[2] = {1, 2};
+	Prng.Seed(aSeed);
+
+	const int Size = 50;
+	const float WorldSize = Size * 32.0f;
+	CSpatialGrid<CGridTestItem> Grid;
+	Grid.Init(Size, Size);
+	std::vector<CGridTestItem> vItems(500);
+	for(auto &Item : vItems)
+	{
+		Item.m_Pos = vec2(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+		Grid.Insert(&Item, &Item.m_Handle, Item.m_Pos);
+	}
+
+	for(int Round = 0; Round < 200; Round++)
+	{
+		for(auto &Item : vItems)
+		{
+			if(Prng.RandomBits() % 4 == 0)
+			{
+				Item.m_Pos = vec2(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+				Grid.Move(&Item, &Item.m_Handle, Item.m_Pos);
+			}
+		}
+
+		vec2 Min(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+		vec2 Max = Min + vec2(Prng.RandomBits() % 300, Prng.RandomBits() % 300);
+		std::vector<CGridTestItem *> vpItems = QueryItems(Grid, Min, Max);
+
+		// every item is reported once and all items in the box are found
+		std::vector<CGridTestItem *> vpSorted = vpItems;
+		std::sort(vpSorted.begin(), vpSorted.end());
+		EXPECT_EQ(std::unique(vpSorted.begin(), vpSorted.end()), vpSorted.end());
+		for(auto &Item : vItems)
+		{
+			bool Inside = Item.m_Pos.x >= Min.x && Item.m_Pos.x <= Max.x && Item.m_Pos.y >= Min.y && Item.m_Pos.y <= Max.y;
+			EXPECT_TRUE(!Inside || Contains(vpItems, &Item));
+		}
+	}
+}
+
+TEST(SpatialGrid, DISABLED_Benchmark)
+{
+	// 64 players and 1000 turrets on a 500x500 map, every turret looking
+	// for players in its range every tick
+	static const int SIZE = 500;
+	static const int NUM_PLAYERS = 64;
+	static const int NUM_TURRETS = 1000;
+	static const int NUM_TICKS = 50;
+	static const float RANGE = 700.0f;
+	const float WorldSize = SIZE * 32.0f;
+
+	CPrng Prng;
+	uint64_t aSeed[2] = {3, 4};
+	Prng.Seed(aSeed);
+
+	CSpatialGrid<CGridTestItem> Grid;
+	Grid.Init(SIZE, SIZE);
+	std::vector<CGridTestItem> vPlayers(NUM_PLAYERS);
+	for(auto &Player : vPlayers)
+	{
+		Player.m_Pos = vec2(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+		Grid.Insert(&Player, &Player.m_Handle, Player.m_Pos);
+	}
+	std::vector<vec2> vTurrets(NUM_TURRETS);
+	for(auto &Turret : vTurrets)
+		Turret = vec2(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+
+	int64_t ScanTime = 0;
+	int64_t GridTime = 0;
+	int ScanFound = 0;
+	int GridFound = 0;
+	for(int Tick = 0; Tick < NUM_TICKS; Tick++)
+	{
+		int64_t Start = time_get_impl();
+		for(auto &Player : vPlayers)
+		{
+			Player.m_Pos += vec2((int)(Prng.RandomBits() % 21) - 10, (int)(Prng.RandomBits() % 21) - 10);
+			Grid.Move(&Player, &Player.m_Handle, Player.m_Pos);
+		}
+		GridTime += time_get_impl() - Start;
+
+		Start = time_get_impl();
+		for(const vec2 &Turret : vTurrets)
+			for(const auto &Player : vPlayers)
+				if(distance(Turret, Player.m_Pos) < RANGE)
+					ScanFound++;
+		ScanTime += time_get_impl() - Start;
+
+		Start = time_get_impl();
+		for(const vec2 &Turret : vTurrets)
+		{
+			Grid.Query(Turret - vec2(RANGE, RANGE), Turret + vec2(RANGE, RANGE), [&](const CGridTestItem *pPlayer) {
+				if(distance(Turret, pPlayer->m_Pos) < RANGE)
+					GridFound++;
+			});
+		}
+		GridTime += time_get_impl() - Start;
+	}
+
+	EXPECT_EQ(GridFound, ScanFound);
+	dbg_msg("spatial_grid", "%d players, %d turrets: scan %.3f us/tick, grid %.3f us/tick",
+		NUM_PLAYERS, NUM_TURRETS, ScanTime / (double)NUM_TICKS * 1000000.0 / time_freq(), GridTime / (double)NUM_TICKS * 1000000.0 / time_freq());
+}
+
+class CBoxTestItem
+{
+public:
+	vec2 m_Min;
+	vec2 m_Max;
+};
+
+static bool Overlaps(const CBoxTestItem &Item, vec2 Min, vec2 Max)
+{
+	return Item.m_Min.x <= Max.x && Item.m_Max.x >= Min.x && Item.m_Min.y <= Max.y && Item.m_Max.y >= Min.y;
+}
+
+TEST(SpatialBoxGrid, Random)
+{
+	CPrng Prng;
+	uint64_t aSeed[2] = {5, 6};
+	Prng.Seed(aSeed);
+
+	const int Size = 50;
+	const float WorldSize = Size * 32.0f;
+	CSpatialBoxGrid<CBoxTestItem> Grid;
+	Grid.Init(Size, Size);
+	std::vector<CBoxTestItem> vItems(500);
+
+	for(int Round = 0; Round < 50; Round++)
+	{
+		// points, short and long lines, some of them leaving the map
+		Grid.Clear();
+		for(auto &Item : vItems)
+		{
+			Item.m_Min = vec2(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+			const float Length = Prng.RandomBits() % 3 == 0 ? 0.0f : (Prng.RandomBits() % 2 ? 50.0f : 1000.0f);
+			Item.m_Max = Item.m_Min + vec2(Prng.RandomBits() % 1000 / 1000.0f * Length, Prng.RandomBits() % 1000 / 1000.0f * Length);
+			Grid.Add(&Item, Item.m_Min, Item.m_Max);
+		}
+		Grid.Build();
+		EXPECT_EQ(Grid.Size(), (int)vItems.size());
+
+		for(int Query = 0; Query < 20; Query++)
+		{
+			vec2 Min(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+			vec2 Max = Min + vec2(Prng.RandomBits() % 600, Prng.RandomBits() % 600);
+			std::vector<CBoxTestItem *> vpFound;
+			Grid.Query(Min, Max, [&](CBoxTestItem *pItem) { vpFound.push_back(pItem); });
+
+			// exactly the overlapping items, each of them once
+			std::vector<CBoxTestItem *> vpExpected;
+			for(auto &Item : vItems)
+				if(Overlaps(Item, Min, Max))
+					vpExpected.push_back(&Item);
+			std::sort(vpFound.begin(), vpFound.end());
+			EXPECT_EQ(vpFound, vpExpected);
+		}
+	}
+
+	// cleared grids find nothing
+	Grid.Clear();
+	Grid.Build();
+	int Found = 0;
+	Grid.Query(vec2(-1e9, -1e9), vec2(1e9, 1e9), [&](CBoxTestItem *pItem) { Found++; });
+	EXPECT_EQ(Found, 0);
+}
+
+TEST(SpatialBoxGrid, DISABLED_Benchmark)
+{
+	// 64 clients looking at 4000 lasers and doors on a 1000x1000 map, the
+	// grid is rebuilt every snapshot
+	static const int SIZE = 1000;
+	static const int NUM_CLIENTS = 64;
+	static const int NUM_ITEMS = 4000;
+	static const int NUM_SNAPS = 20;
+	const float WorldSize = SIZE * 32.0f;
+	const vec2 ShowDistance(1000.0f, 800.0f);
+
+	CPrng Prng;
+	uint64_t aSeed[2] = {7, 8};
+	Prng.Seed(aSeed);
+
+	std::vector<CBoxTestItem> vItems(NUM_ITEMS);
+	for(auto &Item : vItems)
+	{
+		vec2 From(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+		vec2 To = From + vec2((int)(Prng.RandomBits() % 801) - 400, (int)(Prng.RandomBits() % 801) - 400);
+		Item.m_Min = vec2(minimum(From.x, To.x), minimum(From.y, To.y));
+		Item.m_Max = vec2(maximum(From.x, To.x), maximum(From.y, To.y));
+	}
+	std::vector<vec2> vViews(NUM_CLIENTS);
+	for(auto &View : vViews)
+		View = vec2(RandomCoordinate(&Prng, WorldSize), RandomCoordinate(&Prng, WorldSize));
+
+	CSpatialBoxGrid<CBoxTestItem> Grid;
+	Grid.Init(SIZE, SIZE);
+	int64_t ScanTime = 0;
+	int64_t GridTime = 0;
+	int ScanFound = 0;
+	int GridFound = 0;
+	for(int Snap = 0; Snap < NUM_SNAPS; Snap++)
+	{
+		int64_t Start = time_get_impl();
+		for(const vec2 &View : vViews)
+			for(const auto &Item : vItems)
+				if(Overlaps(Item, View - ShowDistance, View + ShowDistance))
+					ScanFound++;
+		ScanTime += time_get_impl() - Start;
+
+		Start = time_get_impl();
+		Grid.Clear();
+		for(auto &Item : vItems)
+			Grid.Add(&Item, Item.m_Min, Item.m_Max);
+		Grid.Build();
+		for(const vec2 &View : vViews)
+		{
+			Grid.Query(View - ShowDistance, View + ShowDistance, [&](const CBoxTestItem *pItem) {
+				if(Overlaps(*pItem, View - ShowDistance, View + ShowDistance))
+					GridFound++;
+			});
+		}
+		GridTime += time_get_impl() - Start;
+	}
+
+	EXPECT_EQ(GridFound, ScanFound);
+	dbg_msg("spatial_grid", "%d clients, %d lasers: scan %.3f us/snap, grid %.3f us/snap",
+		NUM_CLIENTS, NUM_ITEMS, ScanTime / (double)NUM_SNAPS * 1000000.0 / time_freq(), GridTime / (double)NUM_SNAPS * 1000000.0 / time_freq());
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/spsc_queue.h>
+
+#include <thread>
+
+TEST(SpscQueue, Empty)
+{
+	CSpscQueue<int, 4> Queue;
+	EXPECT_TRUE(Queue.Empty());
+	EXPECT_EQ(Queue.Size(), 0u);
+	EXPECT_FALSE(Queue.TryPop([](int &) { FAIL(); }));
+}
+
+TEST(SpscQueue, Full)
+{
+	CSpscQueue<int, 4> Queue;
+	for(int i = 0; i < 4; i++)
+		EXPECT_TRUE(Queue.TryPush([i](int &Slot) { Slot = i; }));
+	EXPECT_EQ(Queue.Size(), 4u);
+	EXPECT_FALSE(Queue.TryPush([](int &) { FAIL(); }));
+	EXPECT_TRUE(Queue.TryPop([](int &Slot) { EXPECT_EQ(Slot, 0); }));
+	EXPECT_TRUE(Queue.TryPush([](int &Slot) { Slot = 4; }));
+	for(int i = 1; i <= 4; i++)
+		EXPECT_TRUE(Queue.TryPop([i](int &Slot) { EXPECT_EQ(Slot, i); }));
+	EXPECT_TRUE(Queue.Empty());
+}
+
+TEST(SpscQueue, Wraparound)
+{
+	CSpscQueue<int, 4> Queue;
+	for(int i = 0; i < 1000; i++)
+	{
+		EXPECT_TRUE(Queue.TryPush([i](int &Slot) { Slot = i; }));
+		EXPECT_TRUE(Queue.TryPush([i](int &Slot) { Slot = -i; }));
+		EXPECT_TRUE(Queue.TryPop([i](int &Slot) { EXPECT_EQ(Slot, i); }));
+		EXPECT_TRUE(Queue.TryPop([i](int &Slot) { EXPECT_EQ(Slot, -i); }));
+	}
+}
+
+TEST(SpscQueue, Threads)
+{
+	static const int NUM_ITEMS = 100000;
+	CSpscQueue<int, 64> Queue;
+
+	std::thread Producer([&Queue]() {
+		for(int i = 0; i < NUM_ITEMS; i++)
+		{
+			while(!Queue.TryPush([i](int &Slot) { Slot = i; }))
+				std::this_thread::yield();
+		}
+	});
+
+	// items must arrive exactly once and in order
+	int Next = 0;
+	while(Next < NUM_ITEMS)
+	{
+		if(!Queue.TryPop([&](int &Slot) { ASSERT_EQ(Slot, Next); }))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		Next++;
+	}
+
+	Producer.join();
+	EXPECT_TRUE(Queue.Empty());
+}
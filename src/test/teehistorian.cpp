@@ -1,3 +1,4 @@
+#include "test.h"
 #include <gtest/gtest.h>
 
 #include <base/detect.h>
@@ -9,6 +10,8 @@
 
 #include <vector>
 
+#include <zlib.h>
+
 void RegisterGameUuids(CUuidManager *pManager);
 
 class TeeHistorian : public ::testing::Test
@@ -223,6 +226,57 @@ protected:
 		Char.m_Y = y;
 		m_TH.RecordPlayer(ClientId, &Char);
 	}
+
+	// writes the recorded data through the compression filter like the
+	// server does with sv_tee_historian_compression
+	void WriteCompressed(const char *pFilename, CTeeHistorianCompression *pCompression)
+	{
+		IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+		ASYNCIO *pAio = aio_new_filtered(File, CTeeHistorianCompression::Filter, pCompression);
+		for(size_t i = 0; i < m_vBuffer.size(); i += 1024)
+		{
+			aio_write(pAio, &m_vBuffer[i], minimum<size_t>(1024, m_vBuffer.size() - i));
+		}
+		aio_close(pAio);
+		aio_wait(pAio);
+		EXPECT_EQ(aio_error(pAio), 0);
+		aio_free(pAio);
+	}
+
+	// returns false if the file isn't a complete gzip stream
+	static bool ReadCompressed(const char *pFilename, std::vector<unsigned char> &vOutput)
+	{
+		IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+		if(!File)
+			return false;
+		void *pData;
+		unsigned DataSize;
+		io_read_all(File, &pData, &DataSize);
+		io_close(File);
+
+		z_stream Stream;
+		mem_zero(&Stream, sizeof(Stream));
+		if(inflateInit2(&Stream, 15 + 16) != Z_OK)
+		{
+			free(pData);
+			return false;
+		}
+		Stream.next_in = (Bytef *)pData;
+		Stream.avail_in = DataSize;
+		unsigned char aChunk[16 * 1024];
+		int Result;
+		do
+		{
+			Stream.next_out = aChunk;
+			Stream.avail_out = sizeof(aChunk);
+			Result = inflate(&Stream, Z_NO_FLUSH);
+			WriteBuffer(vOutput, aChunk, sizeof(aChunk) - Stream.avail_out);
+		} while(Result == Z_OK);
+		inflateEnd(&Stream);
+		free(pData);
+		return Result == Z_STREAM_END;
+	}
 };
 
 TEST_F(TeeHistorian, Empty)
@@ -904,3 +958,108 @@ TEST_F(TeeHistorian, PrevGameUuid)
 	EXPECT_STREQ(JsonPrevGameUuid, "fe19c218-f555-4002-a273-126c59ccc17a");
 	json_value_free(pJson);
 }
+
+TEST_F(TeeHistorian, Compressed)
+{
+	CNetObj_PlayerInput Input = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	for(int t = 1; t <= 100; t++)
+	{
+		Tick(t);
+		Player(0, t, -t);
+		Player(1, 2 * t, 1000);
+		Inputs();
+		Input.m_TargetX = t;
+		m_TH.RecordPlayerInput(0, 1, &Input);
+	}
+	Finish();
+
+	CTestInfo Info;
+	CTeeHistorianCompression Compression(6);
+	WriteCompressed(Info.m_aFilename, &Compression);
+	EXPECT_EQ(Compression.InputSize(), (int64_t)m_vBuffer.size());
+
+	std::vector<unsigned char> vDecompressed;
+	ASSERT_TRUE(ReadCompressed(Info.m_aFilename, vDecompressed));
+	ASSERT_EQ(vDecompressed.size(), m_vBuffer.size());
+	EXPECT_TRUE(mem_comp(vDecompressed.data(), m_vBuffer.data(), m_vBuffer.size()) == 0);
+
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	EXPECT_EQ((int64_t)io_length(File), Compression.OutputSize());
+	EXPECT_LT(Compression.OutputSize(), Compression.InputSize());
+	io_close(File);
+	fs_remove(Info.m_aFilename);
+}
+
+TEST_F(TeeHistorian, CompressedEmpty)
+{
+	CTestInfo Info;
+	CTeeHistorianCompression Compression(6);
+	WriteCompressed(Info.m_aFilename, &Compression);
+
+	std::vector<unsigned char> vDecompressed;
+	ASSERT_TRUE(ReadCompressed(Info.m_aFilename, vDecompressed));
+	ASSERT_EQ(vDecompressed.size(), m_vBuffer.size());
+	EXPECT_TRUE(mem_comp(vDecompressed.data(), m_vBuffer.data(), m_vBuffer.size()) == 0);
+	fs_remove(Info.m_aFilename);
+}
+
+TEST_F(TeeHistorian, DISABLED_CompressionBenchmark)
+{
+	// five minutes of 64 players running around and changing their input
+	// every few ticks
+	const int NUM_PLAYERS = 64;
+	const int NUM_TICKS = 5 * 60 * SERVER_TICK_SPEED;
+	unsigned Seed = 0x13371337;
+	auto Random = [&Seed](int Max) {
+		Seed = Seed * 1103515245 + 12345;
+		return (int)((Seed >> 16) % Max);
+	};
+	int aX[NUM_PLAYERS];
+	int aVelX[NUM_PLAYERS];
+	CNetObj_PlayerInput aInputs[NUM_PLAYERS];
+	for(int i = 0; i < NUM_PLAYERS; i++)
+	{
+		aX[i] = Random(200 * 32);
+		aVelX[i] = 0;
+		mem_zero(&aInputs[i], sizeof(aInputs[i]));
+	}
+	for(int t = 1; t <= NUM_TICKS; t++)
+	{
+		Tick(t);
+		for(int i = 0; i < NUM_PLAYERS; i++)
+		{
+			aVelX[i] = clamp(aVelX[i] + aInputs[i].m_Direction, -10, 10);
+			aX[i] += aVelX[i];
+			Player(i, aX[i], 500 + Random(3));
+		}
+		Inputs();
+		for(int i = 0; i < NUM_PLAYERS; i++)
+		{
+			if(Random(10) != 0)
+				continue;
+			aInputs[i].m_Direction = Random(3) - 1;
+			aInputs[i].m_TargetX = Random(400) - 200;
+			aInputs[i].m_TargetY = Random(400) - 200;
+			aInputs[i].m_Jump = Random(2);
+			m_TH.RecordPlayerInput(i, i + 1, &aInputs[i]);
+		}
+	}
+	Finish();
+
+	for(int Level : {1, 6})
+	{
+		CTestInfo Info;
+		CTeeHistorianCompression Compression(Level);
+		WriteCompressed(Info.m_aFilename, &Compression);
+		std::vector<unsigned char> vDecompressed;
+		ASSERT_TRUE(ReadCompressed(Info.m_aFilename, vDecompressed));
+		ASSERT_EQ(vDecompressed.size(), m_vBuffer.size());
+		fs_remove(Info.m_aFilename);
+
+		dbg_msg("teehistorian", "level %d: compressed %" PRId64 " to %" PRId64 " bytes (%.1f%%) in %.2f ms on the writer thread",
+			Level, Compression.InputSize(), Compression.OutputSize(),
+			100.0f * Compression.OutputSize() / Compression.InputSize(),
+			Compression.CompressTime() * 1000.0f / time_freq());
+	}
+}
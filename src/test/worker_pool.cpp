@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/worker_pool.h>
+
+#include <atomic>
+#include <vector>
+
+TEST(WorkerPool, SingleThread)
+{
+	CWorkerPool Pool;
+	Pool.Init(1);
+	EXPECT_EQ(Pool.NumThreads(), 1);
+
+	std::vector<int> vOrder;
+	Pool.Run(5, [&](int Item, int Thread) {
+		EXPECT_EQ(Thread, 0);
+		vOrder.push_back(Item);
+	});
+	EXPECT_EQ(vOrder, std::vector<int>({0, 1, 2, 3, 4}));
+}
+
+TEST(WorkerPool, Empty)
+{
+	CWorkerPool Pool;
+	Pool.Init(4);
+	Pool.Run(0, [](int, int) { FAIL(); });
+}
+
+TEST(WorkerPool, AllItemsOnce)
+{
+	static const int NUM_THREADS = 4;
+	static const int NUM_ITEMS = 1000;
+	CWorkerPool Pool;
+	Pool.Init(NUM_THREADS);
+	EXPECT_EQ(Pool.NumThreads(), NUM_THREADS);
+
+	// run several batches to reuse the threads
+	for(int Batch = 0; Batch < 50; Batch++)
+	{
+		std::vector<std::atomic<int>> vCount(NUM_ITEMS);
+		std::atomic<bool> WrongThread(false);
+		Pool.Run(NUM_ITEMS, [&](int Item, int Thread) {
+			if(Thread < 0 || Thread >= NUM_THREADS)
+				WrongThread = true;
+			vCount[Item]++;
+		});
+		EXPECT_FALSE(WrongThread);
+		for(int i = 0; i < NUM_ITEMS; i++)
+			ASSERT_EQ(vCount[i], 1) << "batch " << Batch << " item " << i;
+	}
+}
+
+TEST(WorkerPool, PerThreadState)
+{
+	// items processed by the same thread index never overlap
+	static const int NUM_THREADS = 3;
+	CWorkerPool Pool;
+	Pool.Init(NUM_THREADS);
+	std::atomic<int> aBusy[NUM_THREADS] = {};
+	std::atomic<bool> Overlap(false);
+	Pool.Run(300, [&](int Item, int Thread) {
+		if(aBusy[Thread].fetch_add(1) != 0)
+			Overlap = true;
+		volatile int Sum = 0;
+		for(int i = 0; i < 1000; i++)
+			Sum = Sum + i;
+		aBusy[Thread].fetch_sub(1);
+	});
+	EXPECT_FALSE(Overlap);
+}
+
+TEST(WorkerPool, Reinit)
+{
+	CWorkerPool Pool;
+	Pool.Init(4);
+	Pool.Init(2);
+	EXPECT_EQ(Pool.NumThreads(), 2);
+	std::atomic<int> Sum(0);
+	Pool.Run(100, [&](int Item, int) { Sum += Item; });
+	EXPECT_EQ(Sum, 99 * 100 / 2);
+	Pool.Shutdown();
+	EXPECT_EQ(Pool.NumThreads(), 1);
+}